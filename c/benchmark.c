@@ -0,0 +1,801 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Times the renderers on fixed scenes taken from the other programs:    *
+ *      the stills of mandelbrot_set_001, mandelbrot_set_002, and             *
+ *      swipecat_fractal_001, the zoom of mandelbrot_set_gif_001 at several   *
+ *      depths, and the power sweep of mandelbrot_set_gif_002 from r = 1 to   *
+ *      r = 11.                                                               *
+ *          benchmark [--repeat N] [--json FILE] [--simd LEVEL] [--dither]    *
+ *                    [--only PREFIX]                                         *
+ *      Each scene is drawn and saved in stages, each timed on its own:       *
+ *          compute     Iterating every pixel, series included.               *
+ *          color       Turning the results into pixels.                      *
+ *          quantize    Making a palette and dithering, for --dither only.    *
+ *          encode      Compressing a GIF into memory.                        *
+ *          write       Saving the file.                                      *
+ *      and once more as the programs draw it, with fractal_render, which may *
+ *      fill regions in by subdivision (render). The best of N runs, 3 by     *
+ *      default, is kept for each stage. Results are printed as a table and,  *
+ *      with --json, saved as JSON, FILE being - for standard output.         *
+ *                                                                            *
+ *      Everything runs on the calling thread, so that the kernels are        *
+ *      measured and not the scheduling. --simd scalar, avx2, or avx512       *
+ *      forces a kernel, see fractal_simd.h. GIF scenes are a single frame,   *
+ *      in the fixed palette the programs use with --global-palette, or with  *
+ *      --dither in a palette made and dithered for the frame, as they do by  *
+ *      default. --only runs the scenes whose names start with PREFIX, such   *
+ *      as zoom or sweep.                                                     *
+ ******************************************************************************/
+
+/*  clock_gettime is POSIX, rather than C99.                                  */
+#define _POSIX_C_SOURCE 200809L
+
+/*  printf, puts, fopen, and setvbuf found here.                              */
+#include <stdio.h>
+
+/*  malloc, free, and strtoul found here.                                     */
+#include <stdlib.h>
+
+/*  strcmp, strncmp, and strlen found here.                                   */
+#include <string.h>
+
+/*  clock_gettime found here.                                                 */
+#include <time.h>
+
+/*  GifBeginStream, GifQuantizeFrame, and the frame writers found here.       */
+#include "gif.h"
+
+/*  The fractals, colorings, renderers, and deep zooms found here.            */
+#include "fractal.h"
+
+/*  ppm_begin, ppm_write_rows, and ppm_end found here.                        */
+#include "ppm.h"
+
+/*  Room for every scene below.                                               */
+#define BENCHMARK_MAX_SCENES (32U)
+
+/*  Time between the frames of a GIF, in hundredths of a second.              */
+#define BENCHMARK_GIF_DELAY (2U)
+
+/*  The file each scene is saved to, removed once done.                       */
+#define BENCHMARK_FILENAME "benchmark.tmp"
+
+/*  The stages each scene is timed in, see the Purpose above.                 */
+enum benchmark_stage {
+    BENCHMARK_COMPUTE,
+    BENCHMARK_COLOR,
+    BENCHMARK_QUANTIZE,
+    BENCHMARK_ENCODE,
+    BENCHMARK_WRITE,
+    BENCHMARK_RENDER,
+    BENCHMARK_NUMBER_OF_STAGES
+};
+
+static const char * const
+benchmark_stage_names[BENCHMARK_NUMBER_OF_STAGES] = {
+    "compute", "color", "quantize", "encode", "write", "render"
+};
+
+static const char * const benchmark_precision_names[3] = {
+    "double", "double-double", "perturbation"
+};
+
+static const char * const benchmark_simd_names[3] = {
+    "scalar", "avx2", "avx512"
+};
+
+/*  A scene, set up as the program it comes from sets it up, and its results. */
+struct benchmark_scene {
+    char name[32];
+
+    /*  Boolean for saving a GIF frame, rather than a PPM.                    */
+    int is_gif;
+
+    struct fractal fractal;
+    struct fractal_viewport viewport;
+    struct fractal_renderer renderer;
+    enum fractal_precision precision;
+
+    /*  A copy of the shared reference orbit, with this scene's series.       */
+    struct fractal_reference reference;
+
+    /*  The best time of each stage, in seconds.                              */
+    double seconds[BENCHMARK_NUMBER_OF_STAGES];
+
+    /*  The iterations done by the compute stage, the pixels iterated by the  *
+     *  render stage, and the size of the saved file.                         */
+    unsigned long long iterations;
+    size_t pixels_iterated;
+    long bytes;
+};
+
+/*  Everything shared by the scenes.                                          */
+struct benchmark {
+    struct benchmark_scene scenes[BENCHMARK_MAX_SCENES];
+    unsigned int number_of_scenes;
+
+    /*  The settings from the command line.                                   */
+    unsigned int repeat;
+    const char *json_filename;
+    const char *only;
+    int dither;
+
+    /*  The zoom of mandelbrot_set_gif_001, whose center is given to more     *
+     *  precision than a double holds, and its reference orbit.               */
+    struct fractal_dd_complex center;
+    struct fractal_reference reference;
+    double reference_seconds;
+
+    struct fractal_colormap colormap;
+    unsigned char palette[256U * 3U];
+
+    /*  Buffers big enough for the largest scene.                             */
+    struct fractal_escape *escape;
+    unsigned char *pixels;
+    unsigned char *stream_buffer;
+    size_t stream_size;
+};
+
+/*  The center of the zoom of mandelbrot_set_gif_001.                         */
+static const char * const benchmark_zoom_x = "0.001643721971153";
+static const char * const benchmark_zoom_y = "-0.822467633298876";
+
+/*  Frames of the zoom, in all three precisions, and powers of the sweep,     *
+ *  both integer and not.                                                     */
+static const unsigned int benchmark_zoom_frames[] = {
+    0U, 300U, 480U, 520U, 700U, 999U
+};
+
+static const double benchmark_sweep_powers[] = {
+    1.0, 2.0, 2.5, 3.0, 5.0, 7.5, 11.0
+};
+
+#define BENCHMARK_ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+/*  The time in seconds, from an arbitrary start.                             */
+static double
+benchmark_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + 1.0E-9 * (double)t.tv_nsec;
+}
+
+/*  Adds a scene, unless --only leaves it out. Returns NULL in that case.     */
+static struct benchmark_scene *
+benchmark_add(struct benchmark *b, const char *name, int is_gif)
+{
+    struct benchmark_scene *s;
+
+    if (b->only && strncmp(name, b->only, strlen(b->only)) != 0)
+        return NULL;
+
+    s = &b->scenes[b->number_of_scenes++];
+    strncpy(s->name, name, sizeof(s->name) - 1U);
+    s->name[sizeof(s->name) - 1U] = '\0';
+    s->is_gif = is_gif;
+    s->precision = FRACTAL_PRECISION_DOUBLE;
+    fractal_reference_init(&s->reference);
+
+    s->renderer.fractal = &s->fractal;
+    s->renderer.viewport = &s->viewport;
+    s->renderer.reference = NULL;
+    s->renderer.center = NULL;
+    s->renderer.colormap = NULL;
+    s->renderer.subdivide = FRACTAL_SUBDIVIDE_NONE;
+    return s;
+}
+
+/*  The stills, set up as in mandelbrot_set_001, mandelbrot_set_002, and      *
+ *  swipecat_fractal_001.                                                     */
+static void
+benchmark_add_stills(struct benchmark *b)
+{
+    struct benchmark_scene *s;
+    const double scale_factor = 2.0 / (0.65 * 1024.0);
+
+    if ((s = benchmark_add(b, "mandelbrot_001", 0)))
+    {
+        fractal_init_mandelbrot(&s->fractal);
+        s->viewport.width = 1024U;
+        s->viewport.height = 1024U;
+        s->viewport.x_start = -0.8 - scale_factor * 512.0;
+        s->viewport.y_start = 0.0 - scale_factor * 512.0;
+        s->viewport.x_step = scale_factor;
+        s->viewport.y_step = scale_factor;
+        s->renderer.color = fractal_color_banded;
+        s->renderer.channels = 3U;
+        s->renderer.subdivide = FRACTAL_SUBDIVIDE_BANDS;
+    }
+
+    if ((s = benchmark_add(b, "mandelbrot_002", 0)))
+    {
+        fractal_init_mandelbrot(&s->fractal);
+        fractal_viewport_from_bounds(&s->viewport, 1024U, 1024U,
+                                     -3.0, 1.0, -2.0, 2.0);
+        s->renderer.color = fractal_color_banded;
+        s->renderer.channels = 3U;
+        s->renderer.subdivide = FRACTAL_SUBDIVIDE_BANDS;
+    }
+
+    if ((s = benchmark_add(b, "swipecat_001", 0)))
+    {
+        fractal_init_swipecat(&s->fractal);
+        fractal_viewport_from_bounds(&s->viewport, 1024U, 1024U,
+                                     -6.6, -0.4, -3.5, 3.5);
+        s->renderer.color = fractal_color_smooth;
+        s->renderer.channels = 3U;
+        s->renderer.colormap = &b->colormap;
+    }
+}
+
+/*  The GIF frames are indices into the fixed palette, or RGBA to be          *
+ *  dithered with --dither.                                                   */
+static void
+benchmark_gif_coloring(const struct benchmark *b, struct benchmark_scene *s)
+{
+    s->renderer.color = b->dither ? fractal_color_smooth
+                                  : fractal_index_smooth;
+    s->renderer.channels = b->dither ? 4U : 1U;
+    s->renderer.colormap = &b->colormap;
+}
+
+/*  Frames of the zoom, set up as in mandelbrot_set_gif_001 and drawn in      *
+ *  full, as it does without --keyframes. Returns 0 or -1.                    */
+static int
+benchmark_add_zoom(struct benchmark *b)
+{
+    const double center_x = strtod(benchmark_zoom_x, NULL);
+    const double center_y = strtod(benchmark_zoom_y, NULL);
+    const unsigned int width = 256U;
+    struct fractal mandelbrot;
+    double deepest = 0.0;
+    unsigned int n, k;
+
+    fractal_init_mandelbrot(&mandelbrot);
+    mandelbrot.escape_test = FRACTAL_ESCAPE_REAL_PART;
+    mandelbrot.start_at_c = 0;
+    mandelbrot.check_period = 1;
+    mandelbrot.period_tolerance = 1E-12;
+
+    for (n = 0U; n < BENCHMARK_ARRAY_SIZE(benchmark_zoom_frames); ++n)
+    {
+        const unsigned int frame = benchmark_zoom_frames[n];
+        struct benchmark_scene *s;
+        char name[32];
+        double ds = 3.0;
+
+        sprintf(name, "zoom_%03u", frame);
+
+        if (!(s = benchmark_add(b, name, 1)))
+            continue;
+
+        for (k = 0U; k < frame; ++k)
+            ds *= 0.95;
+
+        s->fractal = mandelbrot;
+        benchmark_gif_coloring(b, s);
+
+        s->precision = fractal_precision_select(center_x, center_y,
+                                                2.0*ds / (double)(width - 1U));
+
+        if (s->precision == FRACTAL_PRECISION_DOUBLE)
+            fractal_viewport_from_center(&s->viewport, width, width,
+                                         center_x, center_y, ds);
+        else
+        {
+            fractal_viewport_from_center(&s->viewport, width, width,
+                                         0.0, 0.0, ds);
+
+            if (deepest == 0.0 || ds < deepest)
+                deepest = ds;
+        }
+
+        fractal_limit_period_tolerance(&s->fractal, s->viewport.x_step);
+    }
+
+    /*  One orbit, precise enough for the deepest frame, serves all of them.  */
+    if (deepest != 0.0)
+    {
+        const double t = benchmark_now();
+
+        if (fractal_dd_from_string(&b->center.real, benchmark_zoom_x) != 0 ||
+            fractal_dd_from_string(&b->center.imag, benchmark_zoom_y) != 0 ||
+            fractal_reference_compute(&b->reference, &mandelbrot,
+                                      benchmark_zoom_x, benchmark_zoom_y,
+                                      2.0*deepest / (double)(width - 1U)) != 0)
+            return -1;
+
+        b->reference_seconds = benchmark_now() - t;
+    }
+
+    /*  Pick double-double or perturbation as mandelbrot_set_gif_001 does.    */
+    for (n = 0U; n < b->number_of_scenes; ++n)
+    {
+        struct benchmark_scene * const s = &b->scenes[n];
+
+        if (strncmp(s->name, "zoom_", 5U) != 0 ||
+            s->precision == FRACTAL_PRECISION_DOUBLE)
+            continue;
+
+        s->reference = b->reference;
+        fractal_series_compute(&s->reference, &s->fractal, &s->viewport);
+
+        if (fractal_precision_prefer_perturbation(&s->reference, &s->fractal))
+        {
+            s->precision = FRACTAL_PRECISION_PERTURBATION;
+            s->renderer.reference = &s->reference;
+        }
+        else
+            s->renderer.center = &b->center;
+    }
+
+    return 0;
+}
+
+/*  Powers of the sweep, set up as in mandelbrot_set_gif_002.                 */
+static void
+benchmark_add_sweep(struct benchmark *b)
+{
+    unsigned int n;
+
+    for (n = 0U; n < BENCHMARK_ARRAY_SIZE(benchmark_sweep_powers); ++n)
+    {
+        const double r = benchmark_sweep_powers[n];
+        struct benchmark_scene *s;
+        char name[32];
+
+        sprintf(name, "sweep_%.1f", r);
+
+        if (!(s = benchmark_add(b, name, 1)))
+            continue;
+
+        fractal_init_multibrot(&s->fractal, r);
+        fractal_viewport_from_center(&s->viewport, 512U, 512U, 0.0, 0.0, 2.0);
+        benchmark_gif_coloring(b, s);
+    }
+}
+
+/*  Saves a scene as a single frame GIF. Everything is written to the stream  *
+ *  buffer until the write stage, which flushes and closes the file.          */
+static int
+benchmark_save_gif(struct benchmark *b, struct benchmark_scene *s,
+                   double *seconds)
+{
+    const unsigned int width = s->viewport.width;
+    const unsigned int height = s->viewport.height;
+    GifWriter writer;
+    GifPalette palette;
+    FILE *f = fopen(BENCHMARK_FILENAME, "wb");
+    double t;
+    int status;
+
+    if (!f || setvbuf(f, (char *)b->stream_buffer, _IOFBF, b->stream_size))
+    {
+        if (f)
+            fclose(f);
+
+        return -1;
+    }
+
+    if (!GifBeginStream(&writer, f, width, height, BENCHMARK_GIF_DELAY,
+                        b->dither ? NULL : b->palette, 8))
+    {
+        GifEnd(&writer);
+        return -1;
+    }
+
+    t = benchmark_now();
+
+    if (b->dither)
+    {
+        if (!GifMakePalette(NULL, b->pixels, width, height, 8, true,
+                            &palette, &writer.paletteScratch) ||
+            !GifQuantizeFrame(&writer, b->pixels, width, height, true,
+                              &palette))
+        {
+            GifEnd(&writer);
+            return -1;
+        }
+
+        seconds[BENCHMARK_QUANTIZE] = benchmark_now() - t;
+        t = benchmark_now();
+        GifWriteQuantizedFrame(&writer, width, height, BENCHMARK_GIF_DELAY,
+                               &palette);
+    }
+    else if (!GifWriteIndexedFrame(&writer, b->pixels, width, height,
+                                   BENCHMARK_GIF_DELAY))
+    {
+        GifEnd(&writer);
+        return -1;
+    }
+
+    seconds[BENCHMARK_ENCODE] = benchmark_now() - t;
+    s->bytes = ftell(f);
+
+    t = benchmark_now();
+    status = fflush(f);
+    GifEnd(&writer);
+    seconds[BENCHMARK_WRITE] = benchmark_now() - t;
+
+    /*  GifEnd adds one byte, the trailer.                                    */
+    s->bytes += 1L;
+    return status == 0 ? 0 : -1;
+}
+
+/*  Saves a scene as a PPM, the way ppm.h writes the stills.                  */
+static int
+benchmark_save_ppm(struct benchmark *b, struct benchmark_scene *s,
+                   double *seconds)
+{
+    struct ppm_writer w;
+    const double t = benchmark_now();
+    int status = 0;
+
+    if (ppm_begin(&w, BENCHMARK_FILENAME, s->viewport.width,
+                  s->viewport.height) != 0 ||
+        ppm_write_rows(&w, b->pixels, s->viewport.height) != 0)
+        status = -1;
+
+    if (ppm_end(&w) != 0)
+        status = -1;
+
+    seconds[BENCHMARK_WRITE] = benchmark_now() - t;
+    s->bytes = (long)w.header_size
+             + 3L * (long)s->viewport.width * (long)s->viewport.height;
+    return status;
+}
+
+/*  Draws and saves a scene once, timing each stage. Returns 0 or -1.         */
+static int
+benchmark_run(struct benchmark *b, struct benchmark_scene *s,
+              double *seconds)
+{
+    const unsigned int width = s->viewport.width;
+    const unsigned int height = s->viewport.height;
+    const size_t number_of_pixels = (size_t)width * (size_t)height;
+    unsigned int x, y;
+    size_t n;
+    double t;
+
+    for (n = 0U; n < BENCHMARK_NUMBER_OF_STAGES; ++n)
+        seconds[n] = 0.0;
+
+    /*  Perturbation starts every pixel where the series for the image stops, *
+     *  so the series is part of the work for each image.                     */
+    t = benchmark_now();
+
+    if (s->renderer.reference)
+        fractal_series_compute(&s->reference, &s->fractal, &s->viewport);
+
+    for (y = 0U; y < height; ++y)
+    {
+        for (x = 0U; x < width; x += FRACTAL_ROW_CHUNK)
+        {
+            unsigned int chunk = width - x;
+
+            if (chunk > FRACTAL_ROW_CHUNK)
+                chunk = FRACTAL_ROW_CHUNK;
+
+            fractal_render_escapes(&s->renderer, x, y, chunk,
+                                   b->escape + (size_t)y*width + x);
+        }
+    }
+
+    seconds[BENCHMARK_COMPUTE] = benchmark_now() - t;
+
+    s->iterations = 0U;
+
+    for (n = 0U; n < number_of_pixels; ++n)
+        s->iterations += b->escape[n].iters;
+
+    t = benchmark_now();
+    fractal_render_colors(&s->renderer, b->escape,
+                          (unsigned int)number_of_pixels, b->pixels);
+    seconds[BENCHMARK_COLOR] = benchmark_now() - t;
+
+    if (s->is_gif)
+    {
+        if (benchmark_save_gif(b, s, seconds) != 0)
+            return -1;
+    }
+    else if (benchmark_save_ppm(b, s, seconds) != 0)
+        return -1;
+
+    /*  Once more as the programs draw it, over the pixels just saved.        */
+    t = benchmark_now();
+    s->pixels_iterated = fractal_render(&s->renderer, b->pixels);
+    seconds[BENCHMARK_RENDER] = benchmark_now() - t;
+    return 0;
+}
+
+/*  Pixels and iterations per second of the compute stage.                    */
+static double
+benchmark_rate(double count, double seconds)
+{
+    return seconds > 0.0 ? count / seconds : 0.0;
+}
+
+/*  Prints the results as a table.                                            */
+static void
+benchmark_print_table(const struct benchmark *b)
+{
+    unsigned int n, k;
+
+    printf("%-16s %-14s", "scene", "precision");
+
+    for (k = 0U; k < BENCHMARK_NUMBER_OF_STAGES; ++k)
+        printf(" %9s", benchmark_stage_names[k]);
+
+    printf(" %9s %9s\n", "Mpixel/s", "Giter/s");
+
+    for (n = 0U; n < b->number_of_scenes; ++n)
+    {
+        const struct benchmark_scene * const s = &b->scenes[n];
+        const double seconds = s->seconds[BENCHMARK_COMPUTE];
+        const double pixels = (double)s->viewport.width
+                            * (double)s->viewport.height;
+
+        printf("%-16s %-14s", s->name,
+               benchmark_precision_names[s->precision]);
+
+        for (k = 0U; k < BENCHMARK_NUMBER_OF_STAGES; ++k)
+            printf(" %8.2fm", 1.0E3 * s->seconds[k]);
+
+        printf(" %9.2f %9.3f\n", 1.0E-6 * benchmark_rate(pixels, seconds),
+               1.0E-9 * benchmark_rate((double)s->iterations, seconds));
+    }
+
+    printf("Times in milliseconds, kernel %s, best of %u runs.\n",
+           benchmark_simd_names[fractal_simd_level()], b->repeat);
+
+    if (b->reference_seconds > 0.0)
+        printf("Reference orbit for the zoom: %.2fms.\n",
+               1.0E3 * b->reference_seconds);
+}
+
+/*  Saves the results as JSON. Returns 0 or -1.                               */
+static int
+benchmark_write_json(const struct benchmark *b, FILE *f)
+{
+    unsigned int n, k;
+
+    fprintf(f, "{\n  \"simd\": \"%s\",\n",
+            benchmark_simd_names[fractal_simd_level()]);
+    fprintf(f, "  \"repeat\": %u,\n", b->repeat);
+    fprintf(f, "  \"dither\": %s,\n", b->dither ? "true" : "false");
+    fprintf(f, "  \"reference_seconds\": %.9f,\n", b->reference_seconds);
+    fprintf(f, "  \"scenes\": [");
+
+    for (n = 0U; n < b->number_of_scenes; ++n)
+    {
+        const struct benchmark_scene * const s = &b->scenes[n];
+        const double seconds = s->seconds[BENCHMARK_COMPUTE];
+        const double pixels = (double)s->viewport.width
+                            * (double)s->viewport.height;
+
+        fprintf(f, "%s\n    {\n", n ? "," : "");
+        fprintf(f, "      \"name\": \"%s\",\n", s->name);
+        fprintf(f, "      \"format\": \"%s\",\n", s->is_gif ? "gif" : "ppm");
+        fprintf(f, "      \"width\": %u,\n", s->viewport.width);
+        fprintf(f, "      \"height\": %u,\n", s->viewport.height);
+        fprintf(f, "      \"precision\": \"%s\",\n",
+                benchmark_precision_names[s->precision]);
+        fprintf(f, "      \"max_iters\": %u,\n", s->fractal.max_iters);
+        fprintf(f, "      \"iterations\": %llu,\n", s->iterations);
+        fprintf(f, "      \"pixels_iterated\": %lu,\n",
+                (unsigned long)s->pixels_iterated);
+        fprintf(f, "      \"bytes\": %ld,\n", s->bytes);
+        fprintf(f, "      \"seconds\": {");
+
+        for (k = 0U; k < BENCHMARK_NUMBER_OF_STAGES; ++k)
+            fprintf(f, "%s\"%s\": %.9f", k ? ", " : "",
+                    benchmark_stage_names[k], s->seconds[k]);
+
+        fprintf(f, "},\n");
+        fprintf(f, "      \"pixels_per_second\": %.1f,\n",
+                benchmark_rate(pixels, seconds));
+        fprintf(f, "      \"iterations_per_second\": %.1f\n    }",
+                benchmark_rate((double)s->iterations, seconds));
+    }
+
+    fprintf(f, "\n  ]\n}\n");
+    return ferror(f) ? -1 : 0;
+}
+
+/*  Reads the command line. Returns 0, or -1 after printing the usage.        */
+static int
+benchmark_parse_options(int argc, char **argv, struct benchmark *b)
+{
+    int n;
+
+    b->repeat = 3U;
+    b->json_filename = NULL;
+    b->only = NULL;
+    b->dither = 0;
+
+    for (n = 1; n < argc; ++n)
+    {
+        if (strcmp(argv[n], "--repeat") == 0 && n + 1 < argc)
+        {
+            char *end;
+            const unsigned long val = strtoul(argv[n + 1], &end, 10);
+
+            if (*end != '\0' || val == 0UL || val > 1000UL)
+                break;
+
+            b->repeat = (unsigned int)val;
+            ++n;
+        }
+        else if (strcmp(argv[n], "--json") == 0 && n + 1 < argc)
+            b->json_filename = argv[++n];
+        else if (strcmp(argv[n], "--only") == 0 && n + 1 < argc)
+            b->only = argv[++n];
+        else if (strcmp(argv[n], "--simd") == 0 && n + 1 < argc)
+        {
+            unsigned int level;
+
+            for (level = 0U; level < 3U; ++level)
+                if (strcmp(argv[n + 1], benchmark_simd_names[level]) == 0)
+                    break;
+
+            if (level == 3U)
+                break;
+
+            fractal_simd_set_level((enum fractal_simd_level)level);
+            ++n;
+        }
+        else if (strcmp(argv[n], "--dither") == 0)
+            b->dither = 1;
+        else
+            break;
+    }
+
+    if (n < argc)
+    {
+        puts("Usage: [--repeat N] [--json FILE] [--simd scalar|avx2|avx512] "
+             "[--dither] [--only PREFIX], 1 <= N <= 1000.");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*  Frees everything allocated for the scenes.                                */
+static void
+benchmark_free(struct benchmark *b)
+{
+    free(b->escape);
+    free(b->pixels);
+    free(b->stream_buffer);
+    fractal_reference_free(&b->reference);
+    fractal_colormap_free(&b->colormap);
+}
+
+int main(int argc, char **argv)
+{
+    static struct benchmark b;
+    size_t max_pixels = 0U;
+    unsigned int n, k, run;
+    int status = 0;
+
+    if (benchmark_parse_options(argc, argv, &b) != 0)
+        return -1;
+
+    if (fractal_colormap_init(&b.colormap) != 0)
+    {
+        puts("Failed to make the colormap. Aborting.");
+        return -1;
+    }
+
+    fractal_smooth_colormap(b.palette);
+    fractal_reference_init(&b.reference);
+
+    benchmark_add_stills(&b);
+    benchmark_add_sweep(&b);
+
+    if (benchmark_add_zoom(&b) != 0)
+    {
+        puts("Failed to compute the reference orbit. Aborting.");
+        benchmark_free(&b);
+        return -1;
+    }
+
+    if (b.number_of_scenes == 0U)
+    {
+        printf("No scene starts with %s. Aborting.\n", b.only);
+        benchmark_free(&b);
+        return -1;
+    }
+
+    for (n = 0U; n < b.number_of_scenes; ++n)
+    {
+        const size_t pixels = (size_t)b.scenes[n].viewport.width
+                            * (size_t)b.scenes[n].viewport.height;
+
+        if (pixels > max_pixels)
+            max_pixels = pixels;
+    }
+
+    /*  LZW codes are at most 12 bits, so a frame is at most 1.5 bytes per    *
+     *  pixel, plus the sub-block lengths, headers, and a palette.            */
+    b.stream_size = 2U * max_pixels + 65536U;
+    b.escape = malloc(sizeof(*b.escape) * max_pixels);
+    b.pixels = malloc(4U * max_pixels);
+    b.stream_buffer = malloc(b.stream_size);
+
+    if (!b.escape || !b.pixels || !b.stream_buffer)
+    {
+        puts("Failed to allocate the buffers. Aborting.");
+        benchmark_free(&b);
+        return -1;
+    }
+
+    for (n = 0U; n < b.number_of_scenes && status == 0; ++n)
+    {
+        struct benchmark_scene * const s = &b.scenes[n];
+
+        for (run = 0U; run < b.repeat; ++run)
+        {
+            double seconds[BENCHMARK_NUMBER_OF_STAGES];
+
+            if (benchmark_run(&b, s, seconds) != 0)
+            {
+                printf("Failed to write %s for %s. Aborting.\n",
+                       BENCHMARK_FILENAME, s->name);
+                status = -1;
+                break;
+            }
+
+            for (k = 0U; k < BENCHMARK_NUMBER_OF_STAGES; ++k)
+                if (run == 0U || seconds[k] < s->seconds[k])
+                    s->seconds[k] = seconds[k];
+        }
+    }
+
+    remove(BENCHMARK_FILENAME);
+
+    if (status == 0)
+    {
+        const int to_stdout = b.json_filename &&
+                              strcmp(b.json_filename, "-") == 0;
+
+        /*  Standard output is left to the JSON alone when it goes there.     */
+        if (!to_stdout)
+            benchmark_print_table(&b);
+
+        if (b.json_filename)
+        {
+            FILE * const f = to_stdout ? stdout : fopen(b.json_filename, "w");
+
+            if (!f || benchmark_write_json(&b, f) != 0)
+                status = -1;
+
+            if (f && !to_stdout && fclose(f) != 0)
+                status = -1;
+
+            if (status != 0)
+                printf("Failed to write %s. Aborting.\n", b.json_filename);
+        }
+    }
+
+    benchmark_free(&b);
+    return status;
+}
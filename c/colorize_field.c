@@ -0,0 +1,258 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Colors iteration count fields saved by the stills with --field, see   *
+ *      fractal_field.h, without iterating anything again.                    *
+ *          colorize_field [--banded] in.field out.ppm                        *
+ *          colorize_field [--banded] in.field [more.field ...] out.gif       *
+ *      A PPM is made from a single field, and a GIF has one frame for each   *
+ *      field, which must all be the same size. The smooth coloring of the    *
+ *      SwipeCat fractal is used by default, and --banded selects that of the *
+ *      Mandelbrot set stills.                                                *
+ ******************************************************************************/
+
+/*  puts and printf found here.                                               */
+#include <stdio.h>
+
+/*  malloc and free found here.                                               */
+#include <stdlib.h>
+
+/*  strcmp and strlen found here.                                             */
+#include <string.h>
+
+/*  GifBegin, GifBeginWithPalette, and the frame writers found here.          */
+#include "gif.h"
+
+/*  The colorings and the smooth coloring table found here.                   */
+#include "fractal.h"
+
+/*  ppm_begin, ppm_write_rows, and ppm_end found here.                        */
+#include "ppm.h"
+
+/*  fractal_field_open and fractal_field_colorize found here.                 */
+#include "fractal_field.h"
+
+/*  Time between the frames of a GIF, in hundredths of a second.              */
+#define COLORIZE_GIF_DELAY (2U)
+
+/*  Checks whether a string ends with the given suffix.                       */
+static int
+colorize_has_suffix(const char *str, const char *suffix)
+{
+    const size_t str_length = strlen(str);
+    const size_t suffix_length = strlen(suffix);
+
+    if (str_length < suffix_length)
+        return 0;
+
+    return strcmp(str + str_length - suffix_length, suffix) == 0;
+}
+
+/*  Colors a single field and saves it as a PPM. Returns 0 or -1.             */
+static int
+colorize_ppm(const struct fractal_field *field,
+             const struct fractal_colormap *cm, const char *filename)
+{
+    struct ppm_writer w;
+    const unsigned int width = field->header.width;
+    const unsigned int height = field->header.height;
+    unsigned char * const pixels = malloc((size_t)width * height * 3U);
+
+    if (!pixels)
+        return -1;
+
+    fractal_field_colorize(field, cm, fractal_color_banded, 3U, pixels);
+
+    if (ppm_begin(&w, filename, width, height) != 0
+        || ppm_write_rows(&w, pixels, height) != 0)
+    {
+        free(pixels);
+        ppm_end(&w);
+        return -1;
+    }
+
+    free(pixels);
+    return ppm_end(&w);
+}
+
+/*  Colors each field and saves them as the frames of a GIF. The smooth       *
+ *  coloring is written as indices into one fixed palette. Returns 0 or -1.   */
+static int
+colorize_gif(char **field_filenames, unsigned int number_of_fields,
+             const struct fractal_colormap *cm, const char *filename)
+{
+    struct fractal_field field;
+    unsigned char palette[256U * 3U];
+    unsigned char *pixels;
+    unsigned int width, height, n;
+    int status = 0;
+    GifWriter writer;
+
+    /*  The first field sets the size of the animation.                       */
+    if (fractal_field_open(&field, field_filenames[0]) != 0)
+    {
+        printf("Failed to read %s. Aborting.\n", field_filenames[0]);
+        return -1;
+    }
+
+    width = field.header.width;
+    height = field.header.height;
+    fractal_field_close(&field);
+
+    /*  One byte per pixel for the palette indices, or four for RGBA.         */
+    pixels = malloc((size_t)width * height * (cm ? 1U : 4U));
+
+    if (!pixels)
+    {
+        puts("Failed to allocate the frame. Aborting.");
+        return -1;
+    }
+
+    if (cm)
+    {
+        fractal_smooth_colormap(palette);
+        status = GifBeginWithPalette(&writer, filename, width, height,
+                                     COLORIZE_GIF_DELAY, palette, 8) ? 0 : -1;
+    }
+    else
+        status = GifBegin(&writer, filename, width, height,
+                          COLORIZE_GIF_DELAY, 8, false) ? 0 : -1;
+
+    if (status != 0)
+    {
+        printf("Failed to create %s. Aborting.\n", filename);
+        free(pixels);
+        return -1;
+    }
+
+    for (n = 0U; n < number_of_fields && status == 0; ++n)
+    {
+        bool written;
+
+        if (fractal_field_open(&field, field_filenames[n]) != 0)
+        {
+            printf("Failed to read %s. Aborting.\n", field_filenames[n]);
+            status = -1;
+            break;
+        }
+
+        if (field.header.width != width || field.header.height != height)
+        {
+            printf("%s is not the size of the first field. Aborting.\n",
+                   field_filenames[n]);
+            fractal_field_close(&field);
+            status = -1;
+            break;
+        }
+
+        if (cm)
+        {
+            fractal_field_colorize(&field, cm, NULL, 1U, pixels);
+            written = GifWriteIndexedFrame(&writer, pixels, width, height,
+                                           COLORIZE_GIF_DELAY);
+        }
+        else
+        {
+            fractal_field_colorize(&field, NULL, fractal_color_banded,
+                                   4U, pixels);
+            written = GifWriteFrame(&writer, pixels, width, height,
+                                    COLORIZE_GIF_DELAY, 8, false);
+        }
+
+        fractal_field_close(&field);
+
+        if (!written)
+        {
+            printf("Failed to write frame %u. Aborting.\n", n);
+            status = -1;
+        }
+    }
+
+    GifEnd(&writer);
+    free(pixels);
+    return status;
+}
+
+/*  Function for coloring saved fields. Usage is given in the Purpose above.  */
+int main(int argc, char **argv)
+{
+    struct fractal_colormap colormap;
+    const struct fractal_colormap *cm = &colormap;
+    const char *output;
+    unsigned int number_of_fields;
+    int first = 1;
+    int status;
+
+    if (argc > 1 && strcmp(argv[1], "--banded") == 0)
+    {
+        cm = NULL;
+        first = 2;
+    }
+
+    /*  At least one field and the output file.                               */
+    if (argc - first < 2)
+    {
+        puts("Usage: [--banded] in.field [more.field ...] out.ppm|out.gif");
+        return -1;
+    }
+
+    output = argv[argc - 1];
+    number_of_fields = (unsigned int)(argc - first - 1);
+
+    if (!colorize_has_suffix(output, ".gif")
+        && (!colorize_has_suffix(output, ".ppm") || number_of_fields != 1U))
+    {
+        puts("Give one field for a .ppm, or any number for a .gif. Aborting.");
+        return -1;
+    }
+
+    /*  The smooth coloring is a table lookup on the stored smooth counts.    */
+    if (cm && fractal_colormap_init(&colormap) != 0)
+    {
+        puts("Failed to make the colormap. Aborting.");
+        return -1;
+    }
+
+    if (colorize_has_suffix(output, ".gif"))
+        status = colorize_gif(argv + first, number_of_fields, cm, output);
+    else
+    {
+        struct fractal_field field;
+
+        if (fractal_field_open(&field, argv[first]) != 0)
+        {
+            printf("Failed to read %s. Aborting.\n", argv[first]);
+            status = -1;
+        }
+        else
+        {
+            status = colorize_ppm(&field, cm, output);
+            fractal_field_close(&field);
+
+            if (status != 0)
+                printf("Failed to write %s. Aborting.\n", output);
+        }
+    }
+
+    if (cm)
+        fractal_colormap_free(&colormap);
+
+    return status;
+}
+/*  End of main.                                                              */
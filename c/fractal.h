@@ -0,0 +1,1493 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Shared escape-time rendering core used by the programs in this        *
+ *      directory. Provides a viewport type for mapping pixels to points in   *
+ *      the plane, the iteration functions for the Mandelbrot set, the        *
+ *      Multibrot sets z^r + c, and the SwipeCat fractal, the colorings used  *
+ *      by the drawings, and a routine for rendering into a pixel buffer.     *
+ *  Notes:                                                                    *
+ *      Like gif.h, this file is header-only. Every function is static so the *
+ *      programs can be built with a single compiler invocation, e.g.:        *
+ *          cc -O3 mandelbrot_set_001.c -o mandelbrot_set_001 -lm             *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_H
+#define FRACTAL_H
+
+/*  exp, log, pow, atan2, and trig functions provided here.                   */
+#include <math.h>
+
+/*  Some implementations of libm provide pi / 2, some don't. Declare this as  *
+ *  a macro for improved portability.                                         */
+#define FRACTAL_PI_BY_TWO (+1.5707963267948966)
+
+/*  Simple struct for complex numbers, z = real + i*imag.                     */
+struct fractal_complex {
+    double real, imag;
+};
+
+/******************************************************************************
+ *  Struct:                                                                   *
+ *      fractal_viewport                                                      *
+ *  Purpose:                                                                  *
+ *      Describes the rectangle in the plane sampled by an image. The pixel   *
+ *      (x, y) is mapped to the point                                         *
+ *          c = (x_start + x * x_step) + i*(y_start + y * y_step)             *
+ *      Since rows of an image run from top to bottom, y_step is usually      *
+ *      negative.                                                             *
+ ******************************************************************************/
+struct fractal_viewport {
+
+    /*  The number of pixels in the x and y axes, respectively.               */
+    unsigned int width, height;
+
+    /*  The point corresponding to the pixel (0, 0).                          */
+    double x_start, y_start;
+
+    /*  The distance between adjacent pixels in the x and y axes.             */
+    double x_step, y_step;
+};
+
+/*  The fractals with built-in iteration functions.                           */
+enum fractal_type {
+
+    /*  The Mandelbrot set, z_{n+1} = z_{n}^2 + c.                            */
+    FRACTAL_MANDELBROT,
+
+    /*  The Multibrot sets, z_{n+1} = z_{n}^r + c for real r.                 */
+    FRACTAL_MULTIBROT,
+
+    /*  The SwipeCat fractal, z_{n+1} = (pi/2)(exp(z_{n}) - z_{n}) + c.       */
+    FRACTAL_SWIPECAT,
+
+    /*  User provided iteration function, see fractal_iter_func below.        */
+    FRACTAL_CUSTOM
+};
+
+/*  Tests used to decide when an orbit has escaped.                           */
+enum fractal_escape_test {
+
+    /*  Escape once |z| > escape_radius.                                      */
+    FRACTAL_ESCAPE_MODULUS,
+
+    /*  Escape once |Re(z)| >= escape_radius.                                 */
+    FRACTAL_ESCAPE_REAL_PART
+};
+
+/*  Forward declaration, the iteration function takes the fractal as input.   */
+struct fractal;
+
+/*  Function type for a single step of the iteration, z -> f(z, c).           */
+typedef void
+(*fractal_iter_func)(struct fractal_complex *z,
+                     const struct fractal_complex *c,
+                     const struct fractal *f);
+
+/******************************************************************************
+ *  Struct:                                                                   *
+ *      fractal                                                               *
+ *  Purpose:                                                                  *
+ *      Parameters for an escape-time fractal. Use one of the fractal_init    *
+ *      functions below to fill this in, then adjust the values as needed.    *
+ ******************************************************************************/
+struct fractal {
+
+    /*  Which fractal this is. Built-in types get inlined iteration loops.    */
+    enum fractal_type type;
+
+    /*  Iteration function. Only called directly for FRACTAL_CUSTOM.          */
+    fractal_iter_func iterate;
+
+    /*  The exponent r for the Multibrot sets, z^r + c.                       */
+    double power;
+
+    /*  Maximum number of iterations allowed in the computation.              */
+    unsigned int max_iters;
+
+    /*  The radius of the circle (or strip). Points outside of this diverge.  */
+    double escape_radius;
+
+    /*  How the escape radius is compared against the iterates.               */
+    enum fractal_escape_test escape_test;
+
+    /*  Boolean for whether z_{0} = c (non-zero) or z_{0} = 0 (zero).         */
+    int start_at_c;
+
+    /*  Boolean for skipping points inside the main cardioid and the period 2 *
+     *  bulb of the Mandelbrot set. These never escape, so there is no need   *
+     *  to iterate them. The final z is set to c for these points.            */
+    int skip_interior;
+
+    /*  Boolean for periodicity checking. The orbit is compared against a     *
+     *  saved iterate, and once it returns to within period_tolerance of it   *
+     *  (in both the real and imaginary parts) it is taken to be periodic and *
+     *  the point is treated as never escaping.                               */
+    int check_period;
+
+    /*  With a tolerance of zero only exact repeats are detected, and these   *
+     *  can never change the output since the iteration is deterministic. A   *
+     *  positive tolerance finds cycles sooner, but must be kept well below   *
+     *  the pixel spacing, or points just outside the set are misclassified.  *
+     *  See fractal_limit_period_tolerance.                                   */
+    double period_tolerance;
+};
+
+/*  The result of iterating a single point.                                   */
+struct fractal_escape {
+
+    /*  Number of iterations performed before escaping. Points that did not   *
+     *  escape have iters equal to the max_iters value of the fractal.        */
+    unsigned int iters;
+
+    /*  The final value of the iteration.                                     */
+    struct fractal_complex z;
+};
+
+/*  Function type for converting an escape result into a pixel. This is an    *
+ *  RGB color, or a palette index for one channel images.                     */
+typedef void
+(*fractal_color_func)(const struct fractal *f,
+                      const struct fractal_escape *escape,
+                      unsigned char *rgb);
+
+/*  The orbit of the center of a deep zoom, defined in fractal_deep.h.        */
+struct fractal_reference;
+
+/*  A complex number in double-double precision, defined in fractal_dd.h.     */
+struct fractal_dd_complex;
+
+/*  A table of precomputed colors, defined in fractal_colormap.h.             */
+struct fractal_colormap;
+
+/*  Which regions fractal_subdivide.h may fill in without iterating them.     */
+enum fractal_subdivide {
+
+    /*  Iterate every pixel.                                                  */
+    FRACTAL_SUBDIVIDE_NONE,
+
+    /*  Fill regions bordered by points that do not escape. Requires those    *
+     *  points to be drawn the same whatever their final iterate.             */
+    FRACTAL_SUBDIVIDE_INTERIOR,
+
+    /*  Fill regions bordered by points of any one iteration count. Requires  *
+     *  the coloring to depend on the iteration count alone.                  */
+    FRACTAL_SUBDIVIDE_BANDS
+};
+
+/******************************************************************************
+ *  Struct:                                                                   *
+ *      fractal_renderer                                                      *
+ *  Purpose:                                                                  *
+ *      Everything needed to turn a fractal into pixels. The output buffer    *
+ *      holds viewport->height rows of viewport->width pixels, each pixel     *
+ *      being channels bytes long (3 for RGB, 4 for RGBA, 1 for a palette     *
+ *      index, see fractal_index_smooth).                                     *
+ *                                                                            *
+ *      If reference is not NULL the image is a deep zoom, see fractal_deep.h *
+ *      and the viewport gives the offset of each pixel from the center of    *
+ *      the reference orbit, rather than the point itself.                    *
+ *                                                                            *
+ *      If center is not NULL the viewport likewise gives offsets from        *
+ *      center, and the points are iterated in double-double precision, see   *
+ *      fractal_dd.h.                                                         *
+ *                                                                            *
+ *      If colormap is not NULL the smooth coloring is looked up in it, see   *
+ *      fractal_colormap.h, and color is not used.                            *
+ *                                                                            *
+ *      If subdivide is not FRACTAL_SUBDIVIDE_NONE, regions with a uniform    *
+ *      border are filled in without being iterated, see fractal_subdivide.h. *
+ ******************************************************************************/
+struct fractal_renderer {
+    const struct fractal *fractal;
+    const struct fractal_viewport *viewport;
+    fractal_color_func color;
+    unsigned int channels;
+    const struct fractal_reference *reference;
+    const struct fractal_dd_complex *center;
+    const struct fractal_colormap *colormap;
+    enum fractal_subdivide subdivide;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_viewport_from_bounds                                          *
+ *  Purpose:                                                                  *
+ *      Creates a viewport for the rectangle [x_min, x_max] x [y_min, y_max]. *
+ *      The top-left pixel is x_min + i*y_max and the bottom-right pixel is   *
+ *      x_max + i*y_min.                                                      *
+ *  Arguments:                                                                *
+ *      vp (struct fractal_viewport *):                                       *
+ *          The viewport being initialized.                                   *
+ *      width (unsigned int):                                                 *
+ *          The number of pixels in the x axis.                               *
+ *      height (unsigned int):                                                *
+ *          The number of pixels in the y axis.                               *
+ *      x_min (double):                                                       *
+ *          The real part of the left edge of the image.                      *
+ *      x_max (double):                                                       *
+ *          The real part of the right edge of the image.                     *
+ *      y_min (double):                                                       *
+ *          The imaginary part of the bottom edge of the image.               *
+ *      y_max (double):                                                       *
+ *          The imaginary part of the top edge of the image.                  *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_viewport_from_bounds(struct fractal_viewport *vp,
+                             unsigned int width, unsigned int height,
+                             double x_min, double x_max,
+                             double y_min, double y_max)
+{
+    vp->width = width;
+    vp->height = height;
+    vp->x_start = x_min;
+    vp->y_start = y_max;
+
+    /*  Scale factors for converting between pixels and points in the plane.  */
+    vp->x_step = (x_max - x_min) / (double)(width - 1U);
+    vp->y_step = -(y_max - y_min) / (double)(height - 1U);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_viewport_from_center                                          *
+ *  Purpose:                                                                  *
+ *      Creates a square viewport of half-width ds about a center point.      *
+ *      This is the framing used by the zoom animations.                      *
+ *  Arguments:                                                                *
+ *      vp (struct fractal_viewport *):                                       *
+ *          The viewport being initialized.                                   *
+ *      width (unsigned int):                                                 *
+ *          The number of pixels in the x axis.                               *
+ *      height (unsigned int):                                                *
+ *          The number of pixels in the y axis.                               *
+ *      center_x (double):                                                    *
+ *          The real part of the center of the image.                         *
+ *      center_y (double):                                                    *
+ *          The imaginary part of the center of the image.                    *
+ *      ds (double):                                                          *
+ *          Half the side length of the square being drawn.                   *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_viewport_from_center(struct fractal_viewport *vp,
+                             unsigned int width, unsigned int height,
+                             double center_x, double center_y, double ds)
+{
+    fractal_viewport_from_bounds(vp, width, height,
+                                 center_x - ds, center_x + ds,
+                                 center_y - ds, center_y + ds);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_mandelbrot_iter                                               *
+ *  Purpose:                                                                  *
+ *      Computes the Mandelbrot iteration, z_{n+1} = z_{n}^2 + c.             *
+ *  Arguments:                                                                *
+ *      z (struct fractal_complex *):                                         *
+ *          The current iterate, z_{n}. Overwritten with z_{n+1}.             *
+ *      c (const struct fractal_complex *):                                   *
+ *          The point being tested.                                           *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Unused, but required by fractal_iter_func.           *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_mandelbrot_iter(struct fractal_complex *z,
+                        const struct fractal_complex *c,
+                        const struct fractal *f)
+{
+    /*  Avoiding overwriting the real part of the complex number.             */
+    const double tmp = z->real;
+
+    /*  Mute "unused argument" warnings.                                      */
+    (void)f;
+
+    /*  Calculate the new value. z_{n+1} = z_{n}^2 + c.                       */
+    z->real = z->real * z->real - z->imag * z->imag + c->real;
+    z->imag = 2.0 * tmp * z->imag + c->imag;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_multibrot_iter                                                *
+ *  Purpose:                                                                  *
+ *      Computes the Multibrot iteration, z_{n+1} = z_{n}^r + c, using the    *
+ *      principal branch of the complex power function.                       *
+ *  Arguments:                                                                *
+ *      z (struct fractal_complex *):                                         *
+ *          The current iterate, z_{n}. Overwritten with z_{n+1}.             *
+ *      c (const struct fractal_complex *):                                   *
+ *          The point being tested.                                           *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. The exponent r is f->power.                          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_multibrot_iter(struct fractal_complex *z,
+                       const struct fractal_complex *c,
+                       const struct fractal *f)
+{
+    /*  Compute z^r by writing z = |z| exp(i arg(z)). log|z| is half the log  *
+     *  of |z|^2, which saves a square root.                                  */
+    const double log_abs_z = 0.5 * log(z->real*z->real + z->imag*z->imag);
+    const double arg = atan2(z->imag, z->real);
+    const double x = f->power * log_abs_z;
+    const double y = f->power * arg;
+    const double exp_val = exp(x);
+
+    z->real = exp_val * cos(y) + c->real;
+    z->imag = exp_val * sin(y) + c->imag;
+}
+
+/*  Exponents within this relative distance of a whole number are treated     *
+ *  as that whole number. The power sweep adds up its exponents in steps, so  *
+ *  they land a few units in the last place away from the integers.           */
+#define FRACTAL_MULTIBROT_INTEGER_TOLERANCE (1.0E-12)
+
+/*  The largest exponent done by repeated multiplication.                     */
+#define FRACTAL_MULTIBROT_MAX_INTEGER (64U)
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_multibrot_integer_power                                       *
+ *  Purpose:                                                                  *
+ *      Determines if the exponent of a Multibrot set is a whole number that  *
+ *      fractal_multibrot_integer_iter can use.                               *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. The exponent r is f->power.                          *
+ *  Output:                                                                   *
+ *      power (unsigned int):                                                 *
+ *          The exponent rounded to the nearest whole number, or zero if r is *
+ *          not within FRACTAL_MULTIBROT_INTEGER_TOLERANCE of one between 1   *
+ *          and FRACTAL_MULTIBROT_MAX_INTEGER.                                *
+ ******************************************************************************/
+static inline unsigned int
+fractal_multibrot_integer_power(const struct fractal *f)
+{
+    double n;
+
+    /*  Written so that NaN fails the test too.                               */
+    if (!(f->power >= 0.5 &&
+          f->power < (double)FRACTAL_MULTIBROT_MAX_INTEGER + 0.5))
+        return 0U;
+
+    n = floor(f->power + 0.5);
+
+    if (fabs(f->power - n) > FRACTAL_MULTIBROT_INTEGER_TOLERANCE * n)
+        return 0U;
+
+    return (unsigned int)n;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_multibrot_integer_iter                                        *
+ *  Purpose:                                                                  *
+ *      Computes the Multibrot iteration, z_{n+1} = z_{n}^r + c, for a whole  *
+ *      number exponent r by complex multiplication alone.                    *
+ *  Arguments:                                                                *
+ *      z (struct fractal_complex *):                                         *
+ *          The current iterate, z_{n}. Overwritten with z_{n+1}.             *
+ *      c (const struct fractal_complex *):                                   *
+ *          The point being tested.                                           *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. fractal_multibrot_integer_power(f) must be nonzero.  *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      Square and multiply, reading the bits of r from the top down. This    *
+ *      takes at most 2 log2(r) complex products instead of a log, an atan2,  *
+ *      an exp, a cos, and a sin.                                             *
+ ******************************************************************************/
+static inline void
+fractal_multibrot_integer_iter(struct fractal_complex *z,
+                               const struct fractal_complex *c,
+                               const struct fractal *f)
+{
+    const unsigned int power = (unsigned int)(f->power + 0.5);
+    unsigned int bit = 1U;
+    struct fractal_complex w = *z;
+
+    /*  Find the leading bit of the exponent, it accounts for w = z.          */
+    while (bit <= (power >> 1U))
+        bit <<= 1U;
+
+    for (bit >>= 1U; bit != 0U; bit >>= 1U)
+    {
+        /*  Avoiding overwriting the real part of the complex number.         */
+        const double tmp = w.real;
+
+        /*  w = w^2.                                                          */
+        w.real = w.real * w.real - w.imag * w.imag;
+        w.imag = 2.0 * tmp * w.imag;
+
+        /*  w = w z.                                                          */
+        if (power & bit)
+        {
+            const double re = w.real;
+            w.real = re * z->real - w.imag * z->imag;
+            w.imag = re * z->imag + w.imag * z->real;
+        }
+    }
+
+    z->real = w.real + c->real;
+    z->imag = w.imag + c->imag;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_swipecat_iter                                                 *
+ *  Purpose:                                                                  *
+ *      Computes the SwipeCat iteration, z -> (pi/2)(exp(z) - z) + c.         *
+ *  Arguments:                                                                *
+ *      z (struct fractal_complex *):                                         *
+ *          The current iterate, z_{n}. Overwritten with z_{n+1}.             *
+ *      c (const struct fractal_complex *):                                   *
+ *          The point being tested.                                           *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Unused, but required by fractal_iter_func.           *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_swipecat_iter(struct fractal_complex *z,
+                      const struct fractal_complex *c,
+                      const struct fractal *f)
+{
+    /*  exp(z) = exp(x) (cos(y) + i sin(y)), z = x + iy.                      */
+    const double exp_x = exp(z->real);
+
+    /*  Mute "unused argument" warnings.                                      */
+    (void)f;
+
+    z->real = FRACTAL_PI_BY_TWO*(exp_x*cos(z->imag) - z->real) + c->real;
+    z->imag = FRACTAL_PI_BY_TWO*(exp_x*sin(z->imag) - z->imag) + c->imag;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_mandelbrot_interior                                           *
+ *  Purpose:                                                                  *
+ *      Determines if a point lies in the main cardioid or the period 2 bulb  *
+ *      of the Mandelbrot set. Points in either region never escape.          *
+ *  Arguments:                                                                *
+ *      c_real (double):                                                      *
+ *          The real part of the point.                                       *
+ *      c_imag (double):                                                      *
+ *          The imaginary part of the point.                                  *
+ *  Output:                                                                   *
+ *      in_interior (int):                                                    *
+ *          Boolean for whether the point is in one of the two regions.       *
+ *  Method:                                                                   *
+ *      With q = (x - 1/4)^2 + y^2, the main cardioid is the region where     *
+ *          q (q + (x - 1/4)) <= y^2 / 4                                      *
+ *      and the period 2 bulb is the disk of radius 1/4 centered at -1,       *
+ *          (x + 1)^2 + y^2 <= 1/16                                           *
+ *      Together these cover most of the area of the set.                     *
+ ******************************************************************************/
+static inline int
+fractal_mandelbrot_interior(double c_real, double c_imag)
+{
+    const double y_sq = c_imag * c_imag;
+    const double x_shift = c_real - 0.25;
+    const double q = x_shift*x_shift + y_sq;
+    const double x_plus_one = c_real + 1.0;
+
+    if (q * (q + x_shift) <= 0.25 * y_sq)
+        return 1;
+
+    return (x_plus_one*x_plus_one + y_sq <= 0.0625);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_init_mandelbrot                                               *
+ *  Purpose:                                                                  *
+ *      Sets up the parameters used by the Mandelbrot set drawings.           *
+ *  Arguments:                                                                *
+ *      f (struct fractal *):                                                 *
+ *          The fractal being initialized.                                    *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_init_mandelbrot(struct fractal *f)
+{
+    f->type = FRACTAL_MANDELBROT;
+    f->iterate = fractal_mandelbrot_iter;
+    f->power = 2.0;
+    f->max_iters = 255U;
+    f->escape_radius = 4.0;
+    f->escape_test = FRACTAL_ESCAPE_MODULUS;
+    f->start_at_c = 1;
+    f->skip_interior = 1;
+    f->check_period = 0;
+    f->period_tolerance = 0.0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_init_multibrot                                                *
+ *  Purpose:                                                                  *
+ *      Sets up the parameters used by the Multibrot set drawings.            *
+ *  Arguments:                                                                *
+ *      f (struct fractal *):                                                 *
+ *          The fractal being initialized.                                    *
+ *      power (double):                                                       *
+ *          The exponent r in z^r + c.                                        *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_init_multibrot(struct fractal *f, double power)
+{
+    f->type = FRACTAL_MULTIBROT;
+    f->iterate = fractal_multibrot_iter;
+    f->power = power;
+    f->max_iters = 255U;
+    f->escape_radius = 4.0;
+    f->escape_test = FRACTAL_ESCAPE_REAL_PART;
+    f->start_at_c = 0;
+    f->skip_interior = 0;
+    f->check_period = 0;
+    f->period_tolerance = 0.0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_init_swipecat                                                 *
+ *  Purpose:                                                                  *
+ *      Sets up the parameters used by the SwipeCat fractal drawings.         *
+ *  Arguments:                                                                *
+ *      f (struct fractal *):                                                 *
+ *          The fractal being initialized.                                    *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_init_swipecat(struct fractal *f)
+{
+    f->type = FRACTAL_SWIPECAT;
+    f->iterate = fractal_swipecat_iter;
+    f->power = 0.0;
+    f->max_iters = 100U;
+    f->escape_radius = 150.0;
+    f->escape_test = FRACTAL_ESCAPE_REAL_PART;
+    f->start_at_c = 0;
+    f->skip_interior = 0;
+    f->check_period = 0;
+    f->period_tolerance = 0.0;
+}
+
+/*  The largest period_tolerance allowed, as a fraction of the pixel spacing. */
+#define FRACTAL_PERIOD_TOLERANCE_SCALE (1.0E-3)
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_limit_period_tolerance                                        *
+ *  Purpose:                                                                  *
+ *      Keeps the period check from mistaking the orbits of neighboring       *
+ *      pixels for a cycle, by lowering period_tolerance to a small fraction  *
+ *      of the distance between pixels.                                       *
+ *  Arguments:                                                                *
+ *      f (struct fractal *):                                                 *
+ *          The fractal, with period_tolerance set for a shallow view.        *
+ *      pixel_spacing (double):                                               *
+ *          The distance between adjacent pixels of the image being drawn.    *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Notes:                                                                    *
+ *      A fixed tolerance that is safe for a wide view is not for a deep one, *
+ *      where the pixels can be closer together than the tolerance. Call this *
+ *      for every image, with a copy of the fractal if it is shared.          *
+ ******************************************************************************/
+static inline void
+fractal_limit_period_tolerance(struct fractal *f, double pixel_spacing)
+{
+    const double limit = FRACTAL_PERIOD_TOLERANCE_SCALE * fabs(pixel_spacing);
+
+    if (f->period_tolerance > limit)
+        f->period_tolerance = limit;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_escape_loop                                                   *
+ *  Purpose:                                                                  *
+ *      The escape-time loop shared by every fractal. This is inlined with a  *
+ *      constant iteration function for the built-in fractals so that the     *
+ *      compiler can inline the iteration step as well.                       *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      c (const struct fractal_complex *):                                   *
+ *          The point being tested.                                           *
+ *      iterate (fractal_iter_func):                                          *
+ *          The iteration function.                                           *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and the final value of z.                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      If check_period is set, Brent's cycle detection is used.              *
+ *      An iterate is saved, and every following iterate is compared against  *
+ *      it. The saved value is replaced after 2, 4, 8, ... iterations, so a   *
+ *      cycle of any period p is found within roughly 2p iterations of the    *
+ *      orbit settling onto it. Points found to be periodic have iters set to *
+ *      max_iters, just as if every iteration had been performed.             *
+ ******************************************************************************/
+static inline void
+fractal_escape_loop(const struct fractal *f,
+                    const struct fractal_complex *c,
+                    fractal_iter_func iterate,
+                    struct fractal_escape *out)
+{
+    /*  Index for keeping track of the number of iterations performed.        */
+    unsigned int iters;
+
+    /*  The threshold for the escape test. Squared for the modulus test.      */
+    const double radius = f->escape_radius;
+    const double radius_squared = radius*radius;
+
+    /*  Initialize the complex number to either c or the origin.              */
+    struct fractal_complex z;
+
+    /*  Variables for the periodicity check. The orbit is compared against    *
+     *  saved, which is replaced once period_step reaches period_limit.       */
+    const double tolerance = f->period_tolerance;
+    struct fractal_complex saved;
+    unsigned int period_step = 0U;
+    unsigned int period_limit = 2U;
+
+    if (f->start_at_c)
+        z = *c;
+    else
+    {
+        z.real = 0.0;
+        z.imag = 0.0;
+    }
+
+    saved = z;
+
+    /*  Start the iteration process. Stop when the iteration diverges         *
+     *  outside of the circle, or when too many iterations are done.          */
+    for (iters = 0U; iters < f->max_iters; ++iters)
+    {
+        /*  Calculate the next iteration.                                     */
+        iterate(&z, c, f);
+
+        /*  Once the iteration falls outside the circle (or strip), abort.    */
+        if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+        {
+            if (z.real*z.real + z.imag*z.imag > radius_squared)
+                break;
+        }
+        else if (fabs(z.real) >= radius)
+            break;
+
+        /*  Periodicity check. A repeated value means the orbit is trapped.   */
+        if (f->check_period)
+        {
+            if (fabs(z.real - saved.real) <= tolerance &&
+                fabs(z.imag - saved.imag) <= tolerance)
+            {
+                iters = f->max_iters;
+                break;
+            }
+
+            /*  Save a new value at powers of two, Brent's method.            */
+            if (++period_step == period_limit)
+            {
+                saved = z;
+                period_step = 0U;
+                period_limit <<= 1U;
+            }
+        }
+    }
+
+    out->iters = iters;
+    out->z = z;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_escape_time                                                   *
+ *  Purpose:                                                                  *
+ *      Iterates a point until it escapes or max_iters is reached.            *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      c (const struct fractal_complex *):                                   *
+ *          The point being tested.                                           *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and the final value of z.                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_escape_time(const struct fractal *f,
+                    const struct fractal_complex *c,
+                    struct fractal_escape *out)
+{
+    switch (f->type)
+    {
+        case FRACTAL_MANDELBROT:
+            if (f->skip_interior &&
+                fractal_mandelbrot_interior(c->real, c->imag))
+            {
+                out->iters = f->max_iters;
+                out->z = *c;
+            }
+            else
+                fractal_escape_loop(f, c, fractal_mandelbrot_iter, out);
+            break;
+        case FRACTAL_MULTIBROT:
+            if (fractal_multibrot_integer_power(f))
+                fractal_escape_loop(f, c, fractal_multibrot_integer_iter, out);
+            else
+                fractal_escape_loop(f, c, fractal_multibrot_iter, out);
+            break;
+        case FRACTAL_SWIPECAT:
+            fractal_escape_loop(f, c, fractal_swipecat_iter, out);
+            break;
+        default:
+            fractal_escape_loop(f, c, f->iterate, out);
+            break;
+    }
+}
+
+/*  Vectorized kernels for z^2 + c, used by fractal_escape_points.            */
+#include "fractal_simd.h"
+
+/*  Vectorized exp, log, sincos, and atan2 for the kernels below.             */
+#include "fractal_simd_math.h"
+
+/*  Vectorized kernels for the SwipeCat and Multibrot fractals, also used by  *
+ *  fractal_escape_points.                                                    */
+#include "fractal_swipecat.h"
+#include "fractal_multibrot.h"
+
+/*  Perturbation theory for deep zooms, used by fractal_render_rect.          */
+#include "fractal_deep.h"
+
+/*  The number of pixels iterated at once by the renderer.                    */
+#define FRACTAL_ROW_CHUNK (64U)
+
+/*  Double-double arithmetic for zooms between doubles and perturbation.      */
+#include "fractal_dd.h"
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_escape_points                                                 *
+ *  Purpose:                                                                  *
+ *      Iterates a batch of points anywhere in the plane. The Mandelbrot set  *
+ *      skips points in the main cardioid and period 2 bulb, and uses the     *
+ *      vectorized kernels for the rest. The SwipeCat and Multibrot fractals  *
+ *      have kernels of their own, and everything else is done one point at   *
+ *      a time.                                                               *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      c_real (const double *):                                              *
+ *          The real parts of the points.                                     *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the points.                                *
+ *      number_of_points (unsigned int):                                      *
+ *          The number of points, at most FRACTAL_ROW_CHUNK.                  *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_escape_points(const struct fractal *f,
+                      const double *c_real, const double *c_imag,
+                      unsigned int number_of_points, struct fractal_escape *out)
+{
+    unsigned int n;
+    struct fractal_complex c;
+
+    if (f->type == FRACTAL_MANDELBROT)
+    {
+        /*  Interior points are filled in directly, and only the remaining    *
+         *  points are packed together and handed to the kernel. This keeps   *
+         *  every lane of the vectorized kernels busy.                        */
+        if (f->skip_interior)
+        {
+            double c_real_left[FRACTAL_ROW_CHUNK];
+            double c_imag_left[FRACTAL_ROW_CHUNK];
+            unsigned int index[FRACTAL_ROW_CHUNK];
+            struct fractal_escape escape[FRACTAL_ROW_CHUNK];
+            unsigned int number_left = 0U;
+
+            for (n = 0U; n < number_of_points; ++n)
+            {
+                if (fractal_mandelbrot_interior(c_real[n], c_imag[n]))
+                {
+                    out[n].iters = f->max_iters;
+                    out[n].z.real = c_real[n];
+                    out[n].z.imag = c_imag[n];
+                }
+                else
+                {
+                    c_real_left[number_left] = c_real[n];
+                    c_imag_left[number_left] = c_imag[n];
+                    index[number_left] = n;
+                    ++number_left;
+                }
+            }
+
+            fractal_mandelbrot_points(f, c_real_left, c_imag_left,
+                                      number_left, escape);
+
+            for (n = 0U; n < number_left; ++n)
+                out[index[n]] = escape[n];
+        }
+        else
+            fractal_mandelbrot_points(f, c_real, c_imag,
+                                      number_of_points, out);
+
+        return;
+    }
+
+    if (f->type == FRACTAL_SWIPECAT)
+    {
+        fractal_swipecat_points(f, c_real, c_imag, number_of_points, out);
+        return;
+    }
+
+    if (f->type == FRACTAL_MULTIBROT)
+    {
+        fractal_multibrot_points(f, c_real, c_imag, number_of_points, out);
+        return;
+    }
+
+    for (n = 0U; n < number_of_points; ++n)
+    {
+        c.real = c_real[n];
+        c.imag = c_imag[n];
+        fractal_escape_time(f, &c, out + n);
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_escape_row                                                    *
+ *  Purpose:                                                                  *
+ *      Iterates a run of consecutive pixels in one row of an image, see      *
+ *      fractal_escape_points.                                                *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      vp (const struct fractal_viewport *):                                 *
+ *          The viewport for the image.                                       *
+ *      x_begin (unsigned int):                                               *
+ *          The first column in the run.                                      *
+ *      y (unsigned int):                                                     *
+ *          The row containing the run.                                       *
+ *      number_of_points (unsigned int):                                      *
+ *          The length of the run, at most FRACTAL_ROW_CHUNK.                 *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each pixel.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_escape_row(const struct fractal *f, const struct fractal_viewport *vp,
+                   unsigned int x_begin, unsigned int y,
+                   unsigned int number_of_points, struct fractal_escape *out)
+{
+    double c_real[FRACTAL_ROW_CHUNK], c_imag[FRACTAL_ROW_CHUNK];
+    unsigned int n;
+
+    /*  Calculate the point corresponding to each pixel.                      */
+    const double y_point = vp->y_start + (double)y * vp->y_step;
+
+    for (n = 0U; n < number_of_points; ++n)
+    {
+        c_real[n] = vp->x_start + (double)(x_begin + n) * vp->x_step;
+        c_imag[n] = y_point;
+    }
+
+    fractal_escape_points(f, c_real, c_imag, number_of_points, out);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_color_banded                                                  *
+ *  Purpose:                                                                  *
+ *      Coloring used by the Mandelbrot set stills. Points in the set are     *
+ *      black, points that diverge quickly are on a blue-to-yellow gradient,  *
+ *      and points that take a long time to diverge are yellow.               *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      escape (const struct fractal_escape *):                               *
+ *          The result of iterating the point.                                *
+ *      rgb (unsigned char *):                                                *
+ *          The output color, three 8-bit channels.                           *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_color_banded(const struct fractal *f,
+                     const struct fractal_escape *escape,
+                     unsigned char *rgb)
+{
+    /*  Color factors to brighten the region around the Mandelbrot set.       */
+    const unsigned int threshold = 0x40U;
+    const unsigned int color_scale = 0x04U;
+
+    /*  Points that don't diverge are the Mandelbrot set. Color black.        */
+    if (escape->iters >= f->max_iters)
+    {
+        rgb[0] = 0x00U;
+        rgb[1] = 0x00U;
+        rgb[2] = 0x00U;
+    }
+
+    /*  Points that diverged very quickly. Blue-to-Yellow gradient.           */
+    else if (escape->iters < threshold)
+    {
+        const unsigned char brightness
+            = (unsigned char)(escape->iters * color_scale);
+
+        rgb[0] = brightness;
+        rgb[1] = brightness;
+        rgb[2] = 0xFFU - brightness;
+    }
+
+    /*  Points that took a long time to diverge, color yellow.                */
+    else
+    {
+        rgb[0] = 0xFFU;
+        rgb[1] = 0xFFU;
+        rgb[2] = 0x00U;
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_smooth_value                                                  *
+ *  Purpose:                                                                  *
+ *      Computes the smooth iteration count of a point, the number of         *
+ *      iterations corrected by the size of the final iterate.                *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      escape (const struct fractal_escape *):                               *
+ *          The result of iterating the point.                                *
+ *  Output:                                                                   *
+ *      value (double):                                                       *
+ *          The smooth iteration count, which is 1 for points that do not     *
+ *          escape. The gradient factor is log(value) * 4/13.                 *
+ ******************************************************************************/
+static inline double
+fractal_smooth_value(const struct fractal *f,
+                     const struct fractal_escape *escape)
+{
+    double correction;
+
+    /*  Points that do not escape get a gradient factor of zero.              */
+    if (escape->iters >= f->max_iters)
+        return 1.0;
+
+    correction = log(log(fabs(escape->z.real) + 1.0) * 0.33333333333);
+    return fabs((double)escape->iters - correction);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_smooth_factor                                                 *
+ *  Purpose:                                                                  *
+ *      Computes the gradient factor used by fractal_color_smooth from the    *
+ *      number of iterations and the size of the final iterate.               *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      escape (const struct fractal_escape *):                               *
+ *          The result of iterating the point.                                *
+ *  Output:                                                                   *
+ *      background (double):                                                  *
+ *          The gradient factor. Points are colored only when it lies in the  *
+ *          open interval (0, 2), and are black otherwise.                    *
+ ******************************************************************************/
+static inline double
+fractal_smooth_factor(const struct fractal *f,
+                      const struct fractal_escape *escape)
+{
+    return log(fractal_smooth_value(f, escape)) * 0.3076923076923077;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_smooth_rgb                                                    *
+ *  Purpose:                                                                  *
+ *      Maps a gradient factor to the red-yellow-white color scheme used by   *
+ *      fractal_color_smooth.                                                 *
+ *  Arguments:                                                                *
+ *      background (double):                                                  *
+ *          The gradient factor, from fractal_smooth_factor.                  *
+ *      rgb (unsigned char *):                                                *
+ *          The output color, three 8-bit channels.                           *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_smooth_rgb(double background, unsigned char *rgb)
+{
+    /*  Factor used for coloring.                                             */
+    const double val = 1.0 - fabs(1.0 - background);
+
+    /*  Non-positive corresponds to the set itself. Color black.              */
+    if (val <= 0.0)
+    {
+        rgb[0] = 0x00U;
+        rgb[1] = 0x00U;
+        rgb[2] = 0x00U;
+    }
+
+    else if (background <= 1.0)
+    {
+        rgb[0] = (unsigned char)(255.0 * pow(val, 4.0));
+        rgb[1] = (unsigned char)(255.0 * pow(val, 2.5));
+        rgb[2] = (unsigned char)(255.0 * val);
+    }
+
+    else
+    {
+        rgb[0] = (unsigned char)(255.0 * val);
+        rgb[1] = (unsigned char)(255.0 * pow(val, 1.5));
+        rgb[2] = (unsigned char)(255.0 * pow(val, 3.0));
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_color_smooth                                                  *
+ *  Purpose:                                                                  *
+ *      Coloring used by the animations and the SwipeCat fractal. A smooth    *
+ *      gradient factor is computed from the number of iterations and the     *
+ *      size of the final iterate, and this is mapped to a red-yellow-white   *
+ *      color scheme. Points that do not escape are black.                    *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      escape (const struct fractal_escape *):                               *
+ *          The result of iterating the point.                                *
+ *      rgb (unsigned char *):                                                *
+ *          The output color, three 8-bit channels.                           *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_color_smooth(const struct fractal *f,
+                     const struct fractal_escape *escape,
+                     unsigned char *rgb)
+{
+    fractal_smooth_rgb(fractal_smooth_factor(f, escape), rgb);
+}
+
+/*  The smooth coloring as palette indices. Index 0 is left unused, it is the *
+ *  transparent index of gif.h, index 1 is black, and the gradient factors in *
+ *  (0, 2) are split evenly between the remaining 254 indices.                */
+#define FRACTAL_SMOOTH_BLACK_INDEX (1U)
+#define FRACTAL_SMOOTH_FIRST_INDEX (2U)
+#define FRACTAL_SMOOTH_LEVELS (254U)
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_smooth_index                                                  *
+ *  Purpose:                                                                  *
+ *      Maps a gradient factor to its index in the fractal_smooth_colormap    *
+ *      palette.                                                              *
+ *  Arguments:                                                                *
+ *      background (double):                                                  *
+ *          The gradient factor, from fractal_smooth_factor.                  *
+ *  Output:                                                                   *
+ *      index (unsigned char):                                                *
+ *          The palette index.                                                *
+ ******************************************************************************/
+static inline unsigned char
+fractal_smooth_index(double background)
+{
+    const double level = background * (0.5 * (double)FRACTAL_SMOOTH_LEVELS);
+
+    /*  Outside of (0, 2) the color is black, see fractal_smooth_rgb.         */
+    if (!(background > 0.0 && background < 2.0))
+        return FRACTAL_SMOOTH_BLACK_INDEX;
+
+    if (level >= (double)(FRACTAL_SMOOTH_LEVELS - 1U))
+        return FRACTAL_SMOOTH_FIRST_INDEX + FRACTAL_SMOOTH_LEVELS - 1U;
+
+    return (unsigned char)(FRACTAL_SMOOTH_FIRST_INDEX + (unsigned int)level);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_index_smooth                                                  *
+ *  Purpose:                                                                  *
+ *      Same as fractal_color_smooth, but writes the index of the color in    *
+ *      the palette made by fractal_smooth_colormap. Used with one channel    *
+ *      images, for GIFs with a fixed global color table.                     *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      escape (const struct fractal_escape *):                               *
+ *          The result of iterating the point.                                *
+ *      index (unsigned char *):                                              *
+ *          The output palette index, a single byte.                          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_index_smooth(const struct fractal *f,
+                     const struct fractal_escape *escape,
+                     unsigned char *index)
+{
+    index[0] = fractal_smooth_index(fractal_smooth_factor(f, escape));
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_smooth_colormap                                               *
+ *  Purpose:                                                                  *
+ *      Creates the 256 color palette used with fractal_index_smooth. Each    *
+ *      gradient index gets the color at the middle of its range of factors.  *
+ *  Arguments:                                                                *
+ *      colors (unsigned char *):                                             *
+ *          The palette, 256 RGB triples.                                     *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_smooth_colormap(unsigned char *colors)
+{
+    unsigned int n;
+
+    /*  The unused index 0 and black are both drawn in black.                 */
+    for (n = 0U; n < FRACTAL_SMOOTH_FIRST_INDEX; ++n)
+        fractal_smooth_rgb(0.0, colors + 3U*n);
+
+    for (n = 0U; n < FRACTAL_SMOOTH_LEVELS; ++n)
+    {
+        const double background
+            = 2.0 * ((double)n + 0.5) / (double)FRACTAL_SMOOTH_LEVELS;
+
+        fractal_smooth_rgb(background,
+                           colors + 3U*(FRACTAL_SMOOTH_FIRST_INDEX + n));
+    }
+}
+
+/*  Table lookups for the smooth coloring, used by fractal_render_colors.     */
+#include "fractal_colormap.h"
+
+/*  Counters and timers, compiled in with FRACTAL_STATS only.                 */
+#include "fractal_stats.h"
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_colors                                                 *
+ *  Purpose:                                                                  *
+ *      Colors a run of pixels from the results of iterating them.            *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, coloring, and pixel format.                          *
+ *      escape (const struct fractal_escape *):                               *
+ *          The result of iterating each point.                               *
+ *      number_of_points (unsigned int):                                      *
+ *          The number of pixels.                                             *
+ *      pixel (unsigned char *):                                              *
+ *          The first pixel of the run.                                       *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_render_colors(const struct fractal_renderer *r,
+                      const struct fractal_escape *escape,
+                      unsigned int number_of_points, unsigned char *pixel)
+{
+    unsigned int n;
+    const unsigned int channels = r->channels;
+
+    if (r->colormap)
+    {
+        fractal_colormap_color(r->colormap, r->fractal, escape,
+                               number_of_points, channels, pixel);
+        return;
+    }
+
+    for (n = 0U; n < number_of_points; ++n)
+    {
+        r->color(r->fractal, &escape[n], pixel);
+
+        /*  RGBA images (used by gif.h) are fully opaque.                     */
+        if (channels == 4U)
+            pixel[3] = 0xFFU;
+
+        pixel += channels;
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_escapes                                                *
+ *  Purpose:                                                                  *
+ *      Iterates a run of points in a row of the image, in whichever          *
+ *      precision the renderer asks for, without coloring them.               *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, and precision.                             *
+ *      x_begin (unsigned int):                                               *
+ *          The first column in the run.                                      *
+ *      y (unsigned int):                                                     *
+ *          The row containing the run.                                       *
+ *      number_of_points (unsigned int):                                      *
+ *          The length of the run, at most FRACTAL_ROW_CHUNK.                 *
+ *      escape (struct fractal_escape *):                                     *
+ *          The result of iterating each point.                               *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_render_escapes(const struct fractal_renderer *r,
+                       unsigned int x_begin, unsigned int y,
+                       unsigned int number_of_points,
+                       struct fractal_escape *escape)
+{
+    if (r->reference)
+        fractal_deep_escape_row(r->fractal, r->reference, r->viewport,
+                                x_begin, y, number_of_points, escape);
+    else if (r->center)
+        fractal_dd_escape_row(r->fractal, r->center, r->viewport,
+                              x_begin, y, number_of_points, escape);
+    else
+        fractal_escape_row(r->fractal, r->viewport,
+                           x_begin, y, number_of_points, escape);
+
+    fractal_stats_count(r->fractal, escape, number_of_points);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_pixels                                                 *
+ *  Purpose:                                                                  *
+ *      Iterates pixels scattered anywhere in the image, without coloring     *
+ *      them. Each point is computed exactly as fractal_render_escapes does,  *
+ *      so the results match those of drawing the whole image.                *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, and precision.                             *
+ *      x (const unsigned int *):                                             *
+ *          The column of each pixel.                                         *
+ *      y (const unsigned int *):                                             *
+ *          The row of each pixel.                                            *
+ *      number_of_points (unsigned int):                                      *
+ *          The number of pixels, at most FRACTAL_ROW_CHUNK.                  *
+ *      escape (struct fractal_escape *):                                     *
+ *          The result of iterating each point.                               *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_render_pixels(const struct fractal_renderer *r,
+                      const unsigned int *x, const unsigned int *y,
+                      unsigned int number_of_points,
+                      struct fractal_escape *escape)
+{
+    const struct fractal_viewport * const vp = r->viewport;
+    unsigned int n;
+
+    if (number_of_points == 0U)
+        return;
+
+    /*  Deep zooms work a row at a time, so their pixels are done singly.     */
+    if (r->reference)
+    {
+        for (n = 0U; n < number_of_points; ++n)
+            fractal_deep_escape_row(r->fractal, r->reference, vp,
+                                    x[n], y[n], 1U, escape + n);
+    }
+
+    /*  Offsets from a double-double center, as in fractal_dd_escape_row.     */
+    else if (r->center)
+    {
+        struct fractal_dd_batch c;
+
+        for (n = 0U; n < number_of_points; ++n)
+            fractal_dd_batch_set(&c, n, r->center,
+                                 vp->x_start + (double)x[n] * vp->x_step,
+                                 vp->y_start + (double)y[n] * vp->y_step);
+
+        fractal_dd_points(r->fractal, &c, number_of_points, escape);
+    }
+
+    /*  Points computed as in fractal_escape_row.                             */
+    else
+    {
+        double c_real[FRACTAL_ROW_CHUNK], c_imag[FRACTAL_ROW_CHUNK];
+
+        for (n = 0U; n < number_of_points; ++n)
+        {
+            c_real[n] = vp->x_start + (double)x[n] * vp->x_step;
+            c_imag[n] = vp->y_start + (double)y[n] * vp->y_step;
+        }
+
+        fractal_escape_points(r->fractal, c_real, c_imag,
+                              number_of_points, escape);
+    }
+
+    fractal_stats_count(r->fractal, escape, number_of_points);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_span                                                   *
+ *  Purpose:                                                                  *
+ *      Iterates and colors a run of pixels in a row of the image.            *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, coloring, and pixel format.                *
+ *      x_begin (unsigned int):                                               *
+ *          The first column in the run.                                      *
+ *      y (unsigned int):                                                     *
+ *          The row containing the run.                                       *
+ *      number_of_points (unsigned int):                                      *
+ *          The length of the run, which may be of any size.                  *
+ *      pixel (unsigned char *):                                              *
+ *          The first pixel of the run.                                       *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_render_span(const struct fractal_renderer *r,
+                    unsigned int x_begin, unsigned int y,
+                    unsigned int number_of_points, unsigned char *pixel)
+{
+    /*  Variable for looping over the x coordinates in the plane.             */
+    unsigned int x;
+
+    /*  Escape data for a chunk of the run.                                   */
+    struct fractal_escape escape[FRACTAL_ROW_CHUNK];
+
+    const unsigned int x_end = x_begin + number_of_points;
+
+    /*  Loop through the run a chunk at a time.                               */
+    for (x = x_begin; x < x_end; x += FRACTAL_ROW_CHUNK)
+    {
+        unsigned int chunk = x_end - x;
+
+        if (chunk > FRACTAL_ROW_CHUNK)
+            chunk = FRACTAL_ROW_CHUNK;
+
+        /*  Iterate every point in the chunk, then color them.                */
+        fractal_render_escapes(r, x, y, chunk, escape);
+        fractal_render_colors(r, escape, chunk, pixel);
+        pixel += chunk * r->channels;
+    }
+}
+
+/*  Mariani-Silver subdivision, used by fractal_render_rect.                  */
+#include "fractal_subdivide.h"
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_rect                                                   *
+ *  Purpose:                                                                  *
+ *      Renders the pixels with x_begin <= x < x_end and y_begin <= y < y_end *
+ *      into a buffer. The buffer need not hold the entire image, only the    *
+ *      rows being drawn, so an image can be produced a band at a time.       *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, coloring, and pixel format.                *
+ *      rows (unsigned char *):                                               *
+ *          Pointer to the start of row y_begin. Rows are width * channels    *
+ *          bytes long and are stored one after another.                      *
+ *      x_begin (unsigned int):                                               *
+ *          The first column drawn.                                           *
+ *      y_begin (unsigned int):                                               *
+ *          The first row drawn.                                              *
+ *      x_end (unsigned int):                                                 *
+ *          One past the last column drawn.                                   *
+ *      y_end (unsigned int):                                                 *
+ *          One past the last row drawn.                                      *
+ *  Output:                                                                   *
+ *      pixels_iterated (size_t):                                             *
+ *          The number of pixels iterated. With subdivision on, the rest were *
+ *          filled in, otherwise this is every pixel of the rectangle.        *
+ ******************************************************************************/
+static inline size_t
+fractal_render_rect(const struct fractal_renderer *r, unsigned char *rows,
+                    unsigned int x_begin, unsigned int y_begin,
+                    unsigned int x_end, unsigned int y_end)
+{
+    /*  Variable for looping over the y coordinates in the plane.             */
+    unsigned int y;
+
+    const struct fractal_viewport * const vp = r->viewport;
+    const unsigned int channels = r->channels;
+
+    if (r->subdivide != FRACTAL_SUBDIVIDE_NONE)
+        return fractal_subdivide_rect(r, rows, x_begin, y_begin, x_end, y_end);
+
+    /*  Loop through each pixel for the y-axis.                               */
+    for (y = y_begin; y < y_end; ++y)
+    {
+        /*  Pointer to the first pixel being drawn in this row.               */
+        const size_t row = (size_t)(y - y_begin);
+        unsigned char *pixel = rows + (row*vp->width + x_begin)*channels;
+
+        fractal_render_span(r, x_begin, y, x_end - x_begin, pixel);
+    }
+
+    return (size_t)(x_end - x_begin) * (size_t)(y_end - y_begin);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render                                                        *
+ *  Purpose:                                                                  *
+ *      Renders an entire image into a buffer.                                *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, coloring, and pixel format.                *
+ *      buffer (unsigned char *):                                             *
+ *          The image, width * height * channels bytes.                       *
+ *  Output:                                                                   *
+ *      pixels_iterated (size_t):                                             *
+ *          The number of pixels iterated, see fractal_render_rect.           *
+ ******************************************************************************/
+static inline size_t
+fractal_render(const struct fractal_renderer *r, unsigned char *buffer)
+{
+    return fractal_render_rect(r, buffer, 0U, 0U,
+                               r->viewport->width, r->viewport->height);
+}
+
+#endif
+/*  End of include guard.                                                     */
@@ -0,0 +1,514 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Pipelined GIF animations. Worker threads draw frames, several at a    *
+ *      time, and build the palette of each one. The calling thread is the    *
+ *      writer: it takes the frames in order, dithers them against the frame  *
+ *      before, and LZW encodes them into the file. Drawing, palettes, and    *
+ *      writing all overlap, rather than the writer sitting idle while a      *
+ *      frame is drawn and the drawing waiting on the writer.                 *
+ *                                                                            *
+ *      Frames may instead be palette indices for a fixed global color table, *
+ *      in which case there are no palettes to make and nothing to dither.    *
+ *                                                                            *
+ *      Frames are held in a ring of number_of_slots buffers. A worker only   *
+ *      starts frame n once frame n - number_of_slots has been written, so    *
+ *      memory stays at number_of_slots frames however long the animation.    *
+ *  Notes:                                                                    *
+ *      Dithering a frame depends on the output of the frame before, so the   *
+ *      writer does it, one frame at a time. The output is the same as        *
+ *      drawing each frame and passing it to GifWriteFrame, in order.         *
+ *                                                                            *
+ *      Requires POSIX threads. Build with -pthread.                          *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_ANIMATE_H
+#define FRACTAL_ANIMATE_H
+
+/*  pthread_create, pthread_join, mutexes, and condition variables here.      */
+#include <pthread.h>
+
+/*  printf found here.                                                        */
+#include <stdio.h>
+
+/*  malloc, calloc, and free found here.                                      */
+#include <stdlib.h>
+
+/*  GifWriter, GifMakePalette, and the parts of writing a frame found here.   */
+#include "gif.h"
+
+/*  The frame timers of fractal_stats.h, for FRACTAL_STATS builds, here.      */
+#include "fractal.h"
+
+/*  Function that draws a frame. Given the user data, the index of the        *
+ *  worker drawing the frame, the frame number, and the RGBA image, it        *
+ *  returns 0 on success and -1 on failure.                                   */
+typedef int
+(*fractal_frame_func)(void *data, unsigned int worker,
+                      unsigned int frame, unsigned char *image);
+
+/*  Settings for an animation.                                                */
+struct fractal_animator {
+
+    /*  The GIF being written, started with GifBegin.                         */
+    GifWriter *writer;
+
+    /*  The number of pixels in the x and y axes, and the number of frames.   */
+    unsigned int width, height, number_of_frames;
+
+    /*  The GifWriteFrame arguments, the same for every frame.                */
+    uint32_t delay;
+    int bit_depth;
+    bool dither;
+
+    /*  Boolean for frames of palette indices, one byte per pixel, written    *
+     *  with GifWriteIndexedFrame to a GIF started with GifBeginWithPalette.  *
+     *  No palettes are made and nothing is dithered. Otherwise frames are    *
+     *  RGBA, four bytes per pixel.                                           */
+    int indexed;
+
+    /*  Draws a frame, passed the data pointer below. Called from several     *
+     *  threads at once, each with its own worker index.                      */
+    fractal_frame_func draw;
+    void *data;
+
+    /*  The number of worker threads, each with an index less than this.      */
+    unsigned int number_of_threads;
+
+    /*  Frames are handed out in runs of this many consecutive frames, with   *
+     *  the first frame of a run a multiple of frames_per_task. A worker      *
+     *  draws the frames of a run in order, so it can carry state, such as a  *
+     *  keyframe, from one frame of a run to the next.                        */
+    unsigned int frames_per_task;
+
+    /*  The number of frames held in memory at once.                          */
+    unsigned int number_of_slots;
+
+    /*  Boolean for printing a line as each frame is written.                 */
+    int print_progress;
+};
+
+/*  A frame that has been drawn, or is being drawn, and its palette.          */
+struct fractal_animation_slot {
+
+    /*  The RGBA image, or the palette indices if the frames are indexed.     */
+    unsigned char *image;
+
+    /*  The palette for the image, made by the worker for dithered frames.    */
+    GifPalette palette;
+
+    /*  The frame held, valid once the frame has been drawn.                  */
+    unsigned int frame;
+
+    /*  Boolean for the frame having been drawn and not yet written.          */
+    int ready;
+};
+
+/*  State shared by the workers and the writer.                               */
+struct fractal_animation {
+
+    /*  The settings for the animation.                                       */
+    const struct fractal_animator *animator;
+
+    /*  The ring of frames, frame n goes in slots[n % number_of_slots].       */
+    struct fractal_animation_slot *slots;
+
+    /*  Guards every variable below, and the ready flags of the slots.        */
+    pthread_mutex_t lock;
+
+    /*  Signaled when a frame has been drawn, and when one has been written.  */
+    pthread_cond_t drawn, written;
+
+    /*  The next run of frames to hand out, and the number of frames written. */
+    unsigned int next_task, frames_written;
+
+    /*  Boolean for a frame having failed to draw. Everything stops.          */
+    int failed;
+};
+
+/*  Per worker arguments for the thread routine.                              */
+struct fractal_animation_worker {
+
+    /*  The shared state.                                                     */
+    struct fractal_animation *animation;
+
+    /*  The worker index passed to the draw function.                         */
+    unsigned int index;
+
+    /*  Buffers for making palettes, reused for every frame of the worker.    */
+    GifPaletteScratch scratch;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_animation_fail                                                *
+ *  Purpose:                                                                  *
+ *      Marks the animation as failed and wakes every waiting thread.         *
+ *  Arguments:                                                                *
+ *      a (struct fractal_animation *):                                       *
+ *          The animation, with the lock held.                                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_animation_fail(struct fractal_animation *a)
+{
+    a->failed = 1;
+    pthread_cond_broadcast(&a->drawn);
+    pthread_cond_broadcast(&a->written);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_animation_thread                                              *
+ *  Purpose:                                                                  *
+ *      Thread routine. Repeatedly grabs the next run of frames and draws     *
+ *      them, waiting for a free slot before each one.                        *
+ *  Arguments:                                                                *
+ *      arg (void *):                                                         *
+ *          Pointer to a struct fractal_animation_worker.                     *
+ *  Output:                                                                   *
+ *      NULL (void *).                                                        *
+ *  Notes:                                                                    *
+ *      Runs are handed out in order, so the worker holding the earliest      *
+ *      frame not yet written always finds its slots free. The pipeline can   *
+ *      not deadlock for any number of slots.                                 *
+ ******************************************************************************/
+static inline void *
+fractal_animation_thread(void *arg)
+{
+    struct fractal_animation_worker * const w = arg;
+    struct fractal_animation * const a = w->animation;
+    const struct fractal_animator * const anim = a->animator;
+    const unsigned int number_of_slots = anim->number_of_slots;
+
+    while (1)
+    {
+        unsigned int frame, first, last;
+
+        pthread_mutex_lock(&a->lock);
+        first = a->next_task * anim->frames_per_task;
+        ++a->next_task;
+        pthread_mutex_unlock(&a->lock);
+
+        if (first >= anim->number_of_frames)
+            break;
+
+        last = first + anim->frames_per_task;
+
+        if (last > anim->number_of_frames)
+            last = anim->number_of_frames;
+
+        for (frame = first; frame < last; ++frame)
+        {
+            struct fractal_animation_slot * const slot
+                = &a->slots[frame % number_of_slots];
+            double start, drawn;
+            int status;
+
+            /*  The slot is free once the frame before it has been written.   */
+            pthread_mutex_lock(&a->lock);
+
+            while (a->frames_written + number_of_slots <= frame && !a->failed)
+                pthread_cond_wait(&a->written, &a->lock);
+
+            status = (a->failed ? -1 : 0);
+            pthread_mutex_unlock(&a->lock);
+
+            if (status != 0)
+                return NULL;
+
+            start = fractal_stats_now();
+            status = anim->draw(anim->data, w->index, frame, slot->image);
+            drawn = fractal_stats_now();
+
+            /*  A dithered palette only depends on this frame, make it here.  */
+            if (status == 0 && anim->dither && !anim->indexed)
+            {
+                if (!GifMakePalette(NULL, slot->image,
+                                    anim->width, anim->height,
+                                    anim->bit_depth, true, &slot->palette,
+                                    &w->scratch))
+                    status = -1;
+            }
+
+            fractal_stats_frame_drawn(frame, w->index, drawn - start,
+                                      fractal_stats_now() - drawn);
+
+            pthread_mutex_lock(&a->lock);
+
+            if (status != 0)
+            {
+                fractal_animation_fail(a);
+                pthread_mutex_unlock(&a->lock);
+                return NULL;
+            }
+
+            slot->frame = frame;
+            slot->ready = 1;
+            pthread_cond_broadcast(&a->drawn);
+            pthread_mutex_unlock(&a->lock);
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_animation_write                                               *
+ *  Purpose:                                                                  *
+ *      Writes a drawn frame to the GIF. This is GifWriteFrameWithPalette, or *
+ *      GifWriteIndexedFrame, a part at a time, so that each part can be      *
+ *      timed, see fractal_stats.h.                                           *
+ *  Arguments:                                                                *
+ *      anim (const struct fractal_animator *):                               *
+ *          The animation.                                                    *
+ *      slot (struct fractal_animation_slot *):                               *
+ *          The frame, with its palette if it is dithered.                    *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+fractal_animation_write(const struct fractal_animator *anim,
+                        struct fractal_animation_slot *slot)
+{
+    GifWriter * const writer = anim->writer;
+    const double start = fractal_stats_now();
+    double palette_done = start, quantize_done = start;
+
+    if (anim->indexed)
+    {
+        if (!GifWriteIndexedFrame(writer, slot->image,
+                                  anim->width, anim->height, anim->delay))
+            return -1;
+    }
+    else
+    {
+        if (!writer->f)
+            return -1;
+
+        /*  Palettes for dithered frames were made by the workers.            */
+        if (!anim->dither &&
+            !GifMakeFramePalette(writer, slot->image, anim->width,
+                                 anim->height, anim->bit_depth, false,
+                                 &slot->palette))
+            return -1;
+
+        palette_done = fractal_stats_now();
+
+        if (!GifQuantizeFrame(writer, slot->image, anim->width, anim->height,
+                              anim->dither, &slot->palette))
+            return -1;
+
+        quantize_done = fractal_stats_now();
+        GifWriteQuantizedFrame(writer, anim->width, anim->height,
+                               anim->delay, &slot->palette);
+    }
+
+    fractal_stats_frame_written(slot->frame, palette_done - start,
+                                quantize_done - palette_done,
+                                fractal_stats_now() - quantize_done);
+    return 0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_animation_run                                                 *
+ *  Purpose:                                                                  *
+ *      Starts the workers and writes the frames as they are drawn.           *
+ *  Arguments:                                                                *
+ *      a (struct fractal_animation *):                                       *
+ *          The animation, with every slot allocated.                         *
+ *      threads (pthread_t *):                                                *
+ *          Room for number_of_threads threads.                               *
+ *      workers (struct fractal_animation_worker *):                          *
+ *          Room for number_of_threads worker arguments.                      *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+fractal_animation_run(struct fractal_animation *a, pthread_t *threads,
+                      struct fractal_animation_worker *workers)
+{
+    const struct fractal_animator * const anim = a->animator;
+    unsigned int n, frame, number_started = 0U;
+    int status = 0;
+
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->drawn, NULL);
+    pthread_cond_init(&a->written, NULL);
+
+    /*  Check the CPU now so the workers only ever read the cached result.    */
+    fractal_simd_level();
+
+    for (n = 0U; n < anim->number_of_threads; ++n)
+    {
+        workers[n].animation = a;
+        workers[n].index = n;
+        GifInitPaletteScratch(&workers[n].scratch);
+
+        if (pthread_create(&threads[n], NULL,
+                           fractal_animation_thread, &workers[n]))
+            break;
+
+        ++number_started;
+    }
+
+    /*  Without a single worker nothing would ever be drawn.                  */
+    if (number_started == 0U)
+        status = -1;
+
+    for (frame = 0U; frame < anim->number_of_frames && status == 0; ++frame)
+    {
+        struct fractal_animation_slot * const slot
+            = &a->slots[frame % anim->number_of_slots];
+
+        pthread_mutex_lock(&a->lock);
+
+        while (!(slot->ready && slot->frame == frame) && !a->failed)
+            pthread_cond_wait(&a->drawn, &a->lock);
+
+        if (a->failed)
+            status = -1;
+
+        pthread_mutex_unlock(&a->lock);
+
+        if (status != 0)
+            break;
+
+        if (anim->print_progress)
+            printf("Writing frame %u...\n", frame);
+
+        status = fractal_animation_write(anim, slot);
+
+        pthread_mutex_lock(&a->lock);
+        slot->ready = 0;
+        a->frames_written = frame + 1U;
+        pthread_cond_broadcast(&a->written);
+        pthread_mutex_unlock(&a->lock);
+    }
+
+    /*  Stop any workers still waiting on a slot if the writer gave up.       */
+    if (status != 0)
+    {
+        pthread_mutex_lock(&a->lock);
+        fractal_animation_fail(a);
+        pthread_mutex_unlock(&a->lock);
+    }
+
+    for (n = 0U; n < number_started; ++n)
+        pthread_join(threads[n], NULL);
+
+    for (n = 0U; n < number_started; ++n)
+        GifFreePaletteScratch(&workers[n].scratch);
+
+    pthread_cond_destroy(&a->written);
+    pthread_cond_destroy(&a->drawn);
+    pthread_mutex_destroy(&a->lock);
+    return status;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_animate                                                       *
+ *  Purpose:                                                                  *
+ *      Draws every frame of an animation and writes them to a GIF.           *
+ *  Arguments:                                                                *
+ *      anim (const struct fractal_animator *):                               *
+ *          The animation. number_of_threads, frames_per_task, and            *
+ *          number_of_slots must all be at least one.                         *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure. Frames written before a failure      *
+ *          remain in the GIF, and GifEnd must still be called.               *
+ *  Notes:                                                                    *
+ *      Memory is number_of_slots * width * height * 4 bytes, a quarter of    *
+ *      that for indexed frames. For every worker to be busy, the number of   *
+ *      slots should be about (number_of_threads + 1) * frames_per_task, so   *
+ *      every worker has a run in progress while the writer catches up on the *
+ *      oldest one. The writer's ditherThreads is set to number_of_threads.   *
+ ******************************************************************************/
+static inline int
+fractal_animate(const struct fractal_animator *anim)
+{
+    struct fractal_animation a;
+    struct fractal_animation_worker *workers;
+    pthread_t *threads;
+    unsigned int n;
+    const size_t image_size = (size_t)anim->width * (size_t)anim->height
+                            * (anim->indexed ? 1U : 4U);
+    int status = 0;
+
+    if (anim->number_of_threads == 0U || anim->frames_per_task == 0U ||
+        anim->number_of_slots == 0U)
+        return -1;
+
+    a.animator = anim;
+    a.next_task = 0U;
+    a.frames_written = 0U;
+    a.failed = 0;
+    a.slots = calloc(anim->number_of_slots, sizeof(*a.slots));
+    threads = malloc(sizeof(*threads) * anim->number_of_threads);
+    workers = malloc(sizeof(*workers) * anim->number_of_threads);
+
+    if (!a.slots || !threads || !workers)
+        status = -1;
+    else
+    {
+        for (n = 0U; n < anim->number_of_slots; ++n)
+        {
+            a.slots[n].image = malloc(image_size);
+
+            if (!a.slots[n].image)
+                status = -1;
+        }
+    }
+
+    /*  Dithering is the slowest part of writing a frame, and is done on the  *
+     *  writer thread. Let it use as many threads as there are workers.       */
+    anim->writer->ditherThreads = (int)anim->number_of_threads;
+
+    if (status == 0)
+    {
+        const double start = fractal_stats_now();
+
+        fractal_stats_begin_frames(anim->number_of_frames);
+        status = fractal_animation_run(&a, threads, workers);
+        fractal_stats_parallel(anim->number_of_threads,
+                               fractal_stats_now() - start);
+    }
+
+    if (a.slots)
+    {
+        for (n = 0U; n < anim->number_of_slots; ++n)
+            free(a.slots[n].image);
+    }
+
+    free(a.slots);
+    free(threads);
+    free(workers);
+    return status;
+}
+
+#endif
+/*  End of include guard.                                                     */
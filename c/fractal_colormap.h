@@ -0,0 +1,244 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Precomputed colors for the smooth coloring. fractal_color_smooth      *
+ *      takes the log of the smooth iteration count and then raises the       *
+ *      result to two powers, for every pixel. The colors only depend on the  *
+ *      smooth iteration count, so they are computed once, for a table of     *
+ *      counts, and coloring a pixel becomes a table lookup.                  *
+ *                                                                            *
+ *      The gradient factor is the log of the count, so the table is spaced   *
+ *      evenly in the log too. Entries are indexed by the exponent and the    *
+ *      leading FRACTAL_COLORMAP_BITS bits of the mantissa of the count, read *
+ *      straight from its bits, which needs no log at all. Counts from 1 up   *
+ *      to 2^FRACTAL_COLORMAP_OCTAVES are covered, and the rest are black.    *
+ *  Notes:                                                                    *
+ *      This file is included by fractal.h, do not include it directly.       *
+ *                                                                            *
+ *      Each entry holds the color at the middle of its range of counts. A    *
+ *      count is within a factor of 1 + 2^-(BITS+1) of the middle, so the     *
+ *      gradient factor is off by less than 1.6e-4 and the colors by less     *
+ *      than a fifth of a level. A lookup gives the same color as             *
+ *      fractal_color_smooth, or one a level away where it is rounded down.   *
+ *                                                                            *
+ *      The table is read-only once made, and is shared by every thread and   *
+ *      every frame.                                                          *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_COLORMAP_H
+#define FRACTAL_COLORMAP_H
+
+/*  uint64_t found here.                                                      */
+#include <stdint.h>
+
+/*  malloc and free found here.                                               */
+#include <stdlib.h>
+
+/*  memcpy found here.                                                        */
+#include <string.h>
+
+/*  Bits of the mantissa used to index the table, entries per octave of the   *
+ *  smooth iteration count.                                                   */
+#define FRACTAL_COLORMAP_BITS (10U)
+
+/*  Octaves of the smooth iteration count covered by the table. The gradient  *
+ *  factor reaches 2, where the colors turn black, at a count of about 665.   */
+#define FRACTAL_COLORMAP_OCTAVES (10U)
+
+/*  The number of entries in the table.                                       */
+#define FRACTAL_COLORMAP_SIZE \
+    (FRACTAL_COLORMAP_OCTAVES << FRACTAL_COLORMAP_BITS)
+
+/*  The bits of a double past those used to index the table.                  */
+#define FRACTAL_COLORMAP_SHIFT (52U - FRACTAL_COLORMAP_BITS)
+
+/*  The bits of the double 1.0, the smooth iteration count of entry 0.        */
+#define FRACTAL_COLORMAP_ONE (UINT64_C(0x3FF0000000000000))
+
+/*  A table of colors indexed by the smooth iteration count.                  */
+struct fractal_colormap {
+
+    /*  Three bytes of RGB for each entry.                                    */
+    unsigned char *rgb;
+
+    /*  The index of each entry in the fractal_smooth_colormap palette.       */
+    unsigned char *index;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_colormap_entry                                                *
+ *  Purpose:                                                                  *
+ *      Finds the table entry for a smooth iteration count.                   *
+ *  Arguments:                                                                *
+ *      value (double):                                                       *
+ *          The smooth iteration count, from fractal_smooth_value.            *
+ *  Output:                                                                   *
+ *      entry (uint64_t):                                                     *
+ *          The index of the entry, FRACTAL_COLORMAP_SIZE or more if the      *
+ *          count is outside of the table.                                    *
+ *  Method:                                                                   *
+ *      For a positive double the bits, read as an integer, grow with the     *
+ *      value, and going up an octave adds one to the exponent field. Taking  *
+ *      away the bits of 1.0 and dropping the low bits of the mantissa gives  *
+ *      octave * 2^BITS plus the leading bits of the mantissa. Counts below 1 *
+ *      wrap around to huge entries, as do infinities and NaNs.               *
+ ******************************************************************************/
+static inline uint64_t
+fractal_colormap_entry(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits - FRACTAL_COLORMAP_ONE) >> FRACTAL_COLORMAP_SHIFT;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_colormap_init                                                 *
+ *  Purpose:                                                                  *
+ *      Allocates and fills in the table for the smooth coloring.             *
+ *  Arguments:                                                                *
+ *      cm (struct fractal_colormap *):                                       *
+ *          The table.                                                        *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+fractal_colormap_init(struct fractal_colormap *cm)
+{
+    unsigned int n;
+
+    cm->rgb = malloc(3U * FRACTAL_COLORMAP_SIZE);
+    cm->index = malloc(FRACTAL_COLORMAP_SIZE);
+
+    if (!cm->rgb || !cm->index)
+    {
+        free(cm->rgb);
+        free(cm->index);
+        cm->rgb = NULL;
+        cm->index = NULL;
+        return -1;
+    }
+
+    for (n = 0U; n < FRACTAL_COLORMAP_SIZE; ++n)
+    {
+        /*  The count in the middle of the entry, half way along the bits.    */
+        const uint64_t bits = FRACTAL_COLORMAP_ONE
+                            + ((uint64_t)n << FRACTAL_COLORMAP_SHIFT)
+                            + (UINT64_C(1) << (FRACTAL_COLORMAP_SHIFT - 1U));
+        double value, background;
+
+        memcpy(&value, &bits, sizeof(value));
+        background = log(value) * 0.3076923076923077;
+
+        fractal_smooth_rgb(background, cm->rgb + 3U*n);
+        cm->index[n] = fractal_smooth_index(background);
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_colormap_free                                                 *
+ *  Purpose:                                                                  *
+ *      Frees the memory used by a table.                                     *
+ *  Arguments:                                                                *
+ *      cm (struct fractal_colormap *):                                       *
+ *          The table.                                                        *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_colormap_free(struct fractal_colormap *cm)
+{
+    free(cm->rgb);
+    free(cm->index);
+    cm->rgb = NULL;
+    cm->index = NULL;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_colormap_color                                                *
+ *  Purpose:                                                                  *
+ *      Colors a run of pixels from the table, as fractal_color_smooth, or    *
+ *      fractal_index_smooth for one channel images, would.                   *
+ *  Arguments:                                                                *
+ *      cm (const struct fractal_colormap *):                                 *
+ *          The table.                                                        *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      escape (const struct fractal_escape *):                               *
+ *          The result of iterating each point.                               *
+ *      number_of_points (unsigned int):                                      *
+ *          The number of pixels.                                             *
+ *      channels (unsigned int):                                              *
+ *          The number of bytes per pixel, 1 for a palette index, 3 for RGB,  *
+ *          or 4 for RGBA.                                                    *
+ *      pixel (unsigned char *):                                              *
+ *          The first pixel of the run.                                       *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_colormap_color(const struct fractal_colormap *cm,
+                       const struct fractal *f,
+                       const struct fractal_escape *escape,
+                       unsigned int number_of_points, unsigned int channels,
+                       unsigned char *pixel)
+{
+    static const unsigned char black[3] = {0x00U, 0x00U, 0x00U};
+    unsigned int n;
+
+    for (n = 0U; n < number_of_points; ++n)
+    {
+        uint64_t entry = FRACTAL_COLORMAP_SIZE;
+
+        /*  Points that do not escape are black.                              */
+        if (escape[n].iters < f->max_iters)
+            entry = fractal_colormap_entry(fractal_smooth_value(f, escape + n));
+
+        if (channels == 1U)
+        {
+            if (entry < FRACTAL_COLORMAP_SIZE)
+                pixel[0] = cm->index[entry];
+            else
+                pixel[0] = FRACTAL_SMOOTH_BLACK_INDEX;
+        }
+        else
+        {
+            if (entry < FRACTAL_COLORMAP_SIZE)
+                memcpy(pixel, cm->rgb + 3U*entry, 3U);
+            else
+                memcpy(pixel, black, 3U);
+
+            /*  RGBA images (used by gif.h) are fully opaque.                 */
+            if (channels == 4U)
+                pixel[3] = 0xFFU;
+        }
+
+        pixel += channels;
+    }
+}
+
+#endif
+/*  End of include guard.                                                     */
@@ -0,0 +1,1031 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Double-double arithmetic for zooms a little too deep for doubles.     *
+ *      A number is stored as the unevaluated sum hi + lo of two doubles,     *
+ *      with |lo| at most half a unit in the last place of hi, giving about   *
+ *      106 bits of precision. Pixels are iterated directly in this           *
+ *      precision, so unlike perturbation there is no reference orbit, no     *
+ *      glitches, and no series, at the cost of about 30 floating point       *
+ *      operations for each one of z^2 + c. The products are exact with FMA,  *
+ *      and the AVX2 and AVX-512 kernels iterate 8 and 16 points at a time.   *
+ *  Notes:                                                                    *
+ *      This file is included by fractal.h, do not include it directly.       *
+ *                                                                            *
+ *      The algorithms are those of the QD library of Hida, Li, and Bailey.   *
+ *      Only the Mandelbrot set, z^2 + c, is supported. The kernels do the    *
+ *      same operations in the same order as the scalar code, and the         *
+ *      products are exact either way, so the output is the same on every     *
+ *      CPU unless the compiler is allowed to contract the remaining          *
+ *      multiplies and adds into FMAs. Periodicity checking and the interior  *
+ *      test are not used, the tolerances of both are meant for doubles.      *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_DD_H
+#define FRACTAL_DD_H
+
+/*  Pixel spacing, relative to the size of the center, below which            *
+ *  double-double loses too many bits per pixel and perturbation should be    *
+ *  used. The same margin as FRACTAL_DEEP_THRESHOLD gives doubles.            */
+#define FRACTAL_DD_THRESHOLD (1.0E-27)
+
+/*  Perturbation is scalar and takes about three times as long per iteration  *
+ *  as the AVX-512 double-double kernel, but skips the iterations covered by  *
+ *  its series. Once that is this fraction of max_iters it is the cheaper of  *
+ *  the two, even where double-double is precise enough.                      */
+#define FRACTAL_DD_SERIES_FRACTION (0.75)
+
+/*  Size of the fixed point numbers used to read the center from a string,    *
+ *  224 bits after the point. More than a double-double can hold.             */
+#define FRACTAL_DD_LIMBS (8U)
+
+/*  2^27 + 1, splits a double into two halves of 26 bits for Dekker's exact   *
+ *  product, used when there is no fast fused multiply-add.                   */
+#define FRACTAL_DD_SPLIT (134217729.0)
+
+/*  A double-double number, hi + lo.                                          */
+struct fractal_dd {
+    double hi, lo;
+};
+
+/*  A complex number with double-double parts.                                */
+struct fractal_dd_complex {
+    struct fractal_dd real, imag;
+};
+
+/*  A batch of points, at most FRACTAL_ROW_CHUNK of them, one array per part  *
+ *  so the kernels can load them as vectors.                                  */
+struct fractal_dd_batch {
+    double real_hi[FRACTAL_ROW_CHUNK], real_lo[FRACTAL_ROW_CHUNK];
+    double imag_hi[FRACTAL_ROW_CHUNK], imag_lo[FRACTAL_ROW_CHUNK];
+};
+
+/*  The ways a zoom can compute its points, from cheapest to deepest.         */
+enum fractal_precision {
+
+    /*  Plain doubles, each pixel given by its own coordinates.               */
+    FRACTAL_PRECISION_DOUBLE,
+
+    /*  Double-double, pixels given as offsets from a center, see             *
+     *  fractal_dd_escape_row.                                                */
+    FRACTAL_PRECISION_DOUBLE_DOUBLE,
+
+    /*  Perturbation from a reference orbit, see fractal_deep.h.              */
+    FRACTAL_PRECISION_PERTURBATION
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_precision_select                                              *
+ *  Purpose:                                                                  *
+ *      Picks the cheapest precision that can draw a zoom.                    *
+ *  Arguments:                                                                *
+ *      center_real (double):                                                 *
+ *          The real part of the center of the image.                         *
+ *      center_imag (double):                                                 *
+ *          The imaginary part of the center of the image.                    *
+ *      pixel_spacing (double):                                               *
+ *          The distance between neighboring pixels.                          *
+ *  Output:                                                                   *
+ *      precision (enum fractal_precision):                                   *
+ *          The precision to draw the image with.                             *
+ ******************************************************************************/
+static inline enum fractal_precision
+fractal_precision_select(double center_real, double center_imag,
+                         double pixel_spacing)
+{
+    double size = fabs(center_real);
+
+    if (fabs(center_imag) > size)
+        size = fabs(center_imag);
+
+    if (size < 1.0)
+        size = 1.0;
+
+    if (!fractal_deep_is_needed(center_real, center_imag, pixel_spacing))
+        return FRACTAL_PRECISION_DOUBLE;
+
+    if (fabs(pixel_spacing) >= size * FRACTAL_DD_THRESHOLD)
+        return FRACTAL_PRECISION_DOUBLE_DOUBLE;
+
+    return FRACTAL_PRECISION_PERTURBATION;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_precision_prefer_perturbation                                 *
+ *  Purpose:                                                                  *
+ *      Determines if perturbation is cheaper than double-double for an       *
+ *      image both can draw.                                                  *
+ *  Arguments:                                                                *
+ *      ref (const struct fractal_reference *):                               *
+ *          The orbit of the center, with fractal_series_compute already      *
+ *          called for the image. May be empty.                               *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *  Output:                                                                   *
+ *      prefer (int):                                                         *
+ *          Boolean for whether to use perturbation.                          *
+ ******************************************************************************/
+static inline int
+fractal_precision_prefer_perturbation(const struct fractal_reference *ref,
+                                      const struct fractal *f)
+{
+    if (ref->length == 0U)
+        return 0;
+
+    return (double)ref->series.skip
+        >= FRACTAL_DD_SERIES_FRACTION * (double)f->max_iters;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_two_sum                                                    *
+ *  Purpose:                                                                  *
+ *      Computes a + b and its rounding error exactly.                        *
+ *  Arguments:                                                                *
+ *      out (struct fractal_dd *):                                            *
+ *          The sum, rounded, in out->hi, and the error in out->lo.           *
+ *      a (double):                                                           *
+ *          The first term.                                                   *
+ *      b (double):                                                           *
+ *          The second term.                                                  *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      Knuth's TwoSum, six operations with no branches.                      *
+ ******************************************************************************/
+static inline void
+fractal_dd_two_sum(struct fractal_dd *out, double a, double b)
+{
+    const double sum = a + b;
+    const double b_virtual = sum - a;
+
+    out->lo = (a - (sum - b_virtual)) + (b - b_virtual);
+    out->hi = sum;
+}
+
+/*  The same, for a - b.                                                      */
+static inline void
+fractal_dd_two_diff(struct fractal_dd *out, double a, double b)
+{
+    const double diff = a - b;
+    const double b_virtual = diff - a;
+
+    out->lo = (a - (diff - b_virtual)) - (b + b_virtual);
+    out->hi = diff;
+}
+
+/*  The same, in three operations, for |a| >= |b|.                            */
+static inline void
+fractal_dd_quick_two_sum(struct fractal_dd *out, double a, double b)
+{
+    const double sum = a + b;
+
+    out->lo = b - (sum - a);
+    out->hi = sum;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_two_prod                                                   *
+ *  Purpose:                                                                  *
+ *      Computes a b and its rounding error exactly.                          *
+ *  Arguments:                                                                *
+ *      out (struct fractal_dd *):                                            *
+ *          The product, rounded, in out->hi, and the error in out->lo.       *
+ *      a (double):                                                           *
+ *          The first factor.                                                 *
+ *      b (double):                                                           *
+ *          The second factor.                                                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      With a fused multiply-add the error is fma(a, b, -ab). Without one,   *
+ *      Dekker's method splits a and b into halves whose products are exact.  *
+ *      Both give the exact error, so the results agree.                      *
+ ******************************************************************************/
+static inline void
+fractal_dd_two_prod(struct fractal_dd *out, double a, double b)
+{
+    const double product = a * b;
+
+#ifdef FP_FAST_FMA
+    out->lo = fma(a, b, -product);
+#else
+    const double a_big = FRACTAL_DD_SPLIT * a;
+    const double b_big = FRACTAL_DD_SPLIT * b;
+    const double a_hi = a_big - (a_big - a);
+    const double b_hi = b_big - (b_big - b);
+    const double a_lo = a - a_hi;
+    const double b_lo = b - b_hi;
+
+    out->lo = ((a_hi*b_hi - product) + a_hi*b_lo + a_lo*b_hi) + a_lo*b_lo;
+#endif
+
+    out->hi = product;
+}
+
+/*  Adds a double to a double-double number. out may be the same as a.        */
+static inline void
+fractal_dd_add_double(struct fractal_dd *out,
+                      const struct fractal_dd *a, double b)
+{
+    struct fractal_dd s;
+
+    fractal_dd_two_sum(&s, a->hi, b);
+    fractal_dd_quick_two_sum(out, s.hi, s.lo + a->lo);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_from_string                                                *
+ *  Purpose:                                                                  *
+ *      Converts a decimal string to the nearest double-double.               *
+ *  Arguments:                                                                *
+ *      x (struct fractal_dd *):                                              *
+ *          The output.                                                       *
+ *      str (const char *):                                                   *
+ *          The number, in the format of fractal_fixed_from_string.           *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 if the string is not understood.                 *
+ *  Method:                                                                   *
+ *      The string is read in fixed point. Rounding it to a double gives hi,  *
+ *      and subtracting hi, which is exact, and rounding again gives lo.      *
+ ******************************************************************************/
+static inline int
+fractal_dd_from_string(struct fractal_dd *x, const char *str)
+{
+    struct fractal_fixed value, hi;
+
+    if (fractal_fixed_from_string(&value, str, FRACTAL_DD_LIMBS) != 0)
+        return -1;
+
+    x->hi = fractal_fixed_to_double(&value);
+    fractal_fixed_from_double(&hi, x->hi, FRACTAL_DD_LIMBS);
+    fractal_fixed_sub(&value, &value, &hi);
+    x->lo = fractal_fixed_to_double(&value);
+    return 0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_mandelbrot_iter                                            *
+ *  Purpose:                                                                  *
+ *      Computes z^2 + c in double-double precision.                          *
+ *  Arguments:                                                                *
+ *      z (struct fractal_dd_complex *):                                      *
+ *          The current iterate, z_{n}. Overwritten with z_{n+1}.             *
+ *      c (const struct fractal_dd_complex *):                                *
+ *          The point being tested.                                           *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      Rather than a full double-double multiply or add for every operation, *
+ *      the exact products of the high parts are summed with TwoSum, and the  *
+ *      rounding errors, cross terms, and low parts are added up in double at *
+ *      the end. This is half the work of the general operations with errors  *
+ *      of the same size, a few units in the 106th bit of the largest of      *
+ *      |x^2|, |y^2|, and |c|.                                                *
+ ******************************************************************************/
+static inline void
+fractal_dd_mandelbrot_iter(struct fractal_dd_complex *z,
+                           const struct fractal_dd_complex *c)
+{
+    struct fractal_dd x_sq, y_sq, xy, sum;
+    double lo;
+
+    fractal_dd_two_prod(&x_sq, z->real.hi, z->real.hi);
+    fractal_dd_two_prod(&y_sq, z->imag.hi, z->imag.hi);
+    fractal_dd_two_prod(&xy, z->real.hi, z->imag.hi);
+
+    /*  The cross terms. The products of two low parts are too small to       *
+     *  matter.                                                               */
+    x_sq.lo += 2.0*z->real.hi*z->real.lo;
+    y_sq.lo += 2.0*z->imag.hi*z->imag.lo;
+    xy.lo += z->real.hi*z->imag.lo + z->real.lo*z->imag.hi;
+
+    /*  The real part, x^2 - y^2 + c_real.                                    */
+    fractal_dd_two_diff(&sum, x_sq.hi, y_sq.hi);
+    lo = sum.lo + (x_sq.lo - y_sq.lo);
+    fractal_dd_two_sum(&sum, sum.hi, c->real.hi);
+    lo = (lo + sum.lo) + c->real.lo;
+    fractal_dd_quick_two_sum(&z->real, sum.hi, lo);
+
+    /*  The imaginary part, 2xy + c_imag. Doubling is exact.                  */
+    fractal_dd_two_sum(&sum, 2.0*xy.hi, c->imag.hi);
+    lo = (sum.lo + 2.0*xy.lo) + c->imag.lo;
+    fractal_dd_quick_two_sum(&z->imag, sum.hi, lo);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_escape                                                     *
+ *  Purpose:                                                                  *
+ *      Iterates z^2 + c for a point until it escapes or max_iters is         *
+ *      reached, as fractal_escape_loop does in double precision.             *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      c (const struct fractal_dd_complex *):                                *
+ *          The point being tested.                                           *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and the final value of z, rounded to     *
+ *          double.                                                           *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_dd_escape(const struct fractal *f,
+                  const struct fractal_dd_complex *c,
+                  struct fractal_escape *out)
+{
+    unsigned int iters;
+    const double radius = f->escape_radius;
+    const double radius_squared = radius*radius;
+    struct fractal_dd_complex z;
+
+    if (f->start_at_c)
+        z = *c;
+    else
+    {
+        z.real.hi = z.real.lo = 0.0;
+        z.imag.hi = z.imag.lo = 0.0;
+    }
+
+    for (iters = 0U; iters < f->max_iters; ++iters)
+    {
+        fractal_dd_mandelbrot_iter(&z, c);
+
+        /*  The high parts are z rounded to double, plenty for the test.      */
+        if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+        {
+            if (z.real.hi*z.real.hi + z.imag.hi*z.imag.hi > radius_squared)
+                break;
+        }
+        else if (fabs(z.real.hi) >= radius)
+            break;
+    }
+
+    out->iters = iters;
+    out->z.real = z.real.hi;
+    out->z.imag = z.imag.hi;
+}
+
+#ifdef FRACTAL_HAS_X86_SIMD
+
+/*  A vector of double-double numbers, 4 lanes with AVX2.                     */
+struct fractal_dd_m256 {
+    __m256d hi, lo;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_two_sum_avx2                                               *
+ *  Purpose:                                                                  *
+ *      The same as fractal_dd_two_sum, lane by lane, and likewise for the    *
+ *      other functions ending in _avx2 below.                                *
+ *  Arguments:                                                                *
+ *      out (struct fractal_dd_m256 *):                                       *
+ *          The sums and their errors.                                        *
+ *      a (__m256d):                                                          *
+ *          The first terms.                                                  *
+ *      b (__m256d):                                                          *
+ *          The second terms.                                                 *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+FRACTAL_AVX2_FMA_TARGET
+static inline void
+fractal_dd_two_sum_avx2(struct fractal_dd_m256 *out, __m256d a, __m256d b)
+{
+    const __m256d sum = _mm256_add_pd(a, b);
+    const __m256d b_virtual = _mm256_sub_pd(sum, a);
+
+    out->lo = _mm256_add_pd(_mm256_sub_pd(a, _mm256_sub_pd(sum, b_virtual)),
+                            _mm256_sub_pd(b, b_virtual));
+    out->hi = sum;
+}
+
+FRACTAL_AVX2_FMA_TARGET
+static inline void
+fractal_dd_two_diff_avx2(struct fractal_dd_m256 *out, __m256d a, __m256d b)
+{
+    const __m256d diff = _mm256_sub_pd(a, b);
+    const __m256d b_virtual = _mm256_sub_pd(diff, a);
+
+    out->lo = _mm256_sub_pd(_mm256_sub_pd(a, _mm256_sub_pd(diff, b_virtual)),
+                            _mm256_add_pd(b, b_virtual));
+    out->hi = diff;
+}
+
+FRACTAL_AVX2_FMA_TARGET
+static inline void
+fractal_dd_quick_two_sum_avx2(struct fractal_dd_m256 *out,
+                              __m256d a, __m256d b)
+{
+    const __m256d sum = _mm256_add_pd(a, b);
+
+    out->lo = _mm256_sub_pd(b, _mm256_sub_pd(sum, a));
+    out->hi = sum;
+}
+
+/*  The product and its error, exact with FMA.                                */
+FRACTAL_AVX2_FMA_TARGET
+static inline void
+fractal_dd_two_prod_avx2(struct fractal_dd_m256 *out, __m256d a, __m256d b)
+{
+    const __m256d product = _mm256_mul_pd(a, b);
+
+    out->lo = _mm256_fmsub_pd(a, b, product);
+    out->hi = product;
+}
+
+/*  One step of z^2 + c, the same operations in the same order as             *
+ *  fractal_dd_mandelbrot_iter.                                               */
+FRACTAL_AVX2_FMA_TARGET
+static inline void
+fractal_dd_mandelbrot_step_avx2(struct fractal_dd_m256 *next_re,
+                                struct fractal_dd_m256 *next_im,
+                                const struct fractal_dd_m256 *z_re,
+                                const struct fractal_dd_m256 *z_im,
+                                const struct fractal_dd_m256 *c_re,
+                                const struct fractal_dd_m256 *c_im)
+{
+    const __m256d two = _mm256_set1_pd(2.0);
+    struct fractal_dd_m256 x_sq, y_sq, xy, sum;
+    __m256d lo;
+
+    fractal_dd_two_prod_avx2(&x_sq, z_re->hi, z_re->hi);
+    fractal_dd_two_prod_avx2(&y_sq, z_im->hi, z_im->hi);
+    fractal_dd_two_prod_avx2(&xy, z_re->hi, z_im->hi);
+
+    x_sq.lo = _mm256_add_pd(x_sq.lo, _mm256_mul_pd(
+        _mm256_mul_pd(two, z_re->hi), z_re->lo
+    ));
+    y_sq.lo = _mm256_add_pd(y_sq.lo, _mm256_mul_pd(
+        _mm256_mul_pd(two, z_im->hi), z_im->lo
+    ));
+    xy.lo = _mm256_add_pd(xy.lo, _mm256_add_pd(
+        _mm256_mul_pd(z_re->hi, z_im->lo), _mm256_mul_pd(z_re->lo, z_im->hi)
+    ));
+
+    fractal_dd_two_diff_avx2(&sum, x_sq.hi, y_sq.hi);
+    lo = _mm256_add_pd(sum.lo, _mm256_sub_pd(x_sq.lo, y_sq.lo));
+    fractal_dd_two_sum_avx2(&sum, sum.hi, c_re->hi);
+    lo = _mm256_add_pd(_mm256_add_pd(lo, sum.lo), c_re->lo);
+    fractal_dd_quick_two_sum_avx2(next_re, sum.hi, lo);
+
+    fractal_dd_two_sum_avx2(&sum, _mm256_mul_pd(two, xy.hi), c_im->hi);
+    lo = _mm256_add_pd(_mm256_add_pd(sum.lo, _mm256_mul_pd(two, xy.lo)),
+                       c_im->lo);
+    fractal_dd_quick_two_sum_avx2(next_im, sum.hi, lo);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_mandelbrot_avx2                                            *
+ *  Purpose:                                                                  *
+ *      Iterates z^2 + c in double-double precision for 8 points, as two      *
+ *      interleaved vectors of 4 points each.                                 *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      c (const struct fractal_dd_batch *):                                  *
+ *          The points.                                                       *
+ *      first (unsigned int):                                                 *
+ *          The index of the first of the 8 points in the batch.              *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Notes:                                                                    *
+ *      The CPU must support FMA as well as AVX2.                             *
+ ******************************************************************************/
+FRACTAL_AVX2_FMA_TARGET
+static inline void
+fractal_dd_mandelbrot_avx2(const struct fractal *f,
+                           const struct fractal_dd_batch *c,
+                           unsigned int first, struct fractal_escape *out)
+{
+    double count_out[8], z_real_out[8], z_imag_out[8];
+    unsigned int iters, n, k;
+
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    const __m256d radius = _mm256_set1_pd(f->escape_radius);
+    const __m256d radius_squared
+        = _mm256_set1_pd(f->escape_radius * f->escape_radius);
+
+    /*  Two independent vectors, see fractal_mandelbrot_avx2.                 */
+    struct fractal_dd_m256 c_re[2], c_im[2], z_re[2], z_im[2];
+    __m256d active[2], count[2];
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        const unsigned int index = first + 4U*k;
+
+        c_re[k].hi = _mm256_loadu_pd(c->real_hi + index);
+        c_re[k].lo = _mm256_loadu_pd(c->real_lo + index);
+        c_im[k].hi = _mm256_loadu_pd(c->imag_hi + index);
+        c_im[k].lo = _mm256_loadu_pd(c->imag_lo + index);
+
+        if (f->start_at_c)
+        {
+            z_re[k] = c_re[k];
+            z_im[k] = c_im[k];
+        }
+        else
+        {
+            z_re[k].hi = z_re[k].lo = zero;
+            z_im[k].hi = z_im[k].lo = zero;
+        }
+
+        active[k] = _mm256_cmp_pd(zero, zero, _CMP_EQ_OQ);
+        count[k] = zero;
+    }
+
+    for (iters = 0U; iters < f->max_iters; ++iters)
+    {
+        int remaining = 0;
+
+        for (k = 0U; k < 2U; ++k)
+        {
+            struct fractal_dd_m256 next_re, next_im;
+            __m256d escaped;
+
+            fractal_dd_mandelbrot_step_avx2(&next_re, &next_im, &z_re[k],
+                                            &z_im[k], &c_re[k], &c_im[k]);
+
+            /*  Lanes that already escaped keep their final value.            */
+            z_re[k].hi = _mm256_blendv_pd(z_re[k].hi, next_re.hi, active[k]);
+            z_re[k].lo = _mm256_blendv_pd(z_re[k].lo, next_re.lo, active[k]);
+            z_im[k].hi = _mm256_blendv_pd(z_im[k].hi, next_im.hi, active[k]);
+            z_im[k].lo = _mm256_blendv_pd(z_im[k].lo, next_im.lo, active[k]);
+
+            if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+            {
+                const __m256d abs_sq = _mm256_add_pd(
+                    _mm256_mul_pd(z_re[k].hi, z_re[k].hi),
+                    _mm256_mul_pd(z_im[k].hi, z_im[k].hi)
+                );
+
+                escaped = _mm256_cmp_pd(abs_sq, radius_squared, _CMP_GT_OQ);
+            }
+            else
+            {
+                const __m256d abs_x = _mm256_andnot_pd(sign_bit, z_re[k].hi);
+                escaped = _mm256_cmp_pd(abs_x, radius, _CMP_GE_OQ);
+            }
+
+            active[k] = _mm256_andnot_pd(escaped, active[k]);
+
+            /*  Lanes still active have survived another iteration.           */
+            count[k] = _mm256_add_pd(count[k], _mm256_and_pd(active[k], one));
+            remaining |= _mm256_movemask_pd(active[k]);
+        }
+
+        /*  Every lane has escaped, nothing left to do.                       */
+        if (!remaining)
+            break;
+    }
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        _mm256_storeu_pd(count_out + 4U*k, count[k]);
+        _mm256_storeu_pd(z_real_out + 4U*k, z_re[k].hi);
+        _mm256_storeu_pd(z_imag_out + 4U*k, z_im[k].hi);
+    }
+
+    for (n = 0U; n < 8U; ++n)
+    {
+        out[n].iters = (unsigned int)count_out[n];
+        out[n].z.real = z_real_out[n];
+        out[n].z.imag = z_imag_out[n];
+    }
+}
+
+/*  A vector of double-double numbers, 8 lanes with AVX-512.                  */
+struct fractal_dd_m512 {
+    __m512d hi, lo;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_two_sum_avx512                                             *
+ *  Purpose:                                                                  *
+ *      The same as fractal_dd_two_sum, lane by lane, and likewise for the    *
+ *      other functions ending in _avx512 below.                              *
+ *  Arguments:                                                                *
+ *      out (struct fractal_dd_m512 *):                                       *
+ *          The sums and their errors.                                        *
+ *      a (__m512d):                                                          *
+ *          The first terms.                                                  *
+ *      b (__m512d):                                                          *
+ *          The second terms.                                                 *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_dd_two_sum_avx512(struct fractal_dd_m512 *out, __m512d a, __m512d b)
+{
+    const __m512d sum = _mm512_add_pd(a, b);
+    const __m512d b_virtual = _mm512_sub_pd(sum, a);
+
+    out->lo = _mm512_add_pd(_mm512_sub_pd(a, _mm512_sub_pd(sum, b_virtual)),
+                            _mm512_sub_pd(b, b_virtual));
+    out->hi = sum;
+}
+
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_dd_two_diff_avx512(struct fractal_dd_m512 *out, __m512d a, __m512d b)
+{
+    const __m512d diff = _mm512_sub_pd(a, b);
+    const __m512d b_virtual = _mm512_sub_pd(diff, a);
+
+    out->lo = _mm512_sub_pd(_mm512_sub_pd(a, _mm512_sub_pd(diff, b_virtual)),
+                            _mm512_add_pd(b, b_virtual));
+    out->hi = diff;
+}
+
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_dd_quick_two_sum_avx512(struct fractal_dd_m512 *out,
+                                __m512d a, __m512d b)
+{
+    const __m512d sum = _mm512_add_pd(a, b);
+
+    out->lo = _mm512_sub_pd(b, _mm512_sub_pd(sum, a));
+    out->hi = sum;
+}
+
+/*  The product and its error, exact with FMA.                                */
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_dd_two_prod_avx512(struct fractal_dd_m512 *out, __m512d a, __m512d b)
+{
+    const __m512d product = _mm512_mul_pd(a, b);
+
+    out->lo = _mm512_fmsub_pd(a, b, product);
+    out->hi = product;
+}
+
+/*  One step of z^2 + c, the same operations in the same order as             *
+ *  fractal_dd_mandelbrot_iter.                                               */
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_dd_mandelbrot_step_avx512(struct fractal_dd_m512 *next_re,
+                                  struct fractal_dd_m512 *next_im,
+                                  const struct fractal_dd_m512 *z_re,
+                                  const struct fractal_dd_m512 *z_im,
+                                  const struct fractal_dd_m512 *c_re,
+                                  const struct fractal_dd_m512 *c_im)
+{
+    const __m512d two = _mm512_set1_pd(2.0);
+    struct fractal_dd_m512 x_sq, y_sq, xy, sum;
+    __m512d lo;
+
+    fractal_dd_two_prod_avx512(&x_sq, z_re->hi, z_re->hi);
+    fractal_dd_two_prod_avx512(&y_sq, z_im->hi, z_im->hi);
+    fractal_dd_two_prod_avx512(&xy, z_re->hi, z_im->hi);
+
+    x_sq.lo = _mm512_add_pd(x_sq.lo, _mm512_mul_pd(
+        _mm512_mul_pd(two, z_re->hi), z_re->lo
+    ));
+    y_sq.lo = _mm512_add_pd(y_sq.lo, _mm512_mul_pd(
+        _mm512_mul_pd(two, z_im->hi), z_im->lo
+    ));
+    xy.lo = _mm512_add_pd(xy.lo, _mm512_add_pd(
+        _mm512_mul_pd(z_re->hi, z_im->lo), _mm512_mul_pd(z_re->lo, z_im->hi)
+    ));
+
+    fractal_dd_two_diff_avx512(&sum, x_sq.hi, y_sq.hi);
+    lo = _mm512_add_pd(sum.lo, _mm512_sub_pd(x_sq.lo, y_sq.lo));
+    fractal_dd_two_sum_avx512(&sum, sum.hi, c_re->hi);
+    lo = _mm512_add_pd(_mm512_add_pd(lo, sum.lo), c_re->lo);
+    fractal_dd_quick_two_sum_avx512(next_re, sum.hi, lo);
+
+    fractal_dd_two_sum_avx512(&sum, _mm512_mul_pd(two, xy.hi), c_im->hi);
+    lo = _mm512_add_pd(_mm512_add_pd(sum.lo, _mm512_mul_pd(two, xy.lo)),
+                       c_im->lo);
+    fractal_dd_quick_two_sum_avx512(next_im, sum.hi, lo);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_mandelbrot_avx512                                          *
+ *  Purpose:                                                                  *
+ *      Iterates z^2 + c in double-double precision for 16 points, as two     *
+ *      interleaved vectors of 8 points each.                                 *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      c (const struct fractal_dd_batch *):                                  *
+ *          The points.                                                       *
+ *      first (unsigned int):                                                 *
+ *          The index of the first of the 16 points in the batch.             *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_dd_mandelbrot_avx512(const struct fractal *f,
+                             const struct fractal_dd_batch *c,
+                             unsigned int first, struct fractal_escape *out)
+{
+    double count_out[16], z_real_out[16], z_imag_out[16];
+    unsigned int iters, n, k;
+
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d radius = _mm512_set1_pd(f->escape_radius);
+    const __m512d radius_squared
+        = _mm512_set1_pd(f->escape_radius * f->escape_radius);
+
+    /*  Two independent vectors, see fractal_mandelbrot_avx2.                 */
+    struct fractal_dd_m512 c_re[2], c_im[2], z_re[2], z_im[2];
+    __m512d count[2];
+
+    /*  One bit per lane, set for lanes that have not escaped yet.            */
+    __mmask8 active[2];
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        const unsigned int index = first + 8U*k;
+
+        c_re[k].hi = _mm512_loadu_pd(c->real_hi + index);
+        c_re[k].lo = _mm512_loadu_pd(c->real_lo + index);
+        c_im[k].hi = _mm512_loadu_pd(c->imag_hi + index);
+        c_im[k].lo = _mm512_loadu_pd(c->imag_lo + index);
+
+        if (f->start_at_c)
+        {
+            z_re[k] = c_re[k];
+            z_im[k] = c_im[k];
+        }
+        else
+        {
+            z_re[k].hi = z_re[k].lo = zero;
+            z_im[k].hi = z_im[k].lo = zero;
+        }
+
+        active[k] = 0xFFU;
+        count[k] = zero;
+    }
+
+    for (iters = 0U; iters < f->max_iters; ++iters)
+    {
+        for (k = 0U; k < 2U; ++k)
+        {
+            struct fractal_dd_m512 next_re, next_im;
+            __mmask8 escaped;
+
+            fractal_dd_mandelbrot_step_avx512(&next_re, &next_im, &z_re[k],
+                                              &z_im[k], &c_re[k], &c_im[k]);
+
+            /*  Lanes that already escaped keep their final value.            */
+            z_re[k].hi = _mm512_mask_blend_pd(active[k], z_re[k].hi,
+                                              next_re.hi);
+            z_re[k].lo = _mm512_mask_blend_pd(active[k], z_re[k].lo,
+                                              next_re.lo);
+            z_im[k].hi = _mm512_mask_blend_pd(active[k], z_im[k].hi,
+                                              next_im.hi);
+            z_im[k].lo = _mm512_mask_blend_pd(active[k], z_im[k].lo,
+                                              next_im.lo);
+
+            if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+            {
+                const __m512d abs_sq = _mm512_add_pd(
+                    _mm512_mul_pd(z_re[k].hi, z_re[k].hi),
+                    _mm512_mul_pd(z_im[k].hi, z_im[k].hi)
+                );
+
+                escaped = _mm512_cmp_pd_mask(abs_sq, radius_squared,
+                                             _CMP_GT_OQ);
+            }
+            else
+                escaped = _mm512_cmp_pd_mask(_mm512_abs_pd(z_re[k].hi),
+                                             radius, _CMP_GE_OQ);
+
+            active[k] = (__mmask8)(active[k] & ~escaped);
+
+            /*  Lanes still active have survived another iteration.           */
+            count[k] = _mm512_mask_add_pd(count[k], active[k], count[k], one);
+        }
+
+        /*  Every lane has escaped, nothing left to do.                       */
+        if ((active[0] | active[1]) == 0U)
+            break;
+    }
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        _mm512_storeu_pd(count_out + 8U*k, count[k]);
+        _mm512_storeu_pd(z_real_out + 8U*k, z_re[k].hi);
+        _mm512_storeu_pd(z_imag_out + 8U*k, z_im[k].hi);
+    }
+
+    for (n = 0U; n < 16U; ++n)
+    {
+        out[n].iters = (unsigned int)count_out[n];
+        out[n].z.real = z_real_out[n];
+        out[n].z.imag = z_imag_out[n];
+    }
+}
+
+#endif
+/*  End of #ifdef FRACTAL_HAS_X86_SIMD.                                       */
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_batch_set                                                  *
+ *  Purpose:                                                                  *
+ *      Stores a point, given as an offset from a center, in a batch.         *
+ *  Arguments:                                                                *
+ *      c (struct fractal_dd_batch *):                                        *
+ *          The batch.                                                        *
+ *      n (unsigned int):                                                     *
+ *          The index of the point in the batch.                              *
+ *      center (const struct fractal_dd_complex *):                           *
+ *          The center.                                                       *
+ *      dc_real (double):                                                     *
+ *          The real part of the offset.                                      *
+ *      dc_imag (double):                                                     *
+ *          The imaginary part of the offset.                                 *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_dd_batch_set(struct fractal_dd_batch *c, unsigned int n,
+                     const struct fractal_dd_complex *center,
+                     double dc_real, double dc_imag)
+{
+    struct fractal_dd part;
+
+    fractal_dd_add_double(&part, &center->real, dc_real);
+    c->real_hi[n] = part.hi;
+    c->real_lo[n] = part.lo;
+
+    fractal_dd_add_double(&part, &center->imag, dc_imag);
+    c->imag_hi[n] = part.hi;
+    c->imag_lo[n] = part.lo;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_points                                                     *
+ *  Purpose:                                                                  *
+ *      Iterates a batch of points in double-double precision, using the      *
+ *      fastest available kernel. Leftover points are done one at a time.     *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      c (struct fractal_dd_batch *):                                        *
+ *          The points. Entries past number_of_points may be overwritten.     *
+ *      number_of_points (unsigned int):                                      *
+ *          The number of points, at most FRACTAL_ROW_CHUNK.                  *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_dd_points(const struct fractal *f, struct fractal_dd_batch *c,
+                  unsigned int number_of_points, struct fractal_escape *out)
+{
+    unsigned int n = 0U;
+    struct fractal_dd_complex point;
+
+#ifdef FRACTAL_HAS_X86_SIMD
+    const enum fractal_simd_level level = fractal_simd_level();
+    unsigned int width = 0U;
+
+    if (level == FRACTAL_SIMD_AVX512)
+        width = 16U;
+
+    /*  The exact products need FMA, which every AVX2 CPU but a few early     *
+     *  VIA ones has.                                                         */
+    else if (level == FRACTAL_SIMD_AVX2 && __builtin_cpu_supports("fma"))
+        width = 8U;
+
+    if (width)
+    {
+        /*  The padded tail of fractal_simd_points. FRACTAL_ROW_CHUNK is a    *
+         *  multiple of 16, so the padding stays inside the batch.            */
+        const unsigned int full = number_of_points - number_of_points % width;
+        const unsigned int number_left = number_of_points - full;
+        const unsigned int end
+            = (number_left >= FRACTAL_SIMD_MIN_TAIL ? full + width : full);
+        struct fractal_escape tail[16];
+        unsigned int k;
+
+        for (k = number_of_points; k < end; ++k)
+        {
+            c->real_hi[k] = c->real_hi[number_of_points - 1U];
+            c->real_lo[k] = c->real_lo[number_of_points - 1U];
+            c->imag_hi[k] = c->imag_hi[number_of_points - 1U];
+            c->imag_lo[k] = c->imag_lo[number_of_points - 1U];
+        }
+
+        for (; n < end; n += width)
+        {
+            struct fractal_escape * const dest = (n < full ? out + n : tail);
+
+            if (width == 16U)
+                fractal_dd_mandelbrot_avx512(f, c, n, dest);
+            else
+                fractal_dd_mandelbrot_avx2(f, c, n, dest);
+        }
+
+        if (end > full)
+        {
+            for (k = 0U; k < number_left; ++k)
+                out[full + k] = tail[k];
+
+            return;
+        }
+    }
+#endif
+
+    /*  Scalar code for whatever is left over.                                */
+    for (; n < number_of_points; ++n)
+    {
+        point.real.hi = c->real_hi[n];
+        point.real.lo = c->real_lo[n];
+        point.imag.hi = c->imag_hi[n];
+        point.imag.lo = c->imag_lo[n];
+        fractal_dd_escape(f, &point, out + n);
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_dd_escape_row                                                 *
+ *  Purpose:                                                                  *
+ *      Iterates a run of consecutive pixels in one row of a zoom drawn in    *
+ *      double-double precision.                                              *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      center (const struct fractal_dd_complex *):                           *
+ *          The center of the image.                                          *
+ *      vp (const struct fractal_viewport *):                                 *
+ *          The viewport, giving each pixel's offset from the center. That    *
+ *          is, made with fractal_viewport_from_center with a center of 0.    *
+ *      x_begin (unsigned int):                                               *
+ *          The first column in the run.                                      *
+ *      y (unsigned int):                                                     *
+ *          The row containing the run.                                       *
+ *      number_of_points (unsigned int):                                      *
+ *          The length of the run, at most FRACTAL_ROW_CHUNK.                 *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each pixel.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_dd_escape_row(const struct fractal *f,
+                      const struct fractal_dd_complex *center,
+                      const struct fractal_viewport *vp,
+                      unsigned int x_begin, unsigned int y,
+                      unsigned int number_of_points,
+                      struct fractal_escape *out)
+{
+    struct fractal_dd_batch c;
+    const double dc_imag = vp->y_start + (double)y * vp->y_step;
+    unsigned int n;
+
+    for (n = 0U; n < number_of_points; ++n)
+    {
+        const double dc_real = vp->x_start + (double)(x_begin + n)*vp->x_step;
+        fractal_dd_batch_set(&c, n, center, dc_real, dc_imag);
+    }
+
+    fractal_dd_points(f, &c, number_of_points, out);
+}
+
+#endif
+/*  End of include guard.                                                     */
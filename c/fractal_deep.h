@@ -0,0 +1,1030 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Deep zooms of the Mandelbrot set using perturbation theory. Once the  *
+ *      pixel spacing falls to around 1e-14, doubles can no longer tell       *
+ *      neighboring pixels apart and the image breaks up into blocks. Here a  *
+ *      single reference orbit Z_n, for the center of the image, is computed  *
+ *      in fixed point with as many bits as the zoom requires. Every pixel is *
+ *      then iterated as a small offset dz_n = z_n - Z_n, which obeys         *
+ *                                                                            *
+ *          dz_{n+1} = (2 Z_n + dz_n) dz_n + dc,                              *
+ *                                                                            *
+ *      where dc = c - C is the offset of the pixel from the center. The      *
+ *      offsets are tiny but are stored relative to their own size, so plain  *
+ *      doubles suffice and each iteration costs about as much as z^2 + c.    *
+ *  Notes:                                                                    *
+ *      This file is included by fractal.h, do not include it directly.       *
+ *                                                                            *
+ *      The offsets are doubles, so zooms are limited to a pixel spacing of   *
+ *      about 1e-300. Only the Mandelbrot set, z^2 + c, is supported.         *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_DEEP_H
+#define FRACTAL_DEEP_H
+
+/*  uint32_t and uint64_t found here.                                         */
+#include <stdint.h>
+
+/*  malloc, realloc, and free found here.                                     */
+#include <stdlib.h>
+
+/*  Maximum number of 32-bit limbs in a fixed point number. 40 limbs give     *
+ *  1248 bits after the point, enough for the smallest pixel spacing a double *
+ *  offset can represent.                                                     */
+#define FRACTAL_FIXED_MAX_LIMBS (40U)
+
+/*  Extra bits carried beyond the pixel spacing, so the rounding errors of    *
+ *  the reference orbit stay far below the size of a pixel.                   */
+#define FRACTAL_FIXED_GUARD_BITS (64U)
+
+/*  Pixel spacing, relative to the size of the center, below which plain      *
+ *  doubles lose too many bits per pixel and perturbation should be used.     */
+#define FRACTAL_DEEP_THRESHOLD (1.0E-12)
+
+/*  The number of terms in the series approximation of the offsets.           */
+#define FRACTAL_SERIES_TERMS (8U)
+
+/*  The series is used for as long as its error bound stays below this        *
+ *  fraction of the distance between the offsets of neighboring pixels.       */
+#define FRACTAL_SERIES_TOLERANCE (1.0E-3)
+
+/******************************************************************************
+ *  Struct:                                                                   *
+ *      fractal_fixed                                                         *
+ *  Purpose:                                                                  *
+ *      A signed fixed point number. The limbs hold a two's complement        *
+ *      integer, least significant limb first. The last limb in use is the    *
+ *      integer part and the others are the fraction, so the value is         *
+ *      limb * 2^(32 (k + 1 - number_of_limbs)) summed over every limb k.     *
+ ******************************************************************************/
+struct fractal_fixed {
+
+    /*  The number of limbs in use, between 2 and FRACTAL_FIXED_MAX_LIMBS.    */
+    unsigned int number_of_limbs;
+    uint32_t limb[FRACTAL_FIXED_MAX_LIMBS];
+};
+
+/******************************************************************************
+ *  Struct:                                                                   *
+ *      fractal_series                                                        *
+ *  Purpose:                                                                  *
+ *      A truncated power series for the offsets of every pixel in an image,  *
+ *                                                                            *
+ *          dz_n = a_1 dc + a_2 dc^2 + ... + a_K dc^K,                        *
+ *                                                                            *
+ *      valid up to the iteration n = skip. Pixels start from there instead   *
+ *      of from zero. The coefficients are stored as b_k = a_k r^k, where r   *
+ *      is the largest |dc| in the image, so that they neither overflow nor   *
+ *      underflow however deep the zoom is.                                   *
+ ******************************************************************************/
+struct fractal_series {
+
+    /*  Index into the reference orbit to start at. Zero if there is no       *
+     *  series, or it is not worth using.                                     */
+    unsigned int skip;
+
+    /*  The largest |dc| over the image, the radius of the series.            */
+    double radius;
+
+    /*  The scaled coefficients b_1, ..., b_K, stored from index 0.           */
+    double b_real[FRACTAL_SERIES_TERMS], b_imag[FRACTAL_SERIES_TERMS];
+
+    /*  Bound on |dz_skip - series| for every |dc| <= radius, ignoring the    *
+     *  rounding errors of the computation itself.                            */
+    double error;
+};
+
+/******************************************************************************
+ *  Struct:                                                                   *
+ *      fractal_reference                                                     *
+ *  Purpose:                                                                  *
+ *      The orbit Z_0 = 0, Z_1 = C, Z_2 = C^2 + C, ... of the center C of a   *
+ *      deep zoom, computed in fixed point and rounded to double. A renderer  *
+ *      with a reference treats its viewport as offsets from C.               *
+ ******************************************************************************/
+struct fractal_reference {
+
+    /*  The real and imaginary parts of the orbit.                            */
+    double *z_real, *z_imag;
+
+    /*  The number of points in the orbit. Stops early if the center escapes. */
+    unsigned int length;
+
+    /*  The number of points the arrays have room for.                        */
+    unsigned int capacity;
+
+    /*  The series approximation for the image currently being drawn.         */
+    struct fractal_series series;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_fixed_limbs                                                   *
+ *  Purpose:                                                                  *
+ *      Computes how many limbs are needed to resolve a given pixel spacing.  *
+ *  Arguments:                                                                *
+ *      pixel_spacing (double):                                               *
+ *          The distance between neighboring pixels.                          *
+ *  Output:                                                                   *
+ *      number_of_limbs (unsigned int):                                       *
+ *          The size to use for fractal_fixed numbers.                        *
+ ******************************************************************************/
+static inline unsigned int
+fractal_fixed_limbs(double pixel_spacing)
+{
+    double bits = FRACTAL_FIXED_GUARD_BITS;
+    unsigned int number_of_limbs;
+
+    if (pixel_spacing > 0.0 && pixel_spacing < 1.0)
+        bits -= log2(pixel_spacing);
+
+    /*  One limb for the integer part, the rest for the fraction.             */
+    number_of_limbs = 1U + (unsigned int)ceil(bits / 32.0);
+
+    if (number_of_limbs > FRACTAL_FIXED_MAX_LIMBS)
+        number_of_limbs = FRACTAL_FIXED_MAX_LIMBS;
+
+    return number_of_limbs;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_fixed_negate                                                  *
+ *  Purpose:                                                                  *
+ *      Negates a fixed point number in place.                                *
+ *  Arguments:                                                                *
+ *      x (struct fractal_fixed *):                                           *
+ *          The number being negated.                                         *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      Two's complement, invert every bit and add one.                       *
+ ******************************************************************************/
+static inline void
+fractal_fixed_negate(struct fractal_fixed *x)
+{
+    unsigned int n;
+    uint64_t carry = 1U;
+
+    for (n = 0U; n < x->number_of_limbs; ++n)
+    {
+        carry += (uint32_t)~x->limb[n];
+        x->limb[n] = (uint32_t)carry;
+        carry >>= 32U;
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_fixed_is_negative                                             *
+ *  Purpose:                                                                  *
+ *      Determines the sign of a fixed point number.                          *
+ *  Arguments:                                                                *
+ *      x (const struct fractal_fixed *):                                     *
+ *          The number being tested.                                          *
+ *  Output:                                                                   *
+ *      is_negative (int):                                                    *
+ *          Boolean for whether x < 0.                                        *
+ ******************************************************************************/
+static inline int
+fractal_fixed_is_negative(const struct fractal_fixed *x)
+{
+    return (x->limb[x->number_of_limbs - 1U] >> 31U) != 0U;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_fixed_add                                                     *
+ *  Purpose:                                                                  *
+ *      Adds two fixed point numbers of the same size.                        *
+ *  Arguments:                                                                *
+ *      out (struct fractal_fixed *):                                         *
+ *          The sum a + b. May be the same as a or b.                         *
+ *      a (const struct fractal_fixed *):                                     *
+ *          The first number.                                                 *
+ *      b (const struct fractal_fixed *):                                     *
+ *          The second number.                                                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_fixed_add(struct fractal_fixed *out,
+                  const struct fractal_fixed *a,
+                  const struct fractal_fixed *b)
+{
+    unsigned int n;
+    uint64_t carry = 0U;
+
+    for (n = 0U; n < a->number_of_limbs; ++n)
+    {
+        carry += (uint64_t)a->limb[n] + (uint64_t)b->limb[n];
+        out->limb[n] = (uint32_t)carry;
+        carry >>= 32U;
+    }
+
+    out->number_of_limbs = a->number_of_limbs;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_fixed_sub                                                     *
+ *  Purpose:                                                                  *
+ *      Subtracts two fixed point numbers of the same size.                   *
+ *  Arguments:                                                                *
+ *      out (struct fractal_fixed *):                                         *
+ *          The difference a - b. May be the same as a or b.                  *
+ *      a (const struct fractal_fixed *):                                     *
+ *          The first number.                                                 *
+ *      b (const struct fractal_fixed *):                                     *
+ *          The second number.                                                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      a - b = a + ~b + 1 in two's complement.                               *
+ ******************************************************************************/
+static inline void
+fractal_fixed_sub(struct fractal_fixed *out,
+                  const struct fractal_fixed *a,
+                  const struct fractal_fixed *b)
+{
+    unsigned int n;
+    uint64_t carry = 1U;
+
+    for (n = 0U; n < a->number_of_limbs; ++n)
+    {
+        carry += (uint64_t)a->limb[n] + (uint64_t)(uint32_t)~b->limb[n];
+        out->limb[n] = (uint32_t)carry;
+        carry >>= 32U;
+    }
+
+    out->number_of_limbs = a->number_of_limbs;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_fixed_mul                                                     *
+ *  Purpose:                                                                  *
+ *      Multiplies two fixed point numbers of the same size.                  *
+ *  Arguments:                                                                *
+ *      out (struct fractal_fixed *):                                         *
+ *          The product a * b. May be the same as a or b.                     *
+ *      a (const struct fractal_fixed *):                                     *
+ *          The first number.                                                 *
+ *      b (const struct fractal_fixed *):                                     *
+ *          The second number.                                                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      Schoolbook multiplication of the magnitudes, keeping the limbs that   *
+ *      line up with the fixed point, then restoring the sign. The result is  *
+ *      truncated, and the integer part must not overflow 31 bits.            *
+ ******************************************************************************/
+static inline void
+fractal_fixed_mul(struct fractal_fixed *out,
+                  const struct fractal_fixed *a,
+                  const struct fractal_fixed *b)
+{
+    uint32_t product[2U * FRACTAL_FIXED_MAX_LIMBS];
+    struct fractal_fixed x = *a, y = *b;
+    const unsigned int size = a->number_of_limbs;
+    const int negative
+        = fractal_fixed_is_negative(&x) != fractal_fixed_is_negative(&y);
+    unsigned int i, j;
+
+    if (fractal_fixed_is_negative(&x))
+        fractal_fixed_negate(&x);
+
+    if (fractal_fixed_is_negative(&y))
+        fractal_fixed_negate(&y);
+
+    for (i = 0U; i < 2U * size; ++i)
+        product[i] = 0U;
+
+    for (i = 0U; i < size; ++i)
+    {
+        uint64_t carry = 0U;
+
+        for (j = 0U; j < size; ++j)
+        {
+            carry += (uint64_t)x.limb[i] * (uint64_t)y.limb[j];
+            carry += (uint64_t)product[i + j];
+            product[i + j] = (uint32_t)carry;
+            carry >>= 32U;
+        }
+
+        product[i + size] = (uint32_t)carry;
+    }
+
+    /*  Both inputs have size - 1 fractional limbs, the product has twice as  *
+     *  many. Drop the lowest size - 1 limbs to get back to the fixed point.  */
+    for (i = 0U; i < size; ++i)
+        out->limb[i] = product[i + size - 1U];
+
+    out->number_of_limbs = size;
+
+    if (negative)
+        fractal_fixed_negate(out);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_fixed_from_double                                             *
+ *  Purpose:                                                                  *
+ *      Converts a double to fixed point. The conversion is exact.            *
+ *  Arguments:                                                                *
+ *      x (struct fractal_fixed *):                                           *
+ *          The output.                                                       *
+ *      value (double):                                                       *
+ *          The number being converted, |value| < 2^31.                       *
+ *      number_of_limbs (unsigned int):                                       *
+ *          The size of the output.                                           *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_fixed_from_double(struct fractal_fixed *x, double value,
+                          unsigned int number_of_limbs)
+{
+    unsigned int n = number_of_limbs;
+    double remainder = fabs(value);
+
+    x->number_of_limbs = number_of_limbs;
+
+    /*  Peel off 32 bits at a time, starting with the integer part.           */
+    while (n > 0U)
+    {
+        const double digit = floor(remainder);
+
+        --n;
+        x->limb[n] = (uint32_t)digit;
+        remainder = (remainder - digit) * 4294967296.0;
+    }
+
+    if (value < 0.0)
+        fractal_fixed_negate(x);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_fixed_from_string                                             *
+ *  Purpose:                                                                  *
+ *      Converts a decimal string, like "-0.822467633298876", to fixed point. *
+ *      Centers of deep zooms need more digits than a double can hold, so     *
+ *      they are given as strings.                                            *
+ *  Arguments:                                                                *
+ *      x (struct fractal_fixed *):                                           *
+ *          The output.                                                       *
+ *      str (const char *):                                                   *
+ *          An optional sign, digits, and an optional decimal point followed  *
+ *          by more digits. No exponent.                                      *
+ *      number_of_limbs (unsigned int):                                       *
+ *          The size of the output.                                           *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 if the string is not understood.                 *
+ *  Method:                                                                   *
+ *      The fraction is built from its last digit to its first, adding each   *
+ *      digit to the integer limb and then dividing the number by 10.         *
+ ******************************************************************************/
+static inline int
+fractal_fixed_from_string(struct fractal_fixed *x, const char *str,
+                          unsigned int number_of_limbs)
+{
+    const char *fraction = NULL;
+    const char *end;
+    uint64_t integer_part = 0U;
+    unsigned int n;
+    int negative = 0;
+
+    x->number_of_limbs = number_of_limbs;
+
+    for (n = 0U; n < number_of_limbs; ++n)
+        x->limb[n] = 0U;
+
+    if (*str == '-' || *str == '+')
+    {
+        negative = (*str == '-');
+        ++str;
+    }
+
+    for (end = str; *end != '\0'; ++end)
+    {
+        if (*end == '.' && !fraction)
+            fraction = end + 1;
+
+        else if (*end < '0' || *end > '9')
+            return -1;
+
+        else if (!fraction)
+        {
+            integer_part = 10U * integer_part + (uint64_t)(*end - '0');
+
+            if (integer_part > 0x7FFFFFFFU)
+                return -1;
+        }
+    }
+
+    if (end == str)
+        return -1;
+
+    /*  Horner's method, backwards: 0.d1 d2 d3 = (d1 + (d2 + (d3)/10)/10)/10. */
+    if (fraction)
+    {
+        while (end > fraction)
+        {
+            uint64_t remainder = 0U;
+            --end;
+
+            x->limb[number_of_limbs - 1U] = (uint32_t)(*end - '0');
+
+            /*  Long division by 10, from the most significant limb down.     */
+            for (n = number_of_limbs; n > 0U; --n)
+            {
+                const uint64_t dividend = (remainder << 32U) | x->limb[n - 1U];
+                x->limb[n - 1U] = (uint32_t)(dividend / 10U);
+                remainder = dividend % 10U;
+            }
+        }
+    }
+
+    x->limb[number_of_limbs - 1U] = (uint32_t)integer_part;
+
+    if (negative)
+        fractal_fixed_negate(x);
+
+    return 0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_fixed_to_double                                               *
+ *  Purpose:                                                                  *
+ *      Rounds a fixed point number to the nearest double (truncated past     *
+ *      the first three limbs, which hold more bits than a double can).       *
+ *  Arguments:                                                                *
+ *      x (const struct fractal_fixed *):                                     *
+ *          The number being converted.                                       *
+ *  Output:                                                                   *
+ *      value (double):                                                       *
+ *          The number as a double.                                           *
+ ******************************************************************************/
+static inline double
+fractal_fixed_to_double(const struct fractal_fixed *x)
+{
+    struct fractal_fixed magnitude = *x;
+    const unsigned int top = x->number_of_limbs - 1U;
+    const int negative = fractal_fixed_is_negative(x);
+    double value = 0.0;
+    unsigned int n;
+
+    if (negative)
+        fractal_fixed_negate(&magnitude);
+
+    /*  Sum from the least significant limb up, so the rounding is correct.   */
+    for (n = (top >= 3U ? top - 3U : 0U); n <= top; ++n)
+        value += ldexp((double)magnitude.limb[n], 32*((int)n - (int)top));
+
+    return negative ? -value : value;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_reference_init                                                *
+ *  Purpose:                                                                  *
+ *      Sets up an empty reference orbit.                                     *
+ *  Arguments:                                                                *
+ *      ref (struct fractal_reference *):                                     *
+ *          The reference orbit.                                              *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_reference_init(struct fractal_reference *ref)
+{
+    ref->z_real = NULL;
+    ref->z_imag = NULL;
+    ref->length = 0U;
+    ref->capacity = 0U;
+    ref->series.skip = 0U;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_reference_free                                                *
+ *  Purpose:                                                                  *
+ *      Frees the memory used by a reference orbit.                           *
+ *  Arguments:                                                                *
+ *      ref (struct fractal_reference *):                                     *
+ *          The reference orbit.                                              *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_reference_free(struct fractal_reference *ref)
+{
+    free(ref->z_real);
+    free(ref->z_imag);
+    fractal_reference_init(ref);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_reference_compute                                             *
+ *  Purpose:                                                                  *
+ *      Computes the reference orbit for the center of a deep zoom.           *
+ *  Arguments:                                                                *
+ *      ref (struct fractal_reference *):                                     *
+ *          The reference orbit, set up with fractal_reference_init.          *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      center_real (const char *):                                           *
+ *          The real part of the center, as a decimal string.                 *
+ *      center_imag (const char *):                                           *
+ *          The imaginary part of the center, as a decimal string.            *
+ *      pixel_spacing (double):                                               *
+ *          The smallest distance between pixels the orbit will be used for.  *
+ *          This sets the precision, so one orbit can serve a whole zoom.     *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ *  Notes:                                                                    *
+ *      The orbit is computed up to max_iters + 1 (start_at_c skips Z_0), or  *
+ *      until the center escapes. Pixels needing more of the orbit than this  *
+ *      are rebased onto the start of it, see fractal_deep_escape.            *
+ ******************************************************************************/
+static inline int
+fractal_reference_compute(struct fractal_reference *ref,
+                          const struct fractal *f,
+                          const char *center_real,
+                          const char *center_imag,
+                          double pixel_spacing)
+{
+    struct fractal_fixed c_real, c_imag, z_real, z_imag;
+    struct fractal_fixed x_sq, y_sq, xy;
+    const unsigned int number_of_limbs = fractal_fixed_limbs(pixel_spacing);
+    const unsigned int capacity = f->max_iters + 2U;
+    unsigned int n;
+
+    if (f->type != FRACTAL_MANDELBROT)
+        return -1;
+
+    if (fractal_fixed_from_string(&c_real, center_real, number_of_limbs) ||
+        fractal_fixed_from_string(&c_imag, center_imag, number_of_limbs))
+        return -1;
+
+    if (ref->capacity < capacity)
+    {
+        double *z_new = realloc(ref->z_real, sizeof(*z_new) * capacity);
+
+        if (!z_new)
+            return -1;
+
+        ref->z_real = z_new;
+        z_new = realloc(ref->z_imag, sizeof(*z_new) * capacity);
+
+        if (!z_new)
+            return -1;
+
+        ref->z_imag = z_new;
+        ref->capacity = capacity;
+    }
+
+    fractal_fixed_from_double(&z_real, 0.0, number_of_limbs);
+    fractal_fixed_from_double(&z_imag, 0.0, number_of_limbs);
+    ref->z_real[0] = 0.0;
+    ref->z_imag[0] = 0.0;
+    ref->length = 1U;
+    ref->series.skip = 0U;
+
+    for (n = 1U; n < capacity; ++n)
+    {
+        double x, y;
+
+        /*  z = z^2 + c, computed as (x^2 - y^2 + c_real) + i(2xy + c_imag).  */
+        fractal_fixed_mul(&x_sq, &z_real, &z_real);
+        fractal_fixed_mul(&y_sq, &z_imag, &z_imag);
+        fractal_fixed_mul(&xy, &z_real, &z_imag);
+        fractal_fixed_sub(&z_real, &x_sq, &y_sq);
+        fractal_fixed_add(&z_real, &z_real, &c_real);
+        fractal_fixed_add(&z_imag, &xy, &xy);
+        fractal_fixed_add(&z_imag, &z_imag, &c_imag);
+
+        x = fractal_fixed_to_double(&z_real);
+        y = fractal_fixed_to_double(&z_imag);
+        ref->z_real[n] = x;
+        ref->z_imag[n] = y;
+        ref->length = n + 1U;
+
+        /*  Stop once the center escapes. The bound on y keeps the integer    *
+         *  part of the next square from overflowing for the strip test.      */
+        if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+        {
+            if (x*x + y*y > f->escape_radius * f->escape_radius)
+                break;
+        }
+        else if (fabs(x) >= f->escape_radius || fabs(y) >= 4096.0)
+            break;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_deep_is_needed                                                *
+ *  Purpose:                                                                  *
+ *      Determines if a zoom is too deep for plain doubles.                   *
+ *  Arguments:                                                                *
+ *      center_real (double):                                                 *
+ *          The real part of the center of the image.                         *
+ *      center_imag (double):                                                 *
+ *          The imaginary part of the center of the image.                    *
+ *      pixel_spacing (double):                                               *
+ *          The distance between neighboring pixels.                          *
+ *  Output:                                                                   *
+ *      is_needed (int):                                                      *
+ *          Boolean for whether a reference orbit should be used.             *
+ ******************************************************************************/
+static inline int
+fractal_deep_is_needed(double center_real, double center_imag,
+                       double pixel_spacing)
+{
+    double size = fabs(center_real);
+
+    if (fabs(center_imag) > size)
+        size = fabs(center_imag);
+
+    if (size < 1.0)
+        size = 1.0;
+
+    return fabs(pixel_spacing) < size * FRACTAL_DEEP_THRESHOLD;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_series_compute                                                *
+ *  Purpose:                                                                  *
+ *      Computes the series approximation for one image of a deep zoom, and   *
+ *      the number of iterations every pixel can skip.                        *
+ *  Arguments:                                                                *
+ *      ref (struct fractal_reference *):                                     *
+ *          The orbit of the center. The series is stored in ref->series.     *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be the one the orbit was computed for.          *
+ *      vp (const struct fractal_viewport *):                                 *
+ *          The viewport for the image, as offsets from the center.           *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      Substituting the series into dz_{n+1} = 2 Z_n dz_n + dz_n^2 + dc and  *
+ *      matching powers of dc gives, for the scaled coefficients b_k,         *
+ *                                                                            *
+ *          b_k <- 2 Z_n b_k + sum_{i + j = k} b_i b_j (+ r if k = 1).        *
+ *                                                                            *
+ *      With u = dc / r, |u| <= 1, so the series is bounded by the sum S of   *
+ *      the |b_k|. If E bounds the terms past b_K, then E is updated by       *
+ *                                                                            *
+ *          E <- 2 |Z_n| E + (2 S + E) E + sum_{i + j > K} |b_i| |b_j|.       *
+ *                                                                            *
+ *      This is done until E exceeds FRACTAL_SERIES_TOLERANCE times the       *
+ *      distance between neighboring pixels, |b_1| times the pixel spacing    *
+ *      divided by r. The series also stops once |Z_n| + S + E reaches the    *
+ *      escape radius, since a pixel might escape before that iteration.      *
+ ******************************************************************************/
+static inline void
+fractal_series_compute(struct fractal_reference *ref,
+                       const struct fractal *f,
+                       const struct fractal_viewport *vp)
+{
+    struct fractal_series * const s = &ref->series;
+    double b_real[FRACTAL_SERIES_TERMS], b_imag[FRACTAL_SERIES_TERMS];
+    double error = 0.0, spacing, radius = 0.0;
+    const unsigned int first = (f->start_at_c ? 1U : 0U);
+    const unsigned int last = FRACTAL_SERIES_TERMS - 1U;
+    unsigned int n, i, k, corner;
+
+    s->skip = 0U;
+    s->error = 0.0;
+
+    /*  The largest |dc| is found at one of the corners of the image.         */
+    for (corner = 0U; corner < 4U; ++corner)
+    {
+        const double x = vp->x_start
+            + (corner & 1U ? (double)(vp->width - 1U) * vp->x_step : 0.0);
+        const double y = vp->y_start
+            + (corner & 2U ? (double)(vp->height - 1U) * vp->y_step : 0.0);
+        const double r = sqrt(x*x + y*y);
+
+        if (r > radius)
+            radius = r;
+    }
+
+    spacing = fabs(vp->x_step);
+
+    if (fabs(vp->y_step) > spacing)
+        spacing = fabs(vp->y_step);
+
+    if (radius == 0.0 || ref->length < 2U)
+        return;
+
+    s->radius = radius;
+
+    /*  dz_0 = 0, so every coefficient starts at zero.                        */
+    for (k = 0U; k < FRACTAL_SERIES_TERMS; ++k)
+    {
+        b_real[k] = 0.0;
+        b_imag[k] = 0.0;
+    }
+
+    /*  Pixels may not skip past the end of the reference, nor past the       *
+     *  iteration limit.                                                      */
+    for (n = 0U; n + 1U < ref->length && n + 1U <= f->max_iters + first; ++n)
+    {
+        double next_real[FRACTAL_SERIES_TERMS];
+        double next_imag[FRACTAL_SERIES_TERMS];
+        double size[FRACTAL_SERIES_TERMS];
+        const double z_real = ref->z_real[n];
+        const double z_imag = ref->z_imag[n];
+        double sum = 0.0, tail = 0.0, x, y, gap;
+
+        for (k = 0U; k < FRACTAL_SERIES_TERMS; ++k)
+        {
+            size[k] = sqrt(b_real[k]*b_real[k] + b_imag[k]*b_imag[k]);
+            sum += size[k];
+        }
+
+        /*  Cross terms b_i b_j with i + j > K, dropped from the series. With *
+         *  b_{i+1} stored at index i, that is i + k >= K - 1 = last.         */
+        for (i = 0U; i < FRACTAL_SERIES_TERMS; ++i)
+            for (k = last - i; k < FRACTAL_SERIES_TERMS; ++k)
+                tail += size[i] * size[k];
+
+        error = 2.0 * sqrt(z_real*z_real + z_imag*z_imag) * error
+              + (2.0 * sum + error) * error + tail;
+
+        /*  The coefficient b_{k+1} is stored at index k.                     */
+        for (k = 0U; k < FRACTAL_SERIES_TERMS; ++k)
+        {
+            double re = 2.0 * (z_real*b_real[k] - z_imag*b_imag[k]);
+            double im = 2.0 * (z_real*b_imag[k] + z_imag*b_real[k]);
+
+            /*  Products b_{i+1} b_{k-i}, whose powers of u add up to k + 1.  */
+            for (i = 0U; i < k; ++i)
+            {
+                re += b_real[i]*b_real[k-1U-i] - b_imag[i]*b_imag[k-1U-i];
+                im += b_real[i]*b_imag[k-1U-i] + b_imag[i]*b_real[k-1U-i];
+            }
+
+            next_real[k] = re;
+            next_imag[k] = im;
+        }
+
+        next_real[0] += radius;
+
+        /*  Largest possible |dz| for any pixel at the next iteration.        */
+        sum = 0.0;
+
+        for (k = 0U; k < FRACTAL_SERIES_TERMS; ++k)
+            sum += sqrt(next_real[k]*next_real[k] + next_imag[k]*next_imag[k]);
+
+        sum += error;
+        x = ref->z_real[n + 1U];
+        y = ref->z_imag[n + 1U];
+        gap = sqrt(next_real[0]*next_real[0] + next_imag[0]*next_imag[0]);
+        gap *= spacing / radius;
+
+        /*  Stop if the series is no longer accurate enough...                */
+        if (error > FRACTAL_SERIES_TOLERANCE * gap)
+            break;
+
+        /*  ...or if some pixel might escape at the next iteration.           */
+        if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+        {
+            if (sqrt(x*x + y*y) + sum > f->escape_radius)
+                break;
+        }
+        else if (fabs(x) + sum >= f->escape_radius)
+            break;
+
+        for (k = 0U; k < FRACTAL_SERIES_TERMS; ++k)
+        {
+            b_real[k] = next_real[k];
+            b_imag[k] = next_imag[k];
+        }
+
+        s->skip = n + 1U;
+        s->error = error;
+    }
+
+    /*  Starting at the first iteration anyway, the series gains nothing.     */
+    if (s->skip <= first + 1U)
+    {
+        s->skip = 0U;
+        return;
+    }
+
+    for (k = 0U; k < FRACTAL_SERIES_TERMS; ++k)
+    {
+        s->b_real[k] = b_real[k];
+        s->b_imag[k] = b_imag[k];
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_deep_escape                                                   *
+ *  Purpose:                                                                  *
+ *      Iterates z^2 + c for a point given by its offset from the reference.  *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      ref (const struct fractal_reference *):                               *
+ *          The orbit of the center C.                                        *
+ *      dc (const struct fractal_complex *):                                  *
+ *          The offset of the point from the center, c - C.                   *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and the final value of z.                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      The orbit is z_n = Z_m + dz where m is an index into the reference.   *
+ *      Usually m = n, but whenever |z_n| < |dz| the offset has grown larger  *
+ *      than the point itself and would lose precision on the next step (a    *
+ *      glitch). The pixel is then rebased: dz is set to z_n and m to 0,      *
+ *      which is valid since Z_0 = 0. The same is done when m reaches the end *
+ *      of the reference, so a single orbit serves every pixel, even if the   *
+ *      center escapes long before the pixel does.                            *
+ *                                                                            *
+ *      If fractal_series_compute has been called for the image, the first    *
+ *      ref->series.skip iterations are replaced by evaluating the series.    *
+ ******************************************************************************/
+static inline void
+fractal_deep_escape(const struct fractal *f,
+                    const struct fractal_reference *ref,
+                    const struct fractal_complex *dc,
+                    struct fractal_escape *out)
+{
+    unsigned int iters;
+    const double radius = f->escape_radius;
+    const double radius_squared = radius*radius;
+    const double * const z_real = ref->z_real;
+    const double * const z_imag = ref->z_imag;
+    const unsigned int last = ref->length - 1U;
+    const unsigned int first = (f->start_at_c ? 1U : 0U);
+    const struct fractal_series * const s = &ref->series;
+    double dz_real, dz_imag, x, y;
+    unsigned int m;
+
+    /*  Start from the series when there is one. z_n is reference index       *
+     *  n + first, since z_0 = c is the same as z_1 with z_0 = 0.             */
+    if (s->skip)
+    {
+        const double u_real = dc->real / s->radius;
+        const double u_imag = dc->imag / s->radius;
+        unsigned int k = FRACTAL_SERIES_TERMS;
+
+        /*  Horner's method, dz = (((b_K u + b_{K-1}) u + ...) + b_1) u.      */
+        dz_real = 0.0;
+        dz_imag = 0.0;
+
+        while (k > 0U)
+        {
+            --k;
+            x = dz_real + s->b_real[k];
+            y = dz_imag + s->b_imag[k];
+            dz_real = x*u_real - y*u_imag;
+            dz_imag = x*u_imag + y*u_real;
+        }
+
+        m = s->skip;
+    }
+    else if (f->start_at_c)
+    {
+        m = 1U;
+        dz_real = dc->real;
+        dz_imag = dc->imag;
+    }
+    else
+    {
+        m = 0U;
+        dz_real = 0.0;
+        dz_imag = 0.0;
+    }
+
+    x = z_real[m] + dz_real;
+    y = z_imag[m] + dz_imag;
+
+    for (iters = m - first; iters < f->max_iters; ++iters)
+    {
+        double t_real, t_imag, dz_sq, z_sq;
+
+        /*  Out of reference orbit, start over from Z_0 = 0.                  */
+        if (m >= last)
+        {
+            dz_real += z_real[m];
+            dz_imag += z_imag[m];
+            m = 0U;
+        }
+
+        /*  dz = (2 Z + dz) dz + dc.                                          */
+        t_real = 2.0*z_real[m] + dz_real;
+        t_imag = 2.0*z_imag[m] + dz_imag;
+        x = t_real*dz_real - t_imag*dz_imag + dc->real;
+        y = t_real*dz_imag + t_imag*dz_real + dc->imag;
+        dz_real = x;
+        dz_imag = y;
+        ++m;
+
+        /*  The full value of z, used for the escape test.                    */
+        x = z_real[m] + dz_real;
+        y = z_imag[m] + dz_imag;
+        z_sq = x*x + y*y;
+
+        if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+        {
+            if (z_sq > radius_squared)
+                break;
+        }
+        else if (fabs(x) >= radius)
+            break;
+
+        /*  Glitch, the offset is no longer small compared to z. Rebase.      */
+        dz_sq = dz_real*dz_real + dz_imag*dz_imag;
+
+        if (z_sq < dz_sq)
+        {
+            dz_real = x;
+            dz_imag = y;
+            m = 0U;
+        }
+    }
+
+    out->iters = iters;
+    out->z.real = x;
+    out->z.imag = y;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_deep_escape_row                                               *
+ *  Purpose:                                                                  *
+ *      Iterates a run of consecutive pixels in one row of a deep zoom.       *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      ref (const struct fractal_reference *):                               *
+ *          The orbit of the center of the image.                             *
+ *      vp (const struct fractal_viewport *):                                 *
+ *          The viewport, giving each pixel's offset from the center. That    *
+ *          is, made with fractal_viewport_from_center with a center of 0.    *
+ *      x_begin (unsigned int):                                               *
+ *          The first column in the run.                                      *
+ *      y (unsigned int):                                                     *
+ *          The row containing the run.                                       *
+ *      number_of_points (unsigned int):                                      *
+ *          The length of the run.                                            *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each pixel.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_deep_escape_row(const struct fractal *f,
+                        const struct fractal_reference *ref,
+                        const struct fractal_viewport *vp,
+                        unsigned int x_begin, unsigned int y,
+                        unsigned int number_of_points,
+                        struct fractal_escape *out)
+{
+    unsigned int n;
+    struct fractal_complex dc;
+
+    dc.imag = vp->y_start + (double)y * vp->y_step;
+
+    for (n = 0U; n < number_of_points; ++n)
+    {
+        dc.real = vp->x_start + (double)(x_begin + n) * vp->x_step;
+        fractal_deep_escape(f, ref, &dc, out + n);
+    }
+}
+
+#endif
+/*  End of include guard.                                                     */
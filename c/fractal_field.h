@@ -0,0 +1,453 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Iteration count fields, the raw result of iterating every pixel       *
+ *      before any coloring is applied. Iterating is by far the slowest part  *
+ *      of drawing a fractal, and coloring is cheap, so a field is rendered   *
+ *      once and can then be colored any number of ways without iterating     *
+ *      again.                                                                *
+ *                                                                            *
+ *      A field file is a 64 byte header followed by one record per pixel,    *
+ *      row by row from the top, with no padding:                             *
+ *          uint32 iters    The number of iterations, max_iters if the point  *
+ *                          did not escape.                                   *
+ *          float  smooth   The smooth iteration count, fractal_smooth_value. *
+ *          float  abs_z    The modulus of the final iterate. Optional, only  *
+ *                          present in 12 byte records. Points that did not   *
+ *                          escape are iterated all max_iters times for this. *
+ *      The header and records are in the byte order of the machine that      *
+ *      wrote them, and the header holds a marker for checking this. Files    *
+ *      are written with fractal_render_field, and read by memory mapping     *
+ *      them with fractal_field_open.                                         *
+ *  Notes:                                                                    *
+ *      The smooth count is stored as a float. Its leading 23 bits are kept,  *
+ *      far more than the 10 bits fractal_colormap.h looks at, so coloring a  *
+ *      field from the table almost always gives the colors of the direct     *
+ *      render. The exception is a count rounded across the edge of a table   *
+ *      entry, which moves its color by at most a level.                      *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_FIELD_H
+#define FRACTAL_FIELD_H
+
+/*  uint32_t and SIZE_MAX found here.                                         */
+#include <stdint.h>
+
+/*  memcpy and memcmp found here.                                             */
+#include <string.h>
+
+/*  fstat and struct stat found here.                                         */
+#include <sys/stat.h>
+
+/*  The fractals, colorings, and fractal_colormap_color found here.           */
+#include "fractal.h"
+
+/*  fractal_render_raw, and the headers for open and mmap, found here.        */
+#include "ppm.h"
+
+/*  The first eight bytes of every field file.                                */
+#define FRACTAL_FIELD_MAGIC "FRACFLD1"
+
+/*  Written into the header as a uint32, for detecting files written by a     *
+ *  machine of the other byte order.                                          */
+#define FRACTAL_FIELD_BYTE_ORDER (0x01020304U)
+
+/*  The sizes of records without and with the modulus of the final iterate.   */
+#define FRACTAL_FIELD_RECORD_SIZE (8U)
+#define FRACTAL_FIELD_RECORD_SIZE_ABS_Z (12U)
+
+/*  The start of a field file, 64 bytes with no padding.                      */
+struct fractal_field_header {
+
+    /*  FRACTAL_FIELD_MAGIC, without a terminating zero.                      */
+    char magic[8];
+
+    /*  FRACTAL_FIELD_BYTE_ORDER, read as the wrong number when swapped.      */
+    uint32_t byte_order;
+
+    /*  The number of pixels in the x and y axes.                             */
+    uint32_t width, height;
+
+    /*  The maximum number of iterations of the fractal. Points with iters    *
+     *  equal to this did not escape.                                         */
+    uint32_t max_iters;
+
+    /*  The number of bytes per pixel, 8, or 12 with the final modulus.       */
+    uint32_t record_size;
+
+    /*  Zero, keeps the doubles below aligned.                                */
+    uint32_t reserved;
+
+    /*  The viewport the field was drawn with, see struct fractal_viewport.   */
+    double x_start, y_start, x_step, y_step;
+};
+
+/*  A field file memory mapped for reading.                                   */
+struct fractal_field {
+
+    /*  A copy of the header of the file.                                     */
+    struct fractal_field_header header;
+
+    /*  The first record, straight after the header in the mapping.           */
+    const unsigned char *records;
+
+    /*  The mapping of the entire file, and its size in bytes.                */
+    void *map;
+    size_t map_size;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_field_record                                                  *
+ *  Purpose:                                                                  *
+ *      Writes the 8 byte field record of a point, the iteration count and    *
+ *      the smooth iteration count. This has the form of a fractal_color_func *
+ *      so the usual renderer can draw fields, with channels set to 8.        *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      escape (const struct fractal_escape *):                               *
+ *          The result of iterating the point.                                *
+ *      record (unsigned char *):                                             *
+ *          The output record.                                                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_field_record(const struct fractal *f,
+                     const struct fractal_escape *escape,
+                     unsigned char *record)
+{
+    const uint32_t iters = escape->iters;
+    const float smooth = (float)fractal_smooth_value(f, escape);
+
+    memcpy(record, &iters, 4U);
+    memcpy(record + 4U, &smooth, 4U);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_field_record_abs_z                                            *
+ *  Purpose:                                                                  *
+ *      Writes the 12 byte field record of a point, as fractal_field_record   *
+ *      does, followed by the modulus of the final iterate.                   *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      escape (const struct fractal_escape *):                               *
+ *          The result of iterating the point.                                *
+ *      record (unsigned char *):                                             *
+ *          The output record.                                                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_field_record_abs_z(const struct fractal *f,
+                           const struct fractal_escape *escape,
+                           unsigned char *record)
+{
+    const float abs_z = (float)hypot(escape->z.real, escape->z.imag);
+
+    fractal_field_record(f, escape, record);
+    memcpy(record + 8U, &abs_z, 4U);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_field                                                  *
+ *  Purpose:                                                                  *
+ *      Renders the iteration count field of an image with several threads    *
+ *      and saves it to a file.                                               *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal and viewport. The coloring and pixel format are       *
+ *          ignored, records are written in their place.                      *
+ *      filename (const char *):                                              *
+ *          The path to the output file.                                      *
+ *      with_abs_z (int):                                                     *
+ *          Boolean for including the modulus of the final iterate.           *
+ *      number_of_threads (unsigned int):                                     *
+ *          The number of threads to use, including the calling thread.       *
+ *      use_mmap (int):                                                       *
+ *          Boolean for drawing directly into a memory mapped file, as in     *
+ *          fractal_render_ppm.                                               *
+ *      pixels_iterated (size_t *):                                           *
+ *          If not NULL, set to the number of pixels iterated.                *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+fractal_render_field(const struct fractal_renderer *r, const char *filename,
+                     int with_abs_z, unsigned int number_of_threads,
+                     int use_mmap, size_t *pixels_iterated)
+{
+    struct fractal_field_header header;
+    struct fractal_renderer field_renderer = *r;
+    struct fractal field_fractal = *r->fractal;
+    const struct fractal_viewport * const vp = r->viewport;
+
+    if (with_abs_z)
+    {
+        field_renderer.color = fractal_field_record_abs_z;
+        field_renderer.channels = FRACTAL_FIELD_RECORD_SIZE_ABS_Z;
+    }
+    else
+    {
+        field_renderer.color = fractal_field_record;
+        field_renderer.channels = FRACTAL_FIELD_RECORD_SIZE;
+    }
+
+    /*  The table only makes colors, the records come from the function.      */
+    field_renderer.colormap = NULL;
+
+    /*  Records of points that escape differ even when their iteration counts *
+     *  agree, and the final |z| of those that do not escape does too.        */
+    if (with_abs_z)
+        field_renderer.subdivide = FRACTAL_SUBDIVIDE_NONE;
+    else if (field_renderer.subdivide == FRACTAL_SUBDIVIDE_BANDS)
+        field_renderer.subdivide = FRACTAL_SUBDIVIDE_INTERIOR;
+
+    /*  For the same reason the shortcuts that stop before max_iters are off, *
+     *  as they leave z at c, or part way around a cycle.                     */
+    if (with_abs_z)
+    {
+        field_fractal.skip_interior = 0;
+        field_fractal.check_period = 0;
+        field_renderer.fractal = &field_fractal;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FRACTAL_FIELD_MAGIC, sizeof(header.magic));
+    header.byte_order = FRACTAL_FIELD_BYTE_ORDER;
+    header.width = vp->width;
+    header.height = vp->height;
+    header.max_iters = r->fractal->max_iters;
+    header.record_size = field_renderer.channels;
+    header.x_start = vp->x_start;
+    header.y_start = vp->y_start;
+    header.x_step = vp->x_step;
+    header.y_step = vp->y_step;
+
+    return fractal_render_raw(&field_renderer, filename,
+                              &header, sizeof(header),
+                              number_of_threads, use_mmap, pixels_iterated);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_field_open                                                    *
+ *  Purpose:                                                                  *
+ *      Memory maps a field file for reading and checks its header.           *
+ *  Arguments:                                                                *
+ *      field (struct fractal_field *):                                       *
+ *          The field, assumed to be uninitialized.                           *
+ *      filename (const char *):                                              *
+ *          The path to the field file.                                       *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 if the file could not be mapped, or is not a     *
+ *          field written by a machine of the same byte order, or its header  *
+ *          does not match its size.                                          *
+ ******************************************************************************/
+static inline int
+fractal_field_open(struct fractal_field *field, const char *filename)
+{
+    struct stat info;
+    const struct fractal_field_header *header;
+    size_t records_size;
+    void *map;
+    const int fd = open(filename, O_RDONLY);
+
+    field->map = NULL;
+    field->map_size = 0U;
+    field->records = NULL;
+
+    if (fd < 0)
+        return -1;
+
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(*header))
+    {
+        close(fd);
+        return -1;
+    }
+
+    /*  The mapping stays valid once the file is closed.                      */
+    map = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return -1;
+
+    field->map = map;
+    field->map_size = (size_t)info.st_size;
+    header = map;
+
+    if (memcmp(header->magic, FRACTAL_FIELD_MAGIC, sizeof(header->magic)) != 0
+        || header->byte_order != FRACTAL_FIELD_BYTE_ORDER
+        || (header->record_size != FRACTAL_FIELD_RECORD_SIZE
+            && header->record_size != FRACTAL_FIELD_RECORD_SIZE_ABS_Z))
+    {
+        munmap(field->map, field->map_size);
+        field->map = NULL;
+        return -1;
+    }
+
+    /*  The header is not trusted, so the size of the records must not wrap.  */
+    if (header->width == 0U || header->height == 0U
+        || (size_t)header->width
+           > SIZE_MAX / header->height / header->record_size)
+    {
+        munmap(field->map, field->map_size);
+        field->map = NULL;
+        return -1;
+    }
+
+    records_size = (size_t)header->width * (size_t)header->height
+                 * (size_t)header->record_size;
+
+    /*  A file cut short, by a render that failed part way, say.              */
+    if (field->map_size - sizeof(*header) != records_size)
+    {
+        munmap(field->map, field->map_size);
+        field->map = NULL;
+        return -1;
+    }
+
+    field->header = *header;
+    field->records = (const unsigned char *)map + sizeof(*header);
+    return 0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_field_close                                                   *
+ *  Purpose:                                                                  *
+ *      Unmaps a field file opened with fractal_field_open.                   *
+ *  Arguments:                                                                *
+ *      field (struct fractal_field *):                                       *
+ *          The field.                                                        *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_field_close(struct fractal_field *field)
+{
+    if (field->map)
+        munmap(field->map, field->map_size);
+
+    field->map = NULL;
+    field->records = NULL;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_field_colorize                                                *
+ *  Purpose:                                                                  *
+ *      Colors an iteration count field, without iterating anything.          *
+ *  Arguments:                                                                *
+ *      field (const struct fractal_field *):                                 *
+ *          The field.                                                        *
+ *      cm (const struct fractal_colormap *):                                 *
+ *          The table for the smooth coloring, looked up with the stored      *
+ *          smooth counts. If NULL, color is used instead.                    *
+ *      color (fractal_color_func):                                           *
+ *          The coloring, used when cm is NULL. It is given the iteration     *
+ *          count, and a final iterate with real part equal to the stored     *
+ *          modulus (zero if not stored) and imaginary part zero, so it must  *
+ *          not rely on anything else, fractal_color_banded for example.      *
+ *      channels (unsigned int):                                              *
+ *          The number of bytes per pixel, 1 for a palette index (which needs *
+ *          cm), 3 for RGB, or 4 for RGBA.                                    *
+ *      pixels (unsigned char *):                                             *
+ *          The output image, width * height * channels bytes.                *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_field_colorize(const struct fractal_field *field,
+                       const struct fractal_colormap *cm,
+                       fractal_color_func color, unsigned int channels,
+                       unsigned char *pixels)
+{
+    static const unsigned char black[3] = {0x00U, 0x00U, 0x00U};
+    const size_t size = (size_t)field->header.width * field->header.height;
+    const size_t record_size = field->header.record_size;
+    const unsigned char *record = field->records;
+    struct fractal f;
+    struct fractal_escape escape;
+    size_t n;
+
+    /*  The colorings only look at the iteration limit of the fractal.        */
+    memset(&f, 0, sizeof(f));
+    f.max_iters = field->header.max_iters;
+    escape.z.real = 0.0;
+    escape.z.imag = 0.0;
+
+    for (n = 0U; n < size; ++n)
+    {
+        uint32_t iters;
+        memcpy(&iters, record, 4U);
+
+        if (cm)
+        {
+            uint64_t entry = FRACTAL_COLORMAP_SIZE;
+
+            /*  Points that do not escape are black.                          */
+            if (iters < f.max_iters)
+            {
+                float smooth;
+                memcpy(&smooth, record + 4U, 4U);
+                entry = fractal_colormap_entry((double)smooth);
+            }
+
+            if (channels == 1U)
+                pixels[0] = (entry < FRACTAL_COLORMAP_SIZE ?
+                             cm->index[entry] : FRACTAL_SMOOTH_BLACK_INDEX);
+            else if (entry < FRACTAL_COLORMAP_SIZE)
+                memcpy(pixels, cm->rgb + 3U*entry, 3U);
+            else
+                memcpy(pixels, black, 3U);
+        }
+        else
+        {
+            escape.iters = iters;
+
+            if (record_size == FRACTAL_FIELD_RECORD_SIZE_ABS_Z)
+            {
+                float abs_z;
+                memcpy(&abs_z, record + 8U, 4U);
+                escape.z.real = (double)abs_z;
+            }
+
+            color(&f, &escape, pixels);
+        }
+
+        /*  RGBA images (used by gif.h) are fully opaque.                     */
+        if (channels == 4U)
+            pixels[3] = 0xFFU;
+
+        pixels += channels;
+        record += record_size;
+    }
+}
+
+#endif
+/*  End of include guard.                                                     */
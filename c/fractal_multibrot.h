@@ -0,0 +1,462 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Vectorized escape-time kernels for the Multibrot iteration,           *
+ *      z -> z^r + c. Whole number exponents, which the power sweep passes    *
+ *      through, are done by repeated squaring. Other exponents go through    *
+ *      the polar form, z^r = exp(r log|z|) (cos(r arg z) + i sin(r arg z)),  *
+ *      with log, atan2, exp, and sincos from fractal_simd_math.h. The        *
+ *      kernels are laid out as those of fractal_simd.h, two interleaved      *
+ *      vectors with escaped lanes masked off and frozen.                     *
+ *  Notes:                                                                    *
+ *      This file is included by fractal.h, do not include it directly.       *
+ *                                                                            *
+ *      The repeated squaring kernels do the same operations as               *
+ *      fractal_multibrot_integer_iter and agree with it bit for bit, the     *
+ *      polar ones differ from fractal_multibrot_iter by the rounding of the  *
+ *      vectorized functions, as in fractal_swipecat.h.                       *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_MULTIBROT_H
+#define FRACTAL_MULTIBROT_H
+
+#ifdef FRACTAL_HAS_X86_SIMD
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_multibrot_power_avx2                                          *
+ *  Purpose:                                                                  *
+ *      Computes z^r for 4 points.                                            *
+ *  Arguments:                                                                *
+ *      z_re (__m256d):                                                       *
+ *          The real parts of z.                                              *
+ *      z_im (__m256d):                                                       *
+ *          The imaginary parts of z.                                         *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. The exponent r is f->power.                          *
+ *      power (unsigned int):                                                 *
+ *          fractal_multibrot_integer_power(f).                               *
+ *      w_re (__m256d *):                                                     *
+ *          The real parts of z^r.                                            *
+ *      w_im (__m256d *):                                                     *
+ *          The imaginary parts of z^r.                                       *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      The same operations, in the same order, as                            *
+ *      fractal_multibrot_integer_iter if power is nonzero, and as            *
+ *      fractal_multibrot_iter if it is not.                                  *
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static inline void
+fractal_multibrot_power_avx2(__m256d z_re, __m256d z_im,
+                             const struct fractal *f, unsigned int power,
+                             __m256d *w_re, __m256d *w_im)
+{
+    if (power)
+    {
+        const __m256d two = _mm256_set1_pd(2.0);
+        unsigned int bit = 1U;
+        __m256d re = z_re;
+        __m256d im = z_im;
+
+        while (bit <= (power >> 1U))
+            bit <<= 1U;
+
+        for (bit >>= 1U; bit != 0U; bit >>= 1U)
+        {
+            const __m256d tmp = re;
+
+            re = _mm256_sub_pd(_mm256_mul_pd(re, re), _mm256_mul_pd(im, im));
+            im = _mm256_mul_pd(_mm256_mul_pd(two, tmp), im);
+
+            if (power & bit)
+            {
+                const __m256d prod_re = re;
+                re = _mm256_sub_pd(_mm256_mul_pd(prod_re, z_re),
+                                   _mm256_mul_pd(im, z_im));
+                im = _mm256_add_pd(_mm256_mul_pd(prod_re, z_im),
+                                   _mm256_mul_pd(im, z_re));
+            }
+        }
+
+        *w_re = re;
+        *w_im = im;
+    }
+    else
+    {
+        const __m256d r = _mm256_set1_pd(f->power);
+        const __m256d log_abs_z = _mm256_mul_pd(
+            _mm256_set1_pd(0.5), fractal_simd_log_avx2(_mm256_add_pd(
+                _mm256_mul_pd(z_re, z_re), _mm256_mul_pd(z_im, z_im)
+            ))
+        );
+        const __m256d arg = fractal_simd_atan2_avx2(z_im, z_re);
+        const __m256d exp_val
+            = fractal_simd_exp_avx2(_mm256_mul_pd(r, log_abs_z));
+        __m256d cos_y, sin_y;
+
+        fractal_simd_sincos_avx2(_mm256_mul_pd(r, arg), &cos_y, &sin_y);
+        *w_re = _mm256_mul_pd(exp_val, cos_y);
+        *w_im = _mm256_mul_pd(exp_val, sin_y);
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_multibrot_avx2                                                *
+ *  Purpose:                                                                  *
+ *      Iterates the Multibrot set for 8 points, as two interleaved vectors   *
+ *      of 4 points each.                                                     *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MULTIBROT, without the       *
+ *          periodicity check.                                                *
+ *      c_real (const double *):                                              *
+ *          The real parts of the 8 points.                                   *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the 8 points.                              *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static inline void
+fractal_multibrot_avx2(const struct fractal *f, const double *c_real,
+                       const double *c_imag, struct fractal_escape *out)
+{
+    double count_out[8], z_real_out[8], z_imag_out[8];
+    unsigned int iters, n, k;
+
+    const unsigned int power = fractal_multibrot_integer_power(f);
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    const __m256d radius = _mm256_set1_pd(f->escape_radius);
+    const __m256d radius_squared
+        = _mm256_set1_pd(f->escape_radius * f->escape_radius);
+
+    /*  Two independent vectors, see fractal_mandelbrot_avx2.                 */
+    __m256d c_re[2], c_im[2], z_re[2], z_im[2], active[2], count[2];
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        c_re[k] = _mm256_loadu_pd(c_real + 4U*k);
+        c_im[k] = _mm256_loadu_pd(c_imag + 4U*k);
+        z_re[k] = f->start_at_c ? c_re[k] : zero;
+        z_im[k] = f->start_at_c ? c_im[k] : zero;
+        active[k] = _mm256_cmp_pd(zero, zero, _CMP_EQ_OQ);
+        count[k] = zero;
+    }
+
+    for (iters = 0U; iters < f->max_iters; ++iters)
+    {
+        int remaining = 0;
+
+        for (k = 0U; k < 2U; ++k)
+        {
+            __m256d next_re, next_im, escaped;
+
+            fractal_multibrot_power_avx2(z_re[k], z_im[k], f, power,
+                                         &next_re, &next_im);
+            next_re = _mm256_add_pd(next_re, c_re[k]);
+            next_im = _mm256_add_pd(next_im, c_im[k]);
+
+            /*  Lanes that already escaped keep their final value.            */
+            z_re[k] = _mm256_blendv_pd(z_re[k], next_re, active[k]);
+            z_im[k] = _mm256_blendv_pd(z_im[k], next_im, active[k]);
+
+            if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+            {
+                const __m256d abs_sq = _mm256_add_pd(
+                    _mm256_mul_pd(z_re[k], z_re[k]),
+                    _mm256_mul_pd(z_im[k], z_im[k])
+                );
+
+                escaped = _mm256_cmp_pd(abs_sq, radius_squared, _CMP_GT_OQ);
+            }
+            else
+            {
+                const __m256d abs_x = _mm256_andnot_pd(sign_bit, z_re[k]);
+                escaped = _mm256_cmp_pd(abs_x, radius, _CMP_GE_OQ);
+            }
+
+            active[k] = _mm256_andnot_pd(escaped, active[k]);
+
+            /*  Lanes still active have survived another iteration.           */
+            count[k] = _mm256_add_pd(count[k], _mm256_and_pd(active[k], one));
+            remaining |= _mm256_movemask_pd(active[k]);
+        }
+
+        /*  Every lane has escaped, nothing left to do.                       */
+        if (!remaining)
+            break;
+    }
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        _mm256_storeu_pd(count_out + 4U*k, count[k]);
+        _mm256_storeu_pd(z_real_out + 4U*k, z_re[k]);
+        _mm256_storeu_pd(z_imag_out + 4U*k, z_im[k]);
+    }
+
+    for (n = 0U; n < 8U; ++n)
+    {
+        out[n].iters = (unsigned int)count_out[n];
+        out[n].z.real = z_real_out[n];
+        out[n].z.imag = z_imag_out[n];
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_multibrot_power_avx512                                        *
+ *  Purpose:                                                                  *
+ *      Computes z^r for 8 points.                                            *
+ *  Arguments:                                                                *
+ *      z_re (__m512d):                                                       *
+ *          The real parts of z.                                              *
+ *      z_im (__m512d):                                                       *
+ *          The imaginary parts of z.                                         *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. The exponent r is f->power.                          *
+ *      power (unsigned int):                                                 *
+ *          fractal_multibrot_integer_power(f).                               *
+ *      w_re (__m512d *):                                                     *
+ *          The real parts of z^r.                                            *
+ *      w_im (__m512d *):                                                     *
+ *          The imaginary parts of z^r.                                       *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      The same as fractal_multibrot_power_avx2, step for step.              *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_multibrot_power_avx512(__m512d z_re, __m512d z_im,
+                               const struct fractal *f, unsigned int power,
+                               __m512d *w_re, __m512d *w_im)
+{
+    if (power)
+    {
+        const __m512d two = _mm512_set1_pd(2.0);
+        unsigned int bit = 1U;
+        __m512d re = z_re;
+        __m512d im = z_im;
+
+        while (bit <= (power >> 1U))
+            bit <<= 1U;
+
+        for (bit >>= 1U; bit != 0U; bit >>= 1U)
+        {
+            const __m512d tmp = re;
+
+            re = _mm512_sub_pd(_mm512_mul_pd(re, re), _mm512_mul_pd(im, im));
+            im = _mm512_mul_pd(_mm512_mul_pd(two, tmp), im);
+
+            if (power & bit)
+            {
+                const __m512d prod_re = re;
+                re = _mm512_sub_pd(_mm512_mul_pd(prod_re, z_re),
+                                   _mm512_mul_pd(im, z_im));
+                im = _mm512_add_pd(_mm512_mul_pd(prod_re, z_im),
+                                   _mm512_mul_pd(im, z_re));
+            }
+        }
+
+        *w_re = re;
+        *w_im = im;
+    }
+    else
+    {
+        const __m512d r = _mm512_set1_pd(f->power);
+        const __m512d log_abs_z = _mm512_mul_pd(
+            _mm512_set1_pd(0.5), fractal_simd_log_avx512(_mm512_add_pd(
+                _mm512_mul_pd(z_re, z_re), _mm512_mul_pd(z_im, z_im)
+            ))
+        );
+        const __m512d arg = fractal_simd_atan2_avx512(z_im, z_re);
+        const __m512d exp_val
+            = fractal_simd_exp_avx512(_mm512_mul_pd(r, log_abs_z));
+        __m512d cos_y, sin_y;
+
+        fractal_simd_sincos_avx512(_mm512_mul_pd(r, arg), &cos_y, &sin_y);
+        *w_re = _mm512_mul_pd(exp_val, cos_y);
+        *w_im = _mm512_mul_pd(exp_val, sin_y);
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_multibrot_avx512                                              *
+ *  Purpose:                                                                  *
+ *      Iterates the Multibrot set for 16 points, as two interleaved vectors  *
+ *      of 8 points each.                                                     *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MULTIBROT, without the       *
+ *          periodicity check.                                                *
+ *      c_real (const double *):                                              *
+ *          The real parts of the 16 points.                                  *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the 16 points.                             *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_multibrot_avx512(const struct fractal *f, const double *c_real,
+                         const double *c_imag, struct fractal_escape *out)
+{
+    double count_out[16], z_real_out[16], z_imag_out[16];
+    unsigned int iters, n, k;
+
+    const unsigned int power = fractal_multibrot_integer_power(f);
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d radius = _mm512_set1_pd(f->escape_radius);
+    const __m512d radius_squared
+        = _mm512_set1_pd(f->escape_radius * f->escape_radius);
+
+    /*  Two independent vectors, see fractal_mandelbrot_avx2.                 */
+    __m512d c_re[2], c_im[2], z_re[2], z_im[2], count[2];
+
+    /*  One bit per lane, set for lanes that have not escaped yet.            */
+    __mmask8 active[2];
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        c_re[k] = _mm512_loadu_pd(c_real + 8U*k);
+        c_im[k] = _mm512_loadu_pd(c_imag + 8U*k);
+        z_re[k] = f->start_at_c ? c_re[k] : zero;
+        z_im[k] = f->start_at_c ? c_im[k] : zero;
+        active[k] = 0xFFU;
+        count[k] = zero;
+    }
+
+    for (iters = 0U; iters < f->max_iters; ++iters)
+    {
+        for (k = 0U; k < 2U; ++k)
+        {
+            __m512d next_re, next_im;
+            __mmask8 escaped;
+
+            fractal_multibrot_power_avx512(z_re[k], z_im[k], f, power,
+                                           &next_re, &next_im);
+            next_re = _mm512_add_pd(next_re, c_re[k]);
+            next_im = _mm512_add_pd(next_im, c_im[k]);
+
+            /*  Lanes that already escaped keep their final value.            */
+            z_re[k] = _mm512_mask_blend_pd(active[k], z_re[k], next_re);
+            z_im[k] = _mm512_mask_blend_pd(active[k], z_im[k], next_im);
+
+            if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+            {
+                const __m512d abs_sq = _mm512_add_pd(
+                    _mm512_mul_pd(z_re[k], z_re[k]),
+                    _mm512_mul_pd(z_im[k], z_im[k])
+                );
+
+                escaped = _mm512_cmp_pd_mask(abs_sq, radius_squared,
+                                             _CMP_GT_OQ);
+            }
+            else
+                escaped = _mm512_cmp_pd_mask(_mm512_abs_pd(z_re[k]),
+                                             radius, _CMP_GE_OQ);
+
+            active[k] = (__mmask8)(active[k] & ~escaped);
+
+            /*  Lanes still active have survived another iteration.           */
+            count[k] = _mm512_mask_add_pd(count[k], active[k], count[k], one);
+        }
+
+        /*  Every lane has escaped, nothing left to do.                       */
+        if ((active[0] | active[1]) == 0U)
+            break;
+    }
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        _mm512_storeu_pd(count_out + 8U*k, count[k]);
+        _mm512_storeu_pd(z_real_out + 8U*k, z_re[k]);
+        _mm512_storeu_pd(z_imag_out + 8U*k, z_im[k]);
+    }
+
+    for (n = 0U; n < 16U; ++n)
+    {
+        out[n].iters = (unsigned int)count_out[n];
+        out[n].z.real = z_real_out[n];
+        out[n].z.imag = z_imag_out[n];
+    }
+}
+
+#endif
+/*  End of #ifdef FRACTAL_HAS_X86_SIMD.                                       */
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_multibrot_points                                              *
+ *  Purpose:                                                                  *
+ *      Iterates the Multibrot set for any number of points, using the        *
+ *      fastest available kernel. Leftover points, and every point if the     *
+ *      periodicity check is on, are done one at a time.                      *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MULTIBROT.                   *
+ *      c_real (const double *):                                              *
+ *          The real parts of the points.                                     *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the points.                                *
+ *      number_of_points (unsigned int):                                      *
+ *          The number of elements in c_real, c_imag, and out.                *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_multibrot_points(const struct fractal *f, const double *c_real,
+                         const double *c_imag, unsigned int number_of_points,
+                         struct fractal_escape *out)
+{
+    const enum fractal_simd_level level
+        = f->check_period ? FRACTAL_SIMD_SCALAR : fractal_simd_level();
+
+    /*  Two calls, rather than one with a variable, so the scalar iteration   *
+     *  can be inlined into the leftover loop.                                */
+    if (fractal_multibrot_integer_power(f))
+        fractal_simd_points(f, level,
+                            FRACTAL_SIMD_KERNEL(fractal_multibrot_avx2),
+                            FRACTAL_SIMD_KERNEL(fractal_multibrot_avx512),
+                            fractal_multibrot_integer_iter, c_real, c_imag,
+                            number_of_points, out);
+    else
+        fractal_simd_points(f, level,
+                            FRACTAL_SIMD_KERNEL(fractal_multibrot_avx2),
+                            FRACTAL_SIMD_KERNEL(fractal_multibrot_avx512),
+                            fractal_multibrot_iter, c_real, c_imag,
+                            number_of_points, out);
+}
+
+#endif
+/*  End of include guard.                                                     */
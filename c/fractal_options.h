@@ -0,0 +1,192 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Command line options shared by the programs.                          *
+ *          --threads N     Render with N threads (default: number of CPUs).  *
+ *                          For the GIF programs, N frames are drawn at once. *
+ *          --mmap          Render straight into a memory mapped output file. *
+ *                          Still images only, ignored by the GIF programs.   *
+ *          --field FILE    Save the iteration count field to FILE instead of *
+ *                          the image, see fractal_field.h. Still images      *
+ *                          only, ignored by the GIF programs.                *
+ *          --field-z       Include the final |z| in the field records.       *
+ *          --stats FILE    Save the times of each frame to FILE as CSV, see  *
+ *                          fractal_stats.h. GIF programs built with          *
+ *                          FRACTAL_STATS only.                               *
+ *          --preview FILE  Draw coarse to fine, saving a preview to FILE at  *
+ *                          1/16 and then 1/4 of the pixels, see              *
+ *                          fractal_progressive.h. Still images only.         *
+ *          --keyframes K   Zoom GIF programs only. Render every Kth frame    *
+ *                          in full along with an oversampled keyframe, and   *
+ *                          resample the K - 1 frames after it from the       *
+ *                          keyframe, see fractal_zoom.h. Much faster, but    *
+ *                          the resampled frames are approximate. The         *
+ *                          default, 1, renders every frame exactly.          *
+ *          --global-palette                                                  *
+ *                          GIF programs only. Write one fixed palette made   *
+ *                          from the smooth coloring and frames of indices    *
+ *                          into it, rather than making and dithering a       *
+ *                          palette for each frame. Faster and smaller, but   *
+ *                          the colors differ slightly from the default.      *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_OPTIONS_H
+#define FRACTAL_OPTIONS_H
+
+/*  puts found here.                                                          */
+#include <stdio.h>
+
+/*  strtoul found here.                                                       */
+#include <stdlib.h>
+
+/*  strcmp found here.                                                        */
+#include <string.h>
+
+/*  fractal_default_threads and FRACTAL_MAX_THREADS found here.               */
+#include "fractal_threads.h"
+
+/*  The largest --keyframes allowed. The keyframe for K frames has q^-(K-1)   *
+ *  times the pixels of a frame along each axis, about 5x for K = 32 and a    *
+ *  zoom of q = 0.95 per frame.                                               */
+#define FRACTAL_MAX_KEYFRAMES (32U)
+
+/*  Settings requested on the command line.                                   */
+struct fractal_options {
+
+    /*  The number of threads used for rendering.                             */
+    unsigned int number_of_threads;
+
+    /*  Boolean for writing the output through mmap instead of write.         */
+    int use_mmap;
+
+    /*  The path for the iteration count field, NULL to draw the image.       */
+    const char *field_filename;
+
+    /*  Boolean for including the final |z| in the field.                     */
+    int field_abs_z;
+
+    /*  The path for the frame statistics, NULL for none.                     */
+    const char *stats_filename;
+
+    /*  The path for the previews of a progressive drawing, NULL for none.    */
+    const char *preview_filename;
+
+    /*  The number of frames drawn from each keyframe, 1 for no keyframes.    */
+    unsigned int keyframe_interval;
+
+    /*  Boolean for one fixed palette, rather than a palette for each frame.  */
+    int global_palette;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_parse_options                                                 *
+ *  Purpose:                                                                  *
+ *      Parses the command line. Options that are not given keep their        *
+ *      default values.                                                       *
+ *  Arguments:                                                                *
+ *      argc (int):                                                           *
+ *          The number of command line arguments.                             *
+ *      argv (char **):                                                       *
+ *          The command line arguments.                                       *
+ *      opts (struct fractal_options *):                                      *
+ *          The requested settings.                                           *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 if an argument is not understood. A usage        *
+ *          message is printed in the latter case.                            *
+ ******************************************************************************/
+static inline int
+fractal_parse_options(int argc, char **argv, struct fractal_options *opts)
+{
+    int n;
+
+    opts->number_of_threads = fractal_default_threads();
+    opts->use_mmap = 0;
+    opts->field_filename = NULL;
+    opts->field_abs_z = 0;
+    opts->stats_filename = NULL;
+    opts->preview_filename = NULL;
+    opts->keyframe_interval = 1U;
+    opts->global_palette = 0;
+
+    for (n = 1; n < argc; ++n)
+    {
+        if (strcmp(argv[n], "--threads") == 0 && n + 1 < argc)
+        {
+            char *end;
+            const unsigned long val = strtoul(argv[n + 1], &end, 10);
+
+            if (*end != '\0' || val == 0UL || val > FRACTAL_MAX_THREADS)
+                break;
+
+            opts->number_of_threads = (unsigned int)val;
+            ++n;
+        }
+        else if (strcmp(argv[n], "--mmap") == 0)
+            opts->use_mmap = 1;
+        else if (strcmp(argv[n], "--field") == 0 && n + 1 < argc)
+        {
+            opts->field_filename = argv[n + 1];
+            ++n;
+        }
+        else if (strcmp(argv[n], "--field-z") == 0)
+            opts->field_abs_z = 1;
+        else if (strcmp(argv[n], "--stats") == 0 && n + 1 < argc)
+        {
+            opts->stats_filename = argv[n + 1];
+            ++n;
+        }
+        else if (strcmp(argv[n], "--preview") == 0 && n + 1 < argc)
+        {
+            opts->preview_filename = argv[n + 1];
+            ++n;
+        }
+        else if (strcmp(argv[n], "--keyframes") == 0 && n + 1 < argc)
+        {
+            char *end;
+            const unsigned long val = strtoul(argv[n + 1], &end, 10);
+
+            if (*end != '\0' || val == 0UL || val > FRACTAL_MAX_KEYFRAMES)
+                break;
+
+            opts->keyframe_interval = (unsigned int)val;
+            ++n;
+        }
+        else if (strcmp(argv[n], "--global-palette") == 0)
+            opts->global_palette = 1;
+        else
+            break;
+    }
+
+    if (n < argc)
+    {
+        puts("Usage: [--threads N] [--mmap] [--field FILE [--field-z]] "
+             "[--stats FILE] [--preview FILE] [--keyframes K] "
+             "[--global-palette], "
+             "1 <= N <= 1024, 1 <= K <= 32.");
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif
+/*  End of include guard.                                                     */
@@ -0,0 +1,388 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Draws an image coarse to fine, so a usable preview is ready long      *
+ *      before the image is. The first pass draws every fourth pixel of       *
+ *      every fourth row, a sixteenth of the image, the second pass the rest  *
+ *      of every other pixel of every other row, bringing it to a quarter,    *
+ *      and the last pass the rest. No pixel is drawn twice, so the passes    *
+ *      together cost the same as drawing the image in one go.                *
+ *                                                                            *
+ *      After each of the coarse passes, the pixels not yet drawn are filled  *
+ *      in with the drawn pixel above and to the left of them, giving a       *
+ *      blocky but complete image, which is handed to a callback. The last    *
+ *      pass overwrites every filled in pixel.                                *
+ *  Notes:                                                                    *
+ *      Every point is computed as fractal_render computes it, see            *
+ *      fractal_render_pixels, so the final image is the same as one drawn    *
+ *      by fractal_render_parallel.                                           *
+ *                                                                            *
+ *      The coarse passes iterate all of their pixels, a quarter of the       *
+ *      image. With subdivision on, the last pass is drawn by                 *
+ *      fractal_subdivide.h a band of blocks at a time, looking up the counts *
+ *      the coarse passes found rather than iterating those pixels again, so  *
+ *      it makes the same choices, and the same image, as drawing in one go.  *
+ *      Uniform regions cost their quarter of the pixels on top of what       *
+ *      subdivision alone would iterate, and nothing more.                    *
+ *                                                                            *
+ *      Each pass is split into rows, which the threads take from a shared    *
+ *      counter, as fractal_threads.h does with tiles.                        *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_PROGRESSIVE_H
+#define FRACTAL_PROGRESSIVE_H
+
+/*  pthread_create and pthread_join found here.                               */
+#include <pthread.h>
+
+/*  atomic_uint and atomic_fetch_add provided here.                           */
+#include <stdatomic.h>
+
+/*  size_t, malloc, and free found here.                                      */
+#include <stdlib.h>
+
+/*  memcpy found here.                                                        */
+#include <string.h>
+
+/*  fractal_render_pixels, fractal_render_span, and FRACTAL_MAX_THREADS.      */
+#include "fractal_threads.h"
+
+/*  The distance between the pixels of the first pass. Each pass halves it,   *
+ *  so there are three passes, the first drawing 1/16 of the pixels.          */
+#define FRACTAL_PROGRESSIVE_STRIDE (4U)
+
+/*  Function called with the preview after each coarse pass. Given the user   *
+ *  data, the distance between the pixels drawn so far (4, then 2), and the   *
+ *  image, it returns 0 to go on and -1 to stop drawing.                      */
+typedef int
+(*fractal_preview_func)(void *data, unsigned int stride,
+                        const unsigned char *image);
+
+/*  State shared by the worker threads for one pass.                          */
+struct fractal_progressive_pass {
+
+    /*  The fractal, viewport, coloring, and pixel format.                    */
+    const struct fractal_renderer *renderer;
+
+    /*  The whole image. Every row writes a disjoint set of pixels.           */
+    unsigned char *image;
+
+    /*  The distance between the pixels of this pass.                         */
+    unsigned int stride;
+
+    /*  The iteration counts of the pixels with even x and y, found by the    *
+     *  coarse passes for fractal_subdivide_rect_known. NULL if subdivision   *
+     *  is off.                                                               */
+    unsigned int *known;
+
+    /*  The number of rows in this pass, and the index of the next to draw.   *
+     *  With subdivision, the last pass hands out bands of blocks instead.    */
+    unsigned int number_of_rows;
+    atomic_uint next_row;
+
+    /*  The number of pixels iterated so far, by every pass.                  */
+    atomic_size_t pixels_iterated;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_progressive_row                                               *
+ *  Purpose:                                                                  *
+ *      Draws the pixels of a row that are new in a pass.                     *
+ *  Arguments:                                                                *
+ *      pass (const struct fractal_progressive_pass *):                       *
+ *          The pass.                                                         *
+ *      y (unsigned int):                                                     *
+ *          The row, a multiple of the stride.                                *
+ *  Output:                                                                   *
+ *      pixels_iterated (size_t):                                             *
+ *          The number of pixels drawn.                                       *
+ *  Method:                                                                   *
+ *      The pixels of the pass are those in columns that are multiples of     *
+ *      the stride. In rows that are multiples of twice the stride, every     *
+ *      other one of these was drawn by the pass before, and is skipped.      *
+ *      Full rows of the last pass are drawn with fractal_render_span, the    *
+ *      rest are gathered into chunks for fractal_render_pixels.              *
+ ******************************************************************************/
+static inline size_t
+fractal_progressive_row(const struct fractal_progressive_pass *pass,
+                        unsigned int y)
+{
+    const struct fractal_renderer * const r = pass->renderer;
+    const unsigned int width = r->viewport->width;
+    const unsigned int channels = r->channels;
+    const unsigned int stride = pass->stride;
+    unsigned char * const row = pass->image + (size_t)y * width * channels;
+
+    /*  The first pass draws all of its pixels, the others skip those drawn   *
+     *  already, which are every other one in every other row.                */
+    const int is_first = (stride == FRACTAL_PROGRESSIVE_STRIDE);
+    const int skip = !is_first && (y % (2U*stride) == 0U);
+    const unsigned int step = (skip ? 2U*stride : stride);
+    const unsigned int x_first = (skip ? stride : 0U);
+
+    struct fractal_escape escape[FRACTAL_ROW_CHUNK];
+    unsigned int x_list[FRACTAL_ROW_CHUNK], y_list[FRACTAL_ROW_CHUNK];
+    unsigned int x, n, count = 0U;
+    size_t pixels_iterated = 0U;
+
+    if (step == 1U)
+    {
+        fractal_render_span(r, 0U, y, width, row);
+        return width;
+    }
+
+    for (x = x_first; x < width; x += step)
+    {
+        x_list[count] = x;
+        y_list[count] = y;
+        ++count;
+
+        if (count < FRACTAL_ROW_CHUNK && x + step < width)
+            continue;
+
+        fractal_render_pixels(r, x_list, y_list, count, escape);
+
+        for (n = 0U; n < count; ++n)
+            fractal_render_colors(r, escape + n, 1U,
+                                  row + (size_t)x_list[n] * channels);
+
+        /*  Every coarse pixel has even x and y, keep its count for later.    */
+        if (pass->known)
+        {
+            unsigned int * const known
+                = pass->known + (size_t)(y / 2U) * ((width + 1U) / 2U);
+
+            for (n = 0U; n < count; ++n)
+                known[x_list[n] / 2U] = escape[n].iters;
+        }
+
+        pixels_iterated += count;
+        count = 0U;
+    }
+
+    return pixels_iterated;
+}
+
+/*  Draws a band of FRACTAL_SUBDIVIDE_BLOCK rows of the last pass by          *
+ *  subdivision, looking up the pixels the coarse passes drew.                */
+static inline size_t
+fractal_progressive_band(const struct fractal_progressive_pass *pass,
+                         unsigned int band)
+{
+    const struct fractal_renderer * const r = pass->renderer;
+    const unsigned int width = r->viewport->width;
+    const unsigned int height = r->viewport->height;
+    const unsigned int y_begin = band * FRACTAL_SUBDIVIDE_BLOCK;
+    const size_t offset = (size_t)y_begin * width * r->channels;
+    unsigned int y_end = y_begin + FRACTAL_SUBDIVIDE_BLOCK;
+
+    if (y_end > height)
+        y_end = height;
+
+    return fractal_subdivide_rect_known(r, pass->image + offset, 0U, y_begin,
+                                        width, y_end, pass->known);
+}
+
+/*  Thread routine. Draws the next row of the pass until none are left.       */
+static inline void *
+fractal_progressive_worker(void *arg)
+{
+    struct fractal_progressive_pass * const pass = arg;
+    const int by_band = (pass->stride == 1U && pass->known);
+    size_t pixels_iterated = 0U;
+
+    while (1)
+    {
+        const unsigned int row = atomic_fetch_add(&pass->next_row, 1U);
+
+        if (row >= pass->number_of_rows)
+            break;
+
+        if (by_band)
+            pixels_iterated += fractal_progressive_band(pass, row);
+        else
+            pixels_iterated += fractal_progressive_row(pass,
+                                                       row * pass->stride);
+    }
+
+    atomic_fetch_add(&pass->pixels_iterated, pixels_iterated);
+    return NULL;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_progressive_fill                                              *
+ *  Purpose:                                                                  *
+ *      Fills in the pixels not yet drawn, each stride by stride block taking *
+ *      the color of the drawn pixel at its top left corner.                  *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The viewport and pixel format.                                    *
+ *      image (unsigned char *):                                              *
+ *          The image.                                                        *
+ *      stride (unsigned int):                                                *
+ *          The distance between the pixels drawn so far.                     *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_progressive_fill(const struct fractal_renderer *r,
+                         unsigned char *image, unsigned int stride)
+{
+    const unsigned int width = r->viewport->width;
+    const unsigned int height = r->viewport->height;
+    const size_t channels = r->channels;
+    const size_t row_size = (size_t)width * channels;
+    unsigned int x, y, k;
+
+    for (y = 0U; y < height; y += stride)
+    {
+        unsigned char * const row = image + (size_t)y * row_size;
+
+        /*  Spread each drawn pixel over the columns to its right, then copy  *
+         *  the row down over the rows below it.                              */
+        for (x = 0U; x < width; x += stride)
+        {
+            const unsigned char * const pixel = row + (size_t)x * channels;
+
+            for (k = 1U; k < stride && x + k < width; ++k)
+                memcpy(row + (size_t)(x + k) * channels, pixel, channels);
+        }
+
+        for (k = 1U; k < stride && y + k < height; ++k)
+            memcpy(row + (size_t)k * row_size, row, row_size);
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_progressive                                            *
+ *  Purpose:                                                                  *
+ *      Renders an entire image coarse to fine using several threads, calling *
+ *      back with a preview after each coarse pass. The final image is        *
+ *      identical to the one fractal_render_parallel draws.                   *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, coloring, and pixel format. Subdivision,   *
+ *          if on, is used for the last pass.                                 *
+ *      image (unsigned char *):                                              *
+ *          The image, width * height * channels bytes.                       *
+ *      number_of_threads (unsigned int):                                     *
+ *          The number of threads to use, including the calling thread.       *
+ *      preview (fractal_preview_func):                                       *
+ *          Called with each preview, may be NULL.                            *
+ *      data (void *):                                                        *
+ *          Passed on to preview.                                             *
+ *      pixels_iterated (size_t *):                                           *
+ *          If not NULL, set to the number of pixels iterated, the rest were  *
+ *          filled in by subdivision.                                         *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 if preview asked to stop.                        *
+ *  Notes:                                                                    *
+ *      If threads can not be created the calling thread does the remaining   *
+ *      work on its own, as in fractal_render_rows_parallel. Likewise, if     *
+ *      there is no memory for the counts the coarse passes find, the last    *
+ *      pass iterates every pixel left, which draws the same image.           *
+ ******************************************************************************/
+static inline int
+fractal_render_progressive(const struct fractal_renderer *r,
+                           unsigned char *image,
+                           unsigned int number_of_threads,
+                           fractal_preview_func preview, void *data,
+                           size_t *pixels_iterated)
+{
+    struct fractal_progressive_pass pass;
+    pthread_t *threads = NULL;
+    unsigned int n, stride, number_started = 0U;
+    const unsigned int width = r->viewport->width;
+    const unsigned int height = r->viewport->height;
+    const double start = fractal_stats_now();
+
+    /*  Check the CPU now so the workers only ever read the cached result.    */
+    fractal_simd_level();
+
+    if (number_of_threads > 1U)
+        threads = malloc(sizeof(*threads) * (number_of_threads - 1U));
+
+    pass.renderer = r;
+    pass.image = image;
+    pass.known = NULL;
+    atomic_init(&pass.pixels_iterated, 0U);
+
+    if (r->subdivide != FRACTAL_SUBDIVIDE_NONE)
+        pass.known = malloc(sizeof(*pass.known) * ((width + 1U) / 2U)
+                                                * ((height + 1U) / 2U));
+
+    for (stride = FRACTAL_PROGRESSIVE_STRIDE; stride > 0U; stride /= 2U)
+    {
+        number_started = 0U;
+        pass.stride = stride;
+        pass.number_of_rows = (height + stride - 1U) / stride;
+
+        if (stride == 1U && pass.known)
+            pass.number_of_rows = (height + FRACTAL_SUBDIVIDE_BLOCK - 1U)
+                                / FRACTAL_SUBDIVIDE_BLOCK;
+
+        atomic_init(&pass.next_row, 0U);
+
+        /*  The calling thread is a worker as well, so start one fewer.       */
+        if (threads)
+        {
+            for (n = 0U; n < number_of_threads - 1U; ++n)
+            {
+                if (pthread_create(&threads[n], NULL,
+                                   fractal_progressive_worker, &pass))
+                    break;
+
+                ++number_started;
+            }
+        }
+
+        fractal_progressive_worker(&pass);
+
+        for (n = 0U; n < number_started; ++n)
+            pthread_join(threads[n], NULL);
+
+        if (stride > 1U && preview)
+        {
+            fractal_progressive_fill(r, image, stride);
+
+            if (preview(data, stride, image) != 0)
+            {
+                free(pass.known);
+                free(threads);
+                return -1;
+            }
+        }
+    }
+
+    if (pixels_iterated)
+        *pixels_iterated = atomic_load(&pass.pixels_iterated);
+
+    free(pass.known);
+    free(threads);
+    fractal_stats_parallel(number_started + 1U, fractal_stats_now() - start);
+    return 0;
+}
+
+#endif
+/*  End of include guard.                                                     */
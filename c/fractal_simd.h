@@ -0,0 +1,614 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Vectorized escape-time kernels for z^2 + c. The AVX2 kernel iterates  *
+ *      4 points per vector and the AVX-512 kernel iterates 8, with two       *
+ *      vectors in flight at once. Each lane keeps its own iteration counter, *
+ *      and lanes that have escaped are masked off and frozen so the final    *
+ *      value of z matches the scalar loop. The fastest kernel supported by   *
+ *      the CPU is picked at runtime.                                         *
+ *  Notes:                                                                    *
+ *      This file is included by fractal.h, do not include it directly.       *
+ *                                                                            *
+ *      The kernels perform the same operations in the same order as          *
+ *      fractal_mandelbrot_iter, with the same rounding, so the output is     *
+ *      identical to the scalar code. The kernels are compiled with the       *
+ *      GCC / clang target attribute, so no -mavx2 flag is needed, and on     *
+ *      other compilers or CPUs only the scalar code is used.                 *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_SIMD_H
+#define FRACTAL_SIMD_H
+
+/*  The target attribute and __builtin_cpu_supports are GNU extensions.       */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRACTAL_HAS_X86_SIMD
+#include <immintrin.h>
+
+/*  AVX-512 implies FMA, and the double-double kernels of fractal_dd.h ask    *
+ *  for it alongside AVX2. GCC will fuse the multiplies and adds in the       *
+ *  kernels unless told not to, which changes the rounding. Only allow this   *
+ *  if the rest of the program is built with FMA as well (e.g.                *
+ *  -march=native), so that the kernels and the scalar code always round the  *
+ *  same way.                                                                 */
+#if defined(__FMA__) || defined(__clang__)
+#define FRACTAL_AVX512_TARGET __attribute__((target("avx512f")))
+#define FRACTAL_AVX2_FMA_TARGET __attribute__((target("avx2,fma")))
+#else
+#define FRACTAL_AVX512_TARGET \
+    __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#define FRACTAL_AVX2_FMA_TARGET \
+    __attribute__((target("avx2,fma"), optimize("fp-contract=off")))
+#endif
+
+#endif
+
+/*  Runs of at least this many points left over after the full vectors are    *
+ *  done with one more, partly filled, vector instead of the scalar code.     */
+#define FRACTAL_SIMD_MIN_TAIL (2U)
+
+/*  The instruction sets the Mandelbrot kernel can use.                       */
+enum fractal_simd_level {
+    FRACTAL_SIMD_SCALAR,
+    FRACTAL_SIMD_AVX2,
+    FRACTAL_SIMD_AVX512
+};
+
+/*  The level in use. -1 means the CPU has not been checked yet.              */
+static int fractal_simd_current = -1;
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_detect                                                   *
+ *  Purpose:                                                                  *
+ *      Determines the best instruction set supported by this CPU.            *
+ *  Arguments:                                                                *
+ *      None (void).                                                          *
+ *  Output:                                                                   *
+ *      level (enum fractal_simd_level):                                      *
+ *          The fastest kernel that can be used.                              *
+ ******************************************************************************/
+static inline enum fractal_simd_level
+fractal_simd_detect(void)
+{
+#ifdef FRACTAL_HAS_X86_SIMD
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f"))
+        return FRACTAL_SIMD_AVX512;
+
+    if (__builtin_cpu_supports("avx2"))
+        return FRACTAL_SIMD_AVX2;
+#endif
+
+    return FRACTAL_SIMD_SCALAR;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_level                                                    *
+ *  Purpose:                                                                  *
+ *      Returns the instruction set used by the Mandelbrot kernel, checking   *
+ *      the CPU on the first call.                                            *
+ *  Arguments:                                                                *
+ *      None (void).                                                          *
+ *  Output:                                                                   *
+ *      level (enum fractal_simd_level):                                      *
+ *          The kernel in use.                                                *
+ ******************************************************************************/
+static inline enum fractal_simd_level
+fractal_simd_level(void)
+{
+    if (fractal_simd_current < 0)
+        fractal_simd_current = (int)fractal_simd_detect();
+
+    return (enum fractal_simd_level)fractal_simd_current;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_set_level                                                *
+ *  Purpose:                                                                  *
+ *      Forces a particular kernel, used for benchmarking and for comparing   *
+ *      the vectorized output against the scalar code. Requests for an        *
+ *      instruction set the CPU lacks fall back to the best one it has.       *
+ *  Arguments:                                                                *
+ *      level (enum fractal_simd_level):                                      *
+ *          The requested kernel.                                             *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_simd_set_level(enum fractal_simd_level level)
+{
+    const enum fractal_simd_level best = fractal_simd_detect();
+
+    if (level > best)
+        level = best;
+
+    fractal_simd_current = (int)level;
+}
+
+#ifdef FRACTAL_HAS_X86_SIMD
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_mandelbrot_avx2                                               *
+ *  Purpose:                                                                  *
+ *      Iterates z^2 + c for 8 points, as two interleaved vectors of 4 points *
+ *      each.                                                                 *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      c_real (const double *):                                              *
+ *          The real parts of the 8 points.                                   *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the 8 points.                              *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static inline void
+fractal_mandelbrot_avx2(const struct fractal *f, const double *c_real,
+                        const double *c_imag, struct fractal_escape *out)
+{
+    double count_out[8], z_real_out[8], z_imag_out[8];
+    unsigned int iters, n, k;
+    int periodic_out = 0;
+
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d two = _mm256_set1_pd(2.0);
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    const __m256d radius = _mm256_set1_pd(f->escape_radius);
+    const __m256d radius_squared
+        = _mm256_set1_pd(f->escape_radius * f->escape_radius);
+
+    /*  Periodicity check, see fractal_escape_loop. Since every lane is on    *
+     *  the same iteration, one step counter is shared by all of them.        */
+    const int check_period = f->check_period;
+    const __m256d tolerance = _mm256_set1_pd(f->period_tolerance);
+    unsigned int period_step = 0U, period_limit = 2U;
+
+    /*  The z^2 + c chain is latency bound. Working on two independent        *
+     *  vectors at once lets the CPU overlap their instructions.              */
+    __m256d c_re[2], c_im[2], z_re[2], z_im[2], active[2], count[2];
+
+    /*  The saved iterates, and all bits set for lanes found to be periodic.  */
+    __m256d saved_re[2], saved_im[2], periodic[2];
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        c_re[k] = _mm256_loadu_pd(c_real + 4U*k);
+        c_im[k] = _mm256_loadu_pd(c_imag + 4U*k);
+        z_re[k] = f->start_at_c ? c_re[k] : zero;
+        z_im[k] = f->start_at_c ? c_im[k] : zero;
+
+        /*  All bits set for lanes that have not escaped yet.                 */
+        active[k] = _mm256_cmp_pd(zero, zero, _CMP_EQ_OQ);
+
+        /*  Per-lane iteration counters, stored as doubles.                   */
+        count[k] = zero;
+
+        saved_re[k] = z_re[k];
+        saved_im[k] = z_im[k];
+        periodic[k] = zero;
+    }
+
+    for (iters = 0U; iters < f->max_iters; ++iters)
+    {
+        int remaining = 0;
+
+        for (k = 0U; k < 2U; ++k)
+        {
+            /*  Same operations, in the same order, as the scalar iteration.  */
+            const __m256d x_sq = _mm256_mul_pd(z_re[k], z_re[k]);
+            const __m256d y_sq = _mm256_mul_pd(z_im[k], z_im[k]);
+            const __m256d next_re
+                = _mm256_add_pd(_mm256_sub_pd(x_sq, y_sq), c_re[k]);
+            const __m256d next_im = _mm256_add_pd(
+                _mm256_mul_pd(_mm256_mul_pd(two, z_re[k]), z_im[k]), c_im[k]
+            );
+            __m256d escaped;
+
+            /*  Lanes that already escaped keep their final value.            */
+            z_re[k] = _mm256_blendv_pd(z_re[k], next_re, active[k]);
+            z_im[k] = _mm256_blendv_pd(z_im[k], next_im, active[k]);
+
+            if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+            {
+                const __m256d abs_sq = _mm256_add_pd(
+                    _mm256_mul_pd(z_re[k], z_re[k]),
+                    _mm256_mul_pd(z_im[k], z_im[k])
+                );
+
+                escaped = _mm256_cmp_pd(abs_sq, radius_squared, _CMP_GT_OQ);
+            }
+            else
+            {
+                const __m256d abs_x = _mm256_andnot_pd(sign_bit, z_re[k]);
+                escaped = _mm256_cmp_pd(abs_x, radius, _CMP_GE_OQ);
+            }
+
+            active[k] = _mm256_andnot_pd(escaped, active[k]);
+
+            /*  Active lanes that have returned to the saved value are done.  */
+            if (check_period)
+            {
+                const __m256d dx = _mm256_andnot_pd(
+                    sign_bit, _mm256_sub_pd(z_re[k], saved_re[k])
+                );
+                const __m256d dy = _mm256_andnot_pd(
+                    sign_bit, _mm256_sub_pd(z_im[k], saved_im[k])
+                );
+                const __m256d close = _mm256_and_pd(
+                    _mm256_cmp_pd(dx, tolerance, _CMP_LE_OQ),
+                    _mm256_cmp_pd(dy, tolerance, _CMP_LE_OQ)
+                );
+                const __m256d found = _mm256_and_pd(close, active[k]);
+
+                periodic[k] = _mm256_or_pd(periodic[k], found);
+                active[k] = _mm256_andnot_pd(found, active[k]);
+            }
+
+            /*  Lanes still active have survived another iteration.           */
+            count[k] = _mm256_add_pd(count[k], _mm256_and_pd(active[k], one));
+            remaining |= _mm256_movemask_pd(active[k]);
+        }
+
+        /*  Every lane has escaped, nothing left to do.                       */
+        if (!remaining)
+            break;
+
+        /*  Save new values at powers of two, Brent's method.                 */
+        if (check_period && ++period_step == period_limit)
+        {
+            for (k = 0U; k < 2U; ++k)
+            {
+                saved_re[k] = z_re[k];
+                saved_im[k] = z_im[k];
+            }
+
+            period_step = 0U;
+            period_limit <<= 1U;
+        }
+    }
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        _mm256_storeu_pd(count_out + 4U*k, count[k]);
+        _mm256_storeu_pd(z_real_out + 4U*k, z_re[k]);
+        _mm256_storeu_pd(z_imag_out + 4U*k, z_im[k]);
+        periodic_out |= _mm256_movemask_pd(periodic[k]) << (4U*k);
+    }
+
+    for (n = 0U; n < 8U; ++n)
+    {
+        /*  Periodic points never escape, the same as running to max_iters.   */
+        if (periodic_out & (1 << n))
+            out[n].iters = f->max_iters;
+        else
+            out[n].iters = (unsigned int)count_out[n];
+
+        out[n].z.real = z_real_out[n];
+        out[n].z.imag = z_imag_out[n];
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_mandelbrot_avx512                                             *
+ *  Purpose:                                                                  *
+ *      Iterates z^2 + c for 16 points, as two interleaved vectors of 8       *
+ *      points each.                                                          *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      c_real (const double *):                                              *
+ *          The real parts of the 16 points.                                  *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the 16 points.                             *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_mandelbrot_avx512(const struct fractal *f, const double *c_real,
+                          const double *c_imag, struct fractal_escape *out)
+{
+    double count_out[16], z_real_out[16], z_imag_out[16];
+    unsigned int iters, n, k;
+
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d two = _mm512_set1_pd(2.0);
+    const __m512d radius = _mm512_set1_pd(f->escape_radius);
+    const __m512d radius_squared
+        = _mm512_set1_pd(f->escape_radius * f->escape_radius);
+
+    /*  Periodicity check, shared step counter as in fractal_mandelbrot_avx2. */
+    const int check_period = f->check_period;
+    const __m512d tolerance = _mm512_set1_pd(f->period_tolerance);
+    unsigned int period_step = 0U, period_limit = 2U;
+
+    /*  Two independent vectors, see fractal_mandelbrot_avx2.                 */
+    __m512d c_re[2], c_im[2], z_re[2], z_im[2], count[2];
+    __m512d saved_re[2], saved_im[2];
+
+    /*  One bit per lane, set for lanes that have not escaped yet, and for    *
+     *  lanes that have been found to be periodic, respectively.              */
+    __mmask8 active[2], periodic[2];
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        c_re[k] = _mm512_loadu_pd(c_real + 8U*k);
+        c_im[k] = _mm512_loadu_pd(c_imag + 8U*k);
+        z_re[k] = f->start_at_c ? c_re[k] : zero;
+        z_im[k] = f->start_at_c ? c_im[k] : zero;
+        active[k] = 0xFFU;
+
+        /*  Per-lane iteration counters, stored as doubles.                   */
+        count[k] = zero;
+
+        saved_re[k] = z_re[k];
+        saved_im[k] = z_im[k];
+        periodic[k] = 0U;
+    }
+
+    for (iters = 0U; iters < f->max_iters; ++iters)
+    {
+        for (k = 0U; k < 2U; ++k)
+        {
+            /*  Same operations, in the same order, as the scalar iteration.  */
+            const __m512d x_sq = _mm512_mul_pd(z_re[k], z_re[k]);
+            const __m512d y_sq = _mm512_mul_pd(z_im[k], z_im[k]);
+            const __m512d next_re
+                = _mm512_add_pd(_mm512_sub_pd(x_sq, y_sq), c_re[k]);
+            const __m512d next_im = _mm512_add_pd(
+                _mm512_mul_pd(_mm512_mul_pd(two, z_re[k]), z_im[k]), c_im[k]
+            );
+            __mmask8 escaped;
+
+            /*  Lanes that already escaped keep their final value.            */
+            z_re[k] = _mm512_mask_blend_pd(active[k], z_re[k], next_re);
+            z_im[k] = _mm512_mask_blend_pd(active[k], z_im[k], next_im);
+
+            if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+            {
+                const __m512d abs_sq = _mm512_add_pd(
+                    _mm512_mul_pd(z_re[k], z_re[k]),
+                    _mm512_mul_pd(z_im[k], z_im[k])
+                );
+
+                escaped = _mm512_cmp_pd_mask(abs_sq, radius_squared,
+                                             _CMP_GT_OQ);
+            }
+            else
+                escaped = _mm512_cmp_pd_mask(_mm512_abs_pd(z_re[k]),
+                                             radius, _CMP_GE_OQ);
+
+            active[k] = (__mmask8)(active[k] & ~escaped);
+
+            /*  Active lanes that have returned to the saved value are done.  */
+            if (check_period)
+            {
+                const __m512d dx = _mm512_sub_pd(z_re[k], saved_re[k]);
+                const __m512d dy = _mm512_sub_pd(z_im[k], saved_im[k]);
+                const __mmask8 found = (__mmask8)(
+                    _mm512_mask_cmp_pd_mask(active[k], _mm512_abs_pd(dx),
+                                            tolerance, _CMP_LE_OQ) &
+                    _mm512_cmp_pd_mask(_mm512_abs_pd(dy),
+                                       tolerance, _CMP_LE_OQ)
+                );
+
+                periodic[k] = (__mmask8)(periodic[k] | found);
+                active[k] = (__mmask8)(active[k] & ~found);
+            }
+
+            /*  Lanes still active have survived another iteration.           */
+            count[k] = _mm512_mask_add_pd(count[k], active[k], count[k], one);
+        }
+
+        /*  Every lane has escaped, nothing left to do.                       */
+        if ((active[0] | active[1]) == 0U)
+            break;
+
+        /*  Save new values at powers of two, Brent's method.                 */
+        if (check_period && ++period_step == period_limit)
+        {
+            for (k = 0U; k < 2U; ++k)
+            {
+                saved_re[k] = z_re[k];
+                saved_im[k] = z_im[k];
+            }
+
+            period_step = 0U;
+            period_limit <<= 1U;
+        }
+    }
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        _mm512_storeu_pd(count_out + 8U*k, count[k]);
+        _mm512_storeu_pd(z_real_out + 8U*k, z_re[k]);
+        _mm512_storeu_pd(z_imag_out + 8U*k, z_im[k]);
+    }
+
+    for (n = 0U; n < 16U; ++n)
+    {
+        /*  Periodic points never escape, the same as running to max_iters.   */
+        if ((periodic[n >> 3U] >> (n & 7U)) & 1U)
+            out[n].iters = f->max_iters;
+        else
+            out[n].iters = (unsigned int)count_out[n];
+
+        out[n].z.real = z_real_out[n];
+        out[n].z.imag = z_imag_out[n];
+    }
+}
+
+#endif
+/*  End of #ifdef FRACTAL_HAS_X86_SIMD.                                       */
+
+/*  A kernel iterating a full vector's worth of points, 8 for AVX2 and 16 for *
+ *  AVX-512, as fractal_mandelbrot_avx2 and fractal_mandelbrot_avx512 do.     */
+typedef void
+(*fractal_simd_kernel)(const struct fractal *f, const double *c_real,
+                       const double *c_imag, struct fractal_escape *out);
+
+/*  Kernels only exist where the intrinsics do. Elsewhere they are NULL, and  *
+ *  never called since the level is always FRACTAL_SIMD_SCALAR.               */
+#ifdef FRACTAL_HAS_X86_SIMD
+#define FRACTAL_SIMD_KERNEL(kernel) (kernel)
+#else
+#define FRACTAL_SIMD_KERNEL(kernel) (NULL)
+#endif
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_points                                                   *
+ *  Purpose:                                                                  *
+ *      Iterates any number of points with a pair of vectorized kernels,      *
+ *      doing leftover points one at a time with the scalar iteration.        *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal.                                                      *
+ *      level (enum fractal_simd_level):                                      *
+ *          The kernel to use, usually fractal_simd_level().                  *
+ *      avx2 (fractal_simd_kernel):                                           *
+ *          The AVX2 kernel, 8 points at a time.                              *
+ *      avx512 (fractal_simd_kernel):                                         *
+ *          The AVX-512 kernel, 16 points at a time.                          *
+ *      iterate (fractal_iter_func):                                          *
+ *          The scalar iteration the kernels compute.                         *
+ *      c_real (const double *):                                              *
+ *          The real parts of the points.                                     *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the points.                                *
+ *      number_of_points (unsigned int):                                      *
+ *          The number of elements in c_real, c_imag, and out.                *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_simd_points(const struct fractal *f, enum fractal_simd_level level,
+                    fractal_simd_kernel avx2, fractal_simd_kernel avx512,
+                    fractal_iter_func iterate,
+                    const double *c_real, const double *c_imag,
+                    unsigned int number_of_points, struct fractal_escape *out)
+{
+    unsigned int n = 0U;
+    unsigned int width = 1U;
+    fractal_simd_kernel kernel = NULL;
+    struct fractal_complex c;
+
+    if (level == FRACTAL_SIMD_AVX512)
+    {
+        width = 16U;
+        kernel = avx512;
+    }
+
+    else if (level == FRACTAL_SIMD_AVX2)
+    {
+        width = 8U;
+        kernel = avx2;
+    }
+
+    if (kernel)
+    {
+        for (; n + width <= number_of_points; n += width)
+            kernel(f, c_real + n, c_imag + n, out + n);
+
+        /*  A few points left over still take as long as the slowest of them, *
+         *  so they are cheaper as one vector, padded with copies of the last *
+         *  point, than one at a time. The lanes do not affect one another.   */
+        if (number_of_points - n >= FRACTAL_SIMD_MIN_TAIL)
+        {
+            double tail_real[16], tail_imag[16];
+            struct fractal_escape tail[16];
+            const unsigned int number_left = number_of_points - n;
+            unsigned int k;
+
+            for (k = 0U; k < width; ++k)
+            {
+                const unsigned int index
+                    = (k < number_left ? k : number_left - 1U);
+                tail_real[k] = c_real[n + index];
+                tail_imag[k] = c_imag[n + index];
+            }
+
+            kernel(f, tail_real, tail_imag, tail);
+
+            for (k = 0U; k < number_left; ++k)
+                out[n + k] = tail[k];
+
+            return;
+        }
+    }
+
+    /*  Scalar code for whatever is left over.                                */
+    for (; n < number_of_points; ++n)
+    {
+        c.real = c_real[n];
+        c.imag = c_imag[n];
+        fractal_escape_loop(f, &c, iterate, out + n);
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_mandelbrot_points                                             *
+ *  Purpose:                                                                  *
+ *      Iterates z^2 + c for any number of points, using the fastest          *
+ *      available kernel. Leftover points are done one at a time.             *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_MANDELBROT.                  *
+ *      c_real (const double *):                                              *
+ *          The real parts of the points.                                     *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the points.                                *
+ *      number_of_points (unsigned int):                                      *
+ *          The number of elements in c_real, c_imag, and out.                *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_mandelbrot_points(const struct fractal *f, const double *c_real,
+                          const double *c_imag, unsigned int number_of_points,
+                          struct fractal_escape *out)
+{
+    fractal_simd_points(f, fractal_simd_level(),
+                        FRACTAL_SIMD_KERNEL(fractal_mandelbrot_avx2),
+                        FRACTAL_SIMD_KERNEL(fractal_mandelbrot_avx512),
+                        fractal_mandelbrot_iter, c_real, c_imag,
+                        number_of_points, out);
+}
+
+#endif
+/*  End of include guard.                                                     */
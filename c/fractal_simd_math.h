@@ -0,0 +1,968 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Vectorized exp, log, cos and sin, and atan2, for the escape-time      *
+ *      kernels of fractals that are not polynomials. Each function works on  *
+ *      a whole AVX2 or AVX-512 vector at once, using only multiplies, adds,  *
+ *      divides, and bit operations, in place of one call to libm per lane.   *
+ *  Notes:                                                                    *
+ *      This file is included by fractal.h, do not include it directly.       *
+ *                                                                            *
+ *      The results are not bit for bit those of libm, but are within one or  *
+ *      two units in the last place, see the Method of each function. No      *
+ *      fused multiply-adds are used, and the AVX2 and AVX-512 versions do    *
+ *      the same operations in the same order, so they agree exactly.         *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_SIMD_MATH_H
+#define FRACTAL_SIMD_MATH_H
+
+/*  INT64_C and INT64_MIN found here.                                         */
+#include <stdint.h>
+
+/*  1.5 * 2^52. Adding this to a double of magnitude below 2^51 rounds it to  *
+ *  the nearest integer, which is then the low bits of the sum as an integer. */
+#define FRACTAL_SIMD_ROUND_MAGIC (6755399441055744.0)
+
+/*  exp is evaluated on this range, so 2^k stays a normal double. Below it    *
+ *  the result is zero, and above it infinity.                                */
+#define FRACTAL_SIMD_EXP_MIN (-708.0)
+#define FRACTAL_SIMD_EXP_MAX (+709.0)
+
+/*  ln(2) split in two, the high part with its low 21 bits zero so k ln(2) is *
+ *  exact for every k used, and 1 / ln(2). These are the fdlibm constants.    */
+#define FRACTAL_SIMD_LN2_HI (+6.93147180369123816490E-01)
+#define FRACTAL_SIMD_LN2_LO (+1.90821492927058770002E-10)
+#define FRACTAL_SIMD_INV_LN2 (+1.44269504088896338700E+00)
+
+/*  pi / 2 split in three, each with 33 significant bits so q pi / 2 is exact *
+ *  for q below 2^20, and 2 / pi. These are the fdlibm constants.             */
+#define FRACTAL_SIMD_PIO2_1 (+1.57079632673412561417E+00)
+#define FRACTAL_SIMD_PIO2_2 (+6.07710050630396597660E-11)
+#define FRACTAL_SIMD_PIO2_3 (+2.02226624871116645580E-21)
+#define FRACTAL_SIMD_INV_PIO2 (+6.36619772367581382433E-01)
+
+/*  |y| above which cos(y) and sin(y) are left to libm. The reduction above   *
+ *  needs q < 2^20, and arguments this large are rare in the iterations.      */
+#define FRACTAL_SIMD_SINCOS_MAX (1.0E5)
+
+/*  Taylor coefficients 1/n! of exp, for n = 2 up to 13.                      */
+#define FRACTAL_SIMD_EXP_2 (5.0000000000000000000E-01)
+#define FRACTAL_SIMD_EXP_3 (1.6666666666666666574E-01)
+#define FRACTAL_SIMD_EXP_4 (4.1666666666666664354E-02)
+#define FRACTAL_SIMD_EXP_5 (8.3333333333333332177E-03)
+#define FRACTAL_SIMD_EXP_6 (1.3888888888888889419E-03)
+#define FRACTAL_SIMD_EXP_7 (1.9841269841269841253E-04)
+#define FRACTAL_SIMD_EXP_8 (2.4801587301587301566E-05)
+#define FRACTAL_SIMD_EXP_9 (2.7557319223985892511E-06)
+#define FRACTAL_SIMD_EXP_10 (2.7557319223985888276E-07)
+#define FRACTAL_SIMD_EXP_11 (2.5052108385441720224E-08)
+#define FRACTAL_SIMD_EXP_12 (2.0876756987868100187E-09)
+#define FRACTAL_SIMD_EXP_13 (1.6059043836821613341E-10)
+
+/*  Minimax coefficients for sin and cos on [-pi/4, pi/4], from the fdlibm    *
+ *  __kernel_sin and __kernel_cos. Each is within 2^-58 of the function.      */
+#define FRACTAL_SIMD_SIN_1 (-1.66666666666666324348E-01)
+#define FRACTAL_SIMD_SIN_2 (+8.33333333332248946124E-03)
+#define FRACTAL_SIMD_SIN_3 (-1.98412698298579493134E-04)
+#define FRACTAL_SIMD_SIN_4 (+2.75573137070700676789E-06)
+#define FRACTAL_SIMD_SIN_5 (-2.50507602534068634195E-08)
+#define FRACTAL_SIMD_SIN_6 (+1.58969099521155010221E-10)
+#define FRACTAL_SIMD_COS_1 (+4.16666666666666019037E-02)
+#define FRACTAL_SIMD_COS_2 (-1.38888888888741095749E-03)
+#define FRACTAL_SIMD_COS_3 (+2.48015872894767294178E-05)
+#define FRACTAL_SIMD_COS_4 (-2.75573143513906633035E-07)
+#define FRACTAL_SIMD_COS_5 (+2.08757232129817482790E-09)
+#define FRACTAL_SIMD_COS_6 (-1.13596475577881948265E-11)
+
+/*  The smallest normal double, 2^-1022, and 2^52.                            */
+#define FRACTAL_SIMD_LOG_MIN (2.2250738585072014E-308)
+#define FRACTAL_SIMD_TWO_TO_52 (4503599627370496.0)
+
+/*  The mantissa and sign bits of a double, and sqrt(2).                      */
+#define FRACTAL_SIMD_MANTISSA_BITS (INT64_C(0x000FFFFFFFFFFFFF))
+#define FRACTAL_SIMD_SIGN_BIT (INT64_MIN)
+#define FRACTAL_SIMD_SQRT_TWO (1.4142135623730951)
+
+/*  Minimax coefficients for log(1 + f) = 2 atanh(s), from the fdlibm log.    *
+ *  The polynomial is within 2^-58.45 of the function.                        */
+#define FRACTAL_SIMD_LOG_1 (+6.666666666666735130E-01)
+#define FRACTAL_SIMD_LOG_2 (+3.999999999940941908E-01)
+#define FRACTAL_SIMD_LOG_3 (+2.857142874366239149E-01)
+#define FRACTAL_SIMD_LOG_4 (+2.222219843214978396E-01)
+#define FRACTAL_SIMD_LOG_5 (+1.818357216161805012E-01)
+#define FRACTAL_SIMD_LOG_6 (+1.531383769920937332E-01)
+#define FRACTAL_SIMD_LOG_7 (+1.479819860511658591E-01)
+
+/*  Minimax coefficients for atan on [-7/16, 7/16], from the fdlibm atan.     */
+#define FRACTAL_SIMD_ATAN_0 (+3.33333333333329318027E-01)
+#define FRACTAL_SIMD_ATAN_1 (-1.99999999998764832476E-01)
+#define FRACTAL_SIMD_ATAN_2 (+1.42857142725034663711E-01)
+#define FRACTAL_SIMD_ATAN_3 (-1.11111104054623557880E-01)
+#define FRACTAL_SIMD_ATAN_4 (+9.09088713343650656196E-02)
+#define FRACTAL_SIMD_ATAN_5 (-7.69187620504482999495E-02)
+#define FRACTAL_SIMD_ATAN_6 (+6.66107313738753120669E-02)
+#define FRACTAL_SIMD_ATAN_7 (-5.83357013379057348645E-02)
+#define FRACTAL_SIMD_ATAN_8 (+4.97687799461593236017E-02)
+#define FRACTAL_SIMD_ATAN_9 (-3.65315727442169155270E-02)
+#define FRACTAL_SIMD_ATAN_10 (+1.62858201153657823623E-02)
+
+/*  atan(1/2), pi/4, pi/2, and pi, each as a double and the remainder.        */
+#define FRACTAL_SIMD_ATAN_HALF_HI (+4.63647609000806093515E-01)
+#define FRACTAL_SIMD_ATAN_HALF_LO (+2.26987774529616870924E-17)
+#define FRACTAL_SIMD_PIO4_HI (+7.85398163397448278999E-01)
+#define FRACTAL_SIMD_PIO4_LO (+3.06161699786838301793E-17)
+#define FRACTAL_SIMD_PIO2_HI (+1.57079632679489655800E+00)
+#define FRACTAL_SIMD_PIO2_LO (+6.12323399573676603587E-17)
+#define FRACTAL_SIMD_PI_HI (+3.14159265358979311600E+00)
+#define FRACTAL_SIMD_PI_LO (+1.22464679914735317723E-16)
+
+#ifdef FRACTAL_HAS_X86_SIMD
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_madd_avx2                                                *
+ *  Purpose:                                                                  *
+ *      Computes a + b x lane by lane, as a multiply and then an add, the     *
+ *      step of every polynomial below.                                       *
+ *  Arguments:                                                                *
+ *      a (__m256d):                                                          *
+ *          The constant term.                                                *
+ *      b (__m256d):                                                          *
+ *          The coefficient of x.                                             *
+ *      x (__m256d):                                                          *
+ *          The variable.                                                     *
+ *  Output:                                                                   *
+ *      a_plus_bx (__m256d):                                                  *
+ *          The value a + b x.                                                *
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static inline __m256d
+fractal_simd_madd_avx2(__m256d a, __m256d b, __m256d x)
+{
+    return _mm256_add_pd(a, _mm256_mul_pd(b, x));
+}
+
+/*  The same, for a and b constants.                                          */
+__attribute__((target("avx2")))
+static inline __m256d
+fractal_simd_linear_avx2(double a, double b, __m256d x)
+{
+    return fractal_simd_madd_avx2(_mm256_set1_pd(a), _mm256_set1_pd(b), x);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_exp_avx2                                                 *
+ *  Purpose:                                                                  *
+ *      Computes exp(x) for the 4 lanes of a vector.                          *
+ *  Arguments:                                                                *
+ *      x (__m256d):                                                          *
+ *          The exponents.                                                    *
+ *  Output:                                                                   *
+ *      exp_x (__m256d):                                                      *
+ *          exp(x), computed lane by lane.                                    *
+ *  Method:                                                                   *
+ *      Write x = k ln(2) + r with k the nearest integer to x / ln(2), so     *
+ *      that |r| <= ln(2) / 2 and exp(x) = 2^k exp(r). The product k ln(2) is *
+ *      taken away in two parts, which leaves r with an error of about one    *
+ *      unit in its last place. exp(r) is the Taylor polynomial of degree 13, *
+ *      whose truncation error is below 4.2e-18, and 2^k is built directly in *
+ *      the exponent field. Over [-708, 709] the result is within 1 unit in   *
+ *      the last place of glibc's exp. Below that it is zero, above it        *
+ *      infinity, where libm would still give a subnormal or huge number in   *
+ *      a narrow band. NaNs propagate.                                        *
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static inline __m256d
+fractal_simd_exp_avx2(__m256d x)
+{
+    const __m256d magic = _mm256_set1_pd(FRACTAL_SIMD_ROUND_MAGIC);
+    const __m256d one = _mm256_set1_pd(1.0);
+    __m256d y, t, k, r, r2, r4, p, b0, b1, b2, b3, b4, b5;
+    __m256i bits;
+
+    /*  The clamped value is taken from x, so a NaN in x is kept.             */
+    y = _mm256_max_pd(_mm256_set1_pd(FRACTAL_SIMD_EXP_MIN), x);
+    y = _mm256_min_pd(_mm256_set1_pd(FRACTAL_SIMD_EXP_MAX), y);
+
+    /*  k = round(x / ln(2)), as a double, and in the low bits of t.          */
+    t = _mm256_add_pd(
+        _mm256_mul_pd(y, _mm256_set1_pd(FRACTAL_SIMD_INV_LN2)), magic
+    );
+    k = _mm256_sub_pd(t, magic);
+
+    r = _mm256_sub_pd(
+        y, _mm256_mul_pd(k, _mm256_set1_pd(FRACTAL_SIMD_LN2_HI))
+    );
+    r = _mm256_sub_pd(
+        r, _mm256_mul_pd(k, _mm256_set1_pd(FRACTAL_SIMD_LN2_LO))
+    );
+
+    /*  The terms of degree 2 and up, over r^2, by Estrin's scheme. Horner's  *
+     *  rule would make the whole polynomial one long chain of dependent      *
+     *  multiplies and adds, where here most of them run side by side.        */
+    r2 = _mm256_mul_pd(r, r);
+    r4 = _mm256_mul_pd(r2, r2);
+    b0 = fractal_simd_linear_avx2(FRACTAL_SIMD_EXP_2,
+                                      FRACTAL_SIMD_EXP_3, r);
+    b1 = fractal_simd_linear_avx2(FRACTAL_SIMD_EXP_4,
+                                      FRACTAL_SIMD_EXP_5, r);
+    b2 = fractal_simd_linear_avx2(FRACTAL_SIMD_EXP_6,
+                                      FRACTAL_SIMD_EXP_7, r);
+    b3 = fractal_simd_linear_avx2(FRACTAL_SIMD_EXP_8,
+                                      FRACTAL_SIMD_EXP_9, r);
+    b4 = fractal_simd_linear_avx2(FRACTAL_SIMD_EXP_10,
+                                      FRACTAL_SIMD_EXP_11, r);
+    b5 = fractal_simd_linear_avx2(FRACTAL_SIMD_EXP_12,
+                                      FRACTAL_SIMD_EXP_13, r);
+    b0 = fractal_simd_madd_avx2(b0, b1, r2);
+    b2 = fractal_simd_madd_avx2(b2, b3, r2);
+    b4 = fractal_simd_madd_avx2(b4, b5, r2);
+    p = fractal_simd_madd_avx2(b2, b4, r4);
+    p = fractal_simd_madd_avx2(b0, p, r4);
+
+    /*  exp(r) = 1 + r (1 + r p), the last steps in order for accuracy.       */
+    p = fractal_simd_madd_avx2(one, p, r);
+    p = fractal_simd_madd_avx2(one, p, r);
+
+    /*  2^k has exponent field k + 1023. Shifting drops the magic bits.       */
+    bits = _mm256_add_epi64(_mm256_castpd_si256(t), _mm256_set1_epi64x(1023));
+    bits = _mm256_slli_epi64(bits, 52);
+    p = _mm256_mul_pd(p, _mm256_castsi256_pd(bits));
+
+    /*  Past the ends of the range exp(x) is taken to be zero or infinite.    */
+    p = _mm256_blendv_pd(p, _mm256_setzero_pd(), _mm256_cmp_pd(
+        x, _mm256_set1_pd(FRACTAL_SIMD_EXP_MIN), _CMP_LT_OQ
+    ));
+    return _mm256_blendv_pd(p, _mm256_set1_pd(HUGE_VAL), _mm256_cmp_pd(
+        x, _mm256_set1_pd(FRACTAL_SIMD_EXP_MAX), _CMP_GT_OQ
+    ));
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_sincos_avx2                                              *
+ *  Purpose:                                                                  *
+ *      Computes cos(y) and sin(y) together for the 4 lanes of a vector.      *
+ *  Arguments:                                                                *
+ *      y (__m256d):                                                          *
+ *          The angles.                                                       *
+ *      cos_y (__m256d *):                                                    *
+ *          Set to cos(y), computed lane by lane.                             *
+ *      sin_y (__m256d *):                                                    *
+ *          Set to sin(y), computed lane by lane.                             *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      Write y = q pi/2 + r with q the nearest integer to y / (pi/2), so     *
+ *      |r| <= pi/4. The product q pi/2 is taken away in three exact parts,   *
+ *      Cody and Waite's method, leaving r with an error of about one unit in *
+ *      its last place. sin(r) and cos(r) are the fdlibm polynomials, and the *
+ *      low two bits of q say which of them, and which signs, give sin(y) and *
+ *      cos(y). For |y| <= 1e5 both are within 2 units in the last place of   *
+ *      glibc's, or 2^-52 absolute near a zero. Lanes with a larger |y|, or   *
+ *      an infinite one, are passed to libm instead. NaNs propagate.          *
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static inline void
+fractal_simd_sincos_avx2(__m256d y, __m256d *cos_y, __m256d *sin_y)
+{
+    const __m256d magic = _mm256_set1_pd(FRACTAL_SIMD_ROUND_MAGIC);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256i one_bit = _mm256_set1_epi64x(1);
+    const __m256i two_bit = _mm256_set1_epi64x(2);
+    const __m256d abs_y = _mm256_andnot_pd(_mm256_set1_pd(-0.0), y);
+    const __m256d large = _mm256_cmp_pd(
+        abs_y, _mm256_set1_pd(FRACTAL_SIMD_SINCOS_MAX), _CMP_GT_OQ
+    );
+    __m256d t, q, r, z, z2, s, s0, s1, s2, c, c0, c1, c2, swap;
+    __m256i quadrant, sin_sign, cos_sign;
+
+    /*  q = round(y / (pi/2)), as a double, and in the low bits of t.         */
+    t = _mm256_add_pd(
+        _mm256_mul_pd(y, _mm256_set1_pd(FRACTAL_SIMD_INV_PIO2)), magic
+    );
+    q = _mm256_sub_pd(t, magic);
+    quadrant = _mm256_castpd_si256(t);
+
+    r = _mm256_sub_pd(
+        y, _mm256_mul_pd(q, _mm256_set1_pd(FRACTAL_SIMD_PIO2_1))
+    );
+    r = _mm256_sub_pd(
+        r, _mm256_mul_pd(q, _mm256_set1_pd(FRACTAL_SIMD_PIO2_2))
+    );
+    r = _mm256_sub_pd(
+        r, _mm256_mul_pd(q, _mm256_set1_pd(FRACTAL_SIMD_PIO2_3))
+    );
+
+    /*  sin(r) = r + r^3 (S1 + z S2 + ... + z^5 S6), with z = r^2, and        *
+     *  cos(r) = 1 - (z/2 - z^2 (C1 + z C2 + ... + z^5 C6)), both by Estrin's *
+     *  scheme as in fractal_simd_exp_avx2.                                   */
+    z = _mm256_mul_pd(r, r);
+    z2 = _mm256_mul_pd(z, z);
+    s0 = fractal_simd_linear_avx2(FRACTAL_SIMD_SIN_1,
+                                      FRACTAL_SIMD_SIN_2, z);
+    s1 = fractal_simd_linear_avx2(FRACTAL_SIMD_SIN_3,
+                                      FRACTAL_SIMD_SIN_4, z);
+    s2 = fractal_simd_linear_avx2(FRACTAL_SIMD_SIN_5,
+                                      FRACTAL_SIMD_SIN_6, z);
+    c0 = fractal_simd_linear_avx2(FRACTAL_SIMD_COS_1,
+                                      FRACTAL_SIMD_COS_2, z);
+    c1 = fractal_simd_linear_avx2(FRACTAL_SIMD_COS_3,
+                                      FRACTAL_SIMD_COS_4, z);
+    c2 = fractal_simd_linear_avx2(FRACTAL_SIMD_COS_5,
+                                      FRACTAL_SIMD_COS_6, z);
+
+    s = fractal_simd_madd_avx2(s1, s2, z2);
+    s = fractal_simd_madd_avx2(s0, s, z2);
+    s = fractal_simd_madd_avx2(r, _mm256_mul_pd(r, z), s);
+
+    c = fractal_simd_madd_avx2(c1, c2, z2);
+    c = fractal_simd_madd_avx2(c0, c, z2);
+    c = _mm256_sub_pd(_mm256_mul_pd(z, _mm256_set1_pd(0.5)),
+                      _mm256_mul_pd(z2, c));
+    c = _mm256_sub_pd(one, c);
+
+    /*  Odd quadrants swap sin and cos. sin(y) is negative in quadrants 2     *
+     *  and 3, and cos(y) in quadrants 1 and 2.                               */
+    swap = _mm256_castsi256_pd(
+        _mm256_cmpeq_epi64(_mm256_and_si256(quadrant, one_bit), one_bit)
+    );
+    sin_sign = _mm256_slli_epi64(_mm256_and_si256(quadrant, two_bit), 62);
+    cos_sign = _mm256_slli_epi64(
+        _mm256_and_si256(_mm256_add_epi64(quadrant, one_bit), two_bit), 62
+    );
+
+    *sin_y = _mm256_xor_pd(_mm256_blendv_pd(s, c, swap),
+                           _mm256_castsi256_pd(sin_sign));
+    *cos_y = _mm256_xor_pd(_mm256_blendv_pd(c, s, swap),
+                           _mm256_castsi256_pd(cos_sign));
+
+    /*  Rare, so the lanes are simply patched one at a time.                  */
+    if (_mm256_movemask_pd(large))
+    {
+        double angle[4], cos_out[4], sin_out[4];
+        const int lanes = _mm256_movemask_pd(large);
+        unsigned int n;
+
+        _mm256_storeu_pd(angle, y);
+        _mm256_storeu_pd(cos_out, *cos_y);
+        _mm256_storeu_pd(sin_out, *sin_y);
+
+        for (n = 0U; n < 4U; ++n)
+        {
+            if (lanes & (1 << n))
+            {
+                cos_out[n] = cos(angle[n]);
+                sin_out[n] = sin(angle[n]);
+            }
+        }
+
+        *cos_y = _mm256_loadu_pd(cos_out);
+        *sin_y = _mm256_loadu_pd(sin_out);
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_log_avx2                                                 *
+ *  Purpose:                                                                  *
+ *      Computes log(x) for the 4 lanes of a vector.                          *
+ *  Arguments:                                                                *
+ *      x (__m256d):                                                          *
+ *          The arguments, none of them negative.                             *
+ *  Output:                                                                   *
+ *      log_x (__m256d):                                                      *
+ *          log(x), computed lane by lane.                                    *
+ *  Method:                                                                   *
+ *      Write x = 2^k m with sqrt(2)/2 < m <= sqrt(2), reading k and m        *
+ *      straight from the bits, so f = m - 1 is exact and small. With         *
+ *      s = f / (2 + f), log(1 + f) = 2 atanh(s) = f - f^2/2 + s (f^2/2 + R), *
+ *      where R is the fdlibm minimax polynomial in s^2, and then             *
+ *      log(x) = k ln(2) + log(1 + f), with ln(2) in two parts. The result is *
+ *      within 1 unit in the last place of glibc's log. Zero and subnormals   *
+ *      are taken as 2^-1022, giving -708.4 rather than -inf or a little      *
+ *      less. Infinities and NaNs are passed through.                         *
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static inline __m256d
+fractal_simd_log_avx2(__m256d x)
+{
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    __m256d y, m, k, f, s, z, w, t1, t2, hfsq, log_x, large;
+    __m256i bits;
+
+    /*  Zero and subnormals are raised to the smallest normal double.         */
+    y = _mm256_max_pd(_mm256_set1_pd(FRACTAL_SIMD_LOG_MIN), x);
+
+    /*  The mantissa as a double in [1, 2), and the exponent, by putting the  *
+     *  exponent field in the mantissa of 2^52 and taking 2^52 + 1023 away.   */
+    bits = _mm256_castpd_si256(y);
+    m = _mm256_castsi256_pd(_mm256_or_si256(
+        _mm256_and_si256(bits, _mm256_set1_epi64x(FRACTAL_SIMD_MANTISSA_BITS)),
+        _mm256_castpd_si256(one)
+    ));
+    k = _mm256_castsi256_pd(_mm256_or_si256(
+        _mm256_srli_epi64(bits, 52), _mm256_castpd_si256(
+            _mm256_set1_pd(FRACTAL_SIMD_TWO_TO_52)
+        )
+    ));
+    k = _mm256_sub_pd(k, _mm256_set1_pd(FRACTAL_SIMD_TWO_TO_52 + 1023.0));
+
+    /*  Halve mantissas above sqrt(2), moving them to the next exponent.      */
+    large = _mm256_cmp_pd(m, _mm256_set1_pd(FRACTAL_SIMD_SQRT_TWO), _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, half), large);
+    k = _mm256_add_pd(k, _mm256_and_pd(large, one));
+
+    f = _mm256_sub_pd(m, one);
+    s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.0), f));
+    z = _mm256_mul_pd(s, s);
+    w = _mm256_mul_pd(z, z);
+
+    /*  R = t1 + t2, the even and odd powers of w as two shorter chains.      */
+    t1 = fractal_simd_linear_avx2(FRACTAL_SIMD_LOG_4, FRACTAL_SIMD_LOG_6, w);
+    t1 = fractal_simd_madd_avx2(_mm256_set1_pd(FRACTAL_SIMD_LOG_2), t1, w);
+    t1 = _mm256_mul_pd(w, t1);
+    t2 = fractal_simd_linear_avx2(FRACTAL_SIMD_LOG_5, FRACTAL_SIMD_LOG_7, w);
+    t2 = fractal_simd_madd_avx2(_mm256_set1_pd(FRACTAL_SIMD_LOG_3), t2, w);
+    t2 = fractal_simd_madd_avx2(_mm256_set1_pd(FRACTAL_SIMD_LOG_1), t2, w);
+    t2 = _mm256_mul_pd(z, t2);
+    hfsq = _mm256_mul_pd(_mm256_mul_pd(half, f), f);
+
+    /*  k ln2_hi - ((hfsq - (s (hfsq + R) + k ln2_lo)) - f), as in fdlibm.    */
+    log_x = _mm256_add_pd(
+        _mm256_mul_pd(s, _mm256_add_pd(hfsq, _mm256_add_pd(t2, t1))),
+        _mm256_mul_pd(k, _mm256_set1_pd(FRACTAL_SIMD_LN2_LO))
+    );
+    log_x = _mm256_sub_pd(_mm256_sub_pd(hfsq, log_x), f);
+    log_x = _mm256_sub_pd(
+        _mm256_mul_pd(k, _mm256_set1_pd(FRACTAL_SIMD_LN2_HI)), log_x
+    );
+
+    /*  Infinities and NaNs are their own logs.                               */
+    return _mm256_blendv_pd(
+        log_x, x, _mm256_cmp_pd(x, _mm256_set1_pd(HUGE_VAL), _CMP_EQ_UQ)
+    );
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_atan2_avx2                                               *
+ *  Purpose:                                                                  *
+ *      Computes atan2(y, x), the argument of x + iy, for the 4 lanes of a    *
+ *      vector.                                                               *
+ *  Arguments:                                                                *
+ *      y (__m256d):                                                          *
+ *          The imaginary parts.                                              *
+ *      x (__m256d):                                                          *
+ *          The real parts.                                                   *
+ *  Output:                                                                   *
+ *      angle (__m256d):                                                      *
+ *          atan2(y, x), computed lane by lane, in [-pi, pi].                 *
+ *  Method:                                                                   *
+ *      With a the smaller of |x| and |y| and b the larger, atan(a / b) is in *
+ *      [0, pi/4]. Past 7/16 and 11/16 it is written as atan(1/2) or atan(1)  *
+ *      plus atan of (2a - b) / (2b + a) or (a - b) / (a + b), whose          *
+ *      numerators are exact, leaving a single division and an argument t     *
+ *      with |t| <= 7/16 for the fdlibm minimax polynomial. The angle is then *
+ *      reflected about pi/4 if |y| > |x|, about pi/2 if x is negative, and   *
+ *      takes the sign of y. The result is within 2 units in the last place   *
+ *      of glibc's atan2, and signed zeros are handled as there. NaNs         *
+ *      propagate, but two infinite parts give NaN rather than a multiple of  *
+ *      pi/4.                                                                 *
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static inline __m256d
+fractal_simd_atan2_avx2(__m256d y, __m256d x)
+{
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    const __m256d abs_x = _mm256_andnot_pd(sign_bit, x);
+    const __m256d abs_y = _mm256_andnot_pd(sign_bit, y);
+    const __m256d a = _mm256_min_pd(abs_x, abs_y);
+    const __m256d b = _mm256_max_pd(abs_x, abs_y);
+    const __m256d middle = _mm256_cmp_pd(
+        a, _mm256_mul_pd(b, _mm256_set1_pd(0.4375)), _CMP_GT_OQ
+    );
+    const __m256d upper = _mm256_cmp_pd(
+        a, _mm256_mul_pd(b, _mm256_set1_pd(0.6875)), _CMP_GT_OQ
+    );
+    __m256d num, den, hi, lo, t, z, w, s1, s2, angle;
+
+    /*  The reduced argument t = num / den, and atan(a / b) = hi + atan(t).   */
+    num = _mm256_blendv_pd(a, _mm256_sub_pd(_mm256_add_pd(a, a), b), middle);
+    num = _mm256_blendv_pd(num, _mm256_sub_pd(a, b), upper);
+    den = _mm256_blendv_pd(b, _mm256_add_pd(_mm256_add_pd(b, b), a), middle);
+    den = _mm256_blendv_pd(den, _mm256_add_pd(a, b), upper);
+    hi = _mm256_and_pd(middle, _mm256_set1_pd(FRACTAL_SIMD_ATAN_HALF_HI));
+    hi = _mm256_blendv_pd(hi, _mm256_set1_pd(FRACTAL_SIMD_PIO4_HI), upper);
+    lo = _mm256_and_pd(middle, _mm256_set1_pd(FRACTAL_SIMD_ATAN_HALF_LO));
+    lo = _mm256_blendv_pd(lo, _mm256_set1_pd(FRACTAL_SIMD_PIO4_LO), upper);
+
+    /*  x = y = 0 gives 0 / 2^-1022, and an angle of zero.                    */
+    den = _mm256_max_pd(_mm256_set1_pd(FRACTAL_SIMD_LOG_MIN), den);
+    t = _mm256_div_pd(num, den);
+    z = _mm256_mul_pd(t, t);
+    w = _mm256_mul_pd(z, z);
+
+    /*  atan(t) = t - t (s1 + s2), the odd and even coefficients in w.        */
+    s1 = fractal_simd_linear_avx2(FRACTAL_SIMD_ATAN_8, FRACTAL_SIMD_ATAN_10, w);
+    s1 = fractal_simd_madd_avx2(_mm256_set1_pd(FRACTAL_SIMD_ATAN_6), s1, w);
+    s1 = fractal_simd_madd_avx2(_mm256_set1_pd(FRACTAL_SIMD_ATAN_4), s1, w);
+    s1 = fractal_simd_madd_avx2(_mm256_set1_pd(FRACTAL_SIMD_ATAN_2), s1, w);
+    s1 = fractal_simd_madd_avx2(_mm256_set1_pd(FRACTAL_SIMD_ATAN_0), s1, w);
+    s1 = _mm256_mul_pd(z, s1);
+    s2 = fractal_simd_linear_avx2(FRACTAL_SIMD_ATAN_7, FRACTAL_SIMD_ATAN_9, w);
+    s2 = fractal_simd_madd_avx2(_mm256_set1_pd(FRACTAL_SIMD_ATAN_5), s2, w);
+    s2 = fractal_simd_madd_avx2(_mm256_set1_pd(FRACTAL_SIMD_ATAN_3), s2, w);
+    s2 = fractal_simd_madd_avx2(_mm256_set1_pd(FRACTAL_SIMD_ATAN_1), s2, w);
+    s2 = _mm256_mul_pd(w, s2);
+
+    /*  hi - ((t (s1 + s2) - lo) - t), as in fdlibm.                          */
+    angle = _mm256_sub_pd(_mm256_mul_pd(t, _mm256_add_pd(s1, s2)), lo);
+    angle = _mm256_sub_pd(hi, _mm256_sub_pd(angle, t));
+
+    /*  atan(|y| / |x|) = pi/2 - atan(|x| / |y|).                             */
+    angle = _mm256_blendv_pd(angle, _mm256_add_pd(
+        _mm256_sub_pd(_mm256_set1_pd(FRACTAL_SIMD_PIO2_HI), angle),
+        _mm256_set1_pd(FRACTAL_SIMD_PIO2_LO)
+    ), _mm256_cmp_pd(abs_y, abs_x, _CMP_GT_OQ));
+
+    /*  The left half plane, picked by the sign bit of x so -0 counts too.    */
+    angle = _mm256_blendv_pd(angle, _mm256_add_pd(
+        _mm256_sub_pd(_mm256_set1_pd(FRACTAL_SIMD_PI_HI), angle),
+        _mm256_set1_pd(FRACTAL_SIMD_PI_LO)
+    ), x);
+
+    angle = _mm256_or_pd(angle, _mm256_and_pd(sign_bit, y));
+    return _mm256_blendv_pd(angle, _mm256_add_pd(x, y),
+                            _mm256_cmp_pd(x, y, _CMP_UNORD_Q));
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_madd_avx512                                              *
+ *  Purpose:                                                                  *
+ *      The same as fractal_simd_madd_avx2.                                   *
+ *  Arguments:                                                                *
+ *      a (__m512d):                                                          *
+ *          The constant term.                                                *
+ *      b (__m512d):                                                          *
+ *          The coefficient of x.                                             *
+ *      x (__m512d):                                                          *
+ *          The variable.                                                     *
+ *  Output:                                                                   *
+ *      a_plus_bx (__m512d):                                                  *
+ *          The value a + b x.                                                *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline __m512d
+fractal_simd_madd_avx512(__m512d a, __m512d b, __m512d x)
+{
+    return _mm512_add_pd(a, _mm512_mul_pd(b, x));
+}
+
+/*  The same, for a and b constants.                                          */
+FRACTAL_AVX512_TARGET
+static inline __m512d
+fractal_simd_linear_avx512(double a, double b, __m512d x)
+{
+    return fractal_simd_madd_avx512(_mm512_set1_pd(a),
+                                        _mm512_set1_pd(b), x);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_exp_avx512                                               *
+ *  Purpose:                                                                  *
+ *      Computes exp(x) for the 8 lanes of a vector.                          *
+ *  Arguments:                                                                *
+ *      x (__m512d):                                                          *
+ *          The exponents.                                                    *
+ *  Output:                                                                   *
+ *      exp_x (__m512d):                                                      *
+ *          exp(x), computed lane by lane.                                    *
+ *  Method:                                                                   *
+ *      The same as fractal_simd_exp_avx2, step for step.                     *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline __m512d
+fractal_simd_exp_avx512(__m512d x)
+{
+    const __m512d magic = _mm512_set1_pd(FRACTAL_SIMD_ROUND_MAGIC);
+    const __m512d one = _mm512_set1_pd(1.0);
+    __m512d y, t, k, r, r2, r4, p, b0, b1, b2, b3, b4, b5;
+    __m512i bits;
+
+    /*  The clamped value is taken from x, so a NaN in x is kept.             */
+    y = _mm512_max_pd(_mm512_set1_pd(FRACTAL_SIMD_EXP_MIN), x);
+    y = _mm512_min_pd(_mm512_set1_pd(FRACTAL_SIMD_EXP_MAX), y);
+
+    /*  k = round(x / ln(2)), as a double, and in the low bits of t.          */
+    t = _mm512_add_pd(
+        _mm512_mul_pd(y, _mm512_set1_pd(FRACTAL_SIMD_INV_LN2)), magic
+    );
+    k = _mm512_sub_pd(t, magic);
+
+    r = _mm512_sub_pd(
+        y, _mm512_mul_pd(k, _mm512_set1_pd(FRACTAL_SIMD_LN2_HI))
+    );
+    r = _mm512_sub_pd(
+        r, _mm512_mul_pd(k, _mm512_set1_pd(FRACTAL_SIMD_LN2_LO))
+    );
+
+    /*  The terms of degree 2 and up, over r^2, by Estrin's scheme. Horner's  *
+     *  rule would make the whole polynomial one long chain of dependent      *
+     *  multiplies and adds, where here most of them run side by side.        */
+    r2 = _mm512_mul_pd(r, r);
+    r4 = _mm512_mul_pd(r2, r2);
+    b0 = fractal_simd_linear_avx512(FRACTAL_SIMD_EXP_2,
+                                      FRACTAL_SIMD_EXP_3, r);
+    b1 = fractal_simd_linear_avx512(FRACTAL_SIMD_EXP_4,
+                                      FRACTAL_SIMD_EXP_5, r);
+    b2 = fractal_simd_linear_avx512(FRACTAL_SIMD_EXP_6,
+                                      FRACTAL_SIMD_EXP_7, r);
+    b3 = fractal_simd_linear_avx512(FRACTAL_SIMD_EXP_8,
+                                      FRACTAL_SIMD_EXP_9, r);
+    b4 = fractal_simd_linear_avx512(FRACTAL_SIMD_EXP_10,
+                                      FRACTAL_SIMD_EXP_11, r);
+    b5 = fractal_simd_linear_avx512(FRACTAL_SIMD_EXP_12,
+                                      FRACTAL_SIMD_EXP_13, r);
+    b0 = fractal_simd_madd_avx512(b0, b1, r2);
+    b2 = fractal_simd_madd_avx512(b2, b3, r2);
+    b4 = fractal_simd_madd_avx512(b4, b5, r2);
+    p = fractal_simd_madd_avx512(b2, b4, r4);
+    p = fractal_simd_madd_avx512(b0, p, r4);
+
+    /*  exp(r) = 1 + r (1 + r p), the last steps in order for accuracy.       */
+    p = fractal_simd_madd_avx512(one, p, r);
+    p = fractal_simd_madd_avx512(one, p, r);
+
+    /*  2^k has exponent field k + 1023. Shifting drops the magic bits.       */
+    bits = _mm512_add_epi64(_mm512_castpd_si512(t), _mm512_set1_epi64(1023));
+    bits = _mm512_slli_epi64(bits, 52);
+    p = _mm512_mul_pd(p, _mm512_castsi512_pd(bits));
+
+    /*  Past the ends of the range exp(x) is taken to be zero or infinite.    */
+    p = _mm512_mask_blend_pd(_mm512_cmp_pd_mask(
+        x, _mm512_set1_pd(FRACTAL_SIMD_EXP_MIN), _CMP_LT_OQ
+    ), p, _mm512_setzero_pd());
+    return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(
+        x, _mm512_set1_pd(FRACTAL_SIMD_EXP_MAX), _CMP_GT_OQ
+    ), p, _mm512_set1_pd(HUGE_VAL));
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_sincos_avx512                                            *
+ *  Purpose:                                                                  *
+ *      Computes cos(y) and sin(y) together for the 8 lanes of a vector.      *
+ *  Arguments:                                                                *
+ *      y (__m512d):                                                          *
+ *          The angles.                                                       *
+ *      cos_y (__m512d *):                                                    *
+ *          Set to cos(y), computed lane by lane.                             *
+ *      sin_y (__m512d *):                                                    *
+ *          Set to sin(y), computed lane by lane.                             *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Method:                                                                   *
+ *      The same as fractal_simd_sincos_avx2, step for step.                  *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_simd_sincos_avx512(__m512d y, __m512d *cos_y, __m512d *sin_y)
+{
+    const __m512d magic = _mm512_set1_pd(FRACTAL_SIMD_ROUND_MAGIC);
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512i one_bit = _mm512_set1_epi64(1);
+    const __m512i two_bit = _mm512_set1_epi64(2);
+    const __mmask8 large = _mm512_cmp_pd_mask(
+        _mm512_abs_pd(y), _mm512_set1_pd(FRACTAL_SIMD_SINCOS_MAX),
+        _CMP_GT_OQ
+    );
+    __m512d t, q, r, z, z2, s, s0, s1, s2, c, c0, c1, c2;
+    __m512i quadrant, sin_sign, cos_sign;
+    __mmask8 swap;
+
+    /*  q = round(y / (pi/2)), as a double, and in the low bits of t.         */
+    t = _mm512_add_pd(
+        _mm512_mul_pd(y, _mm512_set1_pd(FRACTAL_SIMD_INV_PIO2)), magic
+    );
+    q = _mm512_sub_pd(t, magic);
+    quadrant = _mm512_castpd_si512(t);
+
+    r = _mm512_sub_pd(
+        y, _mm512_mul_pd(q, _mm512_set1_pd(FRACTAL_SIMD_PIO2_1))
+    );
+    r = _mm512_sub_pd(
+        r, _mm512_mul_pd(q, _mm512_set1_pd(FRACTAL_SIMD_PIO2_2))
+    );
+    r = _mm512_sub_pd(
+        r, _mm512_mul_pd(q, _mm512_set1_pd(FRACTAL_SIMD_PIO2_3))
+    );
+
+    /*  sin(r) = r + r^3 (S1 + z S2 + ... + z^5 S6), with z = r^2, and        *
+     *  cos(r) = 1 - (z/2 - z^2 (C1 + z C2 + ... + z^5 C6)), both by Estrin's *
+     *  scheme as in fractal_simd_exp_avx512.                                 */
+    z = _mm512_mul_pd(r, r);
+    z2 = _mm512_mul_pd(z, z);
+    s0 = fractal_simd_linear_avx512(FRACTAL_SIMD_SIN_1,
+                                      FRACTAL_SIMD_SIN_2, z);
+    s1 = fractal_simd_linear_avx512(FRACTAL_SIMD_SIN_3,
+                                      FRACTAL_SIMD_SIN_4, z);
+    s2 = fractal_simd_linear_avx512(FRACTAL_SIMD_SIN_5,
+                                      FRACTAL_SIMD_SIN_6, z);
+    c0 = fractal_simd_linear_avx512(FRACTAL_SIMD_COS_1,
+                                      FRACTAL_SIMD_COS_2, z);
+    c1 = fractal_simd_linear_avx512(FRACTAL_SIMD_COS_3,
+                                      FRACTAL_SIMD_COS_4, z);
+    c2 = fractal_simd_linear_avx512(FRACTAL_SIMD_COS_5,
+                                      FRACTAL_SIMD_COS_6, z);
+
+    s = fractal_simd_madd_avx512(s1, s2, z2);
+    s = fractal_simd_madd_avx512(s0, s, z2);
+    s = fractal_simd_madd_avx512(r, _mm512_mul_pd(r, z), s);
+
+    c = fractal_simd_madd_avx512(c1, c2, z2);
+    c = fractal_simd_madd_avx512(c0, c, z2);
+    c = _mm512_sub_pd(_mm512_mul_pd(z, _mm512_set1_pd(0.5)),
+                      _mm512_mul_pd(z2, c));
+    c = _mm512_sub_pd(one, c);
+
+    /*  The quadrant picks sin or cos and the signs, as in the AVX2 version.  */
+    swap = _mm512_test_epi64_mask(quadrant, one_bit);
+    sin_sign = _mm512_slli_epi64(_mm512_and_si512(quadrant, two_bit), 62);
+    cos_sign = _mm512_slli_epi64(
+        _mm512_and_si512(_mm512_add_epi64(quadrant, one_bit), two_bit), 62
+    );
+
+    *sin_y = _mm512_castsi512_pd(_mm512_xor_si512(
+        _mm512_castpd_si512(_mm512_mask_blend_pd(swap, s, c)), sin_sign
+    ));
+    *cos_y = _mm512_castsi512_pd(_mm512_xor_si512(
+        _mm512_castpd_si512(_mm512_mask_blend_pd(swap, c, s)), cos_sign
+    ));
+
+    /*  Rare, so the lanes are simply patched one at a time.                  */
+    if (large)
+    {
+        double angle[8], cos_out[8], sin_out[8];
+        unsigned int n;
+
+        _mm512_storeu_pd(angle, y);
+        _mm512_storeu_pd(cos_out, *cos_y);
+        _mm512_storeu_pd(sin_out, *sin_y);
+
+        for (n = 0U; n < 8U; ++n)
+        {
+            if ((large >> n) & 1U)
+            {
+                cos_out[n] = cos(angle[n]);
+                sin_out[n] = sin(angle[n]);
+            }
+        }
+
+        *cos_y = _mm512_loadu_pd(cos_out);
+        *sin_y = _mm512_loadu_pd(sin_out);
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_log_avx512                                               *
+ *  Purpose:                                                                  *
+ *      Computes log(x) for the 8 lanes of a vector.                          *
+ *  Arguments:                                                                *
+ *      x (__m512d):                                                          *
+ *          The arguments, none of them negative.                             *
+ *  Output:                                                                   *
+ *      log_x (__m512d):                                                      *
+ *          log(x), computed lane by lane.                                    *
+ *  Method:                                                                   *
+ *      The same as fractal_simd_log_avx2, step for step.                     *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline __m512d
+fractal_simd_log_avx512(__m512d x)
+{
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d half = _mm512_set1_pd(0.5);
+    __m512d y, m, k, f, s, z, w, t1, t2, hfsq, log_x;
+    __m512i bits;
+    __mmask8 large;
+
+    /*  Zero and subnormals are raised to the smallest normal double.         */
+    y = _mm512_max_pd(_mm512_set1_pd(FRACTAL_SIMD_LOG_MIN), x);
+
+    /*  The mantissa and the exponent, as in fractal_simd_log_avx2.           */
+    bits = _mm512_castpd_si512(y);
+    m = _mm512_castsi512_pd(_mm512_or_si512(
+        _mm512_and_si512(bits, _mm512_set1_epi64(FRACTAL_SIMD_MANTISSA_BITS)),
+        _mm512_castpd_si512(one)
+    ));
+    k = _mm512_castsi512_pd(_mm512_or_si512(
+        _mm512_srli_epi64(bits, 52), _mm512_castpd_si512(
+            _mm512_set1_pd(FRACTAL_SIMD_TWO_TO_52)
+        )
+    ));
+    k = _mm512_sub_pd(k, _mm512_set1_pd(FRACTAL_SIMD_TWO_TO_52 + 1023.0));
+
+    /*  Halve mantissas above sqrt(2), moving them to the next exponent.      */
+    large = _mm512_cmp_pd_mask(m, _mm512_set1_pd(FRACTAL_SIMD_SQRT_TWO),
+                               _CMP_GT_OQ);
+    m = _mm512_mask_mul_pd(m, large, m, half);
+    k = _mm512_mask_add_pd(k, large, k, one);
+
+    f = _mm512_sub_pd(m, one);
+    s = _mm512_div_pd(f, _mm512_add_pd(_mm512_set1_pd(2.0), f));
+    z = _mm512_mul_pd(s, s);
+    w = _mm512_mul_pd(z, z);
+
+    /*  R = t1 + t2, the even and odd powers of w as two shorter chains.      */
+    t1 = fractal_simd_linear_avx512(FRACTAL_SIMD_LOG_4, FRACTAL_SIMD_LOG_6, w);
+    t1 = fractal_simd_madd_avx512(_mm512_set1_pd(FRACTAL_SIMD_LOG_2), t1, w);
+    t1 = _mm512_mul_pd(w, t1);
+    t2 = fractal_simd_linear_avx512(FRACTAL_SIMD_LOG_5, FRACTAL_SIMD_LOG_7, w);
+    t2 = fractal_simd_madd_avx512(_mm512_set1_pd(FRACTAL_SIMD_LOG_3), t2, w);
+    t2 = fractal_simd_madd_avx512(_mm512_set1_pd(FRACTAL_SIMD_LOG_1), t2, w);
+    t2 = _mm512_mul_pd(z, t2);
+    hfsq = _mm512_mul_pd(_mm512_mul_pd(half, f), f);
+
+    /*  k ln2_hi - ((hfsq - (s (hfsq + R) + k ln2_lo)) - f), as in fdlibm.    */
+    log_x = _mm512_add_pd(
+        _mm512_mul_pd(s, _mm512_add_pd(hfsq, _mm512_add_pd(t2, t1))),
+        _mm512_mul_pd(k, _mm512_set1_pd(FRACTAL_SIMD_LN2_LO))
+    );
+    log_x = _mm512_sub_pd(_mm512_sub_pd(hfsq, log_x), f);
+    log_x = _mm512_sub_pd(
+        _mm512_mul_pd(k, _mm512_set1_pd(FRACTAL_SIMD_LN2_HI)), log_x
+    );
+
+    /*  Infinities and NaNs are their own logs.                               */
+    return _mm512_mask_blend_pd(
+        _mm512_cmp_pd_mask(x, _mm512_set1_pd(HUGE_VAL), _CMP_EQ_UQ), log_x, x
+    );
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_simd_atan2_avx512                                             *
+ *  Purpose:                                                                  *
+ *      Computes atan2(y, x), the argument of x + iy, for the 8 lanes of a    *
+ *      vector.                                                               *
+ *  Arguments:                                                                *
+ *      y (__m512d):                                                          *
+ *          The imaginary parts.                                              *
+ *      x (__m512d):                                                          *
+ *          The real parts.                                                   *
+ *  Output:                                                                   *
+ *      angle (__m512d):                                                      *
+ *          atan2(y, x), computed lane by lane, in [-pi, pi].                 *
+ *  Method:                                                                   *
+ *      The same as fractal_simd_atan2_avx2, step for step.                   *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline __m512d
+fractal_simd_atan2_avx512(__m512d y, __m512d x)
+{
+    const __m512i sign_bit = _mm512_set1_epi64(FRACTAL_SIMD_SIGN_BIT);
+    const __m512d abs_x = _mm512_abs_pd(x);
+    const __m512d abs_y = _mm512_abs_pd(y);
+    const __m512d a = _mm512_min_pd(abs_x, abs_y);
+    const __m512d b = _mm512_max_pd(abs_x, abs_y);
+    const __mmask8 middle = _mm512_cmp_pd_mask(
+        a, _mm512_mul_pd(b, _mm512_set1_pd(0.4375)), _CMP_GT_OQ
+    );
+    const __mmask8 upper = _mm512_cmp_pd_mask(
+        a, _mm512_mul_pd(b, _mm512_set1_pd(0.6875)), _CMP_GT_OQ
+    );
+    __m512d num, den, hi, lo, t, z, w, s1, s2, angle;
+
+    /*  The reduced argument t = num / den, and atan(a / b) = hi + atan(t).   */
+    num = _mm512_mask_blend_pd(middle, a,
+                               _mm512_sub_pd(_mm512_add_pd(a, a), b));
+    num = _mm512_mask_blend_pd(upper, num, _mm512_sub_pd(a, b));
+    den = _mm512_mask_blend_pd(middle, b,
+                               _mm512_add_pd(_mm512_add_pd(b, b), a));
+    den = _mm512_mask_blend_pd(upper, den, _mm512_add_pd(a, b));
+    hi = _mm512_maskz_mov_pd(middle,
+                             _mm512_set1_pd(FRACTAL_SIMD_ATAN_HALF_HI));
+    hi = _mm512_mask_blend_pd(upper, hi, _mm512_set1_pd(FRACTAL_SIMD_PIO4_HI));
+    lo = _mm512_maskz_mov_pd(middle,
+                             _mm512_set1_pd(FRACTAL_SIMD_ATAN_HALF_LO));
+    lo = _mm512_mask_blend_pd(upper, lo, _mm512_set1_pd(FRACTAL_SIMD_PIO4_LO));
+
+    /*  x = y = 0 gives 0 / 2^-1022, and an angle of zero.                    */
+    den = _mm512_max_pd(_mm512_set1_pd(FRACTAL_SIMD_LOG_MIN), den);
+    t = _mm512_div_pd(num, den);
+    z = _mm512_mul_pd(t, t);
+    w = _mm512_mul_pd(z, z);
+
+    /*  atan(t) = t - t (s1 + s2), the odd and even coefficients in w.        */
+    s1 = fractal_simd_linear_avx512(FRACTAL_SIMD_ATAN_8,
+                                    FRACTAL_SIMD_ATAN_10, w);
+    s1 = fractal_simd_madd_avx512(_mm512_set1_pd(FRACTAL_SIMD_ATAN_6), s1, w);
+    s1 = fractal_simd_madd_avx512(_mm512_set1_pd(FRACTAL_SIMD_ATAN_4), s1, w);
+    s1 = fractal_simd_madd_avx512(_mm512_set1_pd(FRACTAL_SIMD_ATAN_2), s1, w);
+    s1 = fractal_simd_madd_avx512(_mm512_set1_pd(FRACTAL_SIMD_ATAN_0), s1, w);
+    s1 = _mm512_mul_pd(z, s1);
+    s2 = fractal_simd_linear_avx512(FRACTAL_SIMD_ATAN_7,
+                                    FRACTAL_SIMD_ATAN_9, w);
+    s2 = fractal_simd_madd_avx512(_mm512_set1_pd(FRACTAL_SIMD_ATAN_5), s2, w);
+    s2 = fractal_simd_madd_avx512(_mm512_set1_pd(FRACTAL_SIMD_ATAN_3), s2, w);
+    s2 = fractal_simd_madd_avx512(_mm512_set1_pd(FRACTAL_SIMD_ATAN_1), s2, w);
+    s2 = _mm512_mul_pd(w, s2);
+
+    /*  hi - ((t (s1 + s2) - lo) - t), as in fdlibm.                          */
+    angle = _mm512_sub_pd(_mm512_mul_pd(t, _mm512_add_pd(s1, s2)), lo);
+    angle = _mm512_sub_pd(hi, _mm512_sub_pd(angle, t));
+
+    /*  atan(|y| / |x|) = pi/2 - atan(|x| / |y|).                             */
+    angle = _mm512_mask_blend_pd(
+        _mm512_cmp_pd_mask(abs_y, abs_x, _CMP_GT_OQ), angle, _mm512_add_pd(
+            _mm512_sub_pd(_mm512_set1_pd(FRACTAL_SIMD_PIO2_HI), angle),
+            _mm512_set1_pd(FRACTAL_SIMD_PIO2_LO)
+        )
+    );
+
+    /*  The left half plane, picked by the sign bit of x so -0 counts too.    */
+    angle = _mm512_mask_blend_pd(
+        _mm512_test_epi64_mask(_mm512_castpd_si512(x), sign_bit), angle,
+        _mm512_add_pd(
+            _mm512_sub_pd(_mm512_set1_pd(FRACTAL_SIMD_PI_HI), angle),
+            _mm512_set1_pd(FRACTAL_SIMD_PI_LO)
+        )
+    );
+
+    angle = _mm512_castsi512_pd(_mm512_or_si512(
+        _mm512_castpd_si512(angle),
+        _mm512_and_si512(_mm512_castpd_si512(y), sign_bit)
+    ));
+    return _mm512_mask_blend_pd(_mm512_cmp_pd_mask(x, y, _CMP_UNORD_Q),
+                                angle, _mm512_add_pd(x, y));
+}
+
+#endif
+/*  End of #ifdef FRACTAL_HAS_X86_SIMD.                                       */
+
+#endif
+/*  End of include guard.                                                     */
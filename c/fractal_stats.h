@@ -0,0 +1,385 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Counters and timers for finding where the time goes, compiled in by   *
+ *      defining FRACTAL_STATS, for example with gcc -DFRACTAL_STATS. The     *
+ *      renderers then count the points they iterate, how many escaped and    *
+ *      how many reached max_iters, and the iterations this took. The thread  *
+ *      pools time how long each worker is busy, and the animator times the   *
+ *      drawing of each frame and the three parts of writing it to the GIF:   *
+ *      making the palette (GifMakePalette), mapping the frame onto it        *
+ *      (GifDitherImage or GifThresholdImage), and compressing it (LZW). The  *
+ *      programs print a summary when done, and the GIF programs save the     *
+ *      times of every frame as CSV with --stats FILE.                        *
+ *                                                                            *
+ *      Without FRACTAL_STATS every function here is empty, or returns zero,  *
+ *      and nothing is left of the calls once inlined.                        *
+ *  Notes:                                                                    *
+ *      This file is included by fractal.h, do not include it directly.       *
+ *                                                                            *
+ *      The iterations are those of the results, iters, for every point. For  *
+ *      perturbation this includes the iterations skipped by the series, and  *
+ *      points caught by the period check count as max_iters.                 *
+ *                                                                            *
+ *      The timers use the POSIX clock_gettime. With -std=c99 define          *
+ *      _POSIX_C_SOURCE=200809L as well, the GNU dialects need nothing more.  *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_STATS_H
+#define FRACTAL_STATS_H
+
+/*  printf and the FILE functions found here.                                 */
+#include <stdio.h>
+
+#ifdef FRACTAL_STATS
+
+/*  Counters shared by the threads found here.                                */
+#include <stdatomic.h>
+
+/*  malloc, calloc, and free found here.                                      */
+#include <stdlib.h>
+
+/*  clock_gettime found here.                                                 */
+#include <time.h>
+
+/*  Workers timed, the same as FRACTAL_MAX_THREADS.                           */
+#define FRACTAL_STATS_MAX_WORKERS (1024U)
+
+/*  Times for one frame of an animation, in seconds.                          */
+struct fractal_stats_frame {
+
+    /*  The worker that drew the frame.                                       */
+    unsigned int worker;
+
+    /*  Drawing the frame, and the three parts of writing it.                 */
+    double draw, palette, quantize, encode;
+};
+
+/*  Everything recorded. Counters are added to by every thread at once. Each  *
+ *  busy time and each frame is only written by one thread at a time.         */
+struct fractal_stats {
+    atomic_ullong points, escaped, iterations;
+
+    /*  Time spent in the thread pools, and the most threads used at once.    */
+    double parallel_seconds;
+    unsigned int max_threads;
+
+    /*  Time each worker spent drawing, by worker index.                      */
+    double busy[FRACTAL_STATS_MAX_WORKERS];
+
+    /*  The frames of the animation, if any.                                  */
+    struct fractal_stats_frame *frames;
+    unsigned int number_of_frames;
+};
+
+/*  The one set of statistics of the program.                                 */
+static struct fractal_stats fractal_stats_global;
+
+#endif
+/*  End of #ifdef FRACTAL_STATS.                                              */
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_stats_now                                                     *
+ *  Purpose:                                                                  *
+ *      Returns the time in seconds, from an arbitrary start, for the timers. *
+ *  Arguments:                                                                *
+ *      None (void).                                                          *
+ *  Output:                                                                   *
+ *      seconds (double):                                                     *
+ *          The time, or zero without FRACTAL_STATS.                          *
+ ******************************************************************************/
+static inline double
+fractal_stats_now(void)
+{
+#ifdef FRACTAL_STATS
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + 1.0E-9 * (double)t.tv_nsec;
+#else
+    return 0.0;
+#endif
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_stats_count                                                   *
+ *  Purpose:                                                                  *
+ *      Counts a batch of iterated points.                                    *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal the points were iterated for.                         *
+ *      escape (const struct fractal_escape *):                               *
+ *          The results.                                                      *
+ *      number_of_points (unsigned int):                                      *
+ *          The number of points.                                             *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Notes:                                                                    *
+ *      The batch is added up first, so the shared counters are only touched  *
+ *      once per batch, a row chunk at most.                                  *
+ ******************************************************************************/
+static inline void
+fractal_stats_count(const struct fractal *f,
+                    const struct fractal_escape *escape,
+                    unsigned int number_of_points)
+{
+#ifdef FRACTAL_STATS
+    unsigned long long escaped = 0U, iterations = 0U;
+    unsigned int n;
+
+    for (n = 0U; n < number_of_points; ++n)
+    {
+        escaped += (escape[n].iters < f->max_iters);
+        iterations += escape[n].iters;
+    }
+
+    atomic_fetch_add_explicit(&fractal_stats_global.points,
+                              number_of_points, memory_order_relaxed);
+    atomic_fetch_add_explicit(&fractal_stats_global.escaped,
+                              escaped, memory_order_relaxed);
+    atomic_fetch_add_explicit(&fractal_stats_global.iterations,
+                              iterations, memory_order_relaxed);
+#else
+    (void)f;
+    (void)escape;
+    (void)number_of_points;
+#endif
+}
+
+/*  Adds to the time a worker spent drawing.                                  */
+static inline void
+fractal_stats_busy(unsigned int worker, double seconds)
+{
+#ifdef FRACTAL_STATS
+    if (worker < FRACTAL_STATS_MAX_WORKERS)
+        fractal_stats_global.busy[worker] += seconds;
+#else
+    (void)worker;
+    (void)seconds;
+#endif
+}
+
+/*  Adds the time of a run of the thread pool with the given threads.         */
+static inline void
+fractal_stats_parallel(unsigned int number_of_threads, double seconds)
+{
+#ifdef FRACTAL_STATS
+    fractal_stats_global.parallel_seconds += seconds;
+
+    if (number_of_threads > fractal_stats_global.max_threads)
+        fractal_stats_global.max_threads = number_of_threads;
+#else
+    (void)number_of_threads;
+    (void)seconds;
+#endif
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_stats_begin_frames                                            *
+ *  Purpose:                                                                  *
+ *      Makes room for the times of every frame of an animation.              *
+ *  Arguments:                                                                *
+ *      number_of_frames (unsigned int):                                      *
+ *          The number of frames.                                             *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ *  Notes:                                                                    *
+ *      If memory can not be allocated the frames are not timed.              *
+ ******************************************************************************/
+static inline void
+fractal_stats_begin_frames(unsigned int number_of_frames)
+{
+#ifdef FRACTAL_STATS
+    free(fractal_stats_global.frames);
+    fractal_stats_global.frames = calloc(number_of_frames,
+                                         sizeof(*fractal_stats_global.frames));
+    fractal_stats_global.number_of_frames
+        = fractal_stats_global.frames ? number_of_frames : 0U;
+#else
+    (void)number_of_frames;
+#endif
+}
+
+/*  Records the drawing of a frame, and its palette if the worker made it.    */
+static inline void
+fractal_stats_frame_drawn(unsigned int frame, unsigned int worker,
+                          double draw, double palette)
+{
+#ifdef FRACTAL_STATS
+    if (frame < fractal_stats_global.number_of_frames)
+    {
+        fractal_stats_global.frames[frame].worker = worker;
+        fractal_stats_global.frames[frame].draw = draw;
+        fractal_stats_global.frames[frame].palette = palette;
+    }
+
+    fractal_stats_busy(worker, draw + palette);
+#else
+    (void)frame;
+    (void)worker;
+    (void)draw;
+    (void)palette;
+#endif
+}
+
+/*  Records the writing of a frame, adding to any palette time of the worker. */
+static inline void
+fractal_stats_frame_written(unsigned int frame, double palette,
+                            double quantize, double encode)
+{
+#ifdef FRACTAL_STATS
+    if (frame < fractal_stats_global.number_of_frames)
+    {
+        fractal_stats_global.frames[frame].palette += palette;
+        fractal_stats_global.frames[frame].quantize = quantize;
+        fractal_stats_global.frames[frame].encode = encode;
+    }
+#else
+    (void)frame;
+    (void)palette;
+    (void)quantize;
+    (void)encode;
+#endif
+}
+
+#ifdef FRACTAL_STATS
+
+/*  Saves the times of the frames as CSV. Returns 0 or -1.                    */
+static inline int
+fractal_stats_write_csv(const char *filename)
+{
+    const struct fractal_stats * const s = &fractal_stats_global;
+    FILE * const fp = fopen(filename, "w");
+    unsigned int n;
+    int status = 0;
+
+    if (!fp)
+        return -1;
+
+    fprintf(fp, "frame,worker,draw_seconds,palette_seconds,"
+                "quantize_seconds,encode_seconds\n");
+
+    for (n = 0U; n < s->number_of_frames; ++n)
+        fprintf(fp, "%u,%u,%.9f,%.9f,%.9f,%.9f\n", n, s->frames[n].worker,
+                s->frames[n].draw, s->frames[n].palette,
+                s->frames[n].quantize, s->frames[n].encode);
+
+    if (ferror(fp))
+        status = -1;
+
+    if (fclose(fp) != 0)
+        status = -1;
+
+    return status;
+}
+
+/*  Prints what was recorded.                                                 */
+static inline void
+fractal_stats_print(void)
+{
+    const struct fractal_stats * const s = &fractal_stats_global;
+    const unsigned long long points = atomic_load(&s->points);
+    const unsigned long long escaped = atomic_load(&s->escaped);
+    const unsigned long long iterations = atomic_load(&s->iterations);
+    double draw = 0.0, palette = 0.0, quantize = 0.0, encode = 0.0;
+    unsigned int n, number_of_workers = 0U;
+
+    printf("Points iterated:     %llu\n", points);
+    printf("    escaped:         %llu\n", escaped);
+    printf("    reached max:     %llu\n", points - escaped);
+    printf("Iterations:          %llu (%.1f per point)\n", iterations,
+           points ? (double)iterations / (double)points : 0.0);
+
+    if (s->parallel_seconds > 0.0)
+        printf("Thread pools:        %.3fs, up to %u threads\n",
+               s->parallel_seconds, s->max_threads);
+
+    for (n = 0U; n < FRACTAL_STATS_MAX_WORKERS; ++n)
+        if (s->busy[n] > 0.0)
+            number_of_workers = n + 1U;
+
+    for (n = 0U; n < number_of_workers; ++n)
+        printf("Worker %-4u busy:    %.3fs\n", n, s->busy[n]);
+
+    if (s->number_of_frames == 0U)
+        return;
+
+    for (n = 0U; n < s->number_of_frames; ++n)
+    {
+        draw += s->frames[n].draw;
+        palette += s->frames[n].palette;
+        quantize += s->frames[n].quantize;
+        encode += s->frames[n].encode;
+    }
+
+    printf("Frames:              %u\n", s->number_of_frames);
+    printf("    drawing:         %.3fs\n", draw);
+    printf("    palettes:        %.3fs\n", palette);
+    printf("    dither/map:      %.3fs\n", quantize);
+    printf("    LZW:             %.3fs\n", encode);
+}
+
+#endif
+/*  End of #ifdef FRACTAL_STATS.                                              */
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_stats_finish                                                  *
+ *  Purpose:                                                                  *
+ *      Prints a summary of everything recorded, saves the frame times, and   *
+ *      frees them. Called once, at the end of a program.                     *
+ *  Arguments:                                                                *
+ *      csv_filename (const char *):                                          *
+ *          Where to save the times of each frame as CSV, or NULL.            *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 if the CSV could not be written.                 *
+ *  Notes:                                                                    *
+ *      Without FRACTAL_STATS nothing was recorded. A note is printed if a    *
+ *      CSV was asked for, and nothing else is done.                          *
+ ******************************************************************************/
+static inline int
+fractal_stats_finish(const char *csv_filename)
+{
+#ifdef FRACTAL_STATS
+    int status = 0;
+
+    fractal_stats_print();
+
+    if (csv_filename && fractal_stats_write_csv(csv_filename) != 0)
+        status = -1;
+
+    free(fractal_stats_global.frames);
+    fractal_stats_global.frames = NULL;
+    fractal_stats_global.number_of_frames = 0U;
+    return status;
+#else
+    if (csv_filename)
+        puts("Not built with FRACTAL_STATS, see fractal_stats.h. "
+             "No statistics saved.");
+
+    return 0;
+#endif
+}
+
+#endif
+/*  End of include guard.                                                     */
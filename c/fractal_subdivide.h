@@ -0,0 +1,493 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Mariani-Silver subdivision. Large parts of an image, the interior of  *
+ *      the set and the bands around it, share a single iteration count. The  *
+ *      border of a rectangle is iterated first, and if every pixel on it has *
+ *      the same count, the inside is filled with that color without being    *
+ *      iterated. Otherwise the rectangle is cut into four by a row and a     *
+ *      column through its middle, which are iterated, and each quarter,      *
+ *      whose border is now known, is handled the same way.                   *
+ *                                                                            *
+ *      The image is cut into blocks of FRACTAL_SUBDIVIDE_BLOCK pixels on a   *
+ *      side, each subdivided on its own. This matches the tiles handed out   *
+ *      by fractal_threads.h, so the work is shared between threads as usual. *
+ *      Within a block, every rectangle of one size is handled before any of  *
+ *      the next, and the pixels they need are queued up and iterated         *
+ *      together. The borders and cuts are short and scattered, and this      *
+ *      keeps every lane of the vectorized kernels busy.                      *
+ *                                                                            *
+ *      The counts of the pixels with even x and y may be given up front, as  *
+ *      the coarse passes of fractal_progressive.h find them. Those pixels    *
+ *      are already drawn, and are looked up rather than iterated again.      *
+ *  Notes:                                                                    *
+ *      This file is included by fractal.h, do not include it directly.       *
+ *                                                                            *
+ *      For the Mandelbrot set the region of points needing more than k       *
+ *      iterations is connected, as is the region needing fewer, so neither   *
+ *      can sit inside a rectangle whose border has a count of exactly k. The *
+ *      fill is then exact, up to features too thin to land on any pixel of   *
+ *      the border, which the brute force render can also miss. No such       *
+ *      guarantee holds for the other fractals, so check the output before    *
+ *      turning this on for them.                                             *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_SUBDIVIDE_H
+#define FRACTAL_SUBDIVIDE_H
+
+/*  memcpy found here.                                                        */
+#include <string.h>
+
+/*  Side length of the blocks that are subdivided, as FRACTAL_TILE_SIZE.      */
+#define FRACTAL_SUBDIVIDE_BLOCK (32U)
+
+/*  Rectangles with at most this many pixels between the left and right, or   *
+ *  top and bottom, edges are iterated in full rather than cut again.         */
+#define FRACTAL_SUBDIVIDE_MIN (3U)
+
+/*  The most rectangles of one size in a block. Each is at least 2 pixels on  *
+ *  a side, not counting the pixels shared with its neighbors.                */
+#define FRACTAL_SUBDIVIDE_MAX_RECTS \
+    ((FRACTAL_SUBDIVIDE_BLOCK * FRACTAL_SUBDIVIDE_BLOCK) / 4U)
+
+/*  A rectangle whose border has been iterated, border pixels included.       */
+struct fractal_subdivide_rect {
+    unsigned int x_lo, y_lo, x_hi, y_hi;
+};
+
+/*  A block being subdivided, and the iteration counts found so far.          */
+struct fractal_subdivide_state {
+
+    /*  The fractal, viewport, coloring, and pixel format.                    */
+    const struct fractal_renderer *r;
+
+    /*  Pointer to the start of row y_rows of the image.                      */
+    unsigned char *rows;
+    unsigned int y_rows;
+
+    /*  The top-left pixel of the block.                                      */
+    unsigned int x_block, y_block;
+
+    /*  The number of iterations of each pixel of the block that is known.    */
+    unsigned int iters[FRACTAL_SUBDIVIDE_BLOCK * FRACTAL_SUBDIVIDE_BLOCK];
+
+    /*  The counts of the pixels with even x and y, (width + 1) / 2 of them   *
+     *  per row, drawn before the subdivision started. NULL if none are.      */
+    const unsigned int *known;
+    unsigned int known_width;
+
+    /*  Pixels waiting to be iterated.                                        */
+    unsigned int queue_x[FRACTAL_ROW_CHUNK], queue_y[FRACTAL_ROW_CHUNK];
+    unsigned int queue_size;
+
+    /*  The rectangles being handled, and those cut from them.                */
+    struct fractal_subdivide_rect rects[FRACTAL_SUBDIVIDE_MAX_RECTS];
+    struct fractal_subdivide_rect next_rects[FRACTAL_SUBDIVIDE_MAX_RECTS];
+
+    /*  The number of pixels iterated so far.                                 */
+    size_t pixels_iterated;
+};
+
+/*  Returns the address of the pixel (x, y) in the image.                     */
+static inline unsigned char *
+fractal_subdivide_pixel(const struct fractal_subdivide_state *s,
+                        unsigned int x, unsigned int y)
+{
+    const size_t offset = (size_t)(y - s->y_rows) * s->r->viewport->width + x;
+    return s->rows + offset * s->r->channels;
+}
+
+/*  Returns the address of the iteration count of the pixel (x, y).           */
+static inline unsigned int *
+fractal_subdivide_iters(struct fractal_subdivide_state *s,
+                        unsigned int x, unsigned int y)
+{
+    const unsigned int row = y - s->y_block;
+    return s->iters + row * FRACTAL_SUBDIVIDE_BLOCK + (x - s->x_block);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_subdivide_flush                                               *
+ *  Purpose:                                                                  *
+ *      Iterates and colors the queued pixels, and saves their counts.        *
+ *  Arguments:                                                                *
+ *      s (struct fractal_subdivide_state *):                                 *
+ *          The block.                                                        *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_subdivide_flush(struct fractal_subdivide_state *s)
+{
+    struct fractal_escape escape[FRACTAL_ROW_CHUNK];
+    const struct fractal_renderer * const r = s->r;
+    unsigned int n;
+
+    if (s->queue_size == 0U)
+        return;
+
+    /*  Points computed as in fractal_render_escapes, so the results match.   */
+    fractal_render_pixels(r, s->queue_x, s->queue_y, s->queue_size, escape);
+
+    for (n = 0U; n < s->queue_size; ++n)
+    {
+        const unsigned int x = s->queue_x[n];
+        const unsigned int y = s->queue_y[n];
+
+        *fractal_subdivide_iters(s, x, y) = escape[n].iters;
+        fractal_render_colors(r, escape + n, 1U,
+                              fractal_subdivide_pixel(s, x, y));
+    }
+
+    s->pixels_iterated += s->queue_size;
+    s->queue_size = 0U;
+}
+
+/*  Adds the pixel (x, y) to the queue, iterating the queue once it is full.  *
+ *  Pixels drawn already have their counts looked up instead.                 */
+static inline void
+fractal_subdivide_queue(struct fractal_subdivide_state *s,
+                        unsigned int x, unsigned int y)
+{
+    if (s->known && ((x | y) & 1U) == 0U)
+    {
+        const size_t index = (size_t)(y / 2U) * s->known_width + x / 2U;
+        *fractal_subdivide_iters(s, x, y) = s->known[index];
+        return;
+    }
+
+    s->queue_x[s->queue_size] = x;
+    s->queue_y[s->queue_size] = y;
+    ++s->queue_size;
+
+    if (s->queue_size == FRACTAL_ROW_CHUNK)
+        fractal_subdivide_flush(s);
+}
+
+/*  Queues the pixels x <= x' < x + n of row y.                               */
+static inline void
+fractal_subdivide_queue_row(struct fractal_subdivide_state *s,
+                            unsigned int x, unsigned int y, unsigned int n)
+{
+    unsigned int k;
+
+    for (k = 0U; k < n; ++k)
+        fractal_subdivide_queue(s, x + k, y);
+}
+
+/*  Queues the pixels y <= y' < y + n of column x.                            */
+static inline void
+fractal_subdivide_queue_column(struct fractal_subdivide_state *s,
+                               unsigned int x, unsigned int y, unsigned int n)
+{
+    unsigned int k;
+
+    for (k = 0U; k < n; ++k)
+        fractal_subdivide_queue(s, x, y + k);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_subdivide_uniform                                             *
+ *  Purpose:                                                                  *
+ *      Checks whether the inside of a rectangle may be filled in, that is    *
+ *      whether every pixel on its border has the same iteration count and    *
+ *      the renderer allows regions of that count to be filled.               *
+ *  Arguments:                                                                *
+ *      s (struct fractal_subdivide_state *):                                 *
+ *          The block, with the border of the rectangle iterated.             *
+ *      rect (const struct fractal_subdivide_rect *):                         *
+ *          The rectangle.                                                    *
+ *  Output:                                                                   *
+ *      is_uniform (int):                                                     *
+ *          Boolean for whether the inside can be filled in.                  *
+ ******************************************************************************/
+static inline int
+fractal_subdivide_uniform(struct fractal_subdivide_state *s,
+                          const struct fractal_subdivide_rect *rect)
+{
+    const unsigned int *top = fractal_subdivide_iters(s, rect->x_lo,
+                                                      rect->y_lo);
+    const unsigned int *bottom = fractal_subdivide_iters(s, rect->x_lo,
+                                                         rect->y_hi);
+    const unsigned int iters = top[0];
+    unsigned int n;
+
+    if (s->r->subdivide == FRACTAL_SUBDIVIDE_INTERIOR
+        && iters < s->r->fractal->max_iters)
+        return 0;
+
+    for (n = 0U; n <= rect->x_hi - rect->x_lo; ++n)
+        if (top[n] != iters || bottom[n] != iters)
+            return 0;
+
+    for (n = rect->y_lo + 1U; n < rect->y_hi; ++n)
+        if (*fractal_subdivide_iters(s, rect->x_lo, n) != iters
+            || *fractal_subdivide_iters(s, rect->x_hi, n) != iters)
+            return 0;
+
+    return 1;
+}
+
+/*  Fills the inside of a rectangle with the color of its top-left corner.    */
+static inline void
+fractal_subdivide_fill(struct fractal_subdivide_state *s,
+                       const struct fractal_subdivide_rect *rect)
+{
+    const unsigned int channels = s->r->channels;
+    const unsigned char * const color
+        = fractal_subdivide_pixel(s, rect->x_lo, rect->y_lo);
+    unsigned int x, y;
+
+    for (y = rect->y_lo + 1U; y < rect->y_hi; ++y)
+    {
+        unsigned char *pixel = fractal_subdivide_pixel(s, rect->x_lo + 1U, y);
+
+        for (x = rect->x_lo + 1U; x < rect->x_hi; ++x)
+        {
+            memcpy(pixel, color, channels);
+            pixel += channels;
+        }
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_subdivide_block                                               *
+ *  Purpose:                                                                  *
+ *      Draws a block of at most FRACTAL_SUBDIVIDE_BLOCK pixels on a side.    *
+ *  Arguments:                                                                *
+ *      s (struct fractal_subdivide_state *):                                 *
+ *          The state, with the image set and the queue empty.                *
+ *      x_begin, y_begin (unsigned int):                                      *
+ *          The top-left pixel of the block.                                  *
+ *      x_end, y_end (unsigned int):                                          *
+ *          One past the bottom-right pixel of the block.                     *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_subdivide_block(struct fractal_subdivide_state *s,
+                        unsigned int x_begin, unsigned int y_begin,
+                        unsigned int x_end, unsigned int y_end)
+{
+    unsigned int number_of_rects = 1U;
+    unsigned int n;
+
+    s->x_block = x_begin;
+    s->y_block = y_begin;
+    s->rects[0].x_lo = x_begin;
+    s->rects[0].y_lo = y_begin;
+    s->rects[0].x_hi = x_end - 1U;
+    s->rects[0].y_hi = y_end - 1U;
+
+    /*  The top and bottom rows, then the left and right columns.             */
+    fractal_subdivide_queue_row(s, x_begin, y_begin, x_end - x_begin);
+
+    if (y_end - y_begin > 1U)
+        fractal_subdivide_queue_row(s, x_begin, y_end - 1U, x_end - x_begin);
+
+    if (y_end - y_begin > 2U)
+    {
+        fractal_subdivide_queue_column(s, x_begin, y_begin + 1U,
+                                       y_end - y_begin - 2U);
+
+        if (x_end - x_begin > 1U)
+            fractal_subdivide_queue_column(s, x_end - 1U, y_begin + 1U,
+                                           y_end - y_begin - 2U);
+    }
+
+    fractal_subdivide_flush(s);
+
+    while (number_of_rects > 0U)
+    {
+        unsigned int number_of_next_rects = 0U;
+
+        for (n = 0U; n < number_of_rects; ++n)
+        {
+            const struct fractal_subdivide_rect rect = s->rects[n];
+            struct fractal_subdivide_rect *next;
+            unsigned int x_mid, y_mid, y;
+
+            /*  Nothing is left between the edges.                            */
+            if (rect.x_hi - rect.x_lo < 2U || rect.y_hi - rect.y_lo < 2U)
+                continue;
+
+            if (fractal_subdivide_uniform(s, &rect))
+            {
+                fractal_subdivide_fill(s, &rect);
+                continue;
+            }
+
+            /*  Cutting a thin rectangle saves next to nothing.               */
+            if (rect.x_hi - rect.x_lo <= FRACTAL_SUBDIVIDE_MIN
+                || rect.y_hi - rect.y_lo <= FRACTAL_SUBDIVIDE_MIN)
+            {
+                for (y = rect.y_lo + 1U; y < rect.y_hi; ++y)
+                    fractal_subdivide_queue_row(s, rect.x_lo + 1U, y,
+                                                rect.x_hi - rect.x_lo - 1U);
+
+                continue;
+            }
+
+            /*  The row and column through the middle complete the borders of *
+             *  the four quarters.                                            */
+            x_mid = (rect.x_lo + rect.x_hi) / 2U;
+            y_mid = (rect.y_lo + rect.y_hi) / 2U;
+
+            fractal_subdivide_queue_row(s, rect.x_lo + 1U, y_mid,
+                                        rect.x_hi - rect.x_lo - 1U);
+            fractal_subdivide_queue_column(s, x_mid, rect.y_lo + 1U,
+                                           y_mid - rect.y_lo - 1U);
+            fractal_subdivide_queue_column(s, x_mid, y_mid + 1U,
+                                           rect.y_hi - y_mid - 1U);
+
+            next = s->next_rects + number_of_next_rects;
+            number_of_next_rects += 4U;
+
+            next[0].x_lo = rect.x_lo;
+            next[0].x_hi = x_mid;
+            next[0].y_lo = rect.y_lo;
+            next[0].y_hi = y_mid;
+
+            next[1].x_lo = x_mid;
+            next[1].x_hi = rect.x_hi;
+            next[1].y_lo = rect.y_lo;
+            next[1].y_hi = y_mid;
+
+            next[2].x_lo = rect.x_lo;
+            next[2].x_hi = x_mid;
+            next[2].y_lo = y_mid;
+            next[2].y_hi = rect.y_hi;
+
+            next[3].x_lo = x_mid;
+            next[3].x_hi = rect.x_hi;
+            next[3].y_lo = y_mid;
+            next[3].y_hi = rect.y_hi;
+        }
+
+        /*  The borders of the quarters must be known before they are looked  *
+         *  at, on the next pass.                                             */
+        fractal_subdivide_flush(s);
+
+        memcpy(s->rects, s->next_rects,
+               sizeof(*s->rects) * number_of_next_rects);
+        number_of_rects = number_of_next_rects;
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_subdivide_rect_known                                          *
+ *  Purpose:                                                                  *
+ *      Renders the pixels with x_begin <= x < x_end and y_begin <= y < y_end *
+ *      as fractal_render_rect does, filling in uniform regions, given the    *
+ *      pixels with even x and y that are drawn already.                      *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, coloring, and pixel format.                *
+ *      rows (unsigned char *):                                               *
+ *          Pointer to the start of row y_begin.                              *
+ *      x_begin (unsigned int):                                               *
+ *          The first column drawn.                                           *
+ *      y_begin (unsigned int):                                               *
+ *          The first row drawn.                                              *
+ *      x_end (unsigned int):                                                 *
+ *          One past the last column drawn.                                   *
+ *      y_end (unsigned int):                                                 *
+ *          One past the last row drawn.                                      *
+ *      known (const unsigned int *):                                         *
+ *          The iteration counts of the pixels (2i, 2j) of the image, at      *
+ *          known[j * ((width + 1) / 2) + i], whose colors are already in     *
+ *          rows. NULL if no pixels are drawn yet.                            *
+ *  Output:                                                                   *
+ *      pixels_iterated (size_t):                                             *
+ *          The number of pixels iterated, the rest were filled in or known.  *
+ ******************************************************************************/
+static inline size_t
+fractal_subdivide_rect_known(const struct fractal_renderer *r,
+                             unsigned char *rows,
+                             unsigned int x_begin, unsigned int y_begin,
+                             unsigned int x_end, unsigned int y_end,
+                             const unsigned int *known)
+{
+    struct fractal_subdivide_state s;
+    unsigned int x, y, x_block_end, y_block_end;
+
+    s.r = r;
+    s.rows = rows;
+    s.y_rows = y_begin;
+    s.known = known;
+    s.known_width = (r->viewport->width + 1U) / 2U;
+    s.queue_size = 0U;
+    s.pixels_iterated = 0U;
+
+    for (y = y_begin; y < y_end; y = y_block_end)
+    {
+        y_block_end = y + FRACTAL_SUBDIVIDE_BLOCK;
+
+        if (y_block_end > y_end)
+            y_block_end = y_end;
+
+        for (x = x_begin; x < x_end; x = x_block_end)
+        {
+            x_block_end = x + FRACTAL_SUBDIVIDE_BLOCK;
+
+            if (x_block_end > x_end)
+                x_block_end = x_end;
+
+            fractal_subdivide_block(&s, x, y, x_block_end, y_block_end);
+        }
+    }
+
+    return s.pixels_iterated;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_subdivide_rect                                                *
+ *  Purpose:                                                                  *
+ *      Renders the pixels with x_begin <= x < x_end and y_begin <= y < y_end *
+ *      as fractal_render_rect does, filling in uniform regions.              *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, coloring, and pixel format.                *
+ *      rows (unsigned char *):                                               *
+ *          Pointer to the start of row y_begin.                              *
+ *      x_begin, y_begin (unsigned int):                                      *
+ *          The top-left pixel drawn.                                         *
+ *      x_end, y_end (unsigned int):                                          *
+ *          One past the bottom-right pixel drawn.                            *
+ *  Output:                                                                   *
+ *      pixels_iterated (size_t):                                             *
+ *          The number of pixels iterated, the rest were filled in.           *
+ ******************************************************************************/
+static inline size_t
+fractal_subdivide_rect(const struct fractal_renderer *r, unsigned char *rows,
+                       unsigned int x_begin, unsigned int y_begin,
+                       unsigned int x_end, unsigned int y_end)
+{
+    return fractal_subdivide_rect_known(r, rows, x_begin, y_begin,
+                                        x_end, y_end, NULL);
+}
+
+#endif
+/*  End of include guard.                                                     */
@@ -0,0 +1,313 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Vectorized escape-time kernels for the SwipeCat iteration,            *
+ *      z -> (pi/2)(exp(z) - z) + c. Almost all of the time of the scalar     *
+ *      loop goes to exp, cos, and sin from libm, one point at a time. Here   *
+ *      they come from fractal_simd_math.h, a whole vector at once. The       *
+ *      kernels are laid out as those of fractal_simd.h, two interleaved      *
+ *      vectors with escaped lanes masked off and frozen.                     *
+ *  Notes:                                                                    *
+ *      This file is included by fractal.h, do not include it directly.       *
+ *                                                                            *
+ *      Unlike the Mandelbrot kernels the output is not bit for bit that of   *
+ *      the scalar code, since libm rounds exp, cos, and sin differently. The *
+ *      error is a unit or two in the last place, about the size of the       *
+ *      rounding error of a single step of the iteration. The AVX2 and        *
+ *      AVX-512 kernels agree with each other exactly.                        *
+ *      fractal_simd_set_level(SCALAR) gives back the libm results.           *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_SWIPECAT_H
+#define FRACTAL_SWIPECAT_H
+
+#ifdef FRACTAL_HAS_X86_SIMD
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_swipecat_avx2                                                 *
+ *  Purpose:                                                                  *
+ *      Iterates the SwipeCat fractal for 8 points, as two interleaved        *
+ *      vectors of 4 points each.                                             *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_SWIPECAT, without the        *
+ *          periodicity check.                                                *
+ *      c_real (const double *):                                              *
+ *          The real parts of the 8 points.                                   *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the 8 points.                              *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static inline void
+fractal_swipecat_avx2(const struct fractal *f, const double *c_real,
+                      const double *c_imag, struct fractal_escape *out)
+{
+    double count_out[8], z_real_out[8], z_imag_out[8];
+    unsigned int iters, n, k;
+
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d pi_by_two = _mm256_set1_pd(FRACTAL_PI_BY_TWO);
+    const __m256d sign_bit = _mm256_set1_pd(-0.0);
+    const __m256d radius = _mm256_set1_pd(f->escape_radius);
+    const __m256d radius_squared
+        = _mm256_set1_pd(f->escape_radius * f->escape_radius);
+
+    /*  Two independent vectors, see fractal_mandelbrot_avx2.                 */
+    __m256d c_re[2], c_im[2], z_re[2], z_im[2], active[2], count[2];
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        c_re[k] = _mm256_loadu_pd(c_real + 4U*k);
+        c_im[k] = _mm256_loadu_pd(c_imag + 4U*k);
+        z_re[k] = f->start_at_c ? c_re[k] : zero;
+        z_im[k] = f->start_at_c ? c_im[k] : zero;
+        active[k] = _mm256_cmp_pd(zero, zero, _CMP_EQ_OQ);
+        count[k] = zero;
+    }
+
+    for (iters = 0U; iters < f->max_iters; ++iters)
+    {
+        int remaining = 0;
+
+        for (k = 0U; k < 2U; ++k)
+        {
+            /*  Same operations, in the same order, as fractal_swipecat_iter. */
+            const __m256d exp_x = fractal_simd_exp_avx2(z_re[k]);
+            __m256d cos_y, sin_y, next_re, next_im, escaped;
+
+            /*  Escaped lanes can hold a huge z_im. Zero it so that they do   *
+             *  not fall back to libm on every remaining iteration.           */
+            fractal_simd_sincos_avx2(_mm256_and_pd(z_im[k], active[k]),
+                                     &cos_y, &sin_y);
+
+            next_re = _mm256_add_pd(_mm256_mul_pd(pi_by_two, _mm256_sub_pd(
+                _mm256_mul_pd(exp_x, cos_y), z_re[k]
+            )), c_re[k]);
+            next_im = _mm256_add_pd(_mm256_mul_pd(pi_by_two, _mm256_sub_pd(
+                _mm256_mul_pd(exp_x, sin_y), z_im[k]
+            )), c_im[k]);
+
+            /*  Lanes that already escaped keep their final value.            */
+            z_re[k] = _mm256_blendv_pd(z_re[k], next_re, active[k]);
+            z_im[k] = _mm256_blendv_pd(z_im[k], next_im, active[k]);
+
+            if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+            {
+                const __m256d abs_sq = _mm256_add_pd(
+                    _mm256_mul_pd(z_re[k], z_re[k]),
+                    _mm256_mul_pd(z_im[k], z_im[k])
+                );
+
+                escaped = _mm256_cmp_pd(abs_sq, radius_squared, _CMP_GT_OQ);
+            }
+            else
+            {
+                const __m256d abs_x = _mm256_andnot_pd(sign_bit, z_re[k]);
+                escaped = _mm256_cmp_pd(abs_x, radius, _CMP_GE_OQ);
+            }
+
+            active[k] = _mm256_andnot_pd(escaped, active[k]);
+
+            /*  Lanes still active have survived another iteration.           */
+            count[k] = _mm256_add_pd(count[k], _mm256_and_pd(active[k], one));
+            remaining |= _mm256_movemask_pd(active[k]);
+        }
+
+        /*  Every lane has escaped, nothing left to do.                       */
+        if (!remaining)
+            break;
+    }
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        _mm256_storeu_pd(count_out + 4U*k, count[k]);
+        _mm256_storeu_pd(z_real_out + 4U*k, z_re[k]);
+        _mm256_storeu_pd(z_imag_out + 4U*k, z_im[k]);
+    }
+
+    for (n = 0U; n < 8U; ++n)
+    {
+        out[n].iters = (unsigned int)count_out[n];
+        out[n].z.real = z_real_out[n];
+        out[n].z.imag = z_imag_out[n];
+    }
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_swipecat_avx512                                               *
+ *  Purpose:                                                                  *
+ *      Iterates the SwipeCat fractal for 16 points, as two interleaved       *
+ *      vectors of 8 points each.                                             *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_SWIPECAT, without the        *
+ *          periodicity check.                                                *
+ *      c_real (const double *):                                              *
+ *          The real parts of the 16 points.                                  *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the 16 points.                             *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+FRACTAL_AVX512_TARGET
+static inline void
+fractal_swipecat_avx512(const struct fractal *f, const double *c_real,
+                        const double *c_imag, struct fractal_escape *out)
+{
+    double count_out[16], z_real_out[16], z_imag_out[16];
+    unsigned int iters, n, k;
+
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d one = _mm512_set1_pd(1.0);
+    const __m512d pi_by_two = _mm512_set1_pd(FRACTAL_PI_BY_TWO);
+    const __m512d radius = _mm512_set1_pd(f->escape_radius);
+    const __m512d radius_squared
+        = _mm512_set1_pd(f->escape_radius * f->escape_radius);
+
+    /*  Two independent vectors, see fractal_mandelbrot_avx2.                 */
+    __m512d c_re[2], c_im[2], z_re[2], z_im[2], count[2];
+
+    /*  One bit per lane, set for lanes that have not escaped yet.            */
+    __mmask8 active[2];
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        c_re[k] = _mm512_loadu_pd(c_real + 8U*k);
+        c_im[k] = _mm512_loadu_pd(c_imag + 8U*k);
+        z_re[k] = f->start_at_c ? c_re[k] : zero;
+        z_im[k] = f->start_at_c ? c_im[k] : zero;
+        active[k] = 0xFFU;
+        count[k] = zero;
+    }
+
+    for (iters = 0U; iters < f->max_iters; ++iters)
+    {
+        for (k = 0U; k < 2U; ++k)
+        {
+            /*  Same operations, in the same order, as fractal_swipecat_iter. */
+            const __m512d exp_x = fractal_simd_exp_avx512(z_re[k]);
+            __m512d cos_y, sin_y, next_re, next_im;
+            __mmask8 escaped;
+
+            /*  Escaped lanes are zeroed, see fractal_swipecat_avx2.          */
+            fractal_simd_sincos_avx512(
+                _mm512_maskz_mov_pd(active[k], z_im[k]), &cos_y, &sin_y
+            );
+
+            next_re = _mm512_add_pd(_mm512_mul_pd(pi_by_two, _mm512_sub_pd(
+                _mm512_mul_pd(exp_x, cos_y), z_re[k]
+            )), c_re[k]);
+            next_im = _mm512_add_pd(_mm512_mul_pd(pi_by_two, _mm512_sub_pd(
+                _mm512_mul_pd(exp_x, sin_y), z_im[k]
+            )), c_im[k]);
+
+            /*  Lanes that already escaped keep their final value.            */
+            z_re[k] = _mm512_mask_blend_pd(active[k], z_re[k], next_re);
+            z_im[k] = _mm512_mask_blend_pd(active[k], z_im[k], next_im);
+
+            if (f->escape_test == FRACTAL_ESCAPE_MODULUS)
+            {
+                const __m512d abs_sq = _mm512_add_pd(
+                    _mm512_mul_pd(z_re[k], z_re[k]),
+                    _mm512_mul_pd(z_im[k], z_im[k])
+                );
+
+                escaped = _mm512_cmp_pd_mask(abs_sq, radius_squared,
+                                             _CMP_GT_OQ);
+            }
+            else
+                escaped = _mm512_cmp_pd_mask(_mm512_abs_pd(z_re[k]),
+                                             radius, _CMP_GE_OQ);
+
+            active[k] = (__mmask8)(active[k] & ~escaped);
+
+            /*  Lanes still active have survived another iteration.           */
+            count[k] = _mm512_mask_add_pd(count[k], active[k], count[k], one);
+        }
+
+        /*  Every lane has escaped, nothing left to do.                       */
+        if ((active[0] | active[1]) == 0U)
+            break;
+    }
+
+    for (k = 0U; k < 2U; ++k)
+    {
+        _mm512_storeu_pd(count_out + 8U*k, count[k]);
+        _mm512_storeu_pd(z_real_out + 8U*k, z_re[k]);
+        _mm512_storeu_pd(z_imag_out + 8U*k, z_im[k]);
+    }
+
+    for (n = 0U; n < 16U; ++n)
+    {
+        out[n].iters = (unsigned int)count_out[n];
+        out[n].z.real = z_real_out[n];
+        out[n].z.imag = z_imag_out[n];
+    }
+}
+
+#endif
+/*  End of #ifdef FRACTAL_HAS_X86_SIMD.                                       */
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_swipecat_points                                               *
+ *  Purpose:                                                                  *
+ *      Iterates the SwipeCat fractal for any number of points, using the     *
+ *      fastest available kernel. Leftover points, and every point if the     *
+ *      periodicity check is on, are done one at a time with libm.            *
+ *  Arguments:                                                                *
+ *      f (const struct fractal *):                                           *
+ *          The fractal. Must be of type FRACTAL_SWIPECAT.                    *
+ *      c_real (const double *):                                              *
+ *          The real parts of the points.                                     *
+ *      c_imag (const double *):                                              *
+ *          The imaginary parts of the points.                                *
+ *      number_of_points (unsigned int):                                      *
+ *          The number of elements in c_real, c_imag, and out.                *
+ *      out (struct fractal_escape *):                                        *
+ *          The number of iterations and final value for each point.          *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_swipecat_points(const struct fractal *f, const double *c_real,
+                        const double *c_imag, unsigned int number_of_points,
+                        struct fractal_escape *out)
+{
+    const enum fractal_simd_level level
+        = f->check_period ? FRACTAL_SIMD_SCALAR : fractal_simd_level();
+
+    fractal_simd_points(f, level, FRACTAL_SIMD_KERNEL(fractal_swipecat_avx2),
+                        FRACTAL_SIMD_KERNEL(fractal_swipecat_avx512),
+                        fractal_swipecat_iter, c_real, c_imag,
+                        number_of_points, out);
+}
+
+#endif
+/*  End of include guard.                                                     */
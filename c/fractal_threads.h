@@ -0,0 +1,281 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Multithreaded rendering for the routines in fractal.h. The image is   *
+ *      split into small tiles and worker threads grab the next tile from a   *
+ *      shared atomic counter until none are left. Tiles through the interior *
+ *      of a set cost max_iters per pixel while tiles in the exterior escape  *
+ *      in a few iterations, so handing tiles out dynamically keeps every     *
+ *      thread busy, whereas splitting the rows evenly up front does not.     *
+ *  Notes:                                                                    *
+ *      Requires POSIX threads and C11 atomics. Build with -pthread, e.g.:    *
+ *          cc -O3 -pthread mandelbrot_set_001.c -o mandelbrot_set_001 -lm    *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_THREADS_H
+#define FRACTAL_THREADS_H
+
+/*  pthread_create and pthread_join found here.                               */
+#include <pthread.h>
+
+/*  atomic_uint and atomic_fetch_add provided here.                           */
+#include <stdatomic.h>
+
+/*  malloc and free found here.                                               */
+#include <stdlib.h>
+
+/*  sysconf, used for counting the number of processors, found here.          */
+#include <unistd.h>
+
+/*  The fractal_renderer struct and fractal_render_rect found here.           */
+#include "fractal.h"
+
+/*  Side length of the square tiles handed out to the worker threads. Small   *
+ *  enough to balance the load, large enough that the counter is uncontended. */
+#define FRACTAL_TILE_SIZE (32U)
+
+/*  Upper bound on the number of threads, guards against typos like 10000.    */
+#define FRACTAL_MAX_THREADS (1024U)
+
+/******************************************************************************
+ *  Struct:                                                                   *
+ *      fractal_tile_scheduler                                                *
+ *  Purpose:                                                                  *
+ *      State shared by the worker threads. Tiles are numbered in row-major   *
+ *      order, starting from row y_begin, and next_tile is the index of the   *
+ *      next one to be drawn.                                                 *
+ ******************************************************************************/
+struct fractal_tile_scheduler {
+
+    /*  The fractal, viewport, coloring, and pixel format.                    */
+    const struct fractal_renderer *renderer;
+
+    /*  The shared framebuffer, starting at row y_begin. Every tile writes a  *
+     *  disjoint set of pixels.                                               */
+    unsigned char *rows;
+
+    /*  The range of rows being drawn, y_begin <= y < y_end.                  */
+    unsigned int y_begin, y_end;
+
+    /*  The number of tiles in the x axis, and the total number of tiles.     */
+    unsigned int tiles_x, number_of_tiles;
+
+    /*  Index of the next tile to render. Incremented atomically.             */
+    atomic_uint next_tile;
+
+    /*  Index of the next worker to start, for fractal_stats_busy.            */
+    atomic_uint next_worker;
+
+    /*  The number of pixels iterated, see fractal_render_rect. Each worker   *
+     *  adds its total once it is done.                                       */
+    atomic_size_t pixels_iterated;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tile_worker                                                   *
+ *  Purpose:                                                                  *
+ *      Thread routine. Repeatedly grabs the next tile and renders it.        *
+ *  Arguments:                                                                *
+ *      arg (void *):                                                         *
+ *          Pointer to the shared fractal_tile_scheduler.                     *
+ *  Output:                                                                   *
+ *      NULL (void *).                                                        *
+ ******************************************************************************/
+static inline void *
+fractal_tile_worker(void *arg)
+{
+    struct fractal_tile_scheduler * const sched = arg;
+    const struct fractal_viewport * const vp = sched->renderer->viewport;
+    const unsigned int worker = atomic_fetch_add(&sched->next_worker, 1U);
+    size_t pixels_iterated = 0U;
+    double busy = 0.0;
+
+    while (1)
+    {
+        /*  Claim a tile. Once the counter runs past the end we are done.     */
+        const unsigned int tile = atomic_fetch_add(&sched->next_tile, 1U);
+        unsigned int x_begin, y_begin, x_end, y_end;
+        size_t offset;
+        double start;
+
+        if (tile >= sched->number_of_tiles)
+            break;
+
+        /*  Convert the tile index into the pixel bounds of the tile.         */
+        x_begin = (tile % sched->tiles_x) * FRACTAL_TILE_SIZE;
+        y_begin = (tile / sched->tiles_x) * FRACTAL_TILE_SIZE;
+        y_begin += sched->y_begin;
+        x_end = x_begin + FRACTAL_TILE_SIZE;
+        y_end = y_begin + FRACTAL_TILE_SIZE;
+
+        /*  Tiles on the right and bottom edges may be cut short.             */
+        if (x_end > vp->width)
+            x_end = vp->width;
+
+        if (y_end > sched->y_end)
+            y_end = sched->y_end;
+
+        offset = (size_t)(y_begin - sched->y_begin) * vp->width;
+        offset *= sched->renderer->channels;
+        start = fractal_stats_now();
+        pixels_iterated += fractal_render_rect(sched->renderer,
+                                               sched->rows + offset,
+                                               x_begin, y_begin, x_end, y_end);
+        busy += fractal_stats_now() - start;
+    }
+
+    atomic_fetch_add(&sched->pixels_iterated, pixels_iterated);
+    fractal_stats_busy(worker, busy);
+    return NULL;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_rows_parallel                                          *
+ *  Purpose:                                                                  *
+ *      Renders the rows y_begin <= y < y_end using several threads. The      *
+ *      output is identical to fractal_render_rect.                           *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, coloring, and pixel format.                *
+ *      rows (unsigned char *):                                               *
+ *          Pointer to the start of row y_begin.                              *
+ *      y_begin (unsigned int):                                               *
+ *          The first row drawn.                                              *
+ *      y_end (unsigned int):                                                 *
+ *          One past the last row drawn.                                      *
+ *      number_of_threads (unsigned int):                                     *
+ *          The number of threads to use, including the calling thread.       *
+ *  Output:                                                                   *
+ *      pixels_iterated (size_t):                                             *
+ *          The number of pixels iterated, see fractal_render_rect.           *
+ *  Notes:                                                                    *
+ *      If threads can not be created the calling thread does the remaining   *
+ *      work on its own, so the image is always completely drawn.             *
+ ******************************************************************************/
+static inline size_t
+fractal_render_rows_parallel(const struct fractal_renderer *r,
+                             unsigned char *rows,
+                             unsigned int y_begin, unsigned int y_end,
+                             unsigned int number_of_threads)
+{
+    struct fractal_tile_scheduler sched;
+    pthread_t *threads;
+    unsigned int n, number_started = 0U;
+    const unsigned int tiles_y
+        = (y_end - y_begin + FRACTAL_TILE_SIZE - 1U) / FRACTAL_TILE_SIZE;
+    const double start = fractal_stats_now();
+
+    sched.renderer = r;
+    sched.rows = rows;
+    sched.y_begin = y_begin;
+    sched.y_end = y_end;
+    sched.tiles_x
+        = (r->viewport->width + FRACTAL_TILE_SIZE - 1U) / FRACTAL_TILE_SIZE;
+    sched.number_of_tiles = sched.tiles_x * tiles_y;
+    atomic_init(&sched.next_tile, 0U);
+    atomic_init(&sched.next_worker, 0U);
+    atomic_init(&sched.pixels_iterated, 0U);
+
+    /*  Check the CPU now so the workers only ever read the cached result.    */
+    fractal_simd_level();
+
+    /*  The calling thread is a worker as well, so start one fewer thread.    */
+    if (number_of_threads > 1U)
+        threads = malloc(sizeof(*threads) * (number_of_threads - 1U));
+    else
+        threads = NULL;
+
+    if (threads)
+    {
+        for (n = 0U; n < number_of_threads - 1U; ++n)
+        {
+            if (pthread_create(&threads[n], NULL, fractal_tile_worker, &sched))
+                break;
+
+            ++number_started;
+        }
+    }
+
+    fractal_tile_worker(&sched);
+
+    for (n = 0U; n < number_started; ++n)
+        pthread_join(threads[n], NULL);
+
+    free(threads);
+    fractal_stats_parallel(number_started + 1U, fractal_stats_now() - start);
+    return atomic_load(&sched.pixels_iterated);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_parallel                                               *
+ *  Purpose:                                                                  *
+ *      Renders an entire image into a buffer using several threads. The      *
+ *      output is identical to fractal_render.                                *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, coloring, and pixel format.                *
+ *      buffer (unsigned char *):                                             *
+ *          The image, width * height * channels bytes.                       *
+ *      number_of_threads (unsigned int):                                     *
+ *          The number of threads to use, including the calling thread.       *
+ *  Output:                                                                   *
+ *      pixels_iterated (size_t):                                             *
+ *          The number of pixels iterated, see fractal_render_rect.           *
+ ******************************************************************************/
+static inline size_t
+fractal_render_parallel(const struct fractal_renderer *r,
+                        unsigned char *buffer,
+                        unsigned int number_of_threads)
+{
+    return fractal_render_rows_parallel(r, buffer, 0U, r->viewport->height,
+                                        number_of_threads);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_default_threads                                               *
+ *  Purpose:                                                                  *
+ *      Returns the number of processors currently online, or 1 if this can   *
+ *      not be determined.                                                    *
+ *  Arguments:                                                                *
+ *      None (void).                                                          *
+ *  Output:                                                                   *
+ *      number_of_threads (unsigned int):                                     *
+ *          The default number of threads for fractal_render_parallel.        *
+ ******************************************************************************/
+static inline unsigned int
+fractal_default_threads(void)
+{
+    const long number_of_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (number_of_cpus < 1L)
+        return 1U;
+
+    if (number_of_cpus > (long)FRACTAL_MAX_THREADS)
+        return FRACTAL_MAX_THREADS;
+
+    return (unsigned int)number_of_cpus;
+}
+
+#endif
+/*  End of include guard.                                                     */
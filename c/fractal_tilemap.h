@@ -0,0 +1,953 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Draws a fractal as a pyramid of square tiles, the way web maps do,    *
+ *      for viewers that pan and zoom. A layer is a fractal and the square    *
+ *      in the plane covered by its only tile at zoom level 0. Each level     *
+ *      halves the side of the tiles, so level z has 2^z by 2^z of them, the  *
+ *      tile (z, x, y) being column x and row y, counted from the top left.   *
+ *      Every tile is FRACTAL_TILEMAP_SIZE pixels square, and is saved as a   *
+ *      GIF in the palette of fractal_smooth_colormap.                        *
+ *                                                                            *
+ *      Tiles are kept in two caches. Recently used tiles are kept encoded in *
+ *      memory, up to a number of bytes, the least recently used being        *
+ *      dropped first. Every tile drawn is also saved to a directory, if one  *
+ *      is given, so they outlive the program. A tile is only drawn if it is  *
+ *      in neither.                                                           *
+ *  Notes:                                                                    *
+ *      Tiles are named by the layer, a fingerprint of every parameter that   *
+ *      changes the pixels, and z, x, and y. Changing a layer in the code     *
+ *      changes its fingerprint, so old tiles on disk are never served for    *
+ *      it, but they are not removed either.                                  *
+ *                                                                            *
+ *      Pixels are sampled at their centers, so neighboring tiles meet        *
+ *      without a repeated row or column. Tiles too deep for doubles are      *
+ *      drawn in double-double precision, which fractal_dd.h only has for     *
+ *      the Mandelbrot set. Deeper tiles, and tiles of other fractals too     *
+ *      deep for doubles, are refused with FRACTAL_TILEMAP_UNAVAILABLE.       *
+ *      Deeper tiles are given more iterations, see zoom_iters below.         *
+ *                                                                            *
+ *      The GIF is made in memory with open_memstream, and the tiles saved    *
+ *      with POSIX file functions. With -std=c99 define                       *
+ *      _POSIX_C_SOURCE=200809L before including this file.                   *
+ *                                                                            *
+ *      A tilemap is not safe to share between threads. Each tile is drawn    *
+ *      by fractal_render_parallel with number_of_threads threads.            *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_TILEMAP_H
+#define FRACTAL_TILEMAP_H
+
+/*  errno and EEXIST found here.                                              */
+#include <errno.h>
+
+/*  open_memstream, fopen, fread, rename, and snprintf found here.            */
+#include <stdio.h>
+
+/*  malloc, realloc, calloc, and free found here.                             */
+#include <stdlib.h>
+
+/*  memcmp, memcpy, and strlen found here.                                    */
+#include <string.h>
+
+/*  mkdir found here.                                                         */
+#include <sys/stat.h>
+
+/*  GifBeginStream, GifWriteIndexedFrame, and GifEnd found here.              */
+#include "gif.h"
+
+/*  The fractals, renderers, and double-double precision found here.          */
+#include "fractal.h"
+
+/*  fractal_render_parallel found here.                                       */
+#include "fractal_threads.h"
+
+/*  The number of pixels on a side of a tile, the usual size for web maps.    */
+#define FRACTAL_TILEMAP_SIZE (256U)
+
+/*  The deepest zoom level. Rows and columns, plus one half, are then exact   *
+ *  as doubles, and the pixels of a layer a few units across are well above   *
+ *  the smallest spacing double-double can draw.                              */
+#define FRACTAL_TILEMAP_MAX_ZOOM (52U)
+
+/*  The most layers a tilemap can hold.                                       */
+#define FRACTAL_TILEMAP_MAX_LAYERS (16U)
+
+/*  The longest layer name, not counting the terminator. Names go in file     *
+ *  names and URLs, and may only have letters, digits, '_', and '-'.          */
+#define FRACTAL_TILEMAP_MAX_NAME (31U)
+
+/*  Bumped whenever the drawing or the file format of tiles changes, so that  *
+ *  tiles saved by older versions are not served.                             */
+#define FRACTAL_TILEMAP_VERSION (1U)
+
+/*  Returned, in place of -1, for a tile that is out of range or too deep to  *
+ *  draw, as opposed to one that failed to be drawn.                          */
+#define FRACTAL_TILEMAP_UNAVAILABLE (-2)
+
+/******************************************************************************
+ *  Struct:                                                                   *
+ *      fractal_tilemap_layer                                                 *
+ *  Purpose:                                                                  *
+ *      A fractal to be drawn as tiles, and the square of the plane covered   *
+ *      by the tile (0, 0, 0). Use fractal_tilemap_add to fill this in.       *
+ ******************************************************************************/
+struct fractal_tilemap_layer {
+    char name[FRACTAL_TILEMAP_MAX_NAME + 1U];
+    struct fractal fractal;
+
+    /*  The top left corner of the square, and the length of its sides.       */
+    double x_min, y_max, size;
+
+    /*  Iterations added per zoom level, on top of fractal.max_iters. The     *
+     *  smooth coloring does not depend on max_iters, so the levels match.    */
+    unsigned int zoom_iters;
+
+    /*  Hash of everything above, see fractal_tilemap_fingerprint.            */
+    unsigned long long fingerprint;
+};
+
+/*  Names a tile. Two tiles with the same key have the same pixels.           */
+struct fractal_tilemap_key {
+    unsigned long long fingerprint;
+    unsigned int z;
+    unsigned long long x, y;
+};
+
+/*  An encoded tile in the memory cache. Entries are in a list from the most  *
+ *  to the least recently used, and in a hash table chained through next.     */
+struct fractal_tilemap_entry {
+    struct fractal_tilemap_key key;
+    unsigned char *data;
+    size_t size;
+    struct fractal_tilemap_entry *newer, *older, *next;
+};
+
+/*  The memory cache, holding at most capacity bytes of tiles.                */
+struct fractal_tilemap_cache {
+    struct fractal_tilemap_entry **buckets;
+    size_t number_of_buckets;
+    struct fractal_tilemap_entry *newest, *oldest;
+    size_t bytes, capacity, number_of_entries;
+};
+
+/*  Where a tile came from, see fractal_tilemap_get.                          */
+enum fractal_tilemap_source {
+    FRACTAL_TILEMAP_FROM_MEMORY,
+    FRACTAL_TILEMAP_FROM_DISK,
+    FRACTAL_TILEMAP_DRAWN
+};
+
+/******************************************************************************
+ *  Struct:                                                                   *
+ *      fractal_tilemap                                                       *
+ *  Purpose:                                                                  *
+ *      The layers, the caches, and the buffers used to draw a tile. Set up   *
+ *      with fractal_tilemap_init and fractal_tilemap_add.                    *
+ ******************************************************************************/
+struct fractal_tilemap {
+    struct fractal_tilemap_layer layers[FRACTAL_TILEMAP_MAX_LAYERS];
+    unsigned int number_of_layers;
+
+    struct fractal_tilemap_cache cache;
+
+    /*  The directory tiles are saved in, or NULL for memory only.            */
+    const char *directory;
+
+    /*  The threads used to draw a tile.                                      */
+    unsigned int number_of_threads;
+
+    /*  The coloring, and the palette it indexes.                             */
+    struct fractal_colormap colormap;
+    unsigned char palette[256U * 3U];
+
+    /*  The palette indices of the tile being drawn.                          */
+    unsigned char *pixels;
+
+    /*  The number of tiles taken from each source.                           */
+    unsigned long long served[3];
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_hash                                                  *
+ *  Purpose:                                                                  *
+ *      Adds bytes to a 64-bit FNV-1a hash.                                   *
+ *  Arguments:                                                                *
+ *      hash (unsigned long long):                                            *
+ *          The hash so far, 0xCBF29CE484222325 for none.                     *
+ *      data (const void *):                                                  *
+ *          The bytes.                                                        *
+ *      size (size_t):                                                        *
+ *          The number of bytes.                                              *
+ *  Output:                                                                   *
+ *      hash (unsigned long long):                                            *
+ *          The hash with the bytes added.                                    *
+ ******************************************************************************/
+static inline unsigned long long
+fractal_tilemap_hash(unsigned long long hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t n;
+
+    for (n = 0U; n < size; ++n)
+    {
+        hash ^= bytes[n];
+        hash = (hash * 0x100000001B3ULL) & 0xFFFFFFFFFFFFFFFFULL;
+    }
+
+    return hash;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_fingerprint                                           *
+ *  Purpose:                                                                  *
+ *      Hashes the parameters of a layer that change its pixels.              *
+ *  Arguments:                                                                *
+ *      layer (const struct fractal_tilemap_layer *):                         *
+ *          The layer.                                                        *
+ *  Output:                                                                   *
+ *      fingerprint (unsigned long long):                                     *
+ *          The hash.                                                         *
+ *  Method:                                                                   *
+ *      The parameters are printed to a string, doubles to 17 digits, and     *
+ *      the string is hashed. Unlike hashing the structs, this does not       *
+ *      depend on padding, and is the same on every machine.                  *
+ ******************************************************************************/
+static inline unsigned long long
+fractal_tilemap_fingerprint(const struct fractal_tilemap_layer *layer)
+{
+    const struct fractal * const f = &layer->fractal;
+    char text[512];
+
+    const int length = snprintf(
+        text, sizeof(text),
+        "%u %u %s %d %.17g %u %.17g %d %d %d %d %.17g %.17g %.17g %.17g %u",
+        FRACTAL_TILEMAP_VERSION, FRACTAL_TILEMAP_SIZE, layer->name,
+        (int)f->type, f->power, f->max_iters, f->escape_radius,
+        (int)f->escape_test, f->start_at_c, f->skip_interior,
+        f->check_period, f->period_tolerance,
+        layer->x_min, layer->y_max, layer->size, layer->zoom_iters
+    );
+
+    return fractal_tilemap_hash(0xCBF29CE484222325ULL, text, (size_t)length);
+}
+
+/*  The bucket of a key in the memory cache, mixing the hash of its parts.    */
+static inline size_t
+fractal_tilemap_bucket(const struct fractal_tilemap_cache *cache,
+                       const struct fractal_tilemap_key *key)
+{
+    unsigned long long hash = key->fingerprint;
+
+    hash = fractal_tilemap_hash(hash, &key->z, sizeof(key->z));
+    hash = fractal_tilemap_hash(hash, &key->x, sizeof(key->x));
+    hash = fractal_tilemap_hash(hash, &key->y, sizeof(key->y));
+    return (size_t)(hash % (unsigned long long)cache->number_of_buckets);
+}
+
+/*  Compares two keys. Returns non-zero if they name the same tile.           */
+static inline int
+fractal_tilemap_same_key(const struct fractal_tilemap_key *a,
+                         const struct fractal_tilemap_key *b)
+{
+    return a->fingerprint == b->fingerprint && a->z == b->z &&
+           a->x == b->x && a->y == b->y;
+}
+
+/*  Takes an entry out of the list of recently used tiles.                    */
+static inline void
+fractal_tilemap_unlink(struct fractal_tilemap_cache *cache,
+                       struct fractal_tilemap_entry *entry)
+{
+    if (entry->newer)
+        entry->newer->older = entry->older;
+    else
+        cache->newest = entry->older;
+
+    if (entry->older)
+        entry->older->newer = entry->newer;
+    else
+        cache->oldest = entry->newer;
+}
+
+/*  Puts an entry at the front of the list of recently used tiles.            */
+static inline void
+fractal_tilemap_link(struct fractal_tilemap_cache *cache,
+                     struct fractal_tilemap_entry *entry)
+{
+    entry->newer = NULL;
+    entry->older = cache->newest;
+
+    if (cache->newest)
+        cache->newest->newer = entry;
+    else
+        cache->oldest = entry;
+
+    cache->newest = entry;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_cache_find                                            *
+ *  Purpose:                                                                  *
+ *      Looks a tile up in the memory cache, marking it as the most recently  *
+ *      used if found.                                                        *
+ *  Arguments:                                                                *
+ *      cache (struct fractal_tilemap_cache *):                               *
+ *          The cache.                                                        *
+ *      key (const struct fractal_tilemap_key *):                             *
+ *          The tile.                                                         *
+ *  Output:                                                                   *
+ *      entry (struct fractal_tilemap_entry *):                               *
+ *          The tile, or NULL if it is not in the cache.                      *
+ ******************************************************************************/
+static inline struct fractal_tilemap_entry *
+fractal_tilemap_cache_find(struct fractal_tilemap_cache *cache,
+                           const struct fractal_tilemap_key *key)
+{
+    struct fractal_tilemap_entry *entry;
+
+    entry = cache->buckets[fractal_tilemap_bucket(cache, key)];
+
+    while (entry && !fractal_tilemap_same_key(&entry->key, key))
+        entry = entry->next;
+
+    if (entry && entry != cache->newest)
+    {
+        fractal_tilemap_unlink(cache, entry);
+        fractal_tilemap_link(cache, entry);
+    }
+
+    return entry;
+}
+
+/*  Removes the least recently used tile from the memory cache.               */
+static inline void
+fractal_tilemap_cache_evict(struct fractal_tilemap_cache *cache)
+{
+    struct fractal_tilemap_entry * const entry = cache->oldest;
+    struct fractal_tilemap_entry **link;
+
+    link = &cache->buckets[fractal_tilemap_bucket(cache, &entry->key)];
+
+    while (*link != entry)
+        link = &(*link)->next;
+
+    *link = entry->next;
+    fractal_tilemap_unlink(cache, entry);
+
+    cache->bytes -= entry->size;
+    cache->number_of_entries -= 1U;
+    free(entry->data);
+    free(entry);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_cache_insert                                          *
+ *  Purpose:                                                                  *
+ *      Adds a tile, which must not already be there, to the memory cache,    *
+ *      dropping the least recently used tiles until it fits.                 *
+ *  Arguments:                                                                *
+ *      cache (struct fractal_tilemap_cache *):                               *
+ *          The cache.                                                        *
+ *      key (const struct fractal_tilemap_key *):                             *
+ *          The tile.                                                         *
+ *      data (unsigned char *):                                               *
+ *          The encoded tile, allocated with malloc. The cache takes it over, *
+ *          and frees it on failure.                                          *
+ *      size (size_t):                                                        *
+ *          The number of bytes in data.                                      *
+ *  Output:                                                                   *
+ *      entry (struct fractal_tilemap_entry *):                               *
+ *          The new entry, or NULL if malloc fails.                           *
+ *  Notes:                                                                    *
+ *      A tile larger than the whole cache is still added, on its own, so     *
+ *      that the caller can use it until the next call.                       *
+ ******************************************************************************/
+static inline struct fractal_tilemap_entry *
+fractal_tilemap_cache_insert(struct fractal_tilemap_cache *cache,
+                             const struct fractal_tilemap_key *key,
+                             unsigned char *data, size_t size)
+{
+    struct fractal_tilemap_entry * const entry = malloc(sizeof(*entry));
+    size_t bucket;
+
+    if (!entry)
+    {
+        free(data);
+        return NULL;
+    }
+
+    while (cache->oldest && cache->bytes + size > cache->capacity)
+        fractal_tilemap_cache_evict(cache);
+
+    bucket = fractal_tilemap_bucket(cache, key);
+    entry->key = *key;
+    entry->data = data;
+    entry->size = size;
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    fractal_tilemap_link(cache, entry);
+
+    cache->bytes += size;
+    cache->number_of_entries += 1U;
+    return entry;
+}
+
+/*  Frees every tile in the memory cache, and the table.                      */
+static inline void
+fractal_tilemap_cache_free(struct fractal_tilemap_cache *cache)
+{
+    while (cache->oldest)
+        fractal_tilemap_cache_evict(cache);
+
+    free(cache->buckets);
+    cache->buckets = NULL;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_init                                                  *
+ *  Purpose:                                                                  *
+ *      Sets up a tilemap with no layers.                                     *
+ *  Arguments:                                                                *
+ *      map (struct fractal_tilemap *):                                       *
+ *          The tilemap.                                                      *
+ *      cache_bytes (size_t):                                                 *
+ *          The most bytes of encoded tiles kept in memory.                   *
+ *      directory (const char *):                                             *
+ *          The directory tiles are saved in, made if missing, or NULL to     *
+ *          keep tiles in memory only. The string must outlive the tilemap.   *
+ *      number_of_threads (unsigned int):                                     *
+ *          The threads used to draw each tile.                               *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 if memory could not be allocated or the          *
+ *          directory could not be made.                                      *
+ *  Notes:                                                                    *
+ *      Call fractal_tilemap_free when done, even if this fails.              *
+ ******************************************************************************/
+static inline int
+fractal_tilemap_init(struct fractal_tilemap *map, size_t cache_bytes,
+                     const char *directory, unsigned int number_of_threads)
+{
+    const size_t number_of_pixels
+        = (size_t)FRACTAL_TILEMAP_SIZE * (size_t)FRACTAL_TILEMAP_SIZE;
+
+    /*  Tiles are a few kilobytes to a few tens of kilobytes each.            */
+    size_t number_of_buckets = cache_bytes / 4096U;
+
+    if (number_of_buckets < 64U)
+        number_of_buckets = 64U;
+
+    map->number_of_layers = 0U;
+    map->directory = directory;
+    map->number_of_threads = number_of_threads;
+    map->served[0] = map->served[1] = map->served[2] = 0U;
+
+    map->cache.number_of_buckets = number_of_buckets;
+    map->cache.newest = map->cache.oldest = NULL;
+    map->cache.bytes = map->cache.number_of_entries = 0U;
+    map->cache.capacity = cache_bytes;
+    map->cache.buckets = calloc(number_of_buckets, sizeof(*map->cache.buckets));
+
+    map->pixels = malloc(number_of_pixels);
+    fractal_smooth_colormap(map->palette);
+
+    if (fractal_colormap_init(&map->colormap) != 0)
+        return -1;
+
+    if (!map->cache.buckets || !map->pixels)
+        return -1;
+
+    if (directory && mkdir(directory, 0755) != 0 && errno != EEXIST)
+        return -1;
+
+    return 0;
+}
+
+/*  Frees everything allocated by fractal_tilemap_init.                       */
+static inline void
+fractal_tilemap_free(struct fractal_tilemap *map)
+{
+    fractal_tilemap_cache_free(&map->cache);
+    fractal_colormap_free(&map->colormap);
+    free(map->pixels);
+    map->pixels = NULL;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_add                                                   *
+ *  Purpose:                                                                  *
+ *      Adds a layer to a tilemap.                                            *
+ *  Arguments:                                                                *
+ *      map (struct fractal_tilemap *):                                       *
+ *          The tilemap.                                                      *
+ *      name (const char *):                                                  *
+ *          The name of the layer, see FRACTAL_TILEMAP_MAX_NAME.              *
+ *      f (const struct fractal *):                                           *
+ *          The fractal, which is copied.                                     *
+ *      center_x (double):                                                    *
+ *          The real part of the center of the tile (0, 0, 0).                *
+ *      center_y (double):                                                    *
+ *          The imaginary part of the center of the tile (0, 0, 0).           *
+ *      size (double):                                                        *
+ *          The length of the sides of the tile (0, 0, 0).                    *
+ *      zoom_iters (unsigned int):                                            *
+ *          Iterations added per zoom level.                                  *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 if the name is not allowed or there are too      *
+ *          many layers.                                                      *
+ ******************************************************************************/
+static inline int
+fractal_tilemap_add(struct fractal_tilemap *map, const char *name,
+                    const struct fractal *f, double center_x,
+                    double center_y, double size, unsigned int zoom_iters)
+{
+    struct fractal_tilemap_layer *layer;
+    const size_t length = strlen(name);
+    size_t n;
+
+    if (map->number_of_layers == FRACTAL_TILEMAP_MAX_LAYERS ||
+        length == 0U || length > FRACTAL_TILEMAP_MAX_NAME)
+        return -1;
+
+    for (n = 0U; n < length; ++n)
+    {
+        const char c = name[n];
+
+        if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+              (c >= '0' && c <= '9') || c == '_' || c == '-'))
+            return -1;
+    }
+
+    layer = &map->layers[map->number_of_layers];
+    memcpy(layer->name, name, length + 1U);
+    layer->fractal = *f;
+    layer->x_min = center_x - 0.5*size;
+    layer->y_max = center_y + 0.5*size;
+    layer->size = size;
+    layer->zoom_iters = zoom_iters;
+    layer->fingerprint = fractal_tilemap_fingerprint(layer);
+
+    map->number_of_layers += 1U;
+    return 0;
+}
+
+/*  Finds a layer by name. Returns NULL if there is no such layer.            */
+static inline const struct fractal_tilemap_layer *
+fractal_tilemap_find(const struct fractal_tilemap *map,
+                     const char *name, size_t length)
+{
+    unsigned int n;
+
+    for (n = 0U; n < map->number_of_layers; ++n)
+    {
+        const struct fractal_tilemap_layer * const layer = &map->layers[n];
+
+        if (strlen(layer->name) == length &&
+            memcmp(layer->name, name, length) == 0)
+            return layer;
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_setup                                                 *
+ *  Purpose:                                                                  *
+ *      Sets up the fractal, viewport, and precision for drawing a tile.      *
+ *  Arguments:                                                                *
+ *      layer (const struct fractal_tilemap_layer *):                         *
+ *          The layer.                                                        *
+ *      key (const struct fractal_tilemap_key *):                             *
+ *          The tile.                                                         *
+ *      f (struct fractal *):                                                 *
+ *          The fractal for the tile, with more iterations for deeper tiles.  *
+ *      vp (struct fractal_viewport *):                                       *
+ *          The viewport. For double-double, the offsets from center.         *
+ *      center (struct fractal_dd_complex *):                                 *
+ *          The center of the tile in double-double precision.                *
+ *  Output:                                                                   *
+ *      precision (int):                                                      *
+ *          FRACTAL_PRECISION_DOUBLE or FRACTAL_PRECISION_DOUBLE_DOUBLE, or   *
+ *          FRACTAL_TILEMAP_UNAVAILABLE if the tile does not exist or is too  *
+ *          deep to draw.                                                     *
+ *  Method:                                                                   *
+ *      The center of column x is x_min + (x + 1/2) * width, with width the   *
+ *      side of a tile, size / 2^z. The product is exact in double-double,    *
+ *      see fractal_dd_two_prod, so the center is good to about 32 digits.    *
+ ******************************************************************************/
+static inline int
+fractal_tilemap_setup(const struct fractal_tilemap_layer *layer,
+                      const struct fractal_tilemap_key *key,
+                      struct fractal *f, struct fractal_viewport *vp,
+                      struct fractal_dd_complex *center)
+{
+    const double width = ldexp(layer->size, -(int)key->z);
+    const double step = width / (double)FRACTAL_TILEMAP_SIZE;
+    enum fractal_precision precision;
+    struct fractal_dd offset;
+
+    if (key->z > FRACTAL_TILEMAP_MAX_ZOOM || key->x >> key->z ||
+        key->y >> key->z)
+        return FRACTAL_TILEMAP_UNAVAILABLE;
+
+    fractal_dd_two_prod(&offset, (double)key->x + 0.5, width);
+    fractal_dd_add_double(&center->real, &offset, layer->x_min);
+    fractal_dd_two_prod(&offset, (double)key->y + 0.5, -width);
+    fractal_dd_add_double(&center->imag, &offset, layer->y_max);
+
+    precision = fractal_precision_select(center->real.hi, center->imag.hi,
+                                         step);
+
+    if (precision == FRACTAL_PRECISION_PERTURBATION ||
+        (precision == FRACTAL_PRECISION_DOUBLE_DOUBLE &&
+         layer->fractal.type != FRACTAL_MANDELBROT))
+        return FRACTAL_TILEMAP_UNAVAILABLE;
+
+    *f = layer->fractal;
+    f->max_iters += key->z * layer->zoom_iters;
+
+    /*  The period check must not mistake neighboring pixels for a cycle.     */
+    fractal_limit_period_tolerance(f, step);
+
+    /*  The centers of the pixels, top row first.                             */
+    vp->width = vp->height = FRACTAL_TILEMAP_SIZE;
+    vp->x_start = 0.5*(step - width);
+    vp->y_start = 0.5*(width - step);
+    vp->x_step = step;
+    vp->y_step = -step;
+
+    if (precision == FRACTAL_PRECISION_DOUBLE)
+    {
+        vp->x_start += center->real.hi;
+        vp->y_start += center->imag.hi;
+    }
+
+    return (int)precision;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_draw                                                  *
+ *  Purpose:                                                                  *
+ *      Draws a tile and encodes it as a GIF.                                 *
+ *  Arguments:                                                                *
+ *      map (struct fractal_tilemap *):                                       *
+ *          The tilemap.                                                      *
+ *      layer (const struct fractal_tilemap_layer *):                         *
+ *          The layer.                                                        *
+ *      key (const struct fractal_tilemap_key *):                             *
+ *          The tile.                                                         *
+ *      data (unsigned char **):                                              *
+ *          Set to the GIF, allocated with malloc.                            *
+ *      size (size_t *):                                                      *
+ *          Set to the number of bytes in the GIF.                            *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, FRACTAL_TILEMAP_UNAVAILABLE if the tile does not    *
+ *          exist or is too deep to draw, and -1 if it could not be drawn.    *
+ ******************************************************************************/
+static inline int
+fractal_tilemap_draw(struct fractal_tilemap *map,
+                     const struct fractal_tilemap_layer *layer,
+                     const struct fractal_tilemap_key *key,
+                     unsigned char **data, size_t *size)
+{
+    struct fractal f;
+    struct fractal_viewport vp;
+    struct fractal_dd_complex center;
+    struct fractal_renderer renderer;
+    GifWriter writer;
+    char *buffer = NULL;
+    size_t length = 0U;
+    FILE *stream;
+    int status = 0;
+
+    const int precision = fractal_tilemap_setup(layer, key, &f, &vp, &center);
+
+    if (precision < 0)
+        return precision;
+
+    renderer.fractal = &f;
+    renderer.viewport = &vp;
+    renderer.color = fractal_index_smooth;
+    renderer.channels = 1U;
+    renderer.reference = NULL;
+    renderer.center =
+        (precision == FRACTAL_PRECISION_DOUBLE_DOUBLE ? &center : NULL);
+    renderer.colormap = &map->colormap;
+    renderer.subdivide = FRACTAL_SUBDIVIDE_NONE;
+
+    fractal_render_parallel(&renderer, map->pixels, map->number_of_threads);
+
+    /*  GifEnd closes the stream, which sets buffer and length.               */
+    stream = open_memstream(&buffer, &length);
+
+    if (!GifBeginStream(&writer, stream, FRACTAL_TILEMAP_SIZE,
+                        FRACTAL_TILEMAP_SIZE, 0U, map->palette, 8) ||
+        !GifWriteIndexedFrame(&writer, map->pixels, FRACTAL_TILEMAP_SIZE,
+                              FRACTAL_TILEMAP_SIZE, 0U))
+        status = -1;
+
+    GifEnd(&writer);
+
+    if (status != 0 || !buffer)
+    {
+        free(buffer);
+        return -1;
+    }
+
+    *data = (unsigned char *)buffer;
+    *size = length;
+    return 0;
+}
+
+/*  The file a tile is saved in, directory/name-fingerprint-z-x-y.gif.        *
+ *  Returns 0, or -1 if the path does not fit.                                */
+static inline int
+fractal_tilemap_path(const struct fractal_tilemap *map,
+                     const struct fractal_tilemap_layer *layer,
+                     const struct fractal_tilemap_key *key,
+                     char *path, size_t path_size)
+{
+    const int length = snprintf(path, path_size,
+                                "%s/%s-%016llx-%u-%llu-%llu.gif",
+                                map->directory, layer->name, key->fingerprint,
+                                key->z, key->x, key->y);
+
+    return (length > 0 && (size_t)length < path_size) ? 0 : -1;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_load                                                  *
+ *  Purpose:                                                                  *
+ *      Reads a saved tile from the directory.                                *
+ *  Arguments:                                                                *
+ *      path (const char *):                                                  *
+ *          The file, see fractal_tilemap_path.                               *
+ *      data (unsigned char **):                                              *
+ *          Set to the GIF, allocated with malloc.                            *
+ *      size (size_t *):                                                      *
+ *          Set to the number of bytes in the GIF.                            *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 if there is no such tile or it could not be      *
+ *          read.                                                             *
+ ******************************************************************************/
+static inline int
+fractal_tilemap_load(const char *path, unsigned char **data, size_t *size)
+{
+    FILE * const f = fopen(path, "rb");
+    unsigned char *buffer = NULL;
+    size_t length = 0U, capacity = 0U;
+
+    if (!f)
+        return -1;
+
+    for (;;)
+    {
+        if (length == capacity)
+        {
+            unsigned char * const grown
+                = realloc(buffer, capacity ? 2U*capacity : 65536U);
+
+            if (!grown)
+                break;
+
+            buffer = grown;
+            capacity = capacity ? 2U*capacity : 65536U;
+        }
+
+        length += fread(buffer + length, 1U, capacity - length, f);
+
+        if (length < capacity)
+            break;
+    }
+
+    /*  A tile is never empty, and anything else here is a read error.        */
+    if (ferror(f) || !feof(f) || length == 0U)
+    {
+        fclose(f);
+        free(buffer);
+        return -1;
+    }
+
+    fclose(f);
+    *data = buffer;
+    *size = length;
+    return 0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_save                                                  *
+ *  Purpose:                                                                  *
+ *      Saves a tile to the directory.                                        *
+ *  Arguments:                                                                *
+ *      path (const char *):                                                  *
+ *          The file, see fractal_tilemap_path.                               *
+ *      data (const unsigned char *):                                         *
+ *          The GIF.                                                          *
+ *      size (size_t):                                                        *
+ *          The number of bytes in the GIF.                                   *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 if the file could not be written.                *
+ *  Method:                                                                   *
+ *      The tile is written to a temporary file which is then renamed, so     *
+ *      other programs reading the directory never see half a tile.           *
+ ******************************************************************************/
+static inline int
+fractal_tilemap_save(const char *path, const unsigned char *data, size_t size)
+{
+    char temporary[4096];
+    FILE *f;
+    int status = 0;
+
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", path)
+        >= (int)sizeof(temporary))
+        return -1;
+
+    f = fopen(temporary, "wb");
+
+    if (!f)
+        return -1;
+
+    if (fwrite(data, 1U, size, f) != size)
+        status = -1;
+
+    if (fclose(f) != 0)
+        status = -1;
+
+    if (status == 0 && rename(temporary, path) != 0)
+        status = -1;
+
+    if (status != 0)
+        remove(temporary);
+
+    return status;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_tilemap_get                                                   *
+ *  Purpose:                                                                  *
+ *      Gets a tile as a GIF, from memory, from disk, or by drawing it.       *
+ *  Arguments:                                                                *
+ *      map (struct fractal_tilemap *):                                       *
+ *          The tilemap.                                                      *
+ *      layer (const struct fractal_tilemap_layer *):                         *
+ *          The layer.                                                        *
+ *      z (unsigned int):                                                     *
+ *          The zoom level.                                                   *
+ *      x (unsigned long long):                                               *
+ *          The column, 0 <= x < 2^z.                                         *
+ *      y (unsigned long long):                                               *
+ *          The row, 0 <= y < 2^z.                                            *
+ *      data (const unsigned char **):                                        *
+ *          Set to the GIF. It belongs to the cache, and is only good until   *
+ *          the next call.                                                    *
+ *      size (size_t *):                                                      *
+ *          Set to the number of bytes in the GIF.                            *
+ *      source (enum fractal_tilemap_source *):                               *
+ *          Set to where the tile came from. May be NULL.                     *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, FRACTAL_TILEMAP_UNAVAILABLE if the tile does not    *
+ *          exist or is too deep to draw, and -1 if it could not be drawn or  *
+ *          memory could not be allocated.                                    *
+ *  Notes:                                                                    *
+ *      Failing to save a drawn tile is not an error, the tile is still kept  *
+ *      in memory.                                                            *
+ ******************************************************************************/
+static inline int
+fractal_tilemap_get(struct fractal_tilemap *map,
+                    const struct fractal_tilemap_layer *layer,
+                    unsigned int z, unsigned long long x, unsigned long long y,
+                    const unsigned char **data, size_t *size,
+                    enum fractal_tilemap_source *source)
+{
+    struct fractal_tilemap_key key;
+    struct fractal_tilemap_entry *entry;
+    enum fractal_tilemap_source from = FRACTAL_TILEMAP_FROM_MEMORY;
+    char path[4096];
+    int saved = 0, status;
+
+    key.fingerprint = layer->fingerprint;
+    key.z = z;
+    key.x = x;
+    key.y = y;
+
+    if (z > FRACTAL_TILEMAP_MAX_ZOOM || x >> z || y >> z)
+        return FRACTAL_TILEMAP_UNAVAILABLE;
+
+    entry = fractal_tilemap_cache_find(&map->cache, &key);
+
+    if (!entry)
+    {
+        unsigned char *tile;
+        size_t tile_size;
+
+        saved = map->directory &&
+                fractal_tilemap_path(map, layer, &key, path, sizeof(path)) == 0;
+
+        from = FRACTAL_TILEMAP_FROM_DISK;
+
+        if (!saved || fractal_tilemap_load(path, &tile, &tile_size) != 0)
+        {
+            from = FRACTAL_TILEMAP_DRAWN;
+
+            status = fractal_tilemap_draw(map, layer, &key, &tile, &tile_size);
+
+            if (status != 0)
+                return status;
+
+            if (saved)
+                fractal_tilemap_save(path, tile, tile_size);
+        }
+
+        entry = fractal_tilemap_cache_insert(&map->cache, &key,
+                                             tile, tile_size);
+
+        if (!entry)
+            return -1;
+    }
+
+    map->served[from] += 1U;
+
+    if (source)
+        *source = from;
+
+    *data = entry->data;
+    *size = entry->size;
+    return 0;
+}
+
+#endif
+/*  End of include guard.                                                     */
@@ -0,0 +1,337 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Frame reuse for zoom animations. Consecutive frames of a zoom differ  *
+ *      only by a small change of scale, so rather than rendering each frame  *
+ *      from scratch, a keyframe is rendered at a higher resolution every K   *
+ *      frames and the frames in between are resampled from it. Any part of a *
+ *      frame that lies outside of the keyframe (zooming out, or panning) is  *
+ *      newly exposed and is rendered directly.                               *
+ *                                                                            *
+ *      For a zoom in by a factor q per frame the keyframe must be finer than *
+ *      the frame by a factor of q^-(K-1), so that the last frame resampled   *
+ *      from it still has at least one keyframe pixel per pixel. The cost per *
+ *      frame is then q^-(2(K-1)) / K full renders. For q = 0.95 this is at   *
+ *      its smallest, about 0.25, near K = 10.                                *
+ *  Notes:                                                                    *
+ *      Resampling takes the nearest keyframe pixel, so a resampled frame is  *
+ *      the same as a render with each sample point moved by at most half a   *
+ *      keyframe pixel. It is not identical to rendering the frame directly.  *
+ *      The zoom programs only do this when asked to with --keyframes, and    *
+ *      render the first frame of each run exactly, alongside its keyframe.   *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef FRACTAL_ZOOM_H
+#define FRACTAL_ZOOM_H
+
+/*  floor and ceil found here.                                                */
+#include <math.h>
+
+/*  malloc, realloc, and free found here.                                     */
+#include <stdlib.h>
+
+/*  memcpy found here.                                                        */
+#include <string.h>
+
+/*  The fractal_renderer struct and fractal_render_rect found here.           */
+#include "fractal.h"
+
+/*  A keyframe, rendered at a higher resolution than the frames using it.     */
+struct fractal_keyframe {
+
+    /*  The keyframe image, viewport.width * viewport.height pixels.          */
+    unsigned char *pixels;
+
+    /*  The number of bytes allocated for pixels.                             */
+    size_t capacity;
+
+    /*  The points the keyframe pixels correspond to.                         */
+    struct fractal_viewport viewport;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_keyframe_init                                                 *
+ *  Purpose:                                                                  *
+ *      Sets up an empty keyframe.                                            *
+ *  Arguments:                                                                *
+ *      kf (struct fractal_keyframe *):                                       *
+ *          The keyframe.                                                     *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_keyframe_init(struct fractal_keyframe *kf)
+{
+    kf->pixels = NULL;
+    kf->capacity = 0U;
+    kf->viewport.width = 0U;
+    kf->viewport.height = 0U;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_keyframe_free                                                 *
+ *  Purpose:                                                                  *
+ *      Frees the memory used by a keyframe.                                  *
+ *  Arguments:                                                                *
+ *      kf (struct fractal_keyframe *):                                       *
+ *          The keyframe.                                                     *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_keyframe_free(struct fractal_keyframe *kf)
+{
+    free(kf->pixels);
+    fractal_keyframe_init(kf);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_keyframe_begin                                                *
+ *  Purpose:                                                                  *
+ *      Sets the viewport of a keyframe, covering the same region as a frame  *
+ *      but with more pixels, and allocates room for it.                      *
+ *  Arguments:                                                                *
+ *      kf (struct fractal_keyframe *):                                       *
+ *          The keyframe.                                                     *
+ *      vp (const struct fractal_viewport *):                                 *
+ *          The viewport of the frame.                                        *
+ *      oversample (double):                                                  *
+ *          The number of keyframe pixels per frame pixel, along each axis.   *
+ *      channels (unsigned int):                                              *
+ *          The number of bytes per pixel, 3 for RGB or 4 for RGBA.           *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ *  Notes:                                                                    *
+ *      For deep zooms, fractal_series_compute should be called with the      *
+ *      keyframe viewport before calling fractal_keyframe_render.             *
+ ******************************************************************************/
+static inline int
+fractal_keyframe_begin(struct fractal_keyframe *kf,
+                       const struct fractal_viewport *vp,
+                       double oversample, unsigned int channels)
+{
+    struct fractal_viewport * const kv = &kf->viewport;
+    size_t size;
+
+    if (oversample < 1.0)
+        oversample = 1.0;
+
+    /*  The first and last pixels are at the same points as in the frame.     */
+    kv->width = 1U + (unsigned int)ceil((double)(vp->width - 1U) * oversample);
+    kv->height
+        = 1U + (unsigned int)ceil((double)(vp->height - 1U) * oversample);
+
+    kv->x_start = vp->x_start;
+    kv->y_start = vp->y_start;
+    kv->x_step = vp->x_step * (double)(vp->width - 1U);
+    kv->y_step = vp->y_step * (double)(vp->height - 1U);
+
+    if (kv->width > 1U)
+        kv->x_step /= (double)(kv->width - 1U);
+
+    if (kv->height > 1U)
+        kv->y_step /= (double)(kv->height - 1U);
+
+    size = (size_t)kv->width * (size_t)kv->height * channels;
+
+    if (size > kf->capacity)
+    {
+        unsigned char * const pixels = realloc(kf->pixels, size);
+
+        if (!pixels)
+            return -1;
+
+        kf->pixels = pixels;
+        kf->capacity = size;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_keyframe_render                                               *
+ *  Purpose:                                                                  *
+ *      Renders a keyframe set up with fractal_keyframe_begin.                *
+ *  Arguments:                                                                *
+ *      kf (struct fractal_keyframe *):                                       *
+ *          The keyframe.                                                     *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, coloring, and pixel format. The viewport is ignored  *
+ *          and the keyframe viewport is used instead.                        *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static inline void
+fractal_keyframe_render(struct fractal_keyframe *kf,
+                        const struct fractal_renderer *r)
+{
+    struct fractal_renderer keyframe_renderer = *r;
+    keyframe_renderer.viewport = &kf->viewport;
+    fractal_render(&keyframe_renderer, kf->pixels);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_keyframe_index                                                *
+ *  Purpose:                                                                  *
+ *      Finds the nearest keyframe pixel along one axis.                      *
+ *  Arguments:                                                                *
+ *      point (double):                                                       *
+ *          The coordinate of the frame pixel.                                *
+ *      start (double):                                                       *
+ *          The coordinate of the first keyframe pixel.                       *
+ *      step (double):                                                        *
+ *          The distance between keyframe pixels.                             *
+ *      size (unsigned int):                                                  *
+ *          The number of keyframe pixels along the axis.                     *
+ *  Output:                                                                   *
+ *      index (long):                                                         *
+ *          The index of the nearest keyframe pixel, -1 if outside of it.     *
+ ******************************************************************************/
+static inline long
+fractal_keyframe_index(double point, double start, double step,
+                       unsigned int size)
+{
+    const double index = floor((point - start) / step + 0.5);
+
+    if (index < 0.0 || index >= (double)size)
+        return -1L;
+
+    return (long)index;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_keyframe_resample                                             *
+ *  Purpose:                                                                  *
+ *      Draws a frame from a keyframe. Pixels the keyframe covers are copied  *
+ *      from the nearest keyframe pixel, and the rest are rendered.           *
+ *  Arguments:                                                                *
+ *      kf (const struct fractal_keyframe *):                                 *
+ *          The keyframe.                                                     *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, coloring, and pixel format of the frame.   *
+ *          Must be in the same coordinates as the keyframe (both ordinary,   *
+ *          or both offsets from the same center).                            *
+ *      buffer (unsigned char *):                                             *
+ *          The frame, width * height * channels bytes.                       *
+ *  Output:                                                                   *
+ *      rendered (size_t):                                                    *
+ *          The number of pixels that had to be rendered.                     *
+ *  Method:                                                                   *
+ *      Both viewports are affine, so the frame columns inside the keyframe   *
+ *      form one range x_begin <= x < x_end, and likewise for the rows. The   *
+ *      border outside of this rectangle is at most four rectangles, which    *
+ *      are drawn with fractal_render_rect.                                   *
+ ******************************************************************************/
+static inline size_t
+fractal_keyframe_resample(const struct fractal_keyframe *kf,
+                          const struct fractal_renderer *r,
+                          unsigned char *buffer)
+{
+    const struct fractal_viewport * const vp = r->viewport;
+    const struct fractal_viewport * const kv = &kf->viewport;
+    const unsigned int channels = r->channels;
+    const size_t row_size = (size_t)vp->width * channels;
+    unsigned int x_begin = vp->width, x_end = 0U;
+    unsigned int y_begin = vp->height, y_end = 0U;
+    unsigned int x, y;
+    size_t *column;
+
+    /*  Byte offsets of the keyframe pixel for each column of the frame.      */
+    column = malloc(sizeof(*column) * vp->width);
+
+    if (column)
+    {
+        for (x = 0U; x < vp->width; ++x)
+        {
+            const long index = fractal_keyframe_index(
+                vp->x_start + (double)x * vp->x_step,
+                kv->x_start, kv->x_step, kv->width
+            );
+
+            if (index < 0L)
+                continue;
+
+            if (x < x_begin)
+                x_begin = x;
+
+            x_end = x + 1U;
+            column[x] = (size_t)index * channels;
+        }
+
+        for (y = 0U; y < vp->height; ++y)
+        {
+            const long index = fractal_keyframe_index(
+                vp->y_start + (double)y * vp->y_step,
+                kv->y_start, kv->y_step, kv->height
+            );
+            const unsigned char *source;
+            unsigned char *pixel;
+
+            if (index < 0L || x_begin >= x_end)
+                continue;
+
+            if (y < y_begin)
+                y_begin = y;
+
+            y_end = y + 1U;
+            source = kf->pixels + (size_t)index * kv->width * channels;
+            pixel = buffer + (size_t)y * row_size + (size_t)x_begin * channels;
+
+            for (x = x_begin; x < x_end; ++x)
+            {
+                memcpy(pixel, source + column[x], channels);
+                pixel += channels;
+            }
+        }
+
+        free(column);
+    }
+
+    /*  Nothing could be resampled. Render the entire frame.                  */
+    if (y_begin >= y_end)
+    {
+        fractal_render(r, buffer);
+        return (size_t)vp->width * (size_t)vp->height;
+    }
+
+    /*  The rows above and below the keyframe.                                */
+    fractal_render_rect(r, buffer, 0U, 0U, vp->width, y_begin);
+    fractal_render_rect(r, buffer + y_end * row_size,
+                        0U, y_end, vp->width, vp->height);
+
+    /*  The columns to the left and right of it.                              */
+    fractal_render_rect(r, buffer + y_begin * row_size,
+                        0U, y_begin, x_begin, y_end);
+    fractal_render_rect(r, buffer + y_begin * row_size,
+                        x_end, y_begin, vp->width, y_end);
+
+    return (size_t)vp->width * (size_t)vp->height
+         - (size_t)(x_end - x_begin) * (size_t)(y_end - y_begin);
+}
+
+#endif
+/*  End of include guard.                                                     */
@@ -16,6 +16,9 @@
  *  You should have received a copy of the GNU General Public License         *
  *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
  ******************************************************************************/
+#ifndef GIF_H
+#define GIF_H
+
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
@@ -23,13 +26,71 @@
 #include <math.h>
 #include <stdlib.h>
 
+// Dithering can be spread across threads with pthreads. Define GIF_NO_THREADS to
+// always dither on the calling thread.
+#if !defined(GIF_NO_THREADS) && !defined(_WIN32)
+#define GIF_THREADS
+#include <pthread.h>
+#endif
+
 static const int kGifTransIndex = 0;
 
+// A distinct color of an image and the number of pixels with that color
+typedef struct
+{
+    uint8_t comp[3];  // r, g, b
+    uint32_t count;
+} GifHistColor;
+
+// Buffers reused by GifMakePalette from one frame to the next, so that building a
+// palette allocates nothing once the first frame is done
+typedef struct
+{
+    uint32_t generation;   // hash keys tagged with another generation are empty
+    uint32_t hashBits;     // the hash table has 1 << hashBits slots
+    uint32_t* hashKeys;    // generation << 24 | r << 16 | g << 8 | b
+    uint32_t* hashColors;  // index of the color in colors
+
+    uint32_t capacity;     // room in colors and sorted
+    GifHistColor* colors;  // the histogram, the distinct colors of the image
+    GifHistColor* sorted;  // scratch for sorting the histogram
+} GifPaletteScratch;
+
+#ifndef GIF_COLOR_CACHE_BITS
+#define GIF_COLOR_CACHE_BITS 14
+#endif
+
+// Nearest palette colors found so far for the frame being dithered, direct-mapped
+// on the color, so that repeated colors skip the k-d tree
+typedef struct
+{
+    uint32_t generation;                       // keys tagged with another generation are stale
+    uint32_t keys[1 << GIF_COLOR_CACHE_BITS];  // generation << 24 | r << 16 | g << 8 | b
+    uint8_t indices[1 << GIF_COLOR_CACHE_BITS];
+} GifColorCache;
+
+// Buffers reused by GifDitherImage from one frame to the next
+typedef struct
+{
+    uint32_t capacity;      // room in quantPixels, in pixels
+    int32_t* quantPixels;   // color*256 of each pixel, plus the error diffused into it
+    uint32_t rowCapacity;   // room in rowDone
+    uint32_t* rowDone;      // pixels of each row dithered so far, when threaded
+    int numCaches;
+    GifColorCache* caches;  // one for each thread
+} GifDitherScratch;
+
 typedef struct
 {
     FILE* f;
     uint8_t* oldImage;
     bool firstFrame;
+    GifPaletteScratch paletteScratch;
+    GifDitherScratch ditherScratch;
+    int ditherThreads;   // threads GifDitherImage may use, 1 unless set after GifBegin
+    int globalBitDepth;  // bit depth of the global color table set by GifBeginWithPalette, 0 if none
+    uint32_t* rowSpans;  // first and one past the last changed column of each row of a frame
+    uint32_t maxRects;   // most sub-images a frame is split into, 1 unless set after GifBegin
 } GifWriter;
 
 typedef struct
@@ -47,23 +108,48 @@ typedef struct
     uint8_t treeSplit[256];
 } GifPalette;
 
-// Simple structure to write out the LZW-compressed portion of the image
-// one bit at a time
+// Size of the buffer the LZW-compressed image is collected in before going to the file
+#define GIF_OUT_BUFFER_SIZE 16384
+
+// Simple structure to write out the LZW-compressed portion of the image.
+// Codes are packed into a 64-bit word and whole bytes are moved from it to a buffer,
+// already split into the 255-byte sub-blocks of the file format.
 typedef struct
 {
-    uint8_t bitIndex;  // how many bits in the partial byte written so far
-    uint8_t byte;      // current partial byte
+    uint64_t bits;        // bits not yet moved to the buffer, the first in the lowest place
+    uint32_t bitCount;    // how many bits are held in bits
+
+    uint32_t chunkIndex;  // bytes in the current sub-block, 0 if none is open
+    uint32_t chunkStart;  // position of the length byte of the current sub-block
 
-    uint32_t chunkIndex;
-    uint8_t chunk[256];   // bytes are written in here until we have 256 of them, then written to the file
+    uint32_t outIndex;    // bytes in out
+    uint8_t out[GIF_OUT_BUFFER_SIZE];  // sub-blocks waiting to be written to the file
 } GifBitStatus;
 
-// The LZW dictionary is a 256-ary tree constructed as the file is encoded,
-// this is one node
+// The LZW dictionary maps a run (the code of the run minus its last index, and that
+// index) to the code of the run. It is an open-addressed hash table, at most half full.
+// Each entry is tagged with the generation of the dictionary it belongs to, so
+// clearing the dictionary only increments the generation.
+#define GIF_LZW_HASH_BITS 13
+#define GIF_LZW_HASH_SIZE (1 << GIF_LZW_HASH_BITS)
+
 typedef struct
 {
-    uint16_t m_next[256];
-} GifLzwNode;
+    uint32_t generation;                // entries tagged with another generation are empty
+    uint32_t tag[GIF_LZW_HASH_SIZE];    // generation << 20 | code << 8 | index
+    uint16_t code[GIF_LZW_HASH_SIZE];
+} GifLzwDict;
+
+// A rectangle of the canvas, written out as one sub-image
+typedef struct
+{
+    uint32_t left, top, width, height;
+} GifRect;
+
+// most rectangles a frame can be split into, see GifWriter::maxRects
+#ifndef GIF_MAX_RECTS
+#define GIF_MAX_RECTS 16
+#endif
 
 // max, min, and abs functions
 static int GifIMax(int l, int r) { return l>r?l:r; }
@@ -124,83 +210,140 @@ GifGetClosestPaletteColor(GifPalette* pPal, int r, int g, int b,
     }
 }
 
-static void GifSwapPixels(uint8_t* image, int pixA, int pixB)
+static void GifInitPaletteScratch(GifPaletteScratch* scratch)
+{
+    memset(scratch, 0, sizeof(*scratch));
+}
+
+static void GifFreePaletteScratch(GifPaletteScratch* scratch)
 {
-    uint8_t rA = image[pixA*4];
-    uint8_t gA = image[pixA*4+1];
-    uint8_t bA = image[pixA*4+2];
-    uint8_t aA = image[pixA*4+3];
+    free(scratch->hashKeys);
+    free(scratch->hashColors);
+    free(scratch->colors);
+    free(scratch->sorted);
+    GifInitPaletteScratch(scratch);
+}
 
-    uint8_t rB = image[pixB*4];
-    uint8_t gB = image[pixB*4+1];
-    uint8_t bB = image[pixB*4+2];
-    uint8_t aB = image[pixA*4+3];
+// Makes room for the histogram of an image with numPixels pixels
+static bool GifReservePaletteScratch(GifPaletteScratch* scratch, uint32_t numPixels)
+{
+    // the hash table is at most half full
+    uint32_t hashBits = 8;
+    while( (1u << hashBits) < 2*numPixels ) ++hashBits;
 
-    image[pixA*4] = rB;
-    image[pixA*4+1] = gB;
-    image[pixA*4+2] = bB;
-    image[pixA*4+3] = aB;
+    if( hashBits > scratch->hashBits )
+    {
+        free(scratch->hashKeys);
+        free(scratch->hashColors);
+        scratch->hashBits = 0;
+        scratch->hashKeys = (uint32_t*)calloc((size_t)1 << hashBits, sizeof(uint32_t));
+        scratch->hashColors = (uint32_t*)malloc(sizeof(uint32_t) << hashBits);
+        if( !scratch->hashKeys || !scratch->hashColors ) return false;
+        scratch->hashBits = hashBits;
+        scratch->generation = 0;
+    }
 
-    image[pixB*4] = rA;
-    image[pixB*4+1] = gA;
-    image[pixB*4+2] = bA;
-    image[pixB*4+3] = aA;
+    // each split of the k-d tree can cut a color in two, adding one more
+    const uint32_t capacity = numPixels + 256;
+    if( capacity > scratch->capacity )
+    {
+        free(scratch->colors);
+        free(scratch->sorted);
+        scratch->capacity = 0;
+        scratch->colors = (GifHistColor*)malloc(sizeof(GifHistColor) * capacity);
+        scratch->sorted = (GifHistColor*)malloc(sizeof(GifHistColor) * capacity);
+        if( !scratch->colors || !scratch->sorted ) return false;
+        scratch->capacity = capacity;
+    }
+
+    return true;
 }
 
-// just the partition operation from quicksort
-static int
-GifPartition(uint8_t* image, const int left, const int right,
-             const int elt, int pivotIndex)
+// Builds the histogram of the image, or of the pixels that differ from lastFrame if
+// given, in scratch->colors. Returns the number of distinct colors.
+static uint32_t
+GifBuildHistogram(const uint8_t* lastFrame, const uint8_t* frame, uint32_t numPixels,
+                  GifPaletteScratch* scratch)
 {
-    const int pivotValue = image[(pivotIndex)*4+elt];
-    GifSwapPixels(image, pivotIndex, right-1);
-    int storeIndex = left;
-    bool split = 0;
-    for(int ii=left; ii<right-1; ++ii)
+    // the generation is 8 bits, start over once it runs out
+    if( ++scratch->generation == 256 )
     {
-        int arrayVal = image[ii*4+elt];
-        if( arrayVal < pivotValue )
+        memset(scratch->hashKeys, 0, sizeof(uint32_t) << scratch->hashBits);
+        scratch->generation = 1;
+    }
+
+    const uint32_t generation = scratch->generation << 24;
+    const uint32_t mask = (1u << scratch->hashBits) - 1;
+    uint32_t numColors = 0;
+    uint32_t lastKey = 0;  // neighboring pixels are often the same color
+    GifHistColor* lastColor = NULL;
+
+    for( uint32_t ii=0; ii<numPixels; ++ii, frame += 4 )
+    {
+        if(lastFrame)
         {
-            GifSwapPixels(image, ii, storeIndex);
-            ++storeIndex;
+            const uint8_t* last = lastFrame;
+            lastFrame += 4;
+            if( last[0] == frame[0] && last[1] == frame[1] && last[2] == frame[2] )
+                continue;
         }
-        else if( arrayVal == pivotValue )
+
+        const uint32_t key = generation | (uint32_t)frame[0] << 16 | (uint32_t)frame[1] << 8 | frame[2];
+        if( lastColor && key == lastKey )
         {
-            if(split)
-            {
-                GifSwapPixels(image, ii, storeIndex);
-                ++storeIndex;
-            }
-            split = !split;
+            ++lastColor->count;
+            continue;
+        }
+
+        uint32_t slot = (key * 2654435761u) >> (32 - scratch->hashBits);
+        while( scratch->hashKeys[slot] != key && scratch->hashKeys[slot] >> 24 == scratch->generation )
+            slot = (slot + 1) & mask;
+
+        if( scratch->hashKeys[slot] != key )
+        {
+            // a new color
+            scratch->hashKeys[slot] = key;
+            scratch->hashColors[slot] = numColors;
+            GifHistColor* color = scratch->colors + numColors++;
+            color->comp[0] = frame[0];
+            color->comp[1] = frame[1];
+            color->comp[2] = frame[2];
+            color->count = 0;
         }
+
+        lastKey = key;
+        lastColor = scratch->colors + scratch->hashColors[slot];
+        ++lastColor->count;
     }
-    GifSwapPixels(image, storeIndex, right-1);
-    return storeIndex;
+
+    return numColors;
 }
 
-// Perform an incomplete sort, finding all elements above and below the desired median
+// Stable counting sort of colors by one component
 static void
-GifPartitionByMedian(uint8_t* image, int left, int right,
-                     int com, int neededCenter)
+GifSortColors(GifHistColor* colors, GifHistColor* sorted, uint32_t numColors, int com)
 {
-    if (left < right-1)
-    {
-        int pivotIndex = left + (right-left)/2;
+    uint32_t start[257] = {0};
 
-        pivotIndex = GifPartition(image, left, right, com, pivotIndex);
+    for( uint32_t ii=0; ii<numColors; ++ii )
+        ++start[colors[ii].comp[com]+1];
 
-        // Only "sort" the section of the array that contains the median
-        if(pivotIndex > neededCenter)
-            GifPartitionByMedian(image, left, pivotIndex, com, neededCenter);
+    for( int vv=0; vv<256; ++vv )
+        start[vv+1] += start[vv];
 
-        if(pivotIndex < neededCenter)
-            GifPartitionByMedian(image, pivotIndex+1, right, com, neededCenter);
-    }
+    for( uint32_t ii=0; ii<numColors; ++ii )
+        sorted[start[colors[ii].comp[com]]++] = colors[ii];
+
+    memcpy(colors, sorted, sizeof(GifHistColor) * numColors);
 }
 
-// Builds a palette by creating a balanced k-d tree of all pixels in the image
+// Builds a palette by creating a balanced k-d tree of all pixels in the image.
+// The pixels are given as a histogram of numColors colors covering numPixels pixels.
+// Each split puts exactly as many pixels on each side as a split of the pixels
+// themselves would, cutting a color in two when its pixels fall on both sides.
 static void
-GifSplitPalette(uint8_t* image, int numPixels, int firstElt, int lastElt,
+GifSplitPalette(GifHistColor* colors, GifHistColor* sorted, uint32_t numColors,
+                uint64_t numPixels, int firstElt, int lastElt,
                 int splitElt, int splitDist, int treeNode,
                 bool buildForDither, GifPalette* pal)
 {
@@ -219,11 +362,11 @@ GifSplitPalette(uint8_t* image, int numPixels, int firstElt, int lastElt,
             {
                 // special case: the darkest color in the image
                 uint32_t r=255, g=255, b=255;
-                for(int ii=0; ii<numPixels; ++ii)
+                for(uint32_t ii=0; ii<numColors; ++ii)
                 {
-                    r = (uint32_t)GifIMin((int32_t)r, image[ii * 4 + 0]);
-                    g = (uint32_t)GifIMin((int32_t)g, image[ii * 4 + 1]);
-                    b = (uint32_t)GifIMin((int32_t)b, image[ii * 4 + 2]);
+                    r = (uint32_t)GifIMin((int32_t)r, colors[ii].comp[0]);
+                    g = (uint32_t)GifIMin((int32_t)g, colors[ii].comp[1]);
+                    b = (uint32_t)GifIMin((int32_t)b, colors[ii].comp[2]);
                 }
 
                 pal->r[firstElt] = (uint8_t)r;
@@ -237,11 +380,11 @@ GifSplitPalette(uint8_t* image, int numPixels, int firstElt, int lastElt,
             {
                 // special case: the lightest color in the image
                 uint32_t r=0, g=0, b=0;
-                for(int ii=0; ii<numPixels; ++ii)
+                for(uint32_t ii=0; ii<numColors; ++ii)
                 {
-                    r = (uint32_t)GifIMax((int32_t)r, image[ii * 4 + 0]);
-                    g = (uint32_t)GifIMax((int32_t)g, image[ii * 4 + 1]);
-                    b = (uint32_t)GifIMax((int32_t)b, image[ii * 4 + 2]);
+                    r = (uint32_t)GifIMax((int32_t)r, colors[ii].comp[0]);
+                    g = (uint32_t)GifIMax((int32_t)g, colors[ii].comp[1]);
+                    b = (uint32_t)GifIMax((int32_t)b, colors[ii].comp[2]);
                 }
 
                 pal->r[firstElt] = (uint8_t)r;
@@ -254,20 +397,20 @@ GifSplitPalette(uint8_t* image, int numPixels, int firstElt, int lastElt,
 
         // otherwise, take the average of all colors in this subcube
         uint64_t r=0, g=0, b=0;
-        for(int ii=0; ii<numPixels; ++ii)
+        for(uint32_t ii=0; ii<numColors; ++ii)
         {
-            r += image[ii*4+0];
-            g += image[ii*4+1];
-            b += image[ii*4+2];
+            r += (uint64_t)colors[ii].comp[0] * colors[ii].count;
+            g += (uint64_t)colors[ii].comp[1] * colors[ii].count;
+            b += (uint64_t)colors[ii].comp[2] * colors[ii].count;
         }
 
-        r += (uint64_t)numPixels / 2;  // round to nearest
-        g += (uint64_t)numPixels / 2;
-        b += (uint64_t)numPixels / 2;
+        r += numPixels / 2;  // round to nearest
+        g += numPixels / 2;
+        b += numPixels / 2;
 
-        r /= (uint64_t)numPixels;
-        g /= (uint64_t)numPixels;
-        b /= (uint64_t)numPixels;
+        r /= numPixels;
+        g /= numPixels;
+        b /= numPixels;
 
         pal->r[firstElt] = (uint8_t)r;
         pal->g[firstElt] = (uint8_t)g;
@@ -280,11 +423,11 @@ GifSplitPalette(uint8_t* image, int numPixels, int firstElt, int lastElt,
     int minR = 255, maxR = 0;
     int minG = 255, maxG = 0;
     int minB = 255, maxB = 0;
-    for(int ii=0; ii<numPixels; ++ii)
+    for(uint32_t ii=0; ii<numColors; ++ii)
     {
-        int r = image[ii*4+0];
-        int g = image[ii*4+1];
-        int b = image[ii*4+2];
+        int r = colors[ii].comp[0];
+        int g = colors[ii].comp[1];
+        int b = colors[ii].comp[2];
 
         if(r > maxR) maxR = r;
         if(r < minR) minR = r;
@@ -305,191 +448,440 @@ GifSplitPalette(uint8_t* image, int numPixels, int firstElt, int lastElt,
     if(bRange > gRange) splitCom = 2;
     if(rRange > bRange && rRange > gRange) splitCom = 0;
 
-    int subPixelsA = numPixels * (splitElt - firstElt) / (lastElt - firstElt);
-    int subPixelsB = numPixels-subPixelsA;
+    uint64_t subPixelsA = numPixels * (uint64_t)(splitElt - firstElt) / (uint64_t)(lastElt - firstElt);
+    uint64_t subPixelsB = numPixels-subPixelsA;
 
-    GifPartitionByMedian(image, 0, numPixels, splitCom, subPixelsA);
+    GifSortColors(colors, sorted, numColors, splitCom);
 
-    pal->treeSplitElt[treeNode] = (uint8_t)splitCom;
-    pal->treeSplit[treeNode] = image[subPixelsA*4+splitCom];
+    // find the color holding the pixel number subPixelsA, the first one of the second half
+    uint32_t splitColor = 0;
+    uint64_t below = 0;
+    while( splitColor < numColors-1 && below + colors[splitColor].count <= subPixelsA )
+        below += colors[splitColor++].count;
 
-    GifSplitPalette(image,              subPixelsA, firstElt, splitElt, splitElt-splitDist, splitDist/2, treeNode*2,   buildForDither, pal);
-    GifSplitPalette(image+subPixelsA*4, subPixelsB, splitElt, lastElt,  splitElt+splitDist, splitDist/2, treeNode*2+1, buildForDither, pal);
-}
+    pal->treeSplitElt[treeNode] = (uint8_t)splitCom;
+    pal->treeSplit[treeNode] = colors[splitColor].comp[splitCom];
 
-// Finds all pixels that have changed from the previous image and
-// moves them to the fromt of th buffer.
-// This allows us to build a palette optimized for the colors of the
-// changed pixels only.
-static int
-GifPickChangedPixels(const uint8_t* lastFrame, uint8_t* frame, int numPixels)
-{
-    int numChanged = 0;
-    uint8_t* writeIter = frame;
+    // the pixels of the split color before subPixelsA go in the first half
+    GifHistColor whole = colors[splitColor];
+    const uint32_t countA = (uint32_t)(subPixelsA - below);
+    uint32_t numColorsA = splitColor;
 
-    for (int ii=0; ii<numPixels; ++ii)
+    if( countA > 0 )
     {
-        if(lastFrame[0] != frame[0] ||
-           lastFrame[1] != frame[1] ||
-           lastFrame[2] != frame[2])
-        {
-            writeIter[0] = frame[0];
-            writeIter[1] = frame[1];
-            writeIter[2] = frame[2];
-            ++numChanged;
-            writeIter += 4;
-        }
-        lastFrame += 4;
-        frame += 4;
+        colors[splitColor].count = countA;
+        ++numColorsA;
     }
 
-    return numChanged;
+    GifSplitPalette(colors, sorted, numColorsA, subPixelsA, firstElt, splitElt, splitElt-splitDist, splitDist/2, treeNode*2, buildForDither, pal);
+
+    // the first half is done with, put the rest of the split color back for the second
+    whole.count -= countA;
+    colors[splitColor] = whole;
+
+    GifSplitPalette(colors+splitColor, sorted, numColors-splitColor, subPixelsB, splitElt, lastElt, splitElt+splitDist, splitDist/2, treeNode*2+1, buildForDither, pal);
 }
 
 // Creates a palette by placing all the image pixels in a k-d tree and then averaging the blocks at the bottom.
-// This is known as the "modified median split" technique
-static void
+// This is known as the "modified median split" technique.
+// The pixels are first collected into a histogram of their distinct colors, and the
+// tree is built over that, which is far faster for images with few colors.
+// If lastFrame is given, only the pixels that have changed from it are used, so the
+// palette is optimized for the colors of the changed pixels only.
+// Returns false if the scratch buffers could not be allocated.
+static bool
 GifMakePalette(const uint8_t* lastFrame, const uint8_t* nextFrame,
                uint32_t width, uint32_t height, int bitDepth,
-               bool buildForDither, GifPalette* pPal)
+               bool buildForDither, GifPalette* pPal, GifPaletteScratch* scratch)
 {
     pPal->bitDepth = bitDepth;
 
-    // SplitPalette is destructive (it sorts the pixels by color) so
-    // we must create a copy of the image for it to destroy
-    size_t imageSize = (size_t)(width * height * 4 * sizeof(uint8_t));
-    uint8_t* destroyableImage = (uint8_t*)malloc(imageSize);
-    memcpy(destroyableImage, nextFrame, imageSize);
+    const uint32_t numPixels = width * height;
+    if( !GifReservePaletteScratch(scratch, numPixels) )
+        return false;
 
-    int numPixels = (int)(width * height);
-    if(lastFrame)
-        numPixels = GifPickChangedPixels(lastFrame, destroyableImage, numPixels);
+    const uint32_t numColors = GifBuildHistogram(lastFrame, nextFrame, numPixels, scratch);
+
+    uint64_t numUsed = 0;
+    for( uint32_t ii=0; ii<numColors; ++ii )
+        numUsed += scratch->colors[ii].count;
 
     const int lastElt = 1 << bitDepth;
     const int splitElt = lastElt/2;
     const int splitDist = splitElt/2;
 
-    GifSplitPalette(destroyableImage, numPixels, 1, lastElt, splitElt, splitDist, 1, buildForDither, pPal);
-
-    free(destroyableImage);
+    GifSplitPalette(scratch->colors, scratch->sorted, numColors, numUsed, 1, lastElt, splitElt, splitDist, 1, buildForDither, pPal);
 
     // add the bottom node for the transparency index
     pPal->treeSplit[1 << (bitDepth-1)] = 0;
     pPal->treeSplitElt[1 << (bitDepth-1)] = 0;
 
     pPal->r[0] = pPal->g[0] = pPal->b[0] = 0;
+    return true;
 }
 
-// Implements Floyd-Steinberg dithering, writes palette value to alpha
-static void
-GifDitherImage(const uint8_t* lastFrame, const uint8_t* nextFrame,
-               uint8_t* outFrame, uint32_t width, uint32_t height,
-               GifPalette* pPal)
+static void GifInitDitherScratch(GifDitherScratch* scratch)
 {
-    int numPixels = (int)(width * height);
+    memset(scratch, 0, sizeof(*scratch));
+}
 
-    // quantPixels initially holds color*256 for all pixels
-    // The extra 8 bits of precision allow for sub-single-color error values
-    // to be propagated
-    int32_t *quantPixels = (int32_t *)malloc(sizeof(int32_t) * (size_t)numPixels * 4);
+static void GifFreeDitherScratch(GifDitherScratch* scratch)
+{
+    free(scratch->quantPixels);
+    free(scratch->rowDone);
+    free(scratch->caches);
+    GifInitDitherScratch(scratch);
+}
 
-    for( int ii=0; ii<numPixels*4; ++ii )
+// Makes room for dithering an image of width*height pixels on numThreads threads
+static bool
+GifReserveDitherScratch(GifDitherScratch* scratch, uint32_t width, uint32_t height, int numThreads)
+{
+    const uint32_t numPixels = width*height;
+    if( numPixels > scratch->capacity )
     {
-        uint8_t pix = nextFrame[ii];
-        int32_t pix16 = (int32_t)(pix) * 256;
-        quantPixels[ii] = pix16;
+        free(scratch->quantPixels);
+        scratch->capacity = 0;
+        scratch->quantPixels = (int32_t*)malloc(sizeof(int32_t) * (size_t)numPixels * 4);
+        if( !scratch->quantPixels ) return false;
+        scratch->capacity = numPixels;
+    }
+
+    if( height > scratch->rowCapacity )
+    {
+        free(scratch->rowDone);
+        scratch->rowCapacity = 0;
+        scratch->rowDone = (uint32_t*)malloc(sizeof(uint32_t) * height);
+        if( !scratch->rowDone ) return false;
+        scratch->rowCapacity = height;
+    }
+
+    if( numThreads > scratch->numCaches )
+    {
+        // the keys start out as generation 0, which is never used
+        free(scratch->caches);
+        scratch->numCaches = 0;
+        scratch->caches = (GifColorCache*)calloc((size_t)numThreads, sizeof(GifColorCache));
+        if( !scratch->caches ) return false;
+        scratch->numCaches = numThreads;
+    }
+
+    return true;
+}
+
+// Empties the cache, for a new palette
+static void GifClearColorCache(GifColorCache* cache)
+{
+    // the generation is 8 bits, start over once it runs out
+    if( ++cache->generation == 256 )
+    {
+        memset(cache->keys, 0, sizeof(cache->keys));
+        cache->generation = 1;
+    }
+}
+
+// Finds the nearest palette color, looking in the cache before searching the k-d tree
+static int32_t
+GifCachedPaletteColor(GifPalette* pPal, GifColorCache* cache, int32_t r, int32_t g, int32_t b)
+{
+    int32_t bestDiff = 1000000;
+    int32_t bestInd = kGifTransIndex;
+
+    // the diffused error can push a color past 255, which is rare, don't cache those
+    if( r > 255 || g > 255 || b > 255 )
+    {
+        GifGetClosestPaletteColor(pPal, r, g, b, &bestInd, &bestDiff, 1);
+        return bestInd;
     }
 
-    for( uint32_t yy=0; yy<height; ++yy )
+    const uint32_t color = (uint32_t)r << 16 | (uint32_t)g << 8 | (uint32_t)b;
+    const uint32_t slot = (color * 2654435761u) >> (32 - GIF_COLOR_CACHE_BITS);
+    const uint32_t key = cache->generation << 24 | color;
+
+    if( cache->keys[slot] == key )
+        return cache->indices[slot];
+
+    GifGetClosestPaletteColor(pPal, r, g, b, &bestInd, &bestDiff, 1);
+    cache->keys[slot] = key;
+    cache->indices[slot] = (uint8_t)bestInd;
+    return bestInd;
+}
+
+// Adds weight/16 of the error to a pixel, keeping it from going negative
+static void
+GifDiffuseError(int32_t* pix, int32_t r_err, int32_t g_err, int32_t b_err, int32_t weight)
+{
+    pix[0] += GifIMax( -pix[0], r_err * weight / 16 );
+    pix[1] += GifIMax( -pix[1], g_err * weight / 16 );
+    pix[2] += GifIMax( -pix[2], b_err * weight / 16 );
+}
+
+// Dithers pixels xBegin to xEnd-1 of row yy. The error of each pixel goes to the
+// pixel after it and to the three pixels below it, but never past the image edges.
+static void
+GifDitherPixels(const uint8_t* lastFrame, int32_t* quantPixels, uint32_t width,
+                uint32_t height, uint32_t yy, uint32_t xBegin, uint32_t xEnd,
+                GifPalette* pPal, GifColorCache* cache)
+{
+    for( uint32_t xx=xBegin; xx<xEnd; ++xx )
     {
-        for( uint32_t xx=0; xx<width; ++xx )
+        int32_t* nextPix = quantPixels + 4*(yy*width+xx);
+        const uint8_t* lastPix = lastFrame? lastFrame + 4*(yy*width+xx) : NULL;
+
+        // Compute the colors we want (rounding to nearest)
+        int32_t rr = (nextPix[0] + 127) / 256;
+        int32_t gg = (nextPix[1] + 127) / 256;
+        int32_t bb = (nextPix[2] + 127) / 256;
+
+        // if it happens that we want the color from last frame, then just write out
+        // a transparent pixel
+        if( lastFrame &&
+           lastPix[0] == rr &&
+           lastPix[1] == gg &&
+           lastPix[2] == bb )
         {
-            int32_t* nextPix = quantPixels + 4*(yy*width+xx);
-            const uint8_t* lastPix = lastFrame? lastFrame + 4*(yy*width+xx) : NULL;
-
-            // Compute the colors we want (rounding to nearest)
-            int32_t rr = (nextPix[0] + 127) / 256;
-            int32_t gg = (nextPix[1] + 127) / 256;
-            int32_t bb = (nextPix[2] + 127) / 256;
-
-            // if it happens that we want the color from last frame, then just write out
-            // a transparent pixel
-            if( lastFrame &&
-               lastPix[0] == rr &&
-               lastPix[1] == gg &&
-               lastPix[2] == bb )
-            {
-                nextPix[0] = rr;
-                nextPix[1] = gg;
-                nextPix[2] = bb;
-                nextPix[3] = kGifTransIndex;
-                continue;
-            }
+            nextPix[0] = rr;
+            nextPix[1] = gg;
+            nextPix[2] = bb;
+            nextPix[3] = kGifTransIndex;
+            continue;
+        }
 
-            int32_t bestDiff = 1000000;
-            int32_t bestInd = kGifTransIndex;
+        // Search the palette
+        int32_t bestInd = GifCachedPaletteColor(pPal, cache, rr, gg, bb);
 
-            // Search the palete
-            GifGetClosestPaletteColor(pPal, rr, gg, bb, &bestInd, &bestDiff, 1);
+        // Write the result to the temp buffer
+        int32_t r_err = nextPix[0] - (int32_t)(pPal->r[bestInd]) * 256;
+        int32_t g_err = nextPix[1] - (int32_t)(pPal->g[bestInd]) * 256;
+        int32_t b_err = nextPix[2] - (int32_t)(pPal->b[bestInd]) * 256;
 
-            // Write the result to the temp buffer
-            int32_t r_err = nextPix[0] - (int32_t)(pPal->r[bestInd]) * 256;
-            int32_t g_err = nextPix[1] - (int32_t)(pPal->g[bestInd]) * 256;
-            int32_t b_err = nextPix[2] - (int32_t)(pPal->b[bestInd]) * 256;
+        nextPix[0] = pPal->r[bestInd];
+        nextPix[1] = pPal->g[bestInd];
+        nextPix[2] = pPal->b[bestInd];
+        nextPix[3] = bestInd;
 
-            nextPix[0] = pPal->r[bestInd];
-            nextPix[1] = pPal->g[bestInd];
-            nextPix[2] = pPal->b[bestInd];
-            nextPix[3] = bestInd;
+        // Propagate the error to the four adjacent locations
+        // that we haven't touched yet
+        if( xx+1 < width )
+            GifDiffuseError(nextPix+4, r_err, g_err, b_err, 7);
 
-            // Propagate the error to the four adjacent locations
-            // that we haven't touched yet
-            int quantloc_7 = (int)(yy * width + xx + 1);
-            int quantloc_3 = (int)(yy * width + width + xx - 1);
-            int quantloc_5 = (int)(yy * width + width + xx);
-            int quantloc_1 = (int)(yy * width + width + xx + 1);
+        if( yy+1 < height )
+        {
+            int32_t* below = nextPix + 4*width;
 
-            if(quantloc_7 < numPixels)
-            {
-                int32_t* pix7 = quantPixels+4*quantloc_7;
-                pix7[0] += GifIMax( -pix7[0], r_err * 7 / 16 );
-                pix7[1] += GifIMax( -pix7[1], g_err * 7 / 16 );
-                pix7[2] += GifIMax( -pix7[2], b_err * 7 / 16 );
-            }
+            if( xx > 0 )
+                GifDiffuseError(below-4, r_err, g_err, b_err, 3);
 
-            if(quantloc_3 < numPixels)
-            {
-                int32_t* pix3 = quantPixels+4*quantloc_3;
-                pix3[0] += GifIMax( -pix3[0], r_err * 3 / 16 );
-                pix3[1] += GifIMax( -pix3[1], g_err * 3 / 16 );
-                pix3[2] += GifIMax( -pix3[2], b_err * 3 / 16 );
-            }
+            GifDiffuseError(below, r_err, g_err, b_err, 5);
 
-            if(quantloc_5 < numPixels)
-            {
-                int32_t* pix5 = quantPixels+4*quantloc_5;
-                pix5[0] += GifIMax( -pix5[0], r_err * 5 / 16 );
-                pix5[1] += GifIMax( -pix5[1], g_err * 5 / 16 );
-                pix5[2] += GifIMax( -pix5[2], b_err * 5 / 16 );
-            }
+            if( xx+1 < width )
+                GifDiffuseError(below+4, r_err, g_err, b_err, 1);
+        }
+    }
+}
+
+#ifdef GIF_THREADS
+
+// pixels a thread dithers between checking on, and reporting, the progress of rows
+#ifndef GIF_DITHER_CHUNK
+#define GIF_DITHER_CHUNK 32
+#endif
+
+#ifndef GIF_MAX_DITHER_THREADS
+#define GIF_MAX_DITHER_THREADS 64
+#endif
 
-            if(quantloc_1 < numPixels)
+// A frame being dithered by several threads
+typedef struct
+{
+    const uint8_t* lastFrame;
+    int32_t* quantPixels;
+    uint32_t width, height;
+    GifPalette* pPal;
+    uint32_t* rowDone;      // pixels of each row dithered so far
+    uint32_t numThreads;
+    int state;              // 0 until every thread has started, then 1, or -1 to give up
+    pthread_mutex_t lock;
+    pthread_cond_t progress;
+} GifDitherJob;
+
+// A thread's share of a GifDitherJob, every numThreads-th row from firstRow on
+typedef struct
+{
+    GifDitherJob* job;
+    GifColorCache* cache;
+    uint32_t firstRow;
+} GifDitherTask;
+
+static void* GifDitherRows(void* arg)
+{
+    GifDitherTask* task = (GifDitherTask*)arg;
+    GifDitherJob* job = task->job;
+    const uint32_t width = job->width;
+
+    pthread_mutex_lock(&job->lock);
+    while( job->state == 0 )
+        pthread_cond_wait(&job->progress, &job->lock);
+    pthread_mutex_unlock(&job->lock);
+
+    if( job->state < 0 )
+        return NULL;
+
+    for( uint32_t yy=task->firstRow; yy<job->height; yy+=job->numThreads )
+    {
+        for( uint32_t xx=0; xx<width; xx+=GIF_DITHER_CHUNK )
+        {
+            const uint32_t xEnd = (width-xx > GIF_DITHER_CHUNK)? xx+GIF_DITHER_CHUNK : width;
+
+            // the row above must be done two pixels past the end of this run. Those
+            // pixels add to the error of this run, and to that of the pixel after it,
+            // which has to happen before this run adds to it, as it would serially.
+            if( yy > 0 )
             {
-                int32_t* pix1 = quantPixels+4*quantloc_1;
-                pix1[0] += GifIMax( -pix1[0], r_err / 16 );
-                pix1[1] += GifIMax( -pix1[1], g_err / 16 );
-                pix1[2] += GifIMax( -pix1[2], b_err / 16 );
+                const uint32_t needed = (width-xEnd > 2)? xEnd+2 : width;
+
+                pthread_mutex_lock(&job->lock);
+                while( job->rowDone[yy-1] < needed )
+                    pthread_cond_wait(&job->progress, &job->lock);
+                pthread_mutex_unlock(&job->lock);
             }
+
+            GifDitherPixels(job->lastFrame, job->quantPixels, width, job->height,
+                            yy, xx, xEnd, job->pPal, task->cache);
+
+            pthread_mutex_lock(&job->lock);
+            job->rowDone[yy] = xEnd;
+            pthread_cond_broadcast(&job->progress);
+            pthread_mutex_unlock(&job->lock);
         }
     }
 
+    return NULL;
+}
+
+// Dithers the image as a wavefront, with each row a little behind the one above it.
+// Returns false, having done nothing, if the threads could not be started.
+static bool
+GifDitherThreaded(const uint8_t* lastFrame, int32_t* quantPixels, uint32_t width,
+                  uint32_t height, GifPalette* pPal, GifDitherScratch* scratch,
+                  uint32_t numThreads)
+{
+    GifDitherJob job;
+    GifDitherTask tasks[GIF_MAX_DITHER_THREADS];
+    pthread_t threads[GIF_MAX_DITHER_THREADS];
+    uint32_t started;
+
+    job.lastFrame = lastFrame;
+    job.quantPixels = quantPixels;
+    job.width = width;
+    job.height = height;
+    job.pPal = pPal;
+    job.rowDone = scratch->rowDone;
+    job.numThreads = numThreads;
+    job.state = 0;
+    memset(job.rowDone, 0, sizeof(uint32_t) * height);
+
+    if( pthread_mutex_init(&job.lock, NULL) != 0 )
+        return false;
+
+    if( pthread_cond_init(&job.progress, NULL) != 0 )
+    {
+        pthread_mutex_destroy(&job.lock);
+        return false;
+    }
+
+    for( uint32_t ii=0; ii<numThreads; ++ii )
+    {
+        tasks[ii].job = &job;
+        tasks[ii].cache = &scratch->caches[ii];
+        tasks[ii].firstRow = ii;
+    }
+
+    // the first rows are done on this thread
+    for( started=1; started<numThreads; ++started )
+    {
+        if( pthread_create(&threads[started], NULL, GifDitherRows, &tasks[started]) != 0 )
+            break;
+    }
+
+    // every row has to be done, so all of the threads must be running
+    pthread_mutex_lock(&job.lock);
+    job.state = (started == numThreads)? 1 : -1;
+    pthread_cond_broadcast(&job.progress);
+    pthread_mutex_unlock(&job.lock);
+
+    if( job.state > 0 )
+        GifDitherRows(&tasks[0]);
+
+    for( uint32_t ii=1; ii<started; ++ii )
+        pthread_join(threads[ii], NULL);
+
+    pthread_cond_destroy(&job.progress);
+    pthread_mutex_destroy(&job.lock);
+    return job.state > 0;
+}
+
+#endif
+
+// Implements Floyd-Steinberg dithering, writes palette value to alpha.
+// With numThreads > 1 the rows are split between threads, staggered so that every
+// pixel gets the error of its neighbors in the same order as when done serially,
+// and the result is the same. Returns false if memory could not be allocated.
+static bool
+GifDitherImage(const uint8_t* lastFrame, const uint8_t* nextFrame,
+               uint8_t* outFrame, uint32_t width, uint32_t height,
+               GifPalette* pPal, GifDitherScratch* scratch, int numThreads)
+{
+    int numPixels = (int)(width * height);
+
+#ifdef GIF_THREADS
+    if( numThreads > GIF_MAX_DITHER_THREADS ) numThreads = GIF_MAX_DITHER_THREADS;
+    if( numThreads > (int)height ) numThreads = (int)height;
+#else
+    numThreads = 1;
+#endif
+    if( numThreads < 1 ) numThreads = 1;
+
+    if( !GifReserveDitherScratch(scratch, width, height, numThreads) )
+        return false;
+
+    // quantPixels initially holds color*256 for all pixels
+    // The extra 8 bits of precision allow for sub-single-color error values
+    // to be propagated
+    int32_t *quantPixels = scratch->quantPixels;
+
+    for( int ii=0; ii<numPixels*4; ++ii )
+    {
+        uint8_t pix = nextFrame[ii];
+        int32_t pix16 = (int32_t)(pix) * 256;
+        quantPixels[ii] = pix16;
+    }
+
+    // the nearest colors found for the last frame are for its palette
+    for( int ii=0; ii<numThreads; ++ii )
+        GifClearColorCache(&scratch->caches[ii]);
+
+    bool done = false;
+#ifdef GIF_THREADS
+    if( numThreads > 1 )
+        done = GifDitherThreaded(lastFrame, quantPixels, width, height, pPal, scratch,
+                                 (uint32_t)numThreads);
+#endif
+
+    if( !done )
+    {
+        for( uint32_t yy=0; yy<height; ++yy )
+            GifDitherPixels(lastFrame, quantPixels, width, height, yy, 0, width, pPal,
+                            &scratch->caches[0]);
+    }
+
     // Copy the palettized result to the output buffer
     for( int ii=0; ii<numPixels*4; ++ii )
     {
         outFrame[ii] = (uint8_t)quantPixels[ii];
     }
 
-    free(quantPixels);
+    return true;
 }
 
 // Picks palette colors for the image using simple thresholding, no dithering
@@ -533,72 +925,111 @@ GifThresholdImage(const uint8_t* lastFrame, const uint8_t* nextFrame,
     }
 }
 
-// insert a single bit
-static void GifWriteBit( GifBitStatus* stat, uint32_t bit )
+// write all bytes so far to the file
+static void GifFlushBuffer( FILE* f, GifBitStatus* stat )
 {
-    bit = bit & 1;
-    bit = bit << stat->bitIndex;
-    stat->byte |= bit;
+    fwrite(stat->out, 1, stat->outIndex, f);
+    stat->outIndex = 0;
+}
 
-    ++stat->bitIndex;
-    if( stat->bitIndex > 7 )
+// move one byte to the current sub-block, starting a new one if needed
+static void GifWriteByte( FILE* f, GifBitStatus* stat, uint8_t byte )
+{
+    if( stat->chunkIndex == 0 )
     {
-        // move the newly-finished byte to the chunk buffer
-        stat->chunk[stat->chunkIndex++] = stat->byte;
-        // and start a new byte
-        stat->bitIndex = 0;
-        stat->byte = 0;
+        // only flush between sub-blocks, so the open one never moves
+        if( stat->outIndex > GIF_OUT_BUFFER_SIZE - 256 )
+            GifFlushBuffer(f, stat);
+
+        stat->chunkStart = stat->outIndex++;
+        stat->out[stat->chunkStart] = 255;
     }
-}
 
-// write all bytes so far to the file
-static void GifWriteChunk( FILE* f, GifBitStatus* stat )
-{
-    fputc((int)stat->chunkIndex, f);
-    fwrite(stat->chunk, 1, stat->chunkIndex, f);
+    stat->out[stat->outIndex++] = byte;
 
-    stat->bitIndex = 0;
-    stat->byte = 0;
-    stat->chunkIndex = 0;
+    if( ++stat->chunkIndex == 255 )
+        stat->chunkIndex = 0;  // full, the length byte is already right
 }
 
 static void
 GifWriteCode( FILE* f, GifBitStatus* stat, uint32_t code, uint32_t length )
 {
-    for( uint32_t ii=0; ii<length; ++ii )
+    stat->bits |= (uint64_t)code << stat->bitCount;
+    stat->bitCount += length;
+
+    while( stat->bitCount >= 8 )
     {
-        GifWriteBit(stat, code);
-        code = code >> 1;
+        GifWriteByte(f, stat, (uint8_t)stat->bits);
+        stat->bits >>= 8;
+        stat->bitCount -= 8;
+    }
+}
 
-        if( stat->chunkIndex == 255 )
-        {
-            GifWriteChunk(f, stat);
-        }
+// pad the last partial byte with zeros and close the last sub-block
+static void GifFinishCodes( FILE* f, GifBitStatus* stat )
+{
+    if( stat->bitCount )
+        GifWriteByte(f, stat, (uint8_t)stat->bits);
+
+    if( stat->chunkIndex )
+        stat->out[stat->chunkStart] = (uint8_t)stat->chunkIndex;
+
+    stat->bits = 0;
+    stat->bitCount = 0;
+    stat->chunkIndex = 0;
+    GifFlushBuffer(f, stat);
+}
+
+// empty the dictionary
+static void GifLzwClear( GifLzwDict* dict )
+{
+    // the generation is 12 bits, start over once it runs out
+    if( ++dict->generation == 4096 )
+    {
+        memset(dict->tag, 0, sizeof(dict->tag));
+        dict->generation = 1;
     }
 }
 
+// find the run given by code followed by index, returning its place in the table,
+// which is empty if the run is not in the dictionary
+static uint32_t GifLzwFind( const GifLzwDict* dict, uint32_t code, uint32_t index, uint32_t* tag )
+{
+    const uint32_t key = code << 8 | index;
+    uint32_t slot = (key * 2654435761u) >> (32 - GIF_LZW_HASH_BITS);
+
+    *tag = dict->generation << 20 | key;
+
+    // linear probing, stopping at the run or at an entry from an older generation
+    while( dict->tag[slot] != *tag && dict->tag[slot] >> 20 == dict->generation )
+        slot = (slot + 1) & (GIF_LZW_HASH_SIZE - 1);
+
+    return slot;
+}
+
 // write a 256-color (8-bit) image palette to the file
 static void GifWritePalette( const GifPalette* pPal, FILE* f )
 {
-    fputc(0, f);  // first color: transparency
-    fputc(0, f);
-    fputc(0, f);
+    uint8_t colors[256*3];
+
+    colors[0] = 0;  // first color: transparency
+    colors[1] = 0;
+    colors[2] = 0;
 
     for(int ii=1; ii<(1 << pPal->bitDepth); ++ii)
     {
-        uint32_t r = pPal->r[ii];
-        uint32_t g = pPal->g[ii];
-        uint32_t b = pPal->b[ii];
-
-        fputc((int)r, f);
-        fputc((int)g, f);
-        fputc((int)b, f);
+        colors[ii*3+0] = pPal->r[ii];
+        colors[ii*3+1] = pPal->g[ii];
+        colors[ii*3+2] = pPal->b[ii];
     }
+
+    fwrite(colors, 3, (size_t)1 << pPal->bitDepth, f);
 }
 
-// write the image header, LZW-compress and write out the image
+// write the graphics control extension and the image descriptor of a frame,
+// followed by its local color table if pPal is given
 static void
-GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uint32_t width, uint32_t height, uint32_t delay, GifPalette* pPal)
+GifWriteFrameHeader(FILE* f, uint32_t left, uint32_t top, uint32_t width, uint32_t height, uint32_t delay, const GifPalette* pPal)
 {
     // graphics control extension
     fputc(0x21, f);
@@ -625,39 +1056,66 @@ GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uint32_t
     //fputc(0, f); // no local color table, no transparency
     //fputc(0x80, f); // no local color table, but transparency
 
-    fputc(0x80 + pPal->bitDepth-1, f); // local color table present, 2 ^ bitDepth entries
-    GifWritePalette(pPal, f);
+    if(pPal)
+    {
+        fputc(0x80 + pPal->bitDepth-1, f); // local color table present, 2 ^ bitDepth entries
+        GifWritePalette(pPal, f);
+    }
+    else
+    {
+        fputc(0, f); // no local color table, the global one is used
+    }
+}
 
-    const int minCodeSize = pPal->bitDepth;
-    const uint32_t clearCode = 1 << pPal->bitDepth;
+// finds row yy of the canvas in an image of width*height pixels, stride bytes apart
+static const uint8_t*
+GifCanvasRow(const uint8_t* image, uint32_t stride, uint32_t width, uint32_t height, uint32_t yy)
+{
+#ifdef GIF_FLIP_VERT
+    // bottom-left origin image (such as an OpenGL capture)
+    return image + (size_t)(height-1-yy)*width*stride;
+#else
+    // top-left origin
+    (void)height;
+    return image + (size_t)yy*width*stride;
+#endif
+}
+
+// LZW-compress and write out the image data of one rectangle of a frame. The palette
+// indices are taken from every stride-th byte of image, width*height pixels.
+static void
+GifWriteLzwData(FILE* f, const uint8_t* image, uint32_t stride, uint32_t width, uint32_t height, GifRect rect, int bitDepth)
+{
+    const int minCodeSize = bitDepth;
+    const uint32_t clearCode = 1 << bitDepth;
 
     fputc(minCodeSize, f); // min code size 8 bits
 
-    GifLzwNode* codetree = (GifLzwNode*)malloc(sizeof(GifLzwNode)*4096);
+    // both live on the stack, so there is nothing to allocate per frame
+    GifLzwDict dict;
+    memset(dict.tag, 0, sizeof(dict.tag));
+    dict.generation = 1;
 
-    memset(codetree, 0, sizeof(GifLzwNode)*4096);
     int32_t curCode = -1;
     uint32_t codeSize = (uint32_t)minCodeSize + 1;
     uint32_t maxCode = clearCode+1;
 
     GifBitStatus stat;
-    stat.byte = 0;
-    stat.bitIndex = 0;
+    stat.bits = 0;
+    stat.bitCount = 0;
     stat.chunkIndex = 0;
+    stat.chunkStart = 0;
+    stat.outIndex = 0;
 
     GifWriteCode(f, &stat, clearCode, codeSize);  // start with a fresh LZW dictionary
 
-    for(uint32_t yy=0; yy<height; ++yy)
+    for(uint32_t yy=0; yy<rect.height; ++yy)
     {
-        for(uint32_t xx=0; xx<width; ++xx)
+        const uint8_t* row = GifCanvasRow(image, stride, width, height, rect.top+yy) + rect.left*stride;
+
+        for(uint32_t xx=0; xx<rect.width; ++xx)
         {
-    #ifdef GIF_FLIP_VERT
-            // bottom-left origin image (such as an OpenGL capture)
-            uint8_t nextValue = image[((height-1-yy)*width+xx)*4+3];
-    #else
-            // top-left origin
-            uint8_t nextValue = image[(yy*width+xx)*4+3];
-    #endif
+            uint8_t nextValue = row[xx*stride];
 
             // "loser mode" - no compression, every single code is followed immediately by a clear
             //WriteCode( f, stat, nextValue, codeSize );
@@ -667,11 +1125,16 @@ GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uint32_t
             {
                 // first value in a new run
                 curCode = nextValue;
+                continue;
             }
-            else if( codetree[curCode].m_next[nextValue] )
+
+            uint32_t tag;
+            const uint32_t slot = GifLzwFind(&dict, (uint32_t)curCode, nextValue, &tag);
+
+            if( dict.tag[slot] == tag )
             {
                 // current run already in the dictionary
-                curCode = codetree[curCode].m_next[nextValue];
+                curCode = dict.code[slot];
             }
             else
             {
@@ -679,7 +1142,8 @@ GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uint32_t
                 GifWriteCode(f, &stat, (uint32_t)curCode, codeSize);
 
                 // insert the new run into the dictionary
-                codetree[curCode].m_next[nextValue] = (uint16_t)++maxCode;
+                dict.tag[slot] = tag;
+                dict.code[slot] = (uint16_t)++maxCode;
 
                 if( maxCode >= (1ul << codeSize) )
                 {
@@ -692,7 +1156,7 @@ GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uint32_t
                     // the dictionary is full, clear it out and begin anew
                     GifWriteCode(f, &stat, clearCode, codeSize); // clear tree
 
-                    memset(codetree, 0, sizeof(GifLzwNode)*4096);
+                    GifLzwClear(&dict);
                     codeSize = (uint32_t)(minCodeSize + 1);
                     maxCode = clearCode+1;
                 }
@@ -708,34 +1172,196 @@ GifWriteLzwImage(FILE* f, uint8_t* image, uint32_t left, uint32_t top,  uint32_t
     GifWriteCode(f, &stat, clearCode + 1, (uint32_t)minCodeSize + 1);
 
     // write out the last partial chunk
-    while( stat.bitIndex ) GifWriteBit(&stat, 0);
-    if( stat.chunkIndex ) GifWriteChunk(f, &stat);
+    GifFinishCodes(f, &stat);
 
     fputc(0, f); // image block terminator
+}
 
-    free(codetree);
+// bounding box of the changed pixels in rows top to bottom-1, from the row spans
+static GifRect
+GifSpanRect(const uint32_t* rowSpans, uint32_t top, uint32_t bottom)
+{
+    uint32_t left = UINT32_MAX, right = 0;
+
+    for(uint32_t yy=top; yy<bottom; ++yy)
+    {
+        if(rowSpans[yy*2] >= rowSpans[yy*2+1])
+            continue;
+
+        if(rowSpans[yy*2] < left) left = rowSpans[yy*2];
+        if(rowSpans[yy*2+1] > right) right = rowSpans[yy*2+1];
+    }
+
+    GifRect rect = {left, top, right-left, bottom-top};
+    return rect;
 }
 
-// Creates a gif file.
-// The input GIFWriter is assumed to be uninitialized.
-// The delay value is the time between frames in hundredths of a second - note that not all viewers pay much attention to this value.
-static bool
-GifBegin(GifWriter* writer, const char* filename, uint32_t width,
-         uint32_t height, uint32_t delay, int32_t bitDepth, bool dither)
+// Finds up to maxRects rectangles that between them cover every pixel that is not
+// transparent, so that only those need to be encoded. The bounding box of the changed
+// pixels is split across the longest run of unchanged rows inside it for as long as
+// that saves more than the cost of another sub-image, given as a number of pixels.
+// rowSpans has room for two entries per row. Returns the number of rectangles, at
+// least one, as a GIF image can not be empty.
+static uint32_t
+GifFindChangedRects(const uint8_t* image, uint32_t stride, uint32_t width, uint32_t height,
+                    uint32_t* rowSpans, uint32_t maxRects, uint32_t rectCost, GifRect* rects)
+{
+    uint32_t top = height, bottom = 0;
+
+    for(uint32_t yy=0; yy<height; ++yy)
+    {
+        const uint8_t* row = GifCanvasRow(image, stride, width, height, yy);
+        uint32_t left = 0, right = width;
+
+        while(left < width && row[left*stride] == kGifTransIndex) ++left;
+        while(right > left && row[(right-1)*stride] == kGifTransIndex) --right;
+
+        rowSpans[yy*2] = left;
+        rowSpans[yy*2+1] = right;
+
+        if(left < right)
+        {
+            if(yy < top) top = yy;
+            bottom = yy+1;
+        }
+    }
+
+    // nothing changed, write out a single transparent pixel
+    if(top >= bottom)
+    {
+        GifRect rect = {0, 0, 1, 1};
+        rects[0] = rect;
+        return 1;
+    }
+
+    uint32_t numRects = 1;
+    rects[0] = GifSpanRect(rowSpans, top, bottom);
+
+    while(numRects < maxRects)
+    {
+        // find the split that saves the most pixels, the longest gap in each rectangle
+        uint32_t bestRect = 0, bestGapTop = 0, bestGapBottom = 0;
+        uint64_t bestSaving = 0;
+
+        for(uint32_t ii=0; ii<numRects; ++ii)
+        {
+            const GifRect rect = rects[ii];
+            uint32_t gapTop = 0, gapBottom = 0;
+
+            for(uint32_t yy=rect.top; yy<rect.top+rect.height; ++yy)
+            {
+                if(rowSpans[yy*2] < rowSpans[yy*2+1])
+                    continue;
+
+                uint32_t end = yy;
+                while(rowSpans[end*2] >= rowSpans[end*2+1]) ++end;
+
+                if(end-yy > gapBottom-gapTop)
+                {
+                    gapTop = yy;
+                    gapBottom = end;
+                }
+
+                yy = end;
+            }
+
+            if(gapBottom == gapTop)
+                continue;
+
+            const GifRect above = GifSpanRect(rowSpans, rect.top, gapTop);
+            const GifRect below = GifSpanRect(rowSpans, gapBottom, rect.top+rect.height);
+            const uint64_t area = (uint64_t)rect.width*rect.height;
+            const uint64_t split = (uint64_t)above.width*above.height + (uint64_t)below.width*below.height;
+
+            if(area-split > bestSaving)
+            {
+                bestSaving = area-split;
+                bestRect = ii;
+                bestGapTop = gapTop;
+                bestGapBottom = gapBottom;
+            }
+        }
+
+        if(bestSaving <= rectCost)
+            break;
+
+        const GifRect rect = rects[bestRect];
+        rects[bestRect] = GifSpanRect(rowSpans, rect.top, bestGapTop);
+        rects[numRects++] = GifSpanRect(rowSpans, bestGapBottom, rect.top+rect.height);
+    }
+
+    return numRects;
+}
+
+// Writes out a frame as sub-images covering only the pixels that are not transparent,
+// all pixels outside of them are left as they were. The first frame is written whole.
+// When a frame is split the delay goes on the last sub-image, and the local palette,
+// if any, is repeated for each of them.
+static void
+GifWriteChangedRects(GifWriter* writer, const uint8_t* image, uint32_t stride, uint32_t width,
+                     uint32_t height, uint32_t delay, const GifPalette* pPal, int bitDepth,
+                     bool firstFrame)
+{
+    GifRect rects[GIF_MAX_RECTS];
+    uint32_t numRects = 1;
+
+    if(firstFrame || !writer->rowSpans)
+    {
+        GifRect rect = {0, 0, width, height};
+        rects[0] = rect;
+    }
+    else
+    {
+        // a sub-image costs about 20 bytes of headers, plus its palette, and an
+        // unchanged pixel costs a few bits once compressed
+        const uint32_t rectCost = 8 * (20 + (pPal ? 3u << pPal->bitDepth : 0));
+        uint32_t maxRects = writer->maxRects;
+        if(maxRects < 1) maxRects = 1;
+        if(maxRects > GIF_MAX_RECTS) maxRects = GIF_MAX_RECTS;
+        numRects = GifFindChangedRects(image, stride, width, height, writer->rowSpans,
+                                       maxRects, rectCost, rects);
+    }
+
+    for(uint32_t ii=0; ii<numRects; ++ii)
+    {
+        const GifRect rect = rects[ii];
+        GifWriteFrameHeader(writer->f, rect.left, rect.top, rect.width, rect.height,
+                            ii+1 == numRects ? delay : 0, pPal);
+        GifWriteLzwData(writer->f, image, stride, width, height, rect, bitDepth);
+    }
+}
+
+// Opens a file for writing a gif to, NULL on failure.
+static FILE* GifOpen(const char* filename)
 {
-    (void)bitDepth; (void)dither; // Mute "Unused argument" warnings
 #if defined(_MSC_VER) && (_MSC_VER >= 1400)
-    writer->f = 0;
-    fopen_s(&writer->f, filename, "wb");
+    FILE* f = 0;
+    fopen_s(&f, filename, "wb");
+    return f;
 #else
-    writer->f = fopen(filename, "wb");
+    return fopen(filename, "wb");
 #endif
+}
+
+// Starts a gif with the given global color table of 1 << bitDepth colors on an open
+// stream, which GifEnd closes. Fails if f is NULL.
+static bool
+GifBeginWithGlobalTable(GifWriter* writer, FILE* f, uint32_t width,
+                        uint32_t height, uint32_t delay, const uint8_t* colors, int bitDepth)
+{
+    GifInitPaletteScratch(&writer->paletteScratch);
+    GifInitDitherScratch(&writer->ditherScratch);
+    writer->ditherThreads = 1;
+    writer->globalBitDepth = 0;
+    writer->f = f;
     if(!writer->f) return false;
 
     writer->firstFrame = true;
 
     // allocate
     writer->oldImage = (uint8_t*)malloc(width*height*4);
+    writer->rowSpans = (uint32_t*)malloc(sizeof(uint32_t)*height*2);
+    writer->maxRects = 1;
 
     fputs("GIF89a", writer->f);
 
@@ -745,19 +1371,11 @@ GifBegin(GifWriter* writer, const char* filename, uint32_t width,
     fputc(height & 0xff, writer->f);
     fputc((height >> 8) & 0xff, writer->f);
 
-    fputc(0xf0, writer->f);  // there is an unsorted global color table of 2 entries
+    fputc(0xf0 + bitDepth-1, writer->f);  // there is an unsorted global color table of 2 ^ bitDepth entries
     fputc(0, writer->f);     // background color
     fputc(0, writer->f);     // pixels are square (we need to specify this because it's 1989)
 
-    // now the "global" palette (really just a dummy palette)
-    // color 0: black
-    fputc(0, writer->f);
-    fputc(0, writer->f);
-    fputc(0, writer->f);
-    // color 1: also black
-    fputc(0, writer->f);
-    fputc(0, writer->f);
-    fputc(0, writer->f);
+    fwrite(colors, 3, (size_t)1 << bitDepth, writer->f);
 
     if( delay != 0 )
     {
@@ -778,31 +1396,167 @@ GifBegin(GifWriter* writer, const char* filename, uint32_t width,
     return true;
 }
 
-// Writes out a new frame to a GIF in progress.
-// The GIFWriter should have been created by GIFBegin.
-// AFAIK, it is legal to use different bit depths for different frames of an image -
-// this may be handy to save bits in animations that don't change much.
-static void
-GifWriteFrame(GifWriter* writer, const uint8_t* image, uint32_t width,
-              uint32_t height, uint32_t delay, int bitDepth, bool dither)
+// Starts a gif on a stream opened by the caller for binary writing, which GifEnd
+// closes. With colors NULL the frames are RGBA, as for GifBegin, otherwise they are
+// indices into the 1 << bitDepth colors, as for GifBeginWithPalette. A stream given a
+// buffer large enough for the whole file with setvbuf writes nothing until GifEnd.
+static bool
+GifBeginStream(GifWriter* writer, FILE* f, uint32_t width, uint32_t height,
+               uint32_t delay, const uint8_t* colors, int bitDepth)
 {
-    if (!writer->f)
-        return;
+    // now the "global" palette (really just a dummy palette)
+    // color 0: black
+    // color 1: also black
+    const uint8_t dummyColors[6] = {0, 0, 0, 0, 0, 0};
+
+    if(!colors)
+        return GifBeginWithGlobalTable(writer, f, width, height, delay, dummyColors, 1);
+
+    if(!GifBeginWithGlobalTable(writer, f, width, height, delay, colors, bitDepth))
+        return false;
+
+    writer->globalBitDepth = bitDepth;
+    return true;
+}
+
+// Creates a gif file.
+// The input GIFWriter is assumed to be uninitialized.
+// The delay value is the time between frames in hundredths of a second - note that not all viewers pay much attention to this value.
+static inline bool
+GifBegin(GifWriter* writer, const char* filename, uint32_t width,
+         uint32_t height, uint32_t delay, int32_t bitDepth, bool dither)
+{
+    (void)bitDepth; (void)dither; // Mute "Unused argument" warnings
+
+    return GifBeginStream(writer, GifOpen(filename), width, height, delay, NULL, 0);
+}
+
+// Creates a gif file for frames given as indices into a fixed palette of 1 << bitDepth
+// colors, which is written once as the global color table. Frames are then written
+// with GifWriteIndexedFrame, skipping quantization, dithering, and local color tables.
+// Index 0 (kGifTransIndex) is the transparent index and must not be used by the frames.
+static inline bool
+GifBeginWithPalette(GifWriter* writer, const char* filename, uint32_t width,
+                    uint32_t height, uint32_t delay, const uint8_t* colors, int bitDepth)
+{
+    return GifBeginStream(writer, GifOpen(filename), width, height, delay, colors,
+                          bitDepth);
+}
+
+// Writes out a frame of palette indices, one byte per pixel, to a GIF started with
+// GifBeginWithPalette. Pixels with the same index as in the previous frame are
+// written as transparent, which compresses far better.
+static inline bool
+GifWriteIndexedFrame(GifWriter* writer, const uint8_t* indices, uint32_t width,
+                     uint32_t height, uint32_t delay)
+{
+    if(!writer->f || !writer->globalBitDepth)
+        return false;
 
+    // oldImage holds the indices of the previous frame, followed by those written out
+    const uint32_t numPixels = width*height;
+    uint8_t* lastIndices = writer->oldImage;
+    uint8_t* outIndices = writer->oldImage + numPixels;
+
+    const bool firstFrame = writer->firstFrame;
+
+    if(firstFrame)
+        memcpy(outIndices, indices, numPixels);
+    else
+    {
+        for(uint32_t ii=0; ii<numPixels; ++ii)
+            outIndices[ii] = (indices[ii] == lastIndices[ii]) ? (uint8_t)kGifTransIndex : indices[ii];
+    }
+
+    memcpy(lastIndices, indices, numPixels);
+    writer->firstFrame = false;
+
+    GifWriteChangedRects(writer, outIndices, 1, width, height, delay, NULL,
+                         writer->globalBitDepth, firstFrame);
+    return true;
+}
+
+// Makes the palette GifWriteFrame would for an RGBA frame, from the frame alone if it
+// is dithered, otherwise from the pixels that changed since the last frame. This,
+// GifQuantizeFrame, and GifWriteQuantizedFrame are the three parts of
+// GifWriteFrameWithPalette, for callers that time them separately. Returns false if
+// memory for the palette could not be allocated.
+static bool
+GifMakeFramePalette(GifWriter* writer, const uint8_t* image, uint32_t width,
+                    uint32_t height, int bitDepth, bool dither, GifPalette* pPal)
+{
+    const uint8_t* oldImage = (dither || writer->firstFrame)? NULL : writer->oldImage;
+
+    return GifMakePalette(oldImage, image, width, height, bitDepth, dither, pPal,
+                          &writer->paletteScratch);
+}
+
+// Maps an RGBA frame onto a palette, dithering it or not, leaving the palette indices
+// in the alpha channel of writer->oldImage. Returns false if memory for dithering
+// could not be allocated.
+static bool
+GifQuantizeFrame(GifWriter* writer, const uint8_t* image, uint32_t width,
+                 uint32_t height, bool dither, GifPalette* pPal)
+{
     const uint8_t* oldImage = writer->firstFrame? NULL : writer->oldImage;
+
+    if(dither)
+        return GifDitherImage(oldImage, image, writer->oldImage, width, height, pPal,
+                              &writer->ditherScratch, writer->ditherThreads);
+
+    GifThresholdImage(oldImage, image, writer->oldImage, width, height, pPal);
+    return true;
+}
+
+// Writes out a frame mapped onto pPal by GifQuantizeFrame.
+static void
+GifWriteQuantizedFrame(GifWriter* writer, uint32_t width, uint32_t height,
+                       uint32_t delay, const GifPalette* pPal)
+{
+    const bool firstFrame = writer->firstFrame;
     writer->firstFrame = false;
 
+    // the palette index is in the alpha channel
+    GifWriteChangedRects(writer, writer->oldImage+3, 4, width, height, delay, pPal,
+                         pPal->bitDepth, firstFrame);
+}
+
+// Same as GifWriteFrame below, but with the palette optionally made ahead of time.
+// The palette of a dithered frame does not depend on earlier frames, so it can be
+// made with GifMakePalette(NULL, image, width, height, bitDepth, true, &pal, &scratch)
+// on another thread, with its own scratch, while earlier frames are still being written.
+// Pass NULL to have the palette made here, which is required for frames that are not
+// dithered. Returns false if memory for the palette could not be allocated.
+static bool
+GifWriteFrameWithPalette(GifWriter* writer, const uint8_t* image, uint32_t width,
+                         uint32_t height, uint32_t delay, int bitDepth, bool dither,
+                         const GifPalette* pPal)
+{
+    if (!writer->f)
+        return false;
+
     GifPalette pal;
-    GifMakePalette((dither? NULL : oldImage), image, width, height, bitDepth, dither, &pal);
+    if(pPal)
+        pal = *pPal;
+    else if(!GifMakeFramePalette(writer, image, width, height, bitDepth, dither, &pal))
+        return false;
 
-    if(dither)
-        GifDitherImage(oldImage, image, writer->oldImage, width, height, &pal);
-    else
-        GifThresholdImage(oldImage, image, writer->oldImage, width, height, &pal);
+    if(!GifQuantizeFrame(writer, image, width, height, dither, &pal))
+        return false;
 
-    GifWriteLzwImage(writer->f, writer->oldImage, 0, 0, width, height, delay, &pal);
+    GifWriteQuantizedFrame(writer, width, height, delay, &pal);
+    return true;
+}
 
-    return;
+// Writes out a new frame to a GIF in progress.
+// The GIFWriter should have been created by GIFBegin.
+// AFAIK, it is legal to use different bit depths for different frames of an image -
+// this may be handy to save bits in animations that don't change much.
+static inline bool
+GifWriteFrame(GifWriter* writer, const uint8_t* image, uint32_t width,
+              uint32_t height, uint32_t delay, int bitDepth, bool dither)
+{
+    return GifWriteFrameWithPalette(writer, image, width, height, delay, bitDepth, dither, NULL);
 }
 
 // Writes the EOF code, closes the file handle, and frees temp memory used by a GIF.
@@ -816,7 +1570,13 @@ static void GifEnd(GifWriter* writer)
     fputc(0x3b, writer->f);
     fclose(writer->f);
     free(writer->oldImage);
+    free(writer->rowSpans);
+    GifFreePaletteScratch(&writer->paletteScratch);
+    GifFreeDitherScratch(&writer->ditherScratch);
 
     writer->f = NULL;
     writer->oldImage = NULL;
+    writer->rowSpans = NULL;
 }
+
+#endif
@@ -23,84 +23,23 @@
  *  Date:   June 2, 2021                                                      *
  ******************************************************************************/
 
-/*  FILE, fopen, fputc, puts, and other input / output functions found here.  */
+/*  puts and printf found here.                                               */
 #include <stdio.h>
 
-/******************************************************************************
- *  Function:                                                                 *
- *      color                                                                 *
- *  Purpose:                                                                  *
- *      Writes an RGB color to a PPM file.                                    *
- *  Arguments:                                                                *
- *      red (unsigned char):                                                  *
- *          The value of the red channel. 8-bits.                             *
- *      green (unsigned char):                                                *
- *          The value of the green channel. 8-bits.                           *
- *      blue (unsigned char):                                                 *
- *          The value of the blue channel. 8-bits.                            *
- *      fp (FILE *):                                                          *
- *          A pointer to the PPM file.                                        *
- *  Output:                                                                   *
- *      None (void).                                                          *
- ******************************************************************************/
-static void
-color(unsigned char red, unsigned char green, unsigned char blue, FILE *fp)
-{
-    fputc(red, fp);
-    fputc(green, fp);
-    fputc(blue, fp);
-}
+/*  Viewports, the Mandelbrot iteration, coloring, and rendering found here.  */
+#include "fractal.h"
 
-/******************************************************************************
- *  Function:                                                                 *
- *      complex_abs_squared                                                   *
- *  Purpose:                                                                  *
- *      Computes the square of the complex modulus, f(z) = |z|^2.             *
- *  Arguments:                                                                *
- *      re (double):                                                          *
- *          The real part of the complex number.                              *
- *      im (double):                                                          *
- *          The imaginary part of the complex number.                         *
- *  Output:                                                                   *
- *      abs_sq (double):                                                      *
- *          The square of the absolute value of z = re + i*im.                *
- ******************************************************************************/
-static double
-complex_abs_squared(double re, double im)
-{
-    return re*re + im*im;
-}
+/*  The --threads, --mmap, --field, and --preview options found here.         */
+#include "fractal_options.h"
 
-/******************************************************************************
- *  Function:                                                                 *
- *      mandelbrot_iter                                                       *
- *  Purpose:                                                                  *
- *      Computes the Mandelbrot iteration, z_{n+1} = z_{n}^2 + z_{0}.         *
- *  Arguments:                                                                *
- *      xn (double *):                                                        *
- *          The real part of z_{n}.                                           *
- *      yn (double *):                                                        *
- *          The imaginary part of z_{n}.                                      *
- *      x0 (const double *):                                                  *
- *          The real part of z_{0}.                                           *
- *      y0 (const double *):                                                  *
- *          The imaginary part of z_{0}.                                      *
- *  Output:                                                                   *
- *      None (void).                                                          *
- ******************************************************************************/
-static void
-mandelbrot_iter(double *xn, double *yn, const double *x0, const double *y0)
-{
-    /*  Avoiding overwriting the real part of the complex number.             */
-    const double tmp = *xn;
+/*  fractal_render_ppm_progressive, for drawing and saving the image, here.   */
+#include "ppm.h"
 
-    /*  Calculate the new value. z_{n+1} = z_{n}^2 + z_{0}.                   */
-    *xn = *xn * *xn - *yn * *yn + *x0;
-    *yn = 2.0 * tmp * *yn + *y0;
-}
+/*  fractal_render_field, for saving the iteration counts instead, here.      */
+#include "fractal_field.h"
 
-/*  Function for drawing the Mandelbrot set.                                  */
-int main(void)
+/*  Function for drawing the Mandelbrot set. Options in fractal_options.h.    */
+int main(int argc, char **argv)
 {
     /*  The number of pixels in both the x and y axes. The PPM is a square.   */
     const unsigned int size = 1024U;
@@ -108,12 +47,6 @@ int main(void)
     /*  Half the above constant, used for the scale factor.                   */
     const unsigned int half_size = size >> 1U;
 
-    /*  Variables for looping over the x and y coordinates in the plane.      */
-    unsigned int x, y;
-
-    /*  Index for keeping track of the number of iterations performed.        */
-    unsigned char iters;
-
     /*  "Zoom" factor for scaling the image so the Mandelbrot set fits better.*/
     const double zoom = 0.65;
 
@@ -124,79 +57,74 @@ int main(void)
     const double x_start = -0.8;
     const double y_start = +0.0;
 
-    /*  Translations used for converting between pixels and points.           */
-    const double x_shift = x_start - scale_factor * (double)half_size;
-    const double y_shift = y_start - scale_factor * (double)half_size;
-
-    /*  The radius of the circle. Points outside of this diverge.             */
-    const double radius = 4.0;
-    const double radius_squared = radius*radius;
+    /*  The Mandelbrot set, viewport, and renderer for the drawing.           */
+    struct fractal mandelbrot;
+    struct fractal_viewport viewport;
+    struct fractal_renderer renderer;
 
-    /*  Maximum number of iterations allowed in the computation.              */
-    const unsigned char max_iters = 0xFFU;
+    /*  Settings from the command line, the number of threads and so on.      */
+    struct fractal_options opts;
 
-    /*  Color factors to brighten the region around the Mandelbrot set.       */
-    const unsigned char threshold = 0x40U;
-    const unsigned char color_scale = 0x04U;
+    /*  The number of pixels iterated, the rest are filled in.                */
+    size_t pixels_iterated;
 
-    /*  Declare a variable for the output file and give it write permission.  */
-    FILE * const fp = fopen("mandelbrot_set_001.ppm", "w");
-
-    /*  fopen returns NULL on failure. Check for this.                        */
-    if (!fp)
-    {
-        puts("fopen returned NULL. Aborting.");
+    if (fractal_parse_options(argc, argv, &opts) != 0)
         return -1;
-    }
 
-    /*  Otherwise print the preamble to the PPM file.                         */
-    fprintf(fp, "P6\n%u %u\n255\n", size, size);
+    /*  z_{n+1} = z_{n}^2 + z_{0}, 255 iterations, escape radius 4.           */
+    fractal_init_mandelbrot(&mandelbrot);
 
-    /*  Loop through each pixel for the y-axis.                               */
-    for(y = 0U; y < size; y++)
+    /*  Translations used for converting between pixels and points.           */
+    viewport.width = size;
+    viewport.height = size;
+    viewport.x_start = x_start - scale_factor * (double)half_size;
+    viewport.y_start = y_start - scale_factor * (double)half_size;
+    viewport.x_step = scale_factor;
+    viewport.y_step = scale_factor;
+
+    renderer.fractal = &mandelbrot;
+    renderer.viewport = &viewport;
+    renderer.color = fractal_color_banded;
+    renderer.channels = 3U;
+    renderer.reference = NULL;
+    renderer.center = NULL;
+    renderer.colormap = NULL;
+
+    /*  The coloring only depends on the number of iterations, so every band  *
+     *  of equal counts can be filled in, not only the interior of the set.   */
+    renderer.subdivide = FRACTAL_SUBDIVIDE_BANDS;
+
+    /*  Save the raw iteration counts instead, to be colored later on.        */
+    if (opts.field_filename)
     {
-        /*  And each pixel in the x-axis.                                     */
-        for(x = 0U; x < size; x++)
+        if (fractal_render_field(&renderer, opts.field_filename,
+                                 opts.field_abs_z, opts.number_of_threads,
+                                 opts.use_mmap, NULL) != 0)
         {
-            /*  Calculate the location of the current point in the plane.     */
-            const double x0 = x * scale_factor + x_shift;
-            const double y0 = y * scale_factor + y_shift;
-
-            /*  Initialize the complex number to x0 + i*y0.                   */
-            double z_re = x0;
-            double z_im = y0;
-
-            /*  Start the iteration process. Stop when the iteration diverges *
-             *  outside of the circle, or when too many iterations are done.  */
-            for (iters = 0x00U; iters < max_iters; ++iters)
-            {
-                /*  Calculate the next iteration.                             */
-                mandelbrot_iter(&z_re, &z_im, &x0, &y0);
-
-                /*  Once the iteration falls outside the circle, abort.       */
-                if (complex_abs_squared(z_re, z_im) > radius_squared)
-                    break;
-            }
-
-            /*  Points that don't diverge are the Mandelbrot set. Color black.*/
-            if (iters == max_iters)
-                color(0x00U, 0x00U, 0x00U, fp);
-
-            /*  Points that diverged very quickly. Blue-to-Yellow gradient.   */
-            else if (iters < threshold)
-            {
-                const unsigned char brightness = iters * color_scale;
-                color(brightness, brightness, 0xFFU - brightness, fp);
-            }
-
-            /*  Points that took a long time to diverge, color yellow.        */
-            else
-                color(0xFF, 0xFF, 0x00, fp);
+            printf("Failed to write %s. Aborting.\n", opts.field_filename);
+            return -1;
         }
+
+        /*  Counters and timers, printed for FRACTAL_STATS builds only.       */
+        fractal_stats_finish(NULL);
+        return 0;
     }
 
-    /*  Close the file and return.                                            */
-    fclose(fp);
+    /*  Draw the image a band at a time, writing each band in one go, or      *
+     *  coarse to fine with --preview.                                        */
+    if (fractal_render_ppm_progressive(&renderer, "mandelbrot_set_001.ppm",
+                                       opts.preview_filename,
+                                       opts.number_of_threads, opts.use_mmap,
+                                       &pixels_iterated) != 0)
+    {
+        puts("Failed to write mandelbrot_set_001.ppm. Aborting.");
+        return -1;
+    }
+
+    printf("Iterated %.1f%% of the pixels.\n",
+           100.0 * (double)pixels_iterated / ((double)size * (double)size));
+
+    fractal_stats_finish(NULL);
     return 0;
 }
 /*  End of main.                                                              */
@@ -16,105 +16,310 @@
  *  You should have received a copy of the GNU General Public License         *
  *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
  ******************************************************************************/
-#include <math.h>
 #include <stdlib.h>
 #include "gif.h"
+#include "fractal.h"
+#include "fractal_animate.h"
+#include "fractal_options.h"
+#include "fractal_zoom.h"
 
-struct complex_number {
-    double real, imag;
+/*  State kept by each worker thread from one frame to the next.              */
+struct zoom_worker {
+
+    /*  The keyframe the current frames are resampled from, the precision     *
+     *  its frame needed (an enum fractal_precision, or -1 for none yet), and *
+     *  the method it was drawn with, see zoom_method.                        */
+    struct fractal_keyframe keyframe;
+    int keyframe_precision;
+    enum fractal_precision keyframe_method;
+
+    /*  A copy of the shared reference orbit. The orbit itself is shared, but *
+     *  each worker needs its own series approximation.                       */
+    struct fractal_reference reference;
 };
 
-static struct complex_number
-mandel_func(struct complex_number z, struct complex_number c)
+/*  Settings shared by every frame of the zoom.                               */
+struct zoom {
+    double center_x, center_y, ds;
+
+    /*  The center to double-double precision, for frames that need it.       */
+    struct fractal_dd_complex center;
+    unsigned int width, height;
+    unsigned int keyframe_interval;
+    double oversample;
+    const struct fractal *fractal;
+
+    /*  Boolean for palette indices into fractal_smooth_colormap, rather than *
+     *  RGBA pixels.                                                          */
+    int global_palette;
+
+    /*  Precomputed smooth colors, shared by every worker.                    */
+    const struct fractal_colormap *colormap;
+    struct zoom_worker *workers;
+};
+
+/*  Picks how to draw an image that needs the given precision. Perturbation   *
+ *  starts every pixel where the series for the image stops, and is used in   *
+ *  place of double-double when that makes it the faster of the two.          */
+static enum fractal_precision
+zoom_method(const struct zoom *z, struct zoom_worker *w,
+            enum fractal_precision precision,
+            const struct fractal_viewport *viewport)
 {
-    struct complex_number out;
-    out.real = z.real*z.real - z.imag*z.imag + c.real;
-    out.imag = 2.0*z.real*z.imag + c.imag;
-    return out;
+    if (precision == FRACTAL_PRECISION_DOUBLE)
+        return precision;
+
+    fractal_series_compute(&w->reference, z->fractal, viewport);
+
+    if (fractal_precision_prefer_perturbation(&w->reference, z->fractal))
+        return FRACTAL_PRECISION_PERTURBATION;
+
+    return precision;
+}
+
+/*  Draws a frame of the zoom, see fractal_frame_func in fractal_animate.h.   */
+static int
+zoom_draw_frame(void *data, unsigned int worker,
+                unsigned int frame, unsigned char *image)
+{
+    const struct zoom * const z = data;
+    struct zoom_worker * const w = &z->workers[worker];
+    struct fractal_viewport viewport;
+    struct fractal_renderer renderer;
+    struct fractal fractal = *z->fractal;
+    double ds = z->ds;
+    unsigned int n;
+    enum fractal_precision precision, method;
+    int new_keyframe = 0;
+
+    /*  Scale once per frame, rounding exactly as a running product would.    */
+    for (n = 0U; n < frame; ++n)
+        ds *= 0.95;
+
+    renderer.fractal = &fractal;
+    renderer.viewport = &viewport;
+    renderer.color = z->global_palette ? fractal_index_smooth
+                                       : fractal_color_smooth;
+    renderer.channels = z->global_palette ? 1U : 4U;
+    renderer.reference = NULL;
+    renderer.center = NULL;
+    renderer.colormap = z->colormap;
+    renderer.subdivide = FRACTAL_SUBDIVIDE_NONE;
+
+    /*  Each frame uses the cheapest precision deep enough for it. Frames     *
+     *  past doubles give each pixel as an offset from the center.            */
+    precision = fractal_precision_select(z->center_x, z->center_y,
+                                         2.0*ds / (double)(z->width - 1U));
+
+    if (precision == FRACTAL_PRECISION_DOUBLE)
+        fractal_viewport_from_center(&viewport, z->width, z->height,
+                                     z->center_x, z->center_y, ds);
+    else
+        fractal_viewport_from_center(&viewport, z->width, z->height,
+                                     0.0, 0.0, ds);
+
+    /*  Shrink the period tolerance with the pixels, which keyframes make     *
+     *  finer still by a factor of oversample.                                */
+    fractal_limit_period_tolerance(&fractal, viewport.x_step / z->oversample);
+
+    if (z->keyframe_interval > 1U)
+    {
+        /*  New keyframes are also needed when switching precision. Frames    *
+         *  are handed out in runs of keyframe_interval, so the keyframe for  *
+         *  a frame was always drawn by the same worker. The frames resampled *
+         *  from a keyframe are drawn the same way it was.                    */
+        if (frame % z->keyframe_interval == 0U ||
+            (int)precision != w->keyframe_precision)
+        {
+            if (fractal_keyframe_begin(&w->keyframe, &viewport, z->oversample,
+                                       renderer.channels) != 0)
+                return -1;
+
+            w->keyframe_precision = (int)precision;
+            w->keyframe_method = zoom_method(z, w, precision,
+                                             &w->keyframe.viewport);
+            new_keyframe = 1;
+        }
+
+        method = w->keyframe_method;
+    }
+    else
+        method = zoom_method(z, w, precision, &viewport);
+
+    /*  Double-double and perturbation both take offsets from the center.     */
+    if (method == FRACTAL_PRECISION_DOUBLE_DOUBLE)
+        renderer.center = &z->center;
+    else if (method == FRACTAL_PRECISION_PERTURBATION)
+        renderer.reference = &w->reference;
+
+    /*  The frame a keyframe is made for is rendered exactly, and only the    *
+     *  frames after it are resampled.                                        */
+    if (new_keyframe)
+        fractal_keyframe_render(&w->keyframe, &renderer);
+    else if (z->keyframe_interval > 1U)
+    {
+        fractal_keyframe_resample(&w->keyframe, &renderer, image);
+        return 0;
+    }
+
+    fractal_render(&renderer, image);
+
+    return 0;
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    const unsigned int imax = 255U;
-    const double zmax = 4.0;
     const double center_x = 0.001643721971153;
     const double center_y = -0.822467633298876;
-    double ds = 3.0;
+
+    /*  The same center as decimal strings, for the deeper frames.            */
+    const char *center_x_digits = "0.001643721971153";
+    const char *center_y_digits = "-0.822467633298876";
+    const double ds = 3.0;
     const unsigned int width = 256U;
     const unsigned int height = 256U;
     const unsigned int nframes = 1000U;
-    uint8_t *image = malloc(sizeof(*image)*width*height*4);
 
-    unsigned int x, y, iters, frame;
-    unsigned char red, green, blue;
-    double c_x, c_y, backgnd, val;
-    struct complex_number z, c;
+    unsigned int n;
+    int status;
+    struct fractal mandelbrot;
+    struct fractal_reference reference;
+    struct fractal_options opts;
+    struct fractal_animator animator;
+    struct zoom zoom;
+    double final_ds;
+
+    unsigned char palette[256U * 3U];
+    struct fractal_colormap colormap;
 
     const char* filename = "mandelbrot_set_gif_001.gif";
     GifWriter writer;
-    GifBegin(&writer, filename, width, height, 2, 8, true);
 
-    for (frame = 0; frame < nframes; ++frame)
+    /*  --threads N sets the number of frames drawn at once, --keyframes K    *
+     *  resamples K - 1 of every K frames from a keyframe, and                *
+     *  --global-palette writes one fixed palette matching the smooth         *
+     *  coloring, and frames of indices into it.                              */
+    if (fractal_parse_options(argc, argv, &opts) != 0)
+        return -1;
+
+    /*  z_{n+1} = z_{n}^2 + c with z_{0} = 0, stopping once |Re(z)| >= 4.     */
+    fractal_init_mandelbrot(&mandelbrot);
+    mandelbrot.escape_test = FRACTAL_ESCAPE_REAL_PART;
+    mandelbrot.start_at_c = 0;
+
+    /*  Stop early on orbits that have become periodic. Checked against the   *
+     *  unchecked output, 1e-12 leaves every pixel of every frame unchanged   *
+     *  at 255 iterations. Larger tolerances, or many more iterations, let    *
+     *  points near the repelling cycles at the center be misclassified, so   *
+     *  deeper frames lower it with the pixel spacing, see zoom_draw_frame.   */
+    mandelbrot.check_period = 1;
+    mandelbrot.period_tolerance = 1E-12;
+
+    /*  Frames past ds ~ 1e-10 are too deep for doubles. They are drawn in    *
+     *  double-double, or with perturbation once its series makes it cheaper, *
+     *  and always past ds ~ 1e-25. A single reference orbit, precise enough  *
+     *  for the last frame, serves all of them.                               */
+    final_ds = ds * pow(0.95, (double)(nframes - 1U));
+    fractal_reference_init(&reference);
+
+    if (fractal_dd_from_string(&zoom.center.real, center_x_digits) != 0 ||
+        fractal_dd_from_string(&zoom.center.imag, center_y_digits) != 0)
     {
-        double x_min = center_x - ds;
-        double x_max = center_x + ds;
-        double y_min = center_y - ds;
-        double y_max = center_y + ds;
-
-        double x_factor = (x_max - x_min) / ((double)width - 1.0);
-        double y_factor = (y_max - y_min) / ((double)height - 1.0);
-        for (y = 0U; y < height; ++y)
-        {
-            c_y = y_max - (double)y * y_factor;
-            for (x = 0U; x < width; ++x)
-            {
-                c_x = x_min + (double)x * x_factor;
-                c.real = c_x;
-                c.imag = c_y;
-                z.real = 0.0;
-                z.imag = 0.0;
-                backgnd = 0.0;
-                for (iters = 0U; iters < imax; ++iters)
-                {
-                    z = mandel_func(z, c);
-                    if (fabs(z.real) >= zmax)
-                    {
-                        backgnd = log(log(fabs(z.real) + 1.0) * 0.33333333333);
-                        backgnd = log(fabs((double)iters - backgnd));
-                        backgnd = backgnd * 0.3076923076923077;
-                        break;
-                    }
-                }
-
-                val = 1.0 - fabs(1.0 - backgnd);
-                if (val < 0.0)
-                    val = 0.0;
-
-                if (backgnd <= 1.0)
-                {
-                    red = (unsigned char)(255.0 * pow(val, 4.0));
-                    green = (unsigned char)(255.0 * pow(val, 2.5));
-                    blue = (unsigned char)(unsigned char)(255.0 * val);
-                }
-                else
-                {
-                    red = (unsigned char)(255.0 * val);
-                    green = (unsigned char)(255.0 * pow(val, 1.5));
-                    blue = (unsigned char)(255.0 * pow(val, 3.0));
-                }
-                uint8_t* pixel = &image[(y*width + x)*4];
-                pixel[0] = red;
-                pixel[1] = green;
-                pixel[2] = blue;
-                pixel[3] = 255;
-            }
-        }
+        puts("Failed to read the center. Aborting.");
+        return -1;
+    }
 
-        printf( "Writing frame %d...\n", frame);
-        GifWriteFrame(&writer, image, width, height, 2, 8, true);
-        ds *= 0.95;
+    if (fractal_precision_select(center_x, center_y,
+                                 2.0 * final_ds / (double)(width - 1U))
+            != FRACTAL_PRECISION_DOUBLE &&
+        fractal_reference_compute(&reference, &mandelbrot,
+                                  center_x_digits, center_y_digits,
+                                  2.0 * final_ds / (double)(width - 1U)) != 0)
+    {
+        puts("Failed to compute the reference orbit. Aborting.");
+        return -1;
+    }
+
+    /*  Coloring is a table lookup, rather than a log and two powers.         */
+    if (fractal_colormap_init(&colormap) != 0)
+    {
+        puts("Failed to make the colormap. Aborting.");
+        fractal_reference_free(&reference);
+        return -1;
     }
+
+    zoom.center_x = center_x;
+    zoom.center_y = center_y;
+    zoom.ds = ds;
+    zoom.width = width;
+    zoom.height = height;
+    zoom.keyframe_interval = opts.keyframe_interval;
+
+    /*  The keyframe needs enough pixels for the last, smallest, frame that   *
+     *  uses it, see fractal_zoom.h.                                          */
+    zoom.oversample = pow(1.0 / 0.95, (double)(opts.keyframe_interval - 1U));
+    zoom.global_palette = opts.global_palette;
+    zoom.colormap = &colormap;
+    zoom.fractal = &mandelbrot;
+    zoom.workers = malloc(sizeof(*zoom.workers) * opts.number_of_threads);
+
+    if (!zoom.workers)
+    {
+        puts("Failed to allocate the workers. Aborting.");
+        fractal_reference_free(&reference);
+        fractal_colormap_free(&colormap);
+        return -1;
+    }
+
+    for (n = 0U; n < opts.number_of_threads; ++n)
+    {
+        fractal_keyframe_init(&zoom.workers[n].keyframe);
+        zoom.workers[n].keyframe_precision = -1;
+        zoom.workers[n].reference = reference;
+    }
+
+    /*  Each worker keeps a keyframe for a run of --keyframes frames,         *
+     *  with one extra run of frames buffered for the writer.                 */
+    animator.writer = &writer;
+    animator.width = width;
+    animator.height = height;
+    animator.number_of_frames = nframes;
+    animator.delay = 2U;
+    animator.bit_depth = 8;
+    animator.dither = true;
+    animator.indexed = opts.global_palette;
+    animator.draw = zoom_draw_frame;
+    animator.data = &zoom;
+    animator.number_of_threads = opts.number_of_threads;
+    animator.frames_per_task = opts.keyframe_interval;
+    animator.number_of_slots
+        = (opts.number_of_threads + 1U) * opts.keyframe_interval;
+    animator.print_progress = 1;
+
+    if (opts.global_palette)
+    {
+        fractal_smooth_colormap(palette);
+        GifBeginWithPalette(&writer, filename, width, height, 2, palette, 8);
+    }
+    else
+        GifBegin(&writer, filename, width, height, 2, 8, true);
+
+    status = fractal_animate(&animator);
     GifEnd(&writer);
-    free(image);
-    return 0;
+
+    if (status != 0)
+        puts("Failed to draw the animation. Aborting.");
+    else if (fractal_stats_finish(opts.stats_filename) != 0)
+    {
+        printf("Failed to write %s.\n", opts.stats_filename);
+        status = -1;
+    }
+
+    for (n = 0U; n < opts.number_of_threads; ++n)
+        fractal_keyframe_free(&zoom.workers[n].keyframe);
+
+    free(zoom.workers);
+    fractal_reference_free(&reference);
+    fractal_colormap_free(&colormap);
+    return status;
 }
@@ -16,124 +16,148 @@
  *  You should have received a copy of the GNU General Public License         *
  *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
  ******************************************************************************/
-#include <math.h>
 #include <stdlib.h>
 #include "gif.h"
+#include "fractal.h"
+#include "fractal_animate.h"
+#include "fractal_options.h"
 
-#define PI_BY_TWO 1.5707963267948966
+/*  Settings shared by every frame.                                           */
+struct sweep {
+    double center_x, center_y, ds;
+    unsigned int width, height;
+    double r, dr;
+    const struct fractal *fractal;
 
-struct complex_number {
-    double real, imag;
+    /*  Boolean for palette indices into fractal_smooth_colormap, rather than *
+     *  RGBA pixels.                                                          */
+    int global_palette;
+
+    /*  Precomputed smooth colors, shared by every worker.                    */
+    const struct fractal_colormap *colormap;
 };
 
-struct complex_number complex_pow(struct complex_number z, double exponent)
+/*  Draws a frame of the sweep, see fractal_frame_func in fractal_animate.h.  */
+static int
+sweep_draw_frame(void *data, unsigned int worker,
+                 unsigned int frame, unsigned char *image)
 {
-    double abs_z = sqrt(z.real*z.real + z.imag*z.imag);
-    double arg = atan2(z.imag, z.real);
-    double x = exponent * log(abs_z);
-    double y = exponent * arg;
-
-    double exp_val = exp(x);
-    double real_part = exp_val * cos(y);
-    double imag_part = exp_val * sin(y);
-    struct complex_number out;
-    out.real = real_part;
-    out.imag = imag_part;
-    return out;
-}
+    const struct sweep * const s = data;
+    struct fractal multibrot = *s->fractal;
+    struct fractal_viewport viewport;
+    struct fractal_renderer renderer;
+    double r = s->r;
+    unsigned int n;
+    (void)worker;
 
-static struct complex_number
-mandel_func(struct complex_number z, struct complex_number c, double r)
-{
-    struct complex_number out = complex_pow(z, r);
-    out.real += c.real;
-    out.imag += c.imag;
-    return out;
+    /*  Step once per frame, rounding exactly as a running sum would.         */
+    for (n = 0U; n < frame; ++n)
+        r += s->dr;
+
+    multibrot.power = r;
+    fractal_viewport_from_center(&viewport, s->width, s->height,
+                                 s->center_x, s->center_y, s->ds);
+
+    renderer.fractal = &multibrot;
+    renderer.viewport = &viewport;
+    renderer.color = s->global_palette ? fractal_index_smooth
+                                       : fractal_color_smooth;
+    renderer.channels = s->global_palette ? 1U : 4U;
+    renderer.reference = NULL;
+    renderer.center = NULL;
+    renderer.colormap = s->colormap;
+    renderer.subdivide = FRACTAL_SUBDIVIDE_NONE;
+
+    fractal_render(&renderer, image);
+    return 0;
 }
 
-int main(void)
+int main(int argc, char **argv)
 {
-    const unsigned int imax = 255U;
-    const double zmax = 4.0;
     const double center_x = 0.0;
     const double center_y = 0.0;
     const double ds = 2.0;
     const unsigned int width = 512U;
     const unsigned int height = 512U;
     const unsigned int nframes = 500U;
-    uint8_t image[width*height*4];
 
-    unsigned int x, y, iters, frame;
-    unsigned char red, green, blue;
-    double c_x, c_y, backgnd, val, exp_x;
-    struct complex_number z, c;
+    int status;
+    struct fractal multibrot;
+    struct fractal_options opts;
+    struct fractal_animator animator;
+    struct sweep sweep;
     double r = 1.0;
     double dr = 10.0 / (double)nframes;
 
+    unsigned char palette[256U * 3U];
+    struct fractal_colormap colormap;
+
     const char* filename = "mandelbrot_set_gif_002.gif";
     GifWriter writer;
-    GifBegin(&writer, filename, width, height, 2, 8, true);
 
-    for (frame = 0; frame < nframes; ++frame)
+    /*  --threads N sets the number of frames drawn at once, and              *
+     *  --global-palette writes one fixed palette matching the smooth         *
+     *  coloring, and frames of indices into it.                              */
+    if (fractal_parse_options(argc, argv, &opts) != 0)
+        return -1;
+
+    /*  z_{n+1} = z_{n}^r + c with z_{0} = 0, stopping once |Re(z)| >= 4.     */
+    fractal_init_multibrot(&multibrot, r);
+
+    /*  Coloring is a table lookup, rather than a log and two powers.         */
+    if (fractal_colormap_init(&colormap) != 0)
     {
-        double x_min = center_x - ds;
-        double x_max = center_x + ds;
-        double y_min = center_y - ds;
-        double y_max = center_y + ds;
-
-        double x_factor = (x_max - x_min) / ((double)width - 1.0);
-        double y_factor = (y_max - y_min) / ((double)height - 1.0);
-        for (y = 0U; y < height; ++y)
-        {
-            c_y = y_max - (double)y * y_factor;
-            for (x = 0U; x < width; ++x)
-            {
-                c_x = x_min + (double)x * x_factor;
-                c.real = c_x;
-                c.imag = c_y;
-                z.real = 0.0;
-                z.imag = 0.0;
-                backgnd = 0.0;
-                for (iters = 0U; iters < imax; ++iters)
-                {
-                    z = mandel_func(z, c, r);
-                    if (fabs(z.real) >= zmax)
-                    {
-                        backgnd = log(log(fabs(z.real) + 1.0) * 0.33333333333);
-                        backgnd = log(fabs((double)iters - backgnd));
-                        backgnd = backgnd * 0.3076923076923077;
-                        break;
-                    }
-                }
-
-                val = 1.0 - fabs(1.0 - backgnd);
-                if (val < 0.0)
-                    val = 0.0;
-
-                if (backgnd <= 1.0)
-                {
-                    red = (unsigned char)(255.0 * pow(val, 4.0));
-                    green = (unsigned char)(255.0 * pow(val, 2.5));
-                    blue = (unsigned char)(unsigned char)(255.0 * val);
-                }
-                else
-                {
-                    red = (unsigned char)(255.0 * val);
-                    green = (unsigned char)(255.0 * pow(val, 1.5));
-                    blue = (unsigned char)(255.0 * pow(val, 3.0));
-                }
-                uint8_t* pixel = &image[(y*width + x)*4];
-                pixel[0] = red;
-                pixel[1] = green;
-                pixel[2] = blue;
-                pixel[3] = 255;
-            }
-        }
-
-        r += dr;
-        printf( "Writing frame %d...\n", frame);
-        GifWriteFrame(&writer, image, width, height, 2, 8, true);
+        puts("Failed to make the colormap. Aborting.");
+        return -1;
     }
+
+    sweep.center_x = center_x;
+    sweep.center_y = center_y;
+    sweep.ds = ds;
+    sweep.width = width;
+    sweep.height = height;
+    sweep.r = r;
+    sweep.dr = dr;
+    sweep.global_palette = opts.global_palette;
+    sweep.colormap = &colormap;
+    sweep.fractal = &multibrot;
+
+    /*  Frames are independent, so hand them out one at a time, with two      *
+     *  buffered per worker.                                                  */
+    animator.writer = &writer;
+    animator.width = width;
+    animator.height = height;
+    animator.number_of_frames = nframes;
+    animator.delay = 2U;
+    animator.bit_depth = 8;
+    animator.dither = true;
+    animator.indexed = opts.global_palette;
+    animator.draw = sweep_draw_frame;
+    animator.data = &sweep;
+    animator.number_of_threads = opts.number_of_threads;
+    animator.frames_per_task = 1U;
+    animator.number_of_slots = 2U * opts.number_of_threads;
+    animator.print_progress = 1;
+
+    if (opts.global_palette)
+    {
+        fractal_smooth_colormap(palette);
+        GifBeginWithPalette(&writer, filename, width, height, 2, palette, 8);
+    }
+    else
+        GifBegin(&writer, filename, width, height, 2, 8, true);
+
+    status = fractal_animate(&animator);
     GifEnd(&writer);
-    return 0;
+
+    if (status != 0)
+        puts("Failed to draw the animation. Aborting.");
+    else if (fractal_stats_finish(opts.stats_filename) != 0)
+    {
+        printf("Failed to write %s.\n", opts.stats_filename);
+        status = -1;
+    }
+
+    fractal_colormap_free(&colormap);
+    return status;
 }
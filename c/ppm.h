@@ -0,0 +1,672 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Writes binary (P6) PPM files. Rows of RGB pixels are passed in bands  *
+ *      and each band is written with a single call to write, rather than     *
+ *      three calls to fputc per pixel. Alternatively the file can be memory  *
+ *      mapped, and the image drawn straight into it with no copying at all.  *
+ *                                                                            *
+ *      fractal_render_ppm combines this with fractal_threads.h, rendering a  *
+ *      band of rows in parallel and then writing it out. Only one band is    *
+ *      held in memory, so very large images (32768 x 32768 and beyond) can   *
+ *      be drawn without allocating the entire image.                         *
+ *                                                                            *
+ *      The same code writes any file made of a header followed by rows of    *
+ *      fixed size pixels, see the _raw functions, which fractal_field.h uses *
+ *      for iteration count fields.                                           *
+ *  Notes:                                                                    *
+ *      Uses the POSIX open, write, ftruncate, and mmap functions.            *
+ ******************************************************************************/
+
+/*  Include guard to prevent including this file twice.                       */
+#ifndef PPM_H
+#define PPM_H
+
+/*  errno and EINTR found here.                                               */
+#include <errno.h>
+
+/*  open and the O_* flags found here.                                        */
+#include <fcntl.h>
+
+/*  snprintf found here.                                                      */
+#include <stdio.h>
+
+/*  malloc and free found here.                                               */
+#include <stdlib.h>
+
+/*  memcpy found here.                                                        */
+#include <string.h>
+
+/*  mmap and munmap found here.                                               */
+#include <sys/mman.h>
+
+/*  write, close, and ftruncate found here.                                   */
+#include <unistd.h>
+
+/*  fractal_render_rows_parallel, used by fractal_render_ppm, found here.     */
+#include "fractal_threads.h"
+
+/*  fractal_render_progressive, used by fractal_render_ppm_progressive.       */
+#include "fractal_progressive.h"
+
+/*  Approximate size of a band of rows, in bytes. Images smaller than this    *
+ *  are drawn in one go and written with a single call to write.              */
+#define PPM_BAND_BYTES ((size_t)16U << 20U)
+
+/*  State for a PPM file in progress.                                         */
+struct ppm_writer {
+
+    /*  File descriptor for the output, -1 if the file is not open.           */
+    int fd;
+
+    /*  The number of pixels in the x and y axes, respectively.               */
+    unsigned int width, height;
+
+    /*  The number of bytes in the "P6 width height 255" preamble.            */
+    size_t header_size;
+
+    /*  The number of bytes per pixel, 3 for a PPM.                           */
+    size_t pixel_size;
+
+    /*  The entire file when memory mapped, NULL otherwise.                   */
+    unsigned char *map;
+    size_t map_size;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      ppm_write_all                                                         *
+ *  Purpose:                                                                  *
+ *      Writes a buffer to a file descriptor, handling short writes.          *
+ *  Arguments:                                                                *
+ *      fd (int):                                                             *
+ *          The file descriptor.                                              *
+ *      data (const unsigned char *):                                         *
+ *          The bytes to be written.                                          *
+ *      size (size_t):                                                        *
+ *          The number of bytes to write.                                     *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+ppm_write_all(int fd, const unsigned char *data, size_t size)
+{
+    while (size > 0U)
+    {
+        const ssize_t written = write(fd, data, size);
+
+        if (written < 0)
+        {
+            /*  Interrupted by a signal before anything was written. Retry.   */
+            if (errno == EINTR)
+                continue;
+
+            return -1;
+        }
+
+        data += written;
+        size -= (size_t)written;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      ppm_header                                                            *
+ *  Purpose:                                                                  *
+ *      Prints the PPM preamble to a string.                                  *
+ *  Arguments:                                                                *
+ *      header (char *):                                                      *
+ *          The output, at least 64 bytes.                                    *
+ *      width (unsigned int):                                                 *
+ *          The number of pixels in the x axis.                               *
+ *      height (unsigned int):                                                *
+ *          The number of pixels in the y axis.                               *
+ *  Output:                                                                   *
+ *      header_size (size_t):                                                 *
+ *          The length of the preamble.                                       *
+ ******************************************************************************/
+static inline size_t
+ppm_header(char *header, unsigned int width, unsigned int height)
+{
+    return (size_t)snprintf(header, 64U, "P6\n%u %u\n255\n", width, height);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      ppm_begin_raw                                                         *
+ *  Purpose:                                                                  *
+ *      Creates a file and writes a header. Rows are then written with        *
+ *      ppm_write_rows, from top to bottom.                                   *
+ *  Arguments:                                                                *
+ *      w (struct ppm_writer *):                                              *
+ *          The writer, assumed to be uninitialized.                          *
+ *      filename (const char *):                                              *
+ *          The path to the output file.                                      *
+ *      header (const void *):                                                *
+ *          The bytes at the start of the file.                               *
+ *      header_size (size_t):                                                 *
+ *          The number of bytes in the header.                                *
+ *      width (unsigned int):                                                 *
+ *          The number of pixels in the x axis.                               *
+ *      height (unsigned int):                                                *
+ *          The number of pixels in the y axis.                               *
+ *      pixel_size (size_t):                                                  *
+ *          The number of bytes per pixel.                                    *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+ppm_begin_raw(struct ppm_writer *w, const char *filename,
+              const void *header, size_t header_size,
+              unsigned int width, unsigned int height, size_t pixel_size)
+{
+    w->width = width;
+    w->height = height;
+    w->map = NULL;
+    w->map_size = 0U;
+    w->header_size = header_size;
+    w->pixel_size = pixel_size;
+    w->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (w->fd < 0)
+        return -1;
+
+    return ppm_write_all(w->fd, header, header_size);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      ppm_begin                                                             *
+ *  Purpose:                                                                  *
+ *      Creates a PPM file and writes the preamble. Rows are then written     *
+ *      with ppm_write_rows, from top to bottom.                              *
+ *  Arguments:                                                                *
+ *      w (struct ppm_writer *):                                              *
+ *          The writer, assumed to be uninitialized.                          *
+ *      filename (const char *):                                              *
+ *          The path to the output file.                                      *
+ *      width (unsigned int):                                                 *
+ *          The number of pixels in the x axis.                               *
+ *      height (unsigned int):                                                *
+ *          The number of pixels in the y axis.                               *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+ppm_begin(struct ppm_writer *w, const char *filename,
+          unsigned int width, unsigned int height)
+{
+    char header[64];
+    const size_t header_size = ppm_header(header, width, height);
+    return ppm_begin_raw(w, filename, header, header_size, width, height, 3U);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      ppm_write_rows                                                        *
+ *  Purpose:                                                                  *
+ *      Appends rows of pixels to a file started with ppm_begin.              *
+ *  Arguments:                                                                *
+ *      w (struct ppm_writer *):                                              *
+ *          The writer.                                                       *
+ *      rows (const unsigned char *):                                         *
+ *          The pixels, width * pixel_size bytes per row.                     *
+ *      number_of_rows (unsigned int):                                        *
+ *          The number of rows to write.                                      *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+ppm_write_rows(struct ppm_writer *w, const unsigned char *rows,
+               unsigned int number_of_rows)
+{
+    const size_t size
+        = (size_t)number_of_rows * (size_t)w->width * w->pixel_size;
+    return ppm_write_all(w->fd, rows, size);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      ppm_map_raw                                                           *
+ *  Purpose:                                                                  *
+ *      Creates a file of the correct size, writes a header, and memory maps  *
+ *      it. Pixels written to the returned pointer end up in the file once    *
+ *      ppm_end is called.                                                    *
+ *  Arguments:                                                                *
+ *      w (struct ppm_writer *):                                              *
+ *          The writer, assumed to be uninitialized.                          *
+ *      filename (const char *):                                              *
+ *          The path to the output file.                                      *
+ *      header (const void *):                                                *
+ *          The bytes at the start of the file.                               *
+ *      header_size (size_t):                                                 *
+ *          The number of bytes in the header.                                *
+ *      width (unsigned int):                                                 *
+ *          The number of pixels in the x axis.                               *
+ *      height (unsigned int):                                                *
+ *          The number of pixels in the y axis.                               *
+ *      pixel_size (size_t):                                                  *
+ *          The number of bytes per pixel.                                    *
+ *  Output:                                                                   *
+ *      pixels (unsigned char *):                                             *
+ *          The first pixel of the image, width * height * pixel_size bytes   *
+ *          in total. NULL on failure.                                        *
+ ******************************************************************************/
+static inline unsigned char *
+ppm_map_raw(struct ppm_writer *w, const char *filename,
+            const void *header, size_t header_size,
+            unsigned int width, unsigned int height, size_t pixel_size)
+{
+    void *map;
+
+    w->width = width;
+    w->height = height;
+    w->map = NULL;
+    w->header_size = header_size;
+    w->pixel_size = pixel_size;
+    w->map_size = header_size + (size_t)width * (size_t)height * pixel_size;
+    w->fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (w->fd < 0)
+        return NULL;
+
+    /*  Grow the file to its final size, then map the whole thing.            */
+    if (ftruncate(w->fd, (off_t)w->map_size) != 0)
+        return NULL;
+
+    map = mmap(NULL, w->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+
+    if (map == MAP_FAILED)
+        return NULL;
+
+    w->map = map;
+    memcpy(w->map, header, w->header_size);
+    return w->map + w->header_size;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      ppm_map                                                               *
+ *  Purpose:                                                                  *
+ *      Creates a PPM file of the correct size, writes the preamble, and      *
+ *      memory maps it. Pixels written to the returned pointer end up in the  *
+ *      file once ppm_end is called.                                          *
+ *  Arguments:                                                                *
+ *      w (struct ppm_writer *):                                              *
+ *          The writer, assumed to be uninitialized.                          *
+ *      filename (const char *):                                              *
+ *          The path to the output file.                                      *
+ *      width (unsigned int):                                                 *
+ *          The number of pixels in the x axis.                               *
+ *      height (unsigned int):                                                *
+ *          The number of pixels in the y axis.                               *
+ *  Output:                                                                   *
+ *      pixels (unsigned char *):                                             *
+ *          The first pixel of the image, width * height * 3 bytes in total.  *
+ *          NULL on failure.                                                  *
+ ******************************************************************************/
+static inline unsigned char *
+ppm_map(struct ppm_writer *w, const char *filename,
+        unsigned int width, unsigned int height)
+{
+    char header[64];
+    const size_t header_size = ppm_header(header, width, height);
+    return ppm_map_raw(w, filename, header, header_size, width, height, 3U);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      ppm_end                                                               *
+ *  Purpose:                                                                  *
+ *      Unmaps (if needed) and closes a PPM file.                             *
+ *  Arguments:                                                                *
+ *      w (struct ppm_writer *):                                              *
+ *          The writer.                                                       *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+ppm_end(struct ppm_writer *w)
+{
+    int status = 0;
+
+    if (w->map)
+    {
+        if (munmap(w->map, w->map_size) != 0)
+            status = -1;
+
+        w->map = NULL;
+    }
+
+    if (w->fd >= 0)
+    {
+        if (close(w->fd) != 0)
+            status = -1;
+
+        w->fd = -1;
+    }
+
+    return status;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_raw                                                    *
+ *  Purpose:                                                                  *
+ *      Renders an image with several threads and saves it after a header.    *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, coloring, and pixel format. The pixels are *
+ *          written as they are, r->channels bytes each.                      *
+ *      filename (const char *):                                              *
+ *          The path to the output file.                                      *
+ *      header (const void *):                                                *
+ *          The bytes at the start of the file.                               *
+ *      header_size (size_t):                                                 *
+ *          The number of bytes in the header.                                *
+ *      number_of_threads (unsigned int):                                     *
+ *          The number of threads to use, including the calling thread.       *
+ *      use_mmap (int):                                                       *
+ *          Boolean for drawing directly into a memory mapped file. If zero,  *
+ *          the image is drawn a band of rows at a time, and each band is     *
+ *          written with a single call to write.                              *
+ *      pixels_iterated (size_t *):                                           *
+ *          If not NULL, set to the number of pixels iterated, the rest were  *
+ *          filled in by subdivision, see fractal_subdivide.h.                *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+fractal_render_raw(const struct fractal_renderer *r, const char *filename,
+                   const void *header, size_t header_size,
+                   unsigned int number_of_threads, int use_mmap,
+                   size_t *pixels_iterated)
+{
+    struct ppm_writer w;
+    unsigned char *band;
+    unsigned int y, band_rows;
+    const unsigned int width = r->viewport->width;
+    const unsigned int height = r->viewport->height;
+    const size_t pixel_size = r->channels;
+    const size_t row_size = (size_t)width * pixel_size;
+    size_t iterated = 0U;
+
+    if (use_mmap)
+    {
+        unsigned char * const pixels = ppm_map_raw(&w, filename, header,
+                                                   header_size, width, height,
+                                                   pixel_size);
+
+        if (!pixels)
+        {
+            ppm_end(&w);
+            return -1;
+        }
+
+        iterated = fractal_render_rows_parallel(r, pixels, 0U, height,
+                                                number_of_threads);
+
+        if (pixels_iterated)
+            *pixels_iterated = iterated;
+
+        return ppm_end(&w);
+    }
+
+    /*  Whole tiles per band so no thread is left with a sliver of work.      */
+    band_rows = (unsigned int)(PPM_BAND_BYTES / row_size);
+    band_rows -= band_rows % FRACTAL_TILE_SIZE;
+
+    if (band_rows == 0U)
+        band_rows = FRACTAL_TILE_SIZE;
+
+    if (band_rows > height)
+        band_rows = height;
+
+    band = malloc(row_size * band_rows);
+
+    if (!band)
+        return -1;
+
+    if (ppm_begin_raw(&w, filename, header, header_size,
+                      width, height, pixel_size) != 0)
+    {
+        free(band);
+        ppm_end(&w);
+        return -1;
+    }
+
+    for (y = 0U; y < height; y += band_rows)
+    {
+        const unsigned int rows
+            = (height - y < band_rows ? height - y : band_rows);
+
+        iterated += fractal_render_rows_parallel(r, band, y, y + rows,
+                                                 number_of_threads);
+
+        if (ppm_write_rows(&w, band, rows) != 0)
+        {
+            free(band);
+            ppm_end(&w);
+            return -1;
+        }
+    }
+
+    free(band);
+
+    if (pixels_iterated)
+        *pixels_iterated = iterated;
+
+    return ppm_end(&w);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_ppm                                                    *
+ *  Purpose:                                                                  *
+ *      Renders an image with several threads and saves it as a PPM file.     *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, and coloring. The image must be RGB.       *
+ *      filename (const char *):                                              *
+ *          The path to the output file.                                      *
+ *      number_of_threads (unsigned int):                                     *
+ *          The number of threads to use, including the calling thread.       *
+ *      use_mmap (int):                                                       *
+ *          Boolean for drawing directly into a memory mapped file. If zero,  *
+ *          the image is drawn a band of rows at a time, and each band is     *
+ *          written with a single call to write.                              *
+ *      pixels_iterated (size_t *):                                           *
+ *          If not NULL, set to the number of pixels iterated, the rest were  *
+ *          filled in by subdivision, see fractal_subdivide.h.                *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+fractal_render_ppm(const struct fractal_renderer *r, const char *filename,
+                   unsigned int number_of_threads, int use_mmap,
+                   size_t *pixels_iterated)
+{
+    char header[64];
+    size_t header_size;
+
+    if (r->channels != 3U)
+        return -1;
+
+    header_size = ppm_header(header, r->viewport->width, r->viewport->height);
+    return fractal_render_raw(r, filename, header, header_size,
+                              number_of_threads, use_mmap, pixels_iterated);
+}
+
+/*  What ppm_save_preview needs to know about the image.                      */
+struct ppm_preview {
+    const struct fractal_renderer *renderer;
+    const char *filename;
+};
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      ppm_save_preview                                                      *
+ *  Purpose:                                                                  *
+ *      Saves a preview of an image, see fractal_progressive.h. The preview   *
+ *      is written to a temporary file which then replaces the file named,    *
+ *      so a viewer watching it never sees half a preview.                    *
+ *  Arguments:                                                                *
+ *      data (void *):                                                        *
+ *          The image and file name, a struct ppm_preview.                    *
+ *      stride (unsigned int):                                                *
+ *          The distance between the pixels drawn so far. Unused.             *
+ *      image (const unsigned char *):                                        *
+ *          The preview.                                                      *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ ******************************************************************************/
+static inline int
+ppm_save_preview(void *data, unsigned int stride, const unsigned char *image)
+{
+    const struct ppm_preview * const p = data;
+    const struct fractal_viewport * const vp = p->renderer->viewport;
+    char temporary[4096];
+    struct ppm_writer w;
+    int status = 0;
+
+    (void)stride;
+
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", p->filename)
+        >= (int)sizeof(temporary))
+        return -1;
+
+    if (ppm_begin(&w, temporary, vp->width, vp->height) != 0 ||
+        ppm_write_rows(&w, image, vp->height) != 0)
+        status = -1;
+
+    if (ppm_end(&w) != 0)
+        status = -1;
+
+    if (status == 0 && rename(temporary, p->filename) != 0)
+        status = -1;
+
+    if (status != 0)
+        remove(temporary);
+
+    return status;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      fractal_render_ppm_progressive                                        *
+ *  Purpose:                                                                  *
+ *      Renders an image coarse to fine with several threads, saving a        *
+ *      preview after each coarse pass, and saves it as a PPM file. Without   *
+ *      a preview file this is fractal_render_ppm.                            *
+ *  Arguments:                                                                *
+ *      r (const struct fractal_renderer *):                                  *
+ *          The fractal, viewport, and coloring. The image must be RGB.       *
+ *      filename (const char *):                                              *
+ *          The path to the output file.                                      *
+ *      preview_filename (const char *):                                      *
+ *          The path the previews are saved to, each replacing the last, or   *
+ *          NULL to draw the image as fractal_render_ppm does.                *
+ *      number_of_threads (unsigned int):                                     *
+ *          The number of threads to use, including the calling thread.       *
+ *      use_mmap (int):                                                       *
+ *          Boolean for drawing directly into a memory mapped file. If zero,  *
+ *          the image is drawn in memory and written with one call to write.  *
+ *      pixels_iterated (size_t *):                                           *
+ *          If not NULL, set to the number of pixels iterated. With previews  *
+ *          this includes the quarter of the image the coarse passes draw in  *
+ *          full, see fractal_progressive.h.                                  *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 on success, -1 on failure.                                      *
+ *  Notes:                                                                    *
+ *      Unlike fractal_render_ppm, the whole image is held in memory, or      *
+ *      mapped, as the passes draw pixels all over it.                        *
+ ******************************************************************************/
+static inline int
+fractal_render_ppm_progressive(const struct fractal_renderer *r,
+                               const char *filename,
+                               const char *preview_filename,
+                               unsigned int number_of_threads, int use_mmap,
+                               size_t *pixels_iterated)
+{
+    struct ppm_writer w;
+    struct ppm_preview preview;
+    unsigned char *image;
+    const unsigned int width = r->viewport->width;
+    const unsigned int height = r->viewport->height;
+    int status = 0;
+
+    if (!preview_filename)
+        return fractal_render_ppm(r, filename, number_of_threads,
+                                  use_mmap, pixels_iterated);
+
+    if (r->channels != 3U)
+        return -1;
+
+    if (use_mmap)
+        image = ppm_map(&w, filename, width, height);
+    else
+    {
+        w.fd = -1;
+        w.map = NULL;
+        image = malloc((size_t)width * (size_t)height * 3U);
+    }
+
+    if (!image)
+    {
+        ppm_end(&w);
+        return -1;
+    }
+
+    preview.renderer = r;
+    preview.filename = preview_filename;
+
+    if (fractal_render_progressive(r, image, number_of_threads,
+                                   ppm_save_preview, &preview,
+                                   pixels_iterated) != 0)
+        status = -1;
+
+    if (!use_mmap)
+    {
+        if (status == 0 &&
+            (ppm_begin(&w, filename, width, height) != 0 ||
+             ppm_write_rows(&w, image, height) != 0))
+            status = -1;
+
+        free(image);
+    }
+
+    if (ppm_end(&w) != 0)
+        status = -1;
+
+    return status;
+}
+
+#endif
+/*  End of include guard.                                                     */
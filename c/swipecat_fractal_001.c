@@ -17,138 +17,104 @@
  *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
  ******************************************************************************/
 
-/*  FILE, fopen, fputc, puts, and other input / output functions found here.  */
+/*  puts and printf found here.                                               */
 #include <stdio.h>
 
-/*  exp and trig functions provided here.                                     */
-#include <math.h>
+/*  Viewports, the SwipeCat iteration, coloring, and rendering found here.    */
+#include "fractal.h"
 
-/*  Some implementations of libm provide pi / 2, some don't. Declare this as  *
- *  a macro for improved portability.                                         */
-#define PI_BY_TWO (+1.5707963267948966)
+/*  The --threads, --mmap, --field, and --preview options found here.         */
+#include "fractal_options.h"
 
-/*  Function for drawing a modified Mandelbrot set.                           */
-int main(void)
+/*  fractal_render_ppm_progressive, for drawing and saving the image, here.   */
+#include "ppm.h"
+
+/*  fractal_render_field, for saving the iteration counts instead, here.      */
+#include "fractal_field.h"
+
+/*  Function for drawing a modified Mandelbrot set. See fractal_options.h.    */
+int main(int argc, char **argv)
 {
     /*  The number of pixels in the x and y axes, respectively.               */
     const unsigned int width = 1024U;
     const unsigned int height = 1024U;
 
-    /*  The maximum number of iterations allowed.                             */
-    const unsigned int max_iters = 100U;
-
-    /*  Threshold for the coloring scheme.                                    */
-    const double zmax = 150.0;
-
     /*  Setup parameters for the image. These are the bounds of the PPM.      */
     const double x_min = -6.6;
     const double x_max = -0.4;
     const double y_min = -3.5;
     const double y_max = +3.5;
 
-    /*  Scale factors for converting from pixels to points.                   */
-    const double x_factor = (x_max - x_min) / (double)(width - 1U);
-    const double y_factor = (y_max - y_min) / (double)(height - 1U);
+    /*  The fractal, viewport, and renderer for the drawing.                  */
+    struct fractal swipecat;
+    struct fractal_viewport viewport;
+    struct fractal_renderer renderer;
 
-    /*  Variables for looping over the x and y components of the picture.     */
-    unsigned int x, y;
+    /*  Precomputed smooth colors, shared by the threads.                     */
+    struct fractal_colormap colormap;
 
-    /*  Index for keeping track of the number of iterations performed.        */
-    unsigned int iters;
+    /*  Settings from the command line, the number of threads and so on.      */
+    struct fractal_options opts;
 
-    /*  Variables for the color in RGB format.                                */
-    unsigned char red, green, blue;
-
-    /*  Dummy variable for creating the color scheme for the drawing.         */
-    double val;
-
-    /*  Declare a variable for the output file and give it write permission.  */
-    FILE * const fp = fopen("swipecat_fractal_001.ppm", "w");
+    if (fractal_parse_options(argc, argv, &opts) != 0)
+        return -1;
 
-    /*  fopen returns NULL on failure. Check for this.                        */
-    if (!fp)
+    /*  Coloring is a table lookup, rather than a log and two powers.         */
+    if (fractal_colormap_init(&colormap) != 0)
     {
-        puts("fopen return NULL. Aborting.");
+        puts("Failed to make the colormap. Aborting.");
         return -1;
     }
 
-    /*  Otherwise print the preamble to the PPM file.                         */
-    fprintf(fp, "P6\n%u %u\n255\n", width, height);
-
-    /*  Loop through each pixel for the y-axis.                               */
-    for (y = 0U; y < height; ++y)
+    /*  z_{n+1} = (pi/2)(exp(z_{n}) - z_{n}) + z_{0}, 100 iterations, and a   *
+     *  threshold of 150 for the coloring scheme.                             */
+    fractal_init_swipecat(&swipecat);
+    fractal_viewport_from_bounds(&viewport, width, height,
+                                 x_min, x_max, y_min, y_max);
+
+    renderer.fractal = &swipecat;
+    renderer.viewport = &viewport;
+    renderer.color = fractal_color_smooth;
+    renderer.channels = 3U;
+    renderer.reference = NULL;
+    renderer.center = NULL;
+    renderer.colormap = &colormap;
+
+    /*  The fill is not known to be exact for SwipeCat, iterate every pixel.  */
+    renderer.subdivide = FRACTAL_SUBDIVIDE_NONE;
+
+    /*  Save the raw iteration counts instead, to be colored later on.        */
+    if (opts.field_filename)
     {
-        /*  Calculate the imaginary part corresponding to these pixels.       */
-        const double c_y = y_max - (double)y * y_factor;
-
-        /*  Loop through each pixel in the x-axis.                            */
-        for (x = 0U; x < width; ++x)
+        if (fractal_render_field(&renderer, opts.field_filename,
+                                 opts.field_abs_z, opts.number_of_threads,
+                                 opts.use_mmap, NULL) != 0)
         {
-            /*  Calculate the real part corresponding to this pixel.          */
-            const double c_x = x_min + (double)x * x_factor;
-
-            /*  Initialize the complex number to the origin.                  */
-            double xn = 0.0;
-            double yn = 0.0;
-
-            /*  Factor used for creating a gradient in color.                 */
-            double background = 0.0;
-
-            /*  Start the iteration process. Stop when the iteration diverges *
-             *  outside of the circle, or when too many iterations are done.  */
-            for (iters = 0U; iters < max_iters; ++iters)
-            {
-                /*  Modified Mandelbrot iterate. Defined by                   *
-                 *  z_{n+1} = (pi/2)(exp(z_{n}) - z_{n}) + z_{0}.             */
-                const double exp_x = exp(xn);
-                xn = PI_BY_TWO*(exp_x*cos(yn) - xn) + c_x;
-                yn = PI_BY_TWO*(exp_x*sin(yn) - yn) + c_y;
-
-                /*  Once the iterate gets too big, abort the computation.     */
-                if (fabs(xn) >= zmax)
-                {
-                    /*  Gradient factor for coloring the image.               */
-                    background = log(log(fabs(xn) + 1.0) * 0.3333333333333);
-                    background = log(fabs((double)iters - background));
-                    background = background * 0.3076923076923077;
-                    break;
-                }
-            }
-
-            /*  Factor used for coloring.                                     */
-            val = 1.0 - fabs(1.0 - background);
-
-            /*  Non-positive corresponds to the modified Mandelbrot set.      */
-            if (val <= 0.0)
-            {
-                red = 0x00U;
-                green = 0x00U;
-                blue = 0x00U;
-            }
-
-            else if (background <= 1.0)
-            {
-                red = (unsigned char)(255.0 * pow(val, 4.0));
-                green = (unsigned char)(255.0 * pow(val, 2.5));
-                blue = (unsigned char)(unsigned char)(255.0 * val);
-            }
-
-            else
-            {
-                red = (unsigned char)(255.0 * val);
-                green = (unsigned char)(255.0 * pow(val, 1.5));
-                blue = (unsigned char)(255.0 * pow(val, 3.0));
-            }
-
-            /*  Add this current color to the image.                          */
-            fputc(red, fp);
-            fputc(green, fp);
-            fputc(blue, fp);
+            printf("Failed to write %s. Aborting.\n", opts.field_filename);
+            fractal_colormap_free(&colormap);
+            return -1;
         }
+
+        /*  Counters and timers, printed for FRACTAL_STATS builds only.       */
+        fractal_stats_finish(NULL);
+        fractal_colormap_free(&colormap);
+        return 0;
+    }
+
+    /*  Draw the image a band at a time, writing each band in one go, or      *
+     *  coarse to fine with --preview.                                        */
+    if (fractal_render_ppm_progressive(&renderer, "swipecat_fractal_001.ppm",
+                                       opts.preview_filename,
+                                       opts.number_of_threads, opts.use_mmap,
+                                       NULL) != 0)
+    {
+        puts("Failed to write swipecat_fractal_001.ppm. Aborting.");
+        fractal_colormap_free(&colormap);
+        return -1;
     }
 
-    /*  Close the file and return.                                            */
-    fclose(fp);
+    fractal_stats_finish(NULL);
+    fractal_colormap_free(&colormap);
     return 0;
 }
 /*  End of main.                                                              */
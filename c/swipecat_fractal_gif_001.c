@@ -16,100 +16,191 @@
  *  You should have received a copy of the GNU General Public License         *
  *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
  ******************************************************************************/
-
-#include <math.h>
 #include <stdlib.h>
 #include "gif.h"
+#include "fractal.h"
+#include "fractal_animate.h"
+#include "fractal_options.h"
+#include "fractal_zoom.h"
+
+/*  Settings shared by every frame of the zoom.                               */
+struct zoom {
+    double center_x, center_y, ds;
+    unsigned int width, height;
+    unsigned int keyframe_interval;
+    double oversample;
+    const struct fractal *fractal;
+
+    /*  Boolean for palette indices into fractal_smooth_colormap, rather than *
+     *  RGBA pixels.                                                          */
+    int global_palette;
 
-#define PI_BY_TWO 1.5707963267948966
+    /*  Precomputed smooth colors, shared by every worker.                    */
+    const struct fractal_colormap *colormap;
 
-struct complex_number {
-    double real, imag;
+    /*  One keyframe per worker thread.                                       */
+    struct fractal_keyframe *keyframes;
 };
 
-int main(void)
+/*  Draws a frame of the zoom, see fractal_frame_func in fractal_animate.h.   */
+static int
+zoom_draw_frame(void *data, unsigned int worker,
+                unsigned int frame, unsigned char *image)
+{
+    const struct zoom * const z = data;
+    struct fractal_keyframe * const keyframe = &z->keyframes[worker];
+    struct fractal_viewport viewport;
+    struct fractal_renderer renderer;
+    double ds = z->ds;
+    unsigned int n;
+
+    /*  Scale once per frame, rounding exactly as a running product would.    */
+    for (n = 0U; n < frame; ++n)
+        ds *= 0.95;
+
+    fractal_viewport_from_center(&viewport, z->width, z->height,
+                                 z->center_x, z->center_y, ds);
+
+    renderer.fractal = z->fractal;
+    renderer.viewport = &viewport;
+    renderer.color = z->global_palette ? fractal_index_smooth
+                                       : fractal_color_smooth;
+    renderer.channels = z->global_palette ? 1U : 4U;
+    renderer.reference = NULL;
+    renderer.center = NULL;
+    renderer.colormap = z->colormap;
+    renderer.subdivide = FRACTAL_SUBDIVIDE_NONE;
+
+    if (z->keyframe_interval > 1U)
+    {
+        /*  Frames are handed out in runs of keyframe_interval, so this       *
+         *  worker drew the keyframe for the run. The first frame of the run  *
+         *  is rendered exactly, and only the rest are resampled.             */
+        if (frame % z->keyframe_interval == 0U)
+        {
+            if (fractal_keyframe_begin(keyframe, &viewport, z->oversample,
+                                       renderer.channels) != 0)
+                return -1;
+
+            fractal_keyframe_render(keyframe, &renderer);
+        }
+        else
+        {
+            fractal_keyframe_resample(keyframe, &renderer, image);
+            return 0;
+        }
+    }
+
+    fractal_render(&renderer, image);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
 {
-    const unsigned int imax = 100U;
-    const double zmax = 150.0;
     const double center_x = -3.177;
     const double center_y = 0.85;
-    double ds = 3.0;
+    const double ds = 3.0;
     const unsigned int width = 512U;
     const unsigned int height = 512U;
     const unsigned int nframes = 200U;
-    uint8_t image[width*height*4];
 
-    unsigned int x, y, iters, frame;
-    unsigned char red, green, blue;
-    double c_x, c_y, backgnd, val, exp_x;
-    struct complex_number z, c;
+    unsigned int n;
+    int status;
+    struct fractal swipecat;
+    struct fractal_options opts;
+    struct fractal_animator animator;
+    struct zoom zoom;
+
+    unsigned char palette[256U * 3U];
+    struct fractal_colormap colormap;
 
     const char* filename = "swipecat_fractal_gif_001.gif";
     GifWriter writer;
-    GifBegin(&writer, filename, width, height, 2, 8, true);
 
-    for (frame = 0; frame < nframes; ++frame)
+    /*  --threads N sets the number of frames drawn at once, --keyframes K    *
+     *  resamples K - 1 of every K frames from a keyframe, and                *
+     *  --global-palette writes one fixed palette matching the smooth         *
+     *  coloring, and frames of indices into it.                              */
+    if (fractal_parse_options(argc, argv, &opts) != 0)
+        return -1;
+
+    /*  z_{n+1} = (pi/2)(exp(z_{n}) - z_{n}) + c, stopping at |Re(z)| >= 150. */
+    fractal_init_swipecat(&swipecat);
+
+    /*  Coloring is a table lookup, rather than a log and two powers.         */
+    if (fractal_colormap_init(&colormap) != 0)
     {
-        double x_min = center_x - ds;
-        double x_max = center_x + ds;
-        double y_min = center_y - ds;
-        double y_max = center_y + ds;
-
-        double x_factor = (x_max - x_min) / ((double)width - 1.0);
-        double y_factor = (y_max - y_min) / ((double)height - 1.0);
-        for (y = 0U; y < height; ++y)
-        {
-            c_y = y_max - (double)y * y_factor;
-            for (x = 0U; x < width; ++x)
-            {
-                c_x = x_min + (double)x * x_factor;
-                c.real = c_x;
-                c.imag = c_y;
-                z.real = 0.0;
-                z.imag = 0.0;
-                backgnd = 0.0;
-                for (iters = 0U; iters < imax; ++iters)
-                {
-                    exp_x = exp(z.real);
-                    z.real = PI_BY_TWO*(exp_x*cos(z.imag) - z.real) + c.real;
-                    z.imag = PI_BY_TWO*(exp_x*sin(z.imag) - z.imag) + c.imag;
-                    if (fabs(z.real) >= zmax)
-                    {
-                        backgnd = log(log(fabs(z.real) + 1.0) * 0.33333333333);
-                        backgnd = log(fabs((double)iters - backgnd));
-                        backgnd = backgnd * 0.3076923076923077;
-                        break;
-                    }
-                }
-
-                val = 1.0 - fabs(1.0 - backgnd);
-                if (val < 0.0)
-                    val = 0.0;
-
-                if (backgnd <= 1.0)
-                {
-                    red = (unsigned char)(255.0 * pow(val, 4.0));
-                    green = (unsigned char)(255.0 * pow(val, 2.5));
-                    blue = (unsigned char)(unsigned char)(255.0 * val);
-                }
-                else
-                {
-                    red = (unsigned char)(255.0 * val);
-                    green = (unsigned char)(255.0 * pow(val, 1.5));
-                    blue = (unsigned char)(255.0 * pow(val, 3.0));
-                }
-                uint8_t* pixel = &image[(y*width + x)*4];
-                pixel[0] = red;
-                pixel[1] = green;
-                pixel[2] = blue;
-                pixel[3] = 255;
-            }
-        }
+        puts("Failed to make the colormap. Aborting.");
+        return -1;
+    }
 
-        printf( "Writing frame %d...\n", frame );
-        GifWriteFrame(&writer, image, width, height, 2, 8, true);
-        ds *= 0.95;
+    zoom.center_x = center_x;
+    zoom.center_y = center_y;
+    zoom.ds = ds;
+    zoom.width = width;
+    zoom.height = height;
+    zoom.keyframe_interval = opts.keyframe_interval;
+
+    /*  The keyframe needs enough pixels for the last, smallest, frame that   *
+     *  uses it, see fractal_zoom.h.                                          */
+    zoom.oversample = pow(1.0 / 0.95, (double)(opts.keyframe_interval - 1U));
+    zoom.global_palette = opts.global_palette;
+    zoom.colormap = &colormap;
+    zoom.fractal = &swipecat;
+    zoom.keyframes = malloc(sizeof(*zoom.keyframes) * opts.number_of_threads);
+
+    if (!zoom.keyframes)
+    {
+        puts("Failed to allocate the keyframes. Aborting.");
+        fractal_colormap_free(&colormap);
+        return -1;
     }
+
+    for (n = 0U; n < opts.number_of_threads; ++n)
+        fractal_keyframe_init(&zoom.keyframes[n]);
+
+    /*  Each worker keeps a keyframe for a run of --keyframes frames,         *
+     *  with one extra run of frames buffered for the writer.                 */
+    animator.writer = &writer;
+    animator.width = width;
+    animator.height = height;
+    animator.number_of_frames = nframes;
+    animator.delay = 2U;
+    animator.bit_depth = 8;
+    animator.dither = true;
+    animator.indexed = opts.global_palette;
+    animator.draw = zoom_draw_frame;
+    animator.data = &zoom;
+    animator.number_of_threads = opts.number_of_threads;
+    animator.frames_per_task = opts.keyframe_interval;
+    animator.number_of_slots
+        = (opts.number_of_threads + 1U) * opts.keyframe_interval;
+    animator.print_progress = 1;
+
+    if (opts.global_palette)
+    {
+        fractal_smooth_colormap(palette);
+        GifBeginWithPalette(&writer, filename, width, height, 2, palette, 8);
+    }
+    else
+        GifBegin(&writer, filename, width, height, 2, 8, true);
+
+    status = fractal_animate(&animator);
     GifEnd(&writer);
-    return 0;
+
+    if (status != 0)
+        puts("Failed to draw the animation. Aborting.");
+    else if (fractal_stats_finish(opts.stats_filename) != 0)
+    {
+        printf("Failed to write %s.\n", opts.stats_filename);
+        status = -1;
+    }
+
+    for (n = 0U; n < opts.number_of_threads; ++n)
+        fractal_keyframe_free(&zoom.keyframes[n]);
+
+    free(zoom.keyframes);
+    fractal_colormap_free(&colormap);
+    return status;
 }
@@ -0,0 +1,664 @@
+/******************************************************************************
+ *                                  LICENSE                                   *
+ ******************************************************************************
+ *  This file is part of mandelbrot_set.                                      *
+ *                                                                            *
+ *  mandelbrot_set is free software: you can redistribute it and/or modify it *
+ *  under the terms of the GNU General Public License as published by         *
+ *  the Free Software Foundation, either version 3 of the License, or         *
+ *  (at your option) any later version.                                       *
+ *                                                                            *
+ *  mandelbrot_set is distributed in the hope that it will be useful,         *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ *  GNU General Public License for more details.                              *
+ *                                                                            *
+ *  You should have received a copy of the GNU General Public License         *
+ *  along with mandelbrot_set.  If not, see <https://www.gnu.org/licenses/>.  *
+ ******************************************************************************
+ *  Purpose:                                                                  *
+ *      Serves tiles of the fractals over HTTP, for map viewers such as       *
+ *      Leaflet or OpenLayers, see fractal_tilemap.h.                         *
+ *          tile_server [--port N] [--unix PATH] [--cache DIR] [--no-disk]    *
+ *                      [--memory MB] [--threads N] [--quiet]                 *
+ *      Tiles are at /LAYER/Z/X/Y.gif, the layers being mandelbrot, drawn as  *
+ *      in mandelbrot_set_gif_001, swipecat, as in swipecat_fractal_gif_001,  *
+ *      and multibrot3, z^3 + c. / lists the layers, and /stats gives the     *
+ *      number of tiles served from memory, from disk, and drawn.             *
+ *                                                                            *
+ *      The server listens on 127.0.0.1, port 8080 by default, or on a Unix   *
+ *      socket with --unix, for example for curl --unix-socket or a proxy.    *
+ *      Tiles are saved in the directory tile_cache, or DIR with --cache, and *
+ *      only kept in memory with --no-disk. The memory cache holds 64 MB of   *
+ *      tiles by default. Each request is logged unless --quiet is given.     *
+ *  Notes:                                                                    *
+ *      Requests are served one at a time, each tile being drawn with every   *
+ *      thread, which is all the threads would be doing anyway. Tiles served  *
+ *      from a cache take microseconds, so viewers are never kept waiting     *
+ *      long behind a tile being drawn.                                       *
+ *                                                                            *
+ *      Tiles never change, so they are sent with a long Cache-Control, and   *
+ *      with Access-Control-Allow-Origin so viewers on other hosts can use    *
+ *      them. The header X-Tile-Source says which cache a tile came from.     *
+ ******************************************************************************/
+
+/*  Sockets, sigaction, and clock_gettime are POSIX, rather than C99.         */
+#define _POSIX_C_SOURCE 200809L
+
+/*  errno and EINTR found here.                                               */
+#include <errno.h>
+
+/*  sigaction and SIGPIPE found here.                                         */
+#include <signal.h>
+
+/*  printf, puts, and snprintf found here.                                    */
+#include <stdio.h>
+
+/*  strtoul and strtoull found here.                                          */
+#include <stdlib.h>
+
+/*  strcmp, strncmp, strlen, strchr, and strstr found here.                   */
+#include <string.h>
+
+/*  clock_gettime found here.                                                 */
+#include <time.h>
+
+/*  Sockets, for TCP and for Unix domain sockets, found here.                 */
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+/*  close and unlink found here.                                              */
+#include <unistd.h>
+
+/*  The layers, caches, and drawing of tiles found here.                      */
+#include "fractal_tilemap.h"
+
+/*  The longest request read, which is plenty for a GET of a tile.            */
+#define TILE_SERVER_REQUEST_SIZE (4096U)
+
+/*  Seconds a client may take to send its request or read the response.       */
+#define TILE_SERVER_TIMEOUT (5)
+
+/*  Settings from the command line.                                           */
+struct tile_server_options {
+    unsigned int port;
+    const char *unix_path;
+    const char *directory;
+    size_t cache_bytes;
+    unsigned int number_of_threads;
+    int quiet;
+};
+
+/*  Set by SIGINT and SIGTERM, to stop the server between requests.           */
+static volatile sig_atomic_t tile_server_stopping = 0;
+
+static void
+tile_server_stop(int signal_number)
+{
+    (void)signal_number;
+    tile_server_stopping = 1;
+}
+
+/*  The time in seconds, from an arbitrary start.                             */
+static double
+tile_server_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + 1.0E-9 * (double)t.tv_nsec;
+}
+
+/*  The names of the sources in X-Tile-Source and /stats.                     */
+static const char * const tile_server_sources[3] = {
+    "memory", "disk", "drawn"
+};
+
+/*  Sends all of a buffer, retrying on short writes. Returns 0 or -1.         */
+static int
+tile_server_send(int fd, const void *data, size_t size)
+{
+    const char *bytes = (const char *)data;
+
+    while (size > 0U)
+    {
+        const ssize_t sent = send(fd, bytes, size, 0);
+
+        if (sent < 0 && errno == EINTR)
+            continue;
+
+        if (sent <= 0)
+            return -1;
+
+        bytes += sent;
+        size -= (size_t)sent;
+    }
+
+    return 0;
+}
+
+/*  Sends a response. extra is more header lines, each ending in \r\n.        *
+ *  The body is left out for HEAD requests.                                   */
+static int
+tile_server_respond(int fd, int is_head, const char *status,
+                    const char *type, const char *extra,
+                    const void *body, size_t size)
+{
+    char header[512];
+    const int length = snprintf(header, sizeof(header),
+                                "HTTP/1.1 %s\r\n"
+                                "Content-Type: %s\r\n"
+                                "Content-Length: %lu\r\n"
+                                "Access-Control-Allow-Origin: *\r\n"
+                                "%s"
+                                "Connection: close\r\n\r\n",
+                                status, type, (unsigned long)size, extra);
+
+    if (length < 0 || (size_t)length >= sizeof(header))
+        return -1;
+
+    if (tile_server_send(fd, header, (size_t)length) != 0)
+        return -1;
+
+    return is_head ? 0 : tile_server_send(fd, body, size);
+}
+
+/*  Sends a short plain text response, for errors and the index.              */
+static int
+tile_server_text(int fd, int is_head, const char *status, const char *text)
+{
+    return tile_server_respond(fd, is_head, status,
+                               "text/plain; charset=utf-8", "",
+                               text, strlen(text));
+}
+
+/*  Reads a number followed by the character end. Returns the character       *
+ *  after end, or NULL if the text is not a number in [0, max].               */
+static const char *
+tile_server_number(const char *text, char end, unsigned long long max,
+                   unsigned long long *value)
+{
+    char *stop;
+
+    if (*text < '0' || *text > '9')
+        return NULL;
+
+    errno = 0;
+    *value = strtoull(text, &stop, 10);
+
+    if (errno != 0 || *value > max || *stop != end)
+        return NULL;
+
+    return stop + 1;
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      tile_server_tile                                                      *
+ *  Purpose:                                                                  *
+ *      Answers a request for /LAYER/Z/X/Y.gif.                               *
+ *  Arguments:                                                                *
+ *      map (struct fractal_tilemap *):                                       *
+ *          The layers and caches.                                            *
+ *      fd (int):                                                             *
+ *          The connection.                                                   *
+ *      is_head (int):                                                        *
+ *          Boolean for a HEAD request, which gets no body.                   *
+ *      path (const char *):                                                  *
+ *          The path, after the leading '/', ending in a space or '?'.        *
+ *      status (const char **):                                               *
+ *          Set to the status sent, for the log.                              *
+ *      source (const char **):                                               *
+ *          Set to where the tile came from, for the log.                     *
+ *  Output:                                                                   *
+ *      status (int):                                                         *
+ *          0 if the response was sent, -1 otherwise.                         *
+ ******************************************************************************/
+static int
+tile_server_tile(struct fractal_tilemap *map, int fd, int is_head,
+                 const char *path, const char **status, const char **source)
+{
+    const char * const slash = strchr(path, '/');
+    const struct fractal_tilemap_layer *layer = NULL;
+    unsigned long long z, x, y;
+    enum fractal_tilemap_source from;
+    const unsigned char *data;
+    char extra[128];
+    size_t size;
+    int result;
+
+    *status = "404 Not Found";
+
+    if (slash)
+        layer = fractal_tilemap_find(map, path, (size_t)(slash - path));
+
+    if (!layer)
+        return tile_server_text(fd, is_head, *status, "No such layer.\n");
+
+    path = tile_server_number(slash + 1, '/', FRACTAL_TILEMAP_MAX_ZOOM, &z);
+
+    if (path)
+        path = tile_server_number(path, '/', (1ULL << z) - 1ULL, &x);
+
+    if (path)
+        path = tile_server_number(path, '.', (1ULL << z) - 1ULL, &y);
+
+    if (!path || strncmp(path, "gif", 3U) != 0 ||
+        (path[3] != ' ' && path[3] != '?'))
+        return tile_server_text(fd, is_head, *status, "No such tile.\n");
+
+    result = fractal_tilemap_get(map, layer, (unsigned int)z, x, y,
+                                 &data, &size, &from);
+
+    /*  Tiles past the depth the layer can be drawn to are simply not there.  */
+    if (result == FRACTAL_TILEMAP_UNAVAILABLE)
+        return tile_server_text(fd, is_head, *status,
+                                "No such tile, it is too deep to draw.\n");
+
+    /*  Drawing failed, or memory ran out.                                    */
+    if (result != 0)
+    {
+        *status = "500 Internal Server Error";
+        return tile_server_text(fd, is_head, *status,
+                                "The tile could not be drawn.\n");
+    }
+
+    *status = "200 OK";
+    *source = tile_server_sources[from];
+    snprintf(extra, sizeof(extra),
+             "Cache-Control: public, max-age=31536000, immutable\r\n"
+             "X-Tile-Source: %s\r\n", *source);
+
+    return tile_server_respond(fd, is_head, *status, "image/gif", extra,
+                               data, size);
+}
+
+/*  Lists the layers and the URL of their tiles.                              */
+static int
+tile_server_index(const struct fractal_tilemap *map, int fd, int is_head)
+{
+    char text[2048];
+    size_t length = 0U;
+    unsigned int n;
+
+    length += (size_t)snprintf(text, sizeof(text),
+                               "Tiles are %ux%u GIFs, zoom 0 to %u.\n",
+                               FRACTAL_TILEMAP_SIZE, FRACTAL_TILEMAP_SIZE,
+                               FRACTAL_TILEMAP_MAX_ZOOM);
+
+    for (n = 0U; n < map->number_of_layers; ++n)
+        length += (size_t)snprintf(text + length, sizeof(text) - length,
+                                   "/%s/{z}/{x}/{y}.gif\n",
+                                   map->layers[n].name);
+
+    return tile_server_text(fd, is_head, "200 OK", text);
+}
+
+/*  Gives the number of tiles served from each source, and the memory used.   */
+static int
+tile_server_stats(const struct fractal_tilemap *map, int fd, int is_head)
+{
+    char text[512];
+
+    snprintf(text, sizeof(text),
+             "memory %llu\ndisk %llu\ndrawn %llu\n"
+             "cached_tiles %lu\ncached_bytes %lu\ncapacity_bytes %lu\n",
+             map->served[FRACTAL_TILEMAP_FROM_MEMORY],
+             map->served[FRACTAL_TILEMAP_FROM_DISK],
+             map->served[FRACTAL_TILEMAP_DRAWN],
+             (unsigned long)map->cache.number_of_entries,
+             (unsigned long)map->cache.bytes,
+             (unsigned long)map->cache.capacity);
+
+    return tile_server_text(fd, is_head, "200 OK", text);
+}
+
+/******************************************************************************
+ *  Function:                                                                 *
+ *      tile_server_handle                                                    *
+ *  Purpose:                                                                  *
+ *      Reads a request from a connection and answers it.                     *
+ *  Arguments:                                                                *
+ *      map (struct fractal_tilemap *):                                       *
+ *          The layers and caches.                                            *
+ *      fd (int):                                                             *
+ *          The connection, which the caller closes.                          *
+ *      quiet (int):                                                          *
+ *          Boolean for not logging the request.                              *
+ *  Output:                                                                   *
+ *      None (void).                                                          *
+ ******************************************************************************/
+static void
+tile_server_handle(struct fractal_tilemap *map, int fd, int quiet)
+{
+    char request[TILE_SERVER_REQUEST_SIZE + 1U];
+    const char *status = "400 Bad Request";
+    const char *source = "";
+    const char *path = NULL;
+    const double start = tile_server_now();
+    size_t length = 0U;
+    int is_head = 0;
+
+    /*  Everything up to the blank line ending the headers.                   */
+    while (length < TILE_SERVER_REQUEST_SIZE)
+    {
+        const ssize_t received = recv(fd, request + length,
+                                      TILE_SERVER_REQUEST_SIZE - length, 0);
+
+        if (received < 0 && errno == EINTR)
+            continue;
+
+        if (received <= 0)
+            break;
+
+        length += (size_t)received;
+        request[length] = '\0';
+
+        if (strstr(request, "\r\n\r\n"))
+            break;
+    }
+
+    request[length] = '\0';
+
+    if (strncmp(request, "GET /", 5U) == 0)
+        path = request + 5;
+    else if (strncmp(request, "HEAD /", 6U) == 0)
+    {
+        path = request + 6;
+        is_head = 1;
+    }
+
+    if (length == 0U)
+        return;
+
+    if (!path || !strstr(request, "\r\n\r\n") || !strchr(path, ' '))
+        tile_server_text(fd, 0, status, "Bad request.\n");
+    else if (path[0] == ' ' || path[0] == '?')
+    {
+        status = "200 OK";
+        tile_server_index(map, fd, is_head);
+    }
+    else if (strncmp(path, "stats ", 6U) == 0 ||
+             strncmp(path, "stats?", 6U) == 0)
+    {
+        status = "200 OK";
+        tile_server_stats(map, fd, is_head);
+    }
+    else
+        tile_server_tile(map, fd, is_head, path, &status, &source);
+
+    if (!quiet)
+    {
+        const char * const end = path ? strchr(path, ' ') : NULL;
+        const int path_length = end ? (int)(end - path) : 0;
+
+        printf("%s /%.*s %s %s %.3fms\n", is_head ? "HEAD" : "GET",
+               path_length, path ? path : "", status, source,
+               1.0E3 * (tile_server_now() - start));
+        fflush(stdout);
+    }
+}
+
+/*  Opens the socket the server listens on. Returns it, or -1.                */
+static int
+tile_server_listen(const struct tile_server_options *opts)
+{
+    int fd;
+
+    if (opts->unix_path)
+    {
+        struct sockaddr_un address;
+        struct stat info;
+
+        if (strlen(opts->unix_path) >= sizeof(address.sun_path))
+            return -1;
+
+        /*  A socket left by an earlier run is replaced, other files aren't.  */
+        if (stat(opts->unix_path, &info) == 0 && S_ISSOCK(info.st_mode))
+            unlink(opts->unix_path);
+
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, opts->unix_path);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (fd < 0)
+            return -1;
+
+        if (bind(fd, (const struct sockaddr *)&address, sizeof(address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+    else
+    {
+        struct sockaddr_in address;
+        const int reuse = 1;
+
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons((unsigned short)opts->port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+
+        if (fd < 0)
+            return -1;
+
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if (bind(fd, (const struct sockaddr *)&address, sizeof(address)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (listen(fd, 64) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*  Reads a whole number in [min, max]. Returns 0, or -1 if it is not one.    */
+static int
+tile_server_read_number(const char *text, unsigned long min,
+                        unsigned long max, unsigned long *value)
+{
+    char *end;
+
+    if (*text < '0' || *text > '9')
+        return -1;
+
+    errno = 0;
+    *value = strtoul(text, &end, 10);
+
+    if (errno != 0 || *end != '\0' || *value < min || *value > max)
+        return -1;
+
+    return 0;
+}
+
+/*  Reads the command line. Returns 0, or -1 after printing the usage.        */
+static int
+tile_server_parse_options(int argc, char **argv,
+                          struct tile_server_options *opts)
+{
+    unsigned long value;
+    int n;
+
+    opts->port = 8080U;
+    opts->unix_path = NULL;
+    opts->directory = "tile_cache";
+    opts->cache_bytes = (size_t)64U << 20U;
+    opts->number_of_threads = fractal_default_threads();
+    opts->quiet = 0;
+
+    for (n = 1; n < argc; ++n)
+    {
+        const int has_value = (n + 1 < argc);
+
+        if (strcmp(argv[n], "--port") == 0 && has_value &&
+            tile_server_read_number(argv[n + 1], 1UL, 65535UL, &value) == 0)
+            opts->port = (unsigned int)value;
+        else if (strcmp(argv[n], "--memory") == 0 && has_value &&
+                 tile_server_read_number(argv[n + 1], 0UL, 65536UL,
+                                         &value) == 0)
+            opts->cache_bytes = (size_t)value << 20U;
+        else if (strcmp(argv[n], "--threads") == 0 && has_value &&
+                 tile_server_read_number(argv[n + 1], 1UL,
+                                         FRACTAL_MAX_THREADS, &value) == 0)
+            opts->number_of_threads = (unsigned int)value;
+        else if (strcmp(argv[n], "--unix") == 0 && has_value)
+            opts->unix_path = argv[n + 1];
+        else if (strcmp(argv[n], "--cache") == 0 && has_value)
+            opts->directory = argv[n + 1];
+        else if (strcmp(argv[n], "--no-disk") == 0)
+        {
+            opts->directory = NULL;
+            continue;
+        }
+        else if (strcmp(argv[n], "--quiet") == 0)
+        {
+            opts->quiet = 1;
+            continue;
+        }
+        else
+            break;
+
+        /*  Skip the value of the option.                                     */
+        ++n;
+    }
+
+    if (n < argc)
+    {
+        printf("Usage: [--port N] [--unix PATH] [--cache DIR] [--no-disk] "
+               "[--memory MB] [--threads N] [--quiet], 1 <= N <= %u for "
+               "--threads.\n", FRACTAL_MAX_THREADS);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*  Adds the layers served, set up as in the programs they come from.         */
+static int
+tile_server_add_layers(struct fractal_tilemap *map)
+{
+    struct fractal f;
+
+    /*  The Mandelbrot set of mandelbrot_set_gif_001. 32 more iterations per  *
+     *  level keep the boundary detailed down to the deepest tiles.           */
+    fractal_init_mandelbrot(&f);
+    f.escape_test = FRACTAL_ESCAPE_REAL_PART;
+    f.start_at_c = 0;
+    f.check_period = 1;
+    f.period_tolerance = 1E-12;
+
+    if (fractal_tilemap_add(map, "mandelbrot", &f, -0.75, 0.0, 4.0, 32U))
+        return -1;
+
+    /*  The SwipeCat fractal of swipecat_fractal_gif_001.                     */
+    fractal_init_swipecat(&f);
+
+    if (fractal_tilemap_add(map, "swipecat", &f, -3.5, 0.0, 7.0, 16U))
+        return -1;
+
+    /*  The cubic Multibrot set, one of the powers of mandelbrot_set_gif_002. */
+    fractal_init_multibrot(&f, 3.0);
+
+    return fractal_tilemap_add(map, "multibrot3", &f, 0.0, 0.0, 3.0, 16U);
+}
+
+int main(int argc, char **argv)
+{
+    static struct fractal_tilemap map;
+    struct tile_server_options opts;
+    struct sigaction action;
+    struct timeval timeout;
+    int listener;
+
+    if (tile_server_parse_options(argc, argv, &opts) != 0)
+        return -1;
+
+    if (fractal_tilemap_init(&map, opts.cache_bytes, opts.directory,
+                             opts.number_of_threads) != 0 ||
+        tile_server_add_layers(&map) != 0)
+    {
+        if (opts.directory)
+            printf("Failed to make %s, or out of memory. Aborting.\n",
+                   opts.directory);
+        else
+            puts("Failed to allocate the tile cache. Aborting.");
+
+        fractal_tilemap_free(&map);
+        return -1;
+    }
+
+    listener = tile_server_listen(&opts);
+
+    if (listener < 0)
+    {
+        if (opts.unix_path)
+            printf("Failed to listen on %s. Aborting.\n", opts.unix_path);
+        else
+            printf("Failed to listen on port %u. Aborting.\n", opts.port);
+
+        fractal_tilemap_free(&map);
+        return -1;
+    }
+
+    /*  Clients that hang up early must not kill the server. SIGINT and       *
+     *  SIGTERM interrupt accept, rather than restarting it, to stop it.      */
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, NULL);
+    action.sa_handler = tile_server_stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    if (opts.unix_path)
+        printf("Serving tiles on %s.\n", opts.unix_path);
+    else
+        printf("Serving tiles on http://127.0.0.1:%u/\n", opts.port);
+
+    fflush(stdout);
+
+    timeout.tv_sec = TILE_SERVER_TIMEOUT;
+    timeout.tv_usec = 0;
+
+    while (!tile_server_stopping)
+    {
+        const int fd = accept(listener, NULL, NULL);
+
+        if (fd < 0)
+            continue;
+
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        tile_server_handle(&map, fd, opts.quiet);
+        close(fd);
+    }
+
+    close(listener);
+
+    if (opts.unix_path)
+        unlink(opts.unix_path);
+
+    printf("Served %llu tiles from memory, %llu from disk, drew %llu.\n",
+           map.served[FRACTAL_TILEMAP_FROM_MEMORY],
+           map.served[FRACTAL_TILEMAP_FROM_DISK],
+           map.served[FRACTAL_TILEMAP_DRAWN]);
+
+    fractal_tilemap_free(&map);
+    return 0;
+}